@@ -69,6 +69,15 @@ namespace ignition
       /// \return true if the update was successfull
       public: virtual bool Update(const common::Time &_now) override;
 
+      // Documentation inherited
+      public: virtual bool HasSubscribers() const override;
+
+      // Documentation inherited
+      public: virtual bool SaveState(std::ostream &_out) const override;
+
+      // Documentation inherited
+      public: virtual bool LoadState(std::istream &_in) override;
+
       /// \brief Set the reference altitude.
       /// \param[in] _ref Verical reference position in meters
       public: void SetReferenceAltitude(double _reference);
@@ -78,6 +78,12 @@ namespace ignition
       /// \return true if the update was successfull
       public: virtual bool Update(const common::Time &_now) override;
 
+      // Documentation inherited
+      public: virtual bool HasSubscribers() const override;
+
+      // Documentation inherited
+      public: virtual SensorMemoryUsage MemoryUsage() const override;
+
       /// \brief Set a callback to be called when image frame data is
       /// generated.
       /// \param[in] _callback This callback will be called every time the
@@ -120,6 +126,91 @@ namespace ignition
       /// \return The distance from the 1st camera, in meters.
       public: double Baseline() const;
 
+      /// \brief Set whether camera info is only published when it changes
+      /// instead of with every frame. In this mode the message is also
+      /// published when the info topic first gets subscribers, and at the
+      /// heartbeat period if one is set. Defaults to false.
+      /// \param[in] _onChange True to publish only when the info changes.
+      /// \sa SetInfoHeartbeat
+      public: void SetInfoOnChange(bool _onChange);
+
+      /// \brief Get whether camera info is only published when it changes.
+      /// \return True if camera info is only published when it changes.
+      public: bool InfoOnChange() const;
+
+      /// \brief Set the period at which unchanged camera info is published
+      /// again when SetInfoOnChange is enabled. Defaults to zero, which
+      /// disables the heartbeat.
+      /// \param[in] _period Heartbeat period in simulation time.
+      public: void SetInfoHeartbeat(const common::Time &_period);
+
+      /// \brief Get the camera info heartbeat period.
+      /// \return Heartbeat period, zero if disabled.
+      public: common::Time InfoHeartbeat() const;
+
+      /// \brief Enable or disable publishing delta images on DeltaTopic().
+      /// A delta image only holds the tiles that changed since the previous
+      /// image, with a full keyframe sent periodically. Images are only
+      /// encoded while the topic has subscribers. Use ImageDeltaDecoder to
+      /// reconstruct the images.
+      /// \param[in] _enabled True to publish delta images.
+      /// \return True if successful.
+      /// \sa ImageDeltaEncoder
+      public: bool SetDeltaImagesEnabled(bool _enabled);
+
+      /// \brief Get whether delta images are published.
+      /// \return True if delta images are published.
+      public: bool DeltaImagesEnabled() const;
+
+      /// \brief Topic where delta images are published.
+      /// \return Delta image topic.
+      public: std::string DeltaTopic() const;
+
+      /// \brief Set the tile width and height of delta images. Defaults to
+      /// 64.
+      /// \param[in] _size Tile size in pixels.
+      public: void SetDeltaTileSize(unsigned int _size);
+
+      /// \brief Set the number of delta images between keyframes. Defaults
+      /// to 30. New subscribers can reconstruct images from the next
+      /// keyframe on.
+      /// \param[in] _interval Keyframe interval, zero to send keyframes
+      /// only when the image size changes or subscribers first connect.
+      public: void SetDeltaKeyframeInterval(unsigned int _interval);
+
+      /// \brief Set the bounds of the resolution scale. The width and height
+      /// of the images are scaled to keep the render time under the target
+      /// set with SetTargetRenderTime, and camera info intrinsics are scaled
+      /// along. Images carry their scale in a "resolution_scale" header
+      /// entry while scaling is enabled. Both bounds default to 1, which
+      /// disables scaling. Supported by camera and depth camera sensors.
+      /// \param[in] _min Lower bound, greater than zero.
+      /// \param[in] _max Upper bound, not less than the lower bound.
+      /// \return False if the bounds are invalid.
+      public: bool SetResolutionScaleBounds(double _min, double _max);
+
+      /// \brief Get the lower bound of the resolution scale.
+      /// \return Lower bound.
+      public: double MinResolutionScale() const;
+
+      /// \brief Get the upper bound of the resolution scale.
+      /// \return Upper bound.
+      public: double MaxResolutionScale() const;
+
+      /// \brief Set the time to aim for when rendering a frame. Defaults to
+      /// zero, which keeps the resolution scale at its upper bound.
+      /// \param[in] _time Target render time, in wall clock time.
+      /// \sa SetResolutionScaleBounds
+      public: void SetTargetRenderTime(const common::Time &_time);
+
+      /// \brief Get the time to aim for when rendering a frame.
+      /// \return Target render time.
+      public: common::Time TargetRenderTime() const;
+
+      /// \brief Get the current resolution scale.
+      /// \return Scale of the image width and height.
+      public: double ResolutionScale() const;
+
       /// \brief Advertise camera info topic.
       /// \return True if successful.
       protected: bool AdvertiseInfo();
@@ -136,10 +227,32 @@ namespace ignition
       /// information.
       protected: void PopulateInfo(const sdf::Camera *_cameraSdf);
 
-      /// \brief Publish camera info message.
+      /// \brief Publish camera info message. The message is kept serialized
+      /// and only rebuilt after PopulateInfo or SetBaseline.
       /// \param[in] _now The current time
       protected: void PublishInfo(const ignition::common::Time &_now);
 
+      /// \brief Get the image size at the current resolution scale.
+      /// \param[in,out] _width Full image width, replaced by the scaled
+      /// width.
+      /// \param[in,out] _height Full image height, replaced by the scaled
+      /// height.
+      /// \return False if resolution scaling isn't in use, in which case
+      /// the size is unchanged.
+      protected: bool ScaledImageSize(unsigned int &_width,
+                     unsigned int &_height);
+
+      /// \brief Add the time taken to render a frame, to adapt the
+      /// resolution scale.
+      /// \param[in] _seconds Render time in seconds.
+      protected: void AddRenderTime(double _seconds);
+
+      /// \brief Scale the camera info to an image size. The intrinsics of
+      /// the size set by PopulateInfo are scaled by the ratio of the sizes.
+      /// \param[in] _width Image width.
+      /// \param[in] _height Image height.
+      protected: void ScaleInfo(unsigned int _width, unsigned int _height);
+
       /// \brief Create a camera in a scene
       /// \return True on success.
       private: bool CreateCamera();
@@ -50,6 +50,8 @@ namespace ignition
     ///
     /// This class creates depth image from an ignition rendering scene.
     /// The scene  must be created in advance and given to Manager::Init().
+    /// Without a rendering scene, depth is rendered on the CPU by casting
+    /// rays into the scene set with SetCpuScene.
     /// It offers both an ignition-transport interface and a direct C++ API
     /// to access the image data. The API works by setting a callback to be
     /// called with image data.
@@ -81,6 +83,49 @@ namespace ignition
       /// \return true if the update was successfull
       public: virtual bool Update(const common::Time &_now) override;
 
+      // Documentation inherited
+      public: virtual bool HasSubscribers() const override;
+
+      // Documentation inherited
+      public: virtual SensorMemoryUsage MemoryUsage() const override;
+
+      /// \brief Set whether the point cloud keeps only the pixels with a
+      /// finite depth. The cloud is then unorganized and dense, which saves
+      /// bandwidth and processing when much of the view is sky. Otherwise
+      /// it has a point per pixel, including infinite and NaN points.
+      /// \param[in] _dense True to drop pixels without a depth.
+      /// \sa SetDensePointCloudIndex
+      public: void SetDensePointCloud(bool _dense);
+
+      /// \brief Get whether the point cloud is compacted into a dense cloud.
+      /// \return True if invalid points are dropped.
+      public: bool DensePointCloud() const;
+
+      /// \brief Set whether a dense point cloud has UINT16 "row" and
+      /// "column" fields with the position of the pixel of each point.
+      /// \param[in] _index True to add the fields.
+      /// \sa SetDensePointCloud
+      public: void SetDensePointCloudIndex(bool _index);
+
+      /// \brief Get whether a dense point cloud has row and column fields.
+      /// \return True if the fields are added.
+      public: bool DensePointCloudIndex() const;
+
+      /// \brief Set the frame the point cloud is published in. When set,
+      /// points are transformed into the frame using the pose of the camera
+      /// when it rendered, see Sensor::Pose(), once the cloud is filled, so
+      /// that consumers get world or vehicle frame points directly.
+      /// \param[in] _frameId Target frame id, or empty for the camera
+      /// frame, the default.
+      /// \param[in] _targetPoseInWorld Pose of the target frame in the
+      /// frame Pose() is relative to, the world by default.
+      public: void SetPointCloudFrame(const std::string &_frameId,
+          const math::Pose3d &_targetPoseInWorld = math::Pose3d::Zero);
+
+      /// \brief Get the frame the point cloud is published in.
+      /// \return Target frame id, empty for the sensor frame.
+      public: std::string PointCloudFrame() const;
+
       /// \brief Force the sensor to generate data
       /// \param[in] _now The current time
       /// \return true if the update was successfull
@@ -145,6 +190,10 @@ namespace ignition
       /// \return True on success.
       private: bool CreateCamera();
 
+      /// \brief Set up rendering on the CPU from the camera SDF.
+      /// \return True on success.
+      private: bool CreateCpuCamera();
+
       /// \brief Callback that is triggered when the scene changes on
       /// the Manager.
       /// \param[in] _scene Pointer to the new scene.
@@ -38,6 +38,11 @@ namespace ignition
     ignition/sensors/GaussianNoiseModel.hh
     **/
     /// \brief Gaussian noise class
+    ///
+    /// Each model draws its samples from its own random number stream,
+    /// seeded from ignition::math::Rand when loaded, so that its state can
+    /// be saved and restored independently of other users of
+    /// ignition::math::Rand.
     class IGNITION_SENSORS_VISIBLE GaussianNoiseModel : public Noise
     {
       /// \brief Constructor.
@@ -67,6 +72,12 @@ namespace ignition
       /// Documentation inherited
       public: virtual void Print(std::ostream &_out) const override;
 
+      // Documentation inherited.
+      public: bool SaveState(std::ostream &_out) const override;
+
+      // Documentation inherited.
+      public: bool LoadState(std::istream &_in) override;
+
       /// \brief Private data pointer.
       private: GaussianNoiseModelPrivate *dataPtr = nullptr;
     };
@@ -60,6 +60,50 @@ namespace ignition
       /// \return true if the update was successfull
       public: virtual bool Update(const common::Time &_now) override;
 
+      // Documentation inherited
+      public: virtual bool HasSubscribers() const override;
+
+      // Documentation inherited
+      public: virtual SensorMemoryUsage MemoryUsage() const override;
+
+      /// \brief Set whether the point cloud keeps only the rays that hit
+      /// something. The cloud is then unorganized and dense, and much
+      /// smaller in open scenes. Otherwise it is organized, with a point
+      /// per ray, and rays without a return are infinite.
+      /// \param[in] _dense True to drop rays without a return.
+      /// \sa SetDensePointCloudIndex
+      public: void SetDensePointCloud(bool _dense);
+
+      /// \brief Get whether the point cloud is compacted into a dense cloud.
+      /// \return True if invalid points are dropped.
+      public: bool DensePointCloud() const;
+
+      /// \brief Set whether a dense point cloud has UINT16 "row" and
+      /// "column" fields with the position of the ray of each point.
+      /// \param[in] _index True to add the fields.
+      /// \sa SetDensePointCloud
+      public: void SetDensePointCloudIndex(bool _index);
+
+      /// \brief Get whether a dense point cloud has row and column fields.
+      /// \return True if the fields are added.
+      public: bool DensePointCloudIndex() const;
+
+      /// \brief Set the frame the point cloud is published in. When set,
+      /// every point is transformed into the frame using the pose of the
+      /// lidar at the time of the scan, see Sensor::Pose(), once the cloud
+      /// is filled, and the cloud is stamped with the frame id.
+      /// \param[in] _frameId Target frame id, empty for the lidar frame,
+      /// the default.
+      /// \param[in] _targetPoseInWorld Pose of the target frame in the
+      /// frame Pose() is relative to, the world by default. Keep it zero
+      /// when the target frame is that frame itself, such as "world".
+      public: void SetPointCloudFrame(const std::string &_frameId,
+          const math::Pose3d &_targetPoseInWorld = math::Pose3d::Zero);
+
+      /// \brief Get the frame the point cloud is published in.
+      /// \return Target frame id, empty for the sensor frame.
+      public: std::string PointCloudFrame() const;
+
       /// \brief Initialize values in the sensor
       /// \return True on success
       public: virtual bool Init() override;
@@ -116,6 +160,11 @@ namespace ignition
                   unsigned int _heighti, unsigned int _channels,
                   const std::string &/*_format*/)> _subscriber) override;
 
+      /// \brief The rays are rendered at once, so a scan can't be published
+      /// in packets any earlier than as a whole.
+      /// \return False
+      protected: virtual bool SupportsPackets() const override;
+
       /// \brief Data pointer for private data
       /// \internal
       private: std::unique_ptr<GpuLidarSensorPrivate> dataPtr;
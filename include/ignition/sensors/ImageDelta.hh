@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef IGNITION_SENSORS_IMAGEDELTA_HH_
+#define IGNITION_SENSORS_IMAGEDELTA_HH_
+
+#include <cstddef>
+#include <memory>
+
+#include <ignition/msgs/image.pb.h>
+
+#include "ignition/sensors/config.hh"
+#include "ignition/sensors/Export.hh"
+
+namespace ignition
+{
+  namespace sensors
+  {
+    // Inline bracket to help doxygen filtering.
+    inline namespace IGNITION_SENSORS_VERSION_NAMESPACE {
+    //
+    /// \brief forward declarations
+    class ImageDeltaEncoderPrivate;
+    class ImageDeltaDecoderPrivate;
+
+    /// \brief Encodes a stream of images as the tiles that changed since
+    /// the previous image.
+    ///
+    ///   Images are split into square tiles and a hash of each tile is kept
+    /// between frames. A delta image is a msgs::Image with the size and
+    /// format of the full image, whose data only holds the rows of the
+    /// tiles that changed, one tile after the other. The header lists the
+    /// changed tiles:
+    ///
+    ///   * "delta_keyframe": "1" if the data holds the full image, "0"
+    ///     otherwise.
+    ///   * "delta_tile_size": Tile width and height in pixels.
+    ///   * "delta_tiles": Row-major index of each tile in the data.
+    ///   * "delta_seq": Number of the delta in the stream, so that the
+    ///     decoder notices lost deltas.
+    ///
+    ///   Keyframes are sent periodically, and whenever the image size or
+    /// format changes. Use ImageDeltaDecoder to reconstruct the images.
+    class IGNITION_SENSORS_VISIBLE ImageDeltaEncoder
+    {
+      /// \brief Constructor
+      public: ImageDeltaEncoder();
+
+      /// \brief Destructor
+      public: ~ImageDeltaEncoder();
+
+      /// \brief Set the tile width and height. Changing it sends a
+      /// keyframe. Defaults to 64.
+      /// \param[in] _size Tile size in pixels, at least one.
+      public: void SetTileSize(unsigned int _size);
+
+      /// \brief Get the tile width and height.
+      /// \return Tile size in pixels.
+      public: unsigned int TileSize() const;
+
+      /// \brief Set the number of images between keyframes. Defaults to
+      /// 30.
+      /// \param[in] _interval Keyframe interval, zero to only send
+      /// keyframes when needed.
+      public: void SetKeyframeInterval(unsigned int _interval);
+
+      /// \brief Get the number of images between keyframes.
+      /// \return Keyframe interval.
+      public: unsigned int KeyframeInterval() const;
+
+      /// \brief Make the next image a keyframe, for example when a new
+      /// subscriber connects.
+      public: void Reset();
+
+      /// \brief Encode an image.
+      /// \param[in] _image Full image. Its header is copied to the delta.
+      /// \param[out] _delta Delta image.
+      /// \return Number of tiles in the delta.
+      public: unsigned int Encode(const msgs::Image &_image,
+                  msgs::Image &_delta);
+
+      /// \brief Get the memory held by the encoder, mostly the tile hashes
+      /// of the previous image.
+      /// \return Bytes held.
+      public: std::size_t MemoryUsage() const;
+
+      /// \internal
+      /// \brief Private data pointer.
+      private: std::unique_ptr<ImageDeltaEncoderPrivate> dataPtr;
+    };
+
+    /// \brief Reconstructs images from the delta images of an
+    /// ImageDeltaEncoder.
+    class IGNITION_SENSORS_VISIBLE ImageDeltaDecoder
+    {
+      /// \brief Constructor
+      public: ImageDeltaDecoder();
+
+      /// \brief Destructor
+      public: ~ImageDeltaDecoder();
+
+      /// \brief Apply a delta image.
+      /// \param[in] _delta Delta image.
+      /// \return True if the image was reconstructed. False if the delta is
+      /// malformed, or if no keyframe of the same size and format was
+      /// decoded before it. Once a delta is lost, the following deltas
+      /// are rejected until the next keyframe.
+      public: bool Decode(const msgs::Image &_delta);
+
+      /// \brief Get the last reconstructed image. Its header is the header
+      /// of the delta without the delta entries.
+      /// \return Reconstructed image, empty until a keyframe is decoded.
+      public: const msgs::Image &Image() const;
+
+      /// \internal
+      /// \brief Private data pointer.
+      private: std::unique_ptr<ImageDeltaDecoderPrivate> dataPtr;
+    };
+    }
+  }
+}
+
+#endif
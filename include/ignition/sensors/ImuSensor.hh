@@ -70,6 +70,15 @@ namespace ignition
       /// \return true if the update was successfull
       public: virtual bool Update(const common::Time &_now) override;
 
+      // Documentation inherited
+      public: virtual bool HasSubscribers() const override;
+
+      // Documentation inherited
+      public: virtual bool SaveState(std::ostream &_out) const override;
+
+      // Documentation inherited
+      public: virtual bool LoadState(std::istream &_in) override;
+
       /// \brief Set the angular velocity of the imu
       /// \param[in] _angularVel Angular velocity of the imu in body frame
       /// expressed in radians per second
@@ -0,0 +1,363 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef IGNITION_SENSORS_INPUTTRACE_HH_
+#define IGNITION_SENSORS_INPUTTRACE_HH_
+
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <ignition/common/Time.hh>
+#include <ignition/math/Pose3.hh>
+#include <ignition/math/Quaternion.hh>
+#include <ignition/math/Vector3.hh>
+
+#include <ignition/sensors/config.hh>
+#include <ignition/sensors/input_trace/Export.hh>
+
+#include "ignition/sensors/Manager.hh"
+#include "ignition/sensors/RayScene.hh"
+#include "ignition/sensors/Sensor.hh"
+
+namespace ignition
+{
+  namespace sensors
+  {
+    // Inline bracket to help doxygen filtering.
+    inline namespace IGNITION_SENSORS_VERSION_NAMESPACE {
+    //
+    /// \brief forward declarations
+    class InputRecorderPrivate;
+    class InputReplayPrivate;
+
+    /// \brief Results of InputReplay::Run().
+    struct IGNITION_SENSORS_INPUT_TRACE_VISIBLE InputReplayReport
+    {
+      /// \brief Number of steps run.
+      uint64_t steps = 0u;
+
+      /// \brief Number of messages produced by the sensors, zero without
+      /// the equivalence check.
+      uint64_t messages = 0u;
+
+      /// \brief Wall time taken by the steps, in seconds, without the time
+      /// spent digesting messages.
+      double wallTime = 0.0;
+
+      /// \brief Wall time spent digesting messages for the equivalence
+      /// check, in seconds. It is left out of the step latencies.
+      double digestTime = 0.0;
+
+      /// \brief Steps run per second of wall time.
+      double stepsPerSecond = 0.0;
+
+      /// \brief Mean wall time of a step, in seconds. A step includes
+      /// applying its inputs and Manager::RunOnce(), but not digesting its
+      /// messages.
+      double meanLatency = 0.0;
+
+      /// \brief Median wall time of a step, in seconds.
+      double medianLatency = 0.0;
+
+      /// \brief 99th percentile of the wall time of a step, in seconds.
+      double p99Latency = 0.0;
+
+      /// \brief Longest wall time of a step, in seconds.
+      double maxLatency = 0.0;
+
+      /// \brief True if all recorded sensors were found and every step
+      /// produced the same messages as when it was recorded. Always false
+      /// without the equivalence check.
+      bool equivalent = false;
+
+      /// \brief Index of the first step whose messages differ, -1 if none.
+      int64_t firstMismatch = -1;
+
+      /// \brief Number of steps whose messages differ.
+      uint64_t mismatches = 0u;
+
+      /// \brief Scoped names of the recorded sensors that the manager
+      /// doesn't have. Their inputs are skipped.
+      std::vector<std::string> missingSensors;
+    };
+
+    /// \brief Records the inputs a host feeds into the sensors of a
+    /// Manager, to replay them with InputReplay without the host.
+    ///
+    ///   Inputs are passed through this class instead of the sensors:
+    ///   poses, IMU and magnetometer readings, altimeter and air pressure
+    ///   references, logical camera models, changes to a CPU scene owned by
+    ///   the recorder, and time steps. Each input is applied immediately,
+    ///   through the same code the replay uses. A digest of the messages
+    ///   produced by each step is stored, so the replay can check that the
+    ///   sensors still produce the same output.
+    ///
+    ///   The runtime state of the sensors, including their noise models,
+    ///   is saved when the recorder is constructed and restored before the
+    ///   replay, so sensors must be created first. Rendering sensors and
+    ///   CPU scene meshes aren't recorded.
+    ///
+    ///   The recorder taps the messages of the sensors and forwards them to
+    ///   the previous tap, so Manager::StartRecording() must be called
+    ///   before creating the recorder. While the tap is set, sensors
+    ///   produce their messages even if nothing subscribes to them.
+    class IGNITION_SENSORS_INPUT_TRACE_VISIBLE InputRecorder
+    {
+      /// \brief Constructor
+      /// \param[in] _mgr Manager of the sensors. It must outlive the
+      /// recorder.
+      public: explicit InputRecorder(Manager &_mgr);
+
+      /// \brief Destructor, removes the message taps.
+      public: ~InputRecorder();
+
+      /// \brief Set the pose of a sensor.
+      /// \param[in] _id Id of the sensor.
+      /// \param[in] _pose Pose relative to the parent link.
+      /// \return False if the sensor doesn't exist.
+      /// \sa Sensor::SetPose
+      public: bool SetPose(SensorId _id, const math::Pose3d &_pose);
+
+      /// \brief Set the world pose of an IMU or magnetometer.
+      /// \param[in] _id Id of the sensor.
+      /// \param[in] _pose World pose.
+      /// \return False if the sensor doesn't exist or has another type.
+      public: bool SetWorldPose(SensorId _id, const math::Pose3d &_pose);
+
+      /// \brief Set the linear acceleration of an IMU.
+      /// \param[in] _id Id of the sensor.
+      /// \param[in] _acc Linear acceleration.
+      /// \return False if the sensor doesn't exist or has another type.
+      /// \sa ImuSensor::SetLinearAcceleration
+      public: bool SetLinearAcceleration(SensorId _id,
+                  const math::Vector3d &_acc);
+
+      /// \brief Set the angular velocity of an IMU.
+      /// \param[in] _id Id of the sensor.
+      /// \param[in] _vel Angular velocity.
+      /// \return False if the sensor doesn't exist or has another type.
+      /// \sa ImuSensor::SetAngularVelocity
+      public: bool SetAngularVelocity(SensorId _id,
+                  const math::Vector3d &_vel);
+
+      /// \brief Set the gravity vector of an IMU.
+      /// \param[in] _id Id of the sensor.
+      /// \param[in] _gravity Gravity vector.
+      /// \return False if the sensor doesn't exist or has another type.
+      /// \sa ImuSensor::SetGravity
+      public: bool SetGravity(SensorId _id, const math::Vector3d &_gravity);
+
+      /// \brief Set the orientation reference of an IMU.
+      /// \param[in] _id Id of the sensor.
+      /// \param[in] _orient Orientation reference.
+      /// \return False if the sensor doesn't exist or has another type.
+      /// \sa ImuSensor::SetOrientationReference
+      public: bool SetOrientationReference(SensorId _id,
+                  const math::Quaterniond &_orient);
+
+      /// \brief Set the world magnetic field of a magnetometer.
+      /// \param[in] _id Id of the sensor.
+      /// \param[in] _field Magnetic field in world frame.
+      /// \return False if the sensor doesn't exist or has another type.
+      /// \sa MagnetometerSensor::SetWorldMagneticField
+      public: bool SetWorldMagneticField(SensorId _id,
+                  const math::Vector3d &_field);
+
+      /// \brief Set the vertical position of an altimeter.
+      /// \param[in] _id Id of the sensor.
+      /// \param[in] _pos Vertical position.
+      /// \return False if the sensor doesn't exist or has another type.
+      /// \sa AltimeterSensor::SetPosition
+      public: bool SetVerticalPosition(SensorId _id, double _pos);
+
+      /// \brief Set the vertical velocity of an altimeter.
+      /// \param[in] _id Id of the sensor.
+      /// \param[in] _vel Vertical velocity.
+      /// \return False if the sensor doesn't exist or has another type.
+      /// \sa AltimeterSensor::SetVerticalVelocity
+      public: bool SetVerticalVelocity(SensorId _id, double _vel);
+
+      /// \brief Set the vertical reference of an altimeter.
+      /// \param[in] _id Id of the sensor.
+      /// \param[in] _reference Vertical reference.
+      /// \return False if the sensor doesn't exist or has another type.
+      /// \sa AltimeterSensor::SetVerticalReference
+      public: bool SetVerticalReference(SensorId _id, double _reference);
+
+      /// \brief Set the reference altitude of an air pressure sensor.
+      /// \param[in] _id Id of the sensor.
+      /// \param[in] _reference Reference altitude.
+      /// \return False if the sensor doesn't exist or has another type.
+      /// \sa AirPressureSensor::SetReferenceAltitude
+      public: bool SetReferenceAltitude(SensorId _id, double _reference);
+
+      /// \brief Set the models seen by a logical camera.
+      /// \param[in] _id Id of the sensor.
+      /// \param[in] _models A map of model names to their world pose.
+      /// \return False if the sensor doesn't exist or has another type.
+      /// \sa LogicalCameraSensor::SetModelPoses
+      public: bool SetModelPoses(SensorId _id,
+                  const std::map<std::string, math::Pose3d> &_models);
+
+      /// \brief Set the objects of the recorder's scene that make up each
+      /// model seen by a logical camera.
+      /// \param[in] _id Id of the sensor.
+      /// \param[in] _objects A map of model names to object ids returned by
+      /// this recorder.
+      /// \return False if the sensor doesn't exist or has another type.
+      /// \sa LogicalCameraSensor::SetModelObjects
+      public: bool SetModelObjects(SensorId _id,
+                  const std::map<std::string, std::vector<RayObjectId>>
+                  &_objects);
+
+      /// \brief Enable or disable occlusion testing of a logical camera.
+      /// \param[in] _id Id of the sensor.
+      /// \param[in] _enabled True to enable occlusion testing.
+      /// \return False if the sensor doesn't exist or has another type.
+      /// \sa LogicalCameraSensor::SetOcclusionEnabled
+      public: bool SetOcclusionEnabled(SensorId _id, bool _enabled);
+
+      /// \brief Set the recorder's scene as the CPU scene of a logical
+      /// camera.
+      /// \param[in] _id Id of the sensor.
+      /// \return False if the sensor doesn't exist or has another type.
+      /// \sa LogicalCameraSensor::SetCpuScene
+      public: bool SetCpuScene(SensorId _id);
+
+      /// \brief Add a box to the recorder's scene.
+      /// \param[in] _size Size of the box.
+      /// \param[in] _pose World pose of the box.
+      /// \return Id of the new object.
+      public: RayObjectId AddBox(const math::Vector3d &_size,
+                  const math::Pose3d &_pose);
+
+      /// \brief Add a sphere to the recorder's scene.
+      /// \param[in] _radius Radius of the sphere.
+      /// \param[in] _pose World pose of the sphere.
+      /// \return Id of the new object.
+      public: RayObjectId AddSphere(double _radius,
+                  const math::Pose3d &_pose);
+
+      /// \brief Add a cylinder to the recorder's scene.
+      /// \param[in] _radius Radius of the cylinder.
+      /// \param[in] _length Length of the cylinder.
+      /// \param[in] _pose World pose of the cylinder.
+      /// \return Id of the new object.
+      public: RayObjectId AddCylinder(double _radius, double _length,
+                  const math::Pose3d &_pose);
+
+      /// \brief Remove an object from the recorder's scene.
+      /// \param[in] _object Id of the object.
+      /// \return True if the object existed.
+      public: bool RemoveObject(RayObjectId _object);
+
+      /// \brief Set the world pose of an object of the recorder's scene.
+      /// \param[in] _object Id of the object.
+      /// \param[in] _pose New world pose.
+      /// \return True if the object exists.
+      public: bool SetObjectPose(RayObjectId _object,
+                  const math::Pose3d &_pose);
+
+      /// \brief Set the retro-reflectance of an object of the recorder's
+      /// scene.
+      /// \param[in] _object Id of the object.
+      /// \param[in] _retro Retro-reflectance value.
+      /// \return True if the object exists.
+      public: bool SetObjectRetro(RayObjectId _object, double _retro);
+
+      /// \brief Get the recorder's scene. It must only be changed through
+      /// the recorder.
+      /// \return The scene.
+      public: RayScenePtr Scene() const;
+
+      /// \brief Run the sensors one step and store the digest of their
+      /// messages.
+      /// \param[in] _time The current simulated time.
+      /// \param[in] _force True to force all sensors to update.
+      /// \sa Manager::RunOnce
+      public: void RunOnce(const common::Time &_time, bool _force = false);
+
+      /// \brief Get the number of recorded steps.
+      /// \return Number of RunOnce() calls.
+      public: uint64_t StepCount() const;
+
+      /// \brief Write the recorded inputs.
+      /// \param[in] _out Output stream.
+      /// \return False if the stream failed.
+      public: bool Save(std::ostream &_out) const;
+
+      /// \internal
+      /// \brief Private data pointer.
+      private: std::unique_ptr<InputRecorderPrivate> dataPtr;
+    };
+
+    /// \brief Replays inputs recorded by InputRecorder against the sensors
+    /// of a Manager, to measure the time the sensors take and check that
+    /// they produce the same messages.
+    ///
+    ///   The manager must have the recorded sensors, created from the same
+    ///   SDF. Sensors are matched by parent and name.
+    class IGNITION_SENSORS_INPUT_TRACE_VISIBLE InputReplay
+    {
+      /// \brief Constructor
+      public: InputReplay();
+
+      /// \brief Destructor
+      public: ~InputReplay();
+
+      /// \brief Read inputs written by InputRecorder::Save().
+      /// \param[in] _in Input stream.
+      /// \return False if the stream ended or doesn't hold recorded inputs.
+      public: bool Load(std::istream &_in);
+
+      /// \brief Get the number of recorded steps.
+      /// \return Number of steps, zero if nothing was loaded.
+      public: uint64_t StepCount() const;
+
+      /// \brief Set whether Run() checks that the sensors produce the
+      /// recorded messages, enabled by default. The check digests every
+      /// message, and makes sensors that only produce data on demand
+      /// produce it, see Sensor::HasSubscribers(). Its digest time is left
+      /// out of the latencies, but disable it to measure the sensors as
+      /// they run without subscribers.
+      /// \param[in] _check True to check the messages.
+      public: void SetEquivalenceCheck(bool _check);
+
+      /// \brief Get whether Run() checks the messages of the sensors.
+      /// \return True if the messages are checked.
+      public: bool EquivalenceCheck() const;
+
+      /// \brief Restore the recorded state of the sensors, then apply the
+      /// inputs and run the steps. Can be called several times, on the
+      /// same or on different managers.
+      /// \param[in] _mgr Manager of the sensors.
+      /// \return Timing and equivalence results.
+      public: InputReplayReport Run(Manager &_mgr);
+
+      /// \internal
+      /// \brief Private data pointer.
+      private: std::unique_ptr<InputReplayPrivate> dataPtr;
+    };
+    }
+  }
+}
+
+#endif
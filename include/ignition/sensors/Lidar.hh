@@ -45,6 +45,10 @@ namespace ignition
     ///   It offers both an ignition-transport interface and a direct C++ API
     ///   to access the image data. The API works by setting a callback to be
     ///   called with image data.
+    ///
+    ///   This class casts rays on the CPU against the scene set with
+    ///   SetCpuScene, one ray per range. GpuLidarSensor generates scans
+    ///   with a rendering engine instead.
     class IGNITION_SENSORS_LIDAR_VISIBLE Lidar : public RenderingSensor
     {
       /// \brief constructor
@@ -58,11 +62,107 @@ namespace ignition
       /// \return true if the update was successfull
       public: virtual bool Update(const common::Time &_now) override;
 
+      // Documentation inherited
+      public: virtual bool HasSubscribers() const override;
+
+      // Documentation inherited
+      public: virtual bool SaveState(std::ostream &_out) const override;
+
+      // Documentation inherited
+      public: virtual bool LoadState(std::istream &_in) override;
+
+      // Documentation inherited
+      public: virtual SensorMemoryUsage MemoryUsage() const override;
+
       /// \brief Publish LaserScan message
       /// \param[in] _now The current time
       /// \return true if the update was successfull
       public: virtual bool PublishLidarScan(const common::Time &_now);
 
+      /// \brief Split each scan into azimuth slices that are published as
+      /// point cloud packets on the <topic>/packets topic as soon as they
+      /// are filled, the way a spinning lidar streams its data.
+      ///
+      ///   A packet holds all rings of a range of columns, with x, y, z,
+      ///   intensity, ring and time fields. The time field is the offset of
+      ///   the point from the stamp of the scan, in seconds, see
+      ///   SetSweepTime(). Rays are cast on the CPU one slice at a time, and
+      ///   each slice is published before the next one is cast. Packets
+      ///   aren't supported by GpuLidarSensor, which renders the whole scan
+      ///   at once, so its slices couldn't be published any earlier than
+      ///   the full scan.
+      /// \param[in] _count Number of packets per scan, zero to disable
+      /// packets. Scans with fewer columns have one packet per column.
+      /// Ignored if the lidar doesn't support packets.
+      /// \sa SupportsPackets
+      public: void SetPacketCount(unsigned int _count);
+
+      /// \brief Get the number of packets per scan.
+      /// \return Number of packets, zero if packets are disabled.
+      /// \sa SetPacketCount
+      public: unsigned int PacketCount() const;
+
+      /// \brief Set the time the lidar takes to sweep its horizontal field
+      /// of view, which spreads the time offsets of the points of packets.
+      /// \param[in] _seconds Sweep time, zero to sweep during one update
+      /// period.
+      /// \sa SetPacketCount
+      public: void SetSweepTime(double _seconds);
+
+      /// \brief Get the time the lidar takes to sweep its horizontal field
+      /// of view.
+      /// \return Sweep time in seconds, zero to sweep during one update
+      /// period.
+      public: double SweepTime() const;
+
+      /// \brief Set how far apart the ranges of neighboring rays may be for
+      /// ranges to be interpolated between them. When the resolution of
+      /// the scan is above one, more ranges than rays are published, see
+      /// RangeCount(), and a GPU lidar interpolates the extra ranges from
+      /// the rendered rays. Where the ranges of the surrounding rays differ
+      /// by more than this fraction of the smallest of them, such as at the
+      /// edge of an object, the range of the nearest ray is used instead,
+      /// so that no points float between objects.
+      /// \param[in] _threshold Largest relative range difference to
+      /// interpolate across, 0.1 by default. Zero or less always uses the
+      /// nearest ray.
+      public: void SetUpsampleEdgeThreshold(double _threshold);
+
+      /// \brief Get how far apart the ranges of neighboring rays may be for
+      /// ranges to be interpolated between them.
+      /// \return Largest relative range difference to interpolate across.
+      /// \sa SetUpsampleEdgeThreshold
+      public: double UpsampleEdgeThreshold() const;
+
+      /// \brief Enable publishing the scan as range and intensity images,
+      /// which learning pipelines consume more easily than point clouds.
+      /// The images have a row per ring, starting with the lowest ring, and
+      /// a column per azimuth, starting at AngleMin(). They are published
+      /// on "<topic>/range_image" and "<topic>/intensity_image", and are
+      /// filled straight from laserBuffer, so the ranges are free of noise
+      /// like those of the point cloud. The intensity image is R_FLOAT32.
+      /// \param[in] _enabled True to publish the images when they have
+      /// subscribers.
+      /// \sa SetRangeImageQuantization
+      public: void SetRangeImageEnabled(bool _enabled);
+
+      /// \brief Get whether the scan is published as range and intensity
+      /// images.
+      /// \return True if the images are enabled.
+      public: bool RangeImageEnabled() const;
+
+      /// \brief Set the format of the range image.
+      /// \param[in] _meters Zero, the default, for an R_FLOAT32 image of
+      /// ranges in meters. Otherwise, an L_INT16 image of unsigned ranges
+      /// in units of _meters, such as 0.001 for millimeters, where zero
+      /// marks rays without a return or ranges that don't fit.
+      public: void SetRangeImageQuantization(double _meters);
+
+      /// \brief Get the format of the range image.
+      /// \return Units of the L_INT16 range image in meters, or zero for
+      /// an R_FLOAT32 image in meters.
+      public: double RangeImageQuantization() const;
+
       /// \brief Load the sensor based on data from an sdf::Sensor object.
       /// \param[in] _sdf SDF Sensor parameters.
       /// \return true if loading was successful
@@ -81,12 +181,69 @@ namespace ignition
       /// \return True on success
       public: void SetParent(const std::string &_parent) override;
 
-      /// \brief Create Lidar sensor
+      /// \brief Create Lidar sensor. The base class computes the ray
+      /// directions and allocates laserBuffer for casting rays against the
+      /// CPU scene.
+      /// \return True on success, false if there is no CPU scene.
+      /// \sa SetCpuScene
       public: virtual bool CreateLidar();
 
       /// \brief Finalize the ray
       protected: virtual void Fini();
 
+      /// \brief Get whether the lidar can publish a slice of a scan before
+      /// the rest of the scan is produced, which packets require.
+      /// \return True for lidars that cast rays on the CPU.
+      /// \sa SetPacketCount
+      protected: virtual bool SupportsPackets() const;
+
+      /// \brief Get whether packets are enabled and have subscribers.
+      /// \return True if packets should be published.
+      /// \sa SetPacketCount
+      protected: bool PacketsEnabled() const;
+
+      /// \brief Publish one packet of a scan.
+      /// \param[in] _now Stamp of the scan.
+      /// \param[in] _scan Range, intensity and retro data of the scan, three
+      /// channels per ray, row by row. Only the columns of the packet are
+      /// read.
+      /// \param[in] _width Number of columns of the scan.
+      /// \param[in] _height Number of rows of the scan.
+      /// \param[in] _packet Index of the packet, from zero to the packet
+      /// count.
+      /// \return True if the packet was published.
+      protected: bool PublishPacket(const common::Time &_now,
+                     const float *_scan, unsigned int _width,
+                     unsigned int _height, unsigned int _packet);
+
+      /// \brief Call the scan callbacks. Subclasses call this once a scan
+      /// is filled.
+      /// \param[in] _now Stamp of the scan.
+      /// \param[in] _scan Range, intensity and retro data of the scan.
+      /// \param[in] _width Number of columns of the scan.
+      /// \param[in] _height Number of rows of the scan.
+      /// \sa ConnectScanCallback
+      protected: void NotifyScan(const common::Time &_now, const float *_scan,
+                     unsigned int _width, unsigned int _height);
+
+      /// \brief Interpolate a scan of RangeCount() by VerticalRangeCount()
+      /// ranges from a scan of RayCount() by VerticalRayCount() rays. The
+      /// first and last rays of each row and column keep their angles.
+      /// Ranges aren't interpolated across edges, see
+      /// SetUpsampleEdgeThreshold().
+      /// \param[in] _rays Range, intensity and retro data of the rays.
+      /// \param[in] _rayCount Number of columns of the rays.
+      /// \param[in] _verticalRayCount Number of rows of the rays.
+      /// \param[out] _ranges Range, intensity and retro data of the ranges,
+      /// three channels each, must not overlap _rays.
+      /// \param[in] _rangeCount Number of columns of the ranges.
+      /// \param[in] _verticalRangeCount Number of rows of the ranges.
+      /// \return False if a buffer is null or a count is zero.
+      protected: bool UpsampleScan(const float *_rays, unsigned int _rayCount,
+                     unsigned int _verticalRayCount, float *_ranges,
+                     unsigned int _rangeCount,
+                     unsigned int _verticalRangeCount) const;
+
       /// \brief Get the minimum angle
       /// \return The minimum angle
       public: ignition::math::Angle AngleMin() const;
@@ -249,6 +406,25 @@ namespace ignition
                   unsigned int _heighti, unsigned int _channels,
                   const std::string &/*_format*/)> _subscriber);
 
+      /// \brief Set a callback to be called with each scan once it is in
+      /// laserBuffer, before the scan messages are published. Unlike
+      /// ConnectNewLidarFrame(), this works with any data source, and
+      /// passes the stamp of the scan. The callback may be called from a
+      /// rendering pipeline thread, and must not block.
+      /// \param[in] _callback Callback taking the stamp of the scan, its
+      /// range, intensity and retro data, three channels per ray, row by
+      /// row, and its number of columns and rows.
+      /// \return A connection pointer that must remain in scope. When the
+      /// connection pointer falls out of scope, the connection is broken.
+      public: ignition::common::ConnectionPtr ConnectScanCallback(
+          std::function<void(const common::Time &_stamp, const float *_scan,
+                  unsigned int _width, unsigned int _height)> _callback);
+
+      /// \brief Publish the range and intensity images of laserBuffer.
+      /// Called by PublishLidarScan() with lidarMutex locked.
+      /// \param[in] _now Stamp of the scan.
+      private: void PublishRangeImages(const common::Time &_now);
+
       /// \brief Data pointer for private data
       /// \internal
       private: std::unique_ptr<LidarPrivate> dataPtr;
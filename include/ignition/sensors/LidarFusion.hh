@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef IGNITION_SENSORS_LIDARFUSION_HH_
+#define IGNITION_SENSORS_LIDARFUSION_HH_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <ignition/msgs/pointcloud_packed.pb.h>
+
+#include <ignition/common/Event.hh>
+#include <ignition/common/Time.hh>
+#include <ignition/math/Pose3.hh>
+
+#include "ignition/sensors/config.hh"
+#include "ignition/sensors/lidar/Export.hh"
+#include "ignition/sensors/Lidar.hh"
+
+namespace ignition
+{
+  namespace sensors
+  {
+    // Inline bracket to help doxygen filtering.
+    inline namespace IGNITION_SENSORS_VERSION_NAMESPACE {
+    //
+    /// \brief forward declarations
+    class LidarFusionPrivate;
+
+    /// \brief Merges the scans of several lidars into one point cloud in a
+    /// common frame, such as the vehicle frame, so that consumers don't
+    /// have to transform and merge the clouds of each lidar themselves.
+    ///
+    ///   Each scan is read straight from the lidar's buffer when it's
+    ///   filled, see Lidar::ConnectScanCallback(), and its points are
+    ///   transformed into the common frame right away. Once every lidar has
+    ///   a scan newer than the last merged cloud, and their stamps are
+    ///   within the sync tolerance, the scans are merged into one
+    ///   unorganized PointCloudPacked with x, y, z, intensity, ring and
+    ///   source fields. The source field is the index of the lidar, in the
+    ///   order they were added. Rays that didn't hit anything are dropped,
+    ///   so the cloud is dense. The cloud is stamped with the newest scan.
+    ///
+    ///   The lidars must outlive the fusion.
+    class IGNITION_SENSORS_LIDAR_VISIBLE LidarFusion
+    {
+      /// \brief Constructor
+      /// \param[in] _topic Topic to publish the merged clouds on.
+      /// \param[in] _frameId Frame id of the merged clouds.
+      public: LidarFusion(const std::string &_topic,
+                  const std::string &_frameId);
+
+      /// \brief Destructor, disconnects from the lidars.
+      public: ~LidarFusion();
+
+      /// \brief Add a lidar with a fixed pose in the common frame.
+      /// \param[in] _lidar The lidar.
+      /// \param[in] _extrinsic Pose of the lidar in the common frame.
+      /// \return Index of the lidar in the source field, or -1 if the
+      /// lidar is null or was already added.
+      public: int AddLidar(Lidar *_lidar, const math::Pose3d &_extrinsic);
+
+      /// \brief Add a lidar whose pose relative to its parent link, see
+      /// Sensor::Pose(), is its pose in the common frame.
+      /// \param[in] _lidar The lidar.
+      /// \return Index of the lidar in the source field, or -1 if the
+      /// lidar is null or was already added.
+      public: int AddLidar(Lidar *_lidar);
+
+      /// \brief Get the number of lidars.
+      /// \return Number of lidars added.
+      public: unsigned int LidarCount() const;
+
+      /// \brief Set how far apart the stamps of merged scans may be.
+      /// \param[in] _tolerance Largest difference between the stamps of the
+      /// scans of a cloud. Zero, the default, merges only scans with the
+      /// same stamp.
+      public: void SetSyncTolerance(const common::Time &_tolerance);
+
+      /// \brief Get how far apart the stamps of merged scans may be.
+      /// \return Largest difference between the stamps of merged scans.
+      public: common::Time SyncTolerance() const;
+
+      /// \brief Get the number of clouds merged so far.
+      /// \return Number of clouds.
+      public: uint64_t CloudCount() const;
+
+      /// \brief Set a callback to be called with each merged cloud, after
+      /// it's published. The callback is called from the thread that
+      /// filled the last scan, and must not block.
+      /// \param[in] _callback Callback taking the merged cloud.
+      /// \return A connection pointer that must remain in scope. When the
+      /// connection pointer falls out of scope, the connection is broken.
+      public: common::ConnectionPtr ConnectCloudCallback(
+                  std::function<void(const msgs::PointCloudPacked &)>
+                  _callback);
+
+      /// \internal
+      /// \brief Private data pointer.
+      private: std::unique_ptr<LidarFusionPrivate> dataPtr;
+    };
+    }
+  }
+}
+
+#endif
@@ -20,6 +20,7 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <sdf/sdf.hh>
 
@@ -33,6 +34,7 @@
 #include "ignition/sensors/config.hh"
 #include "ignition/sensors/Export.hh"
 #include "ignition/sensors/logical_camera/Export.hh"
+#include "ignition/sensors/RayScene.hh"
 #include "ignition/sensors/Sensor.hh"
 
 namespace ignition
@@ -50,6 +52,13 @@ namespace ignition
     /// A logical camera reports locations of objects. This camera finds models
     /// within the sensor's frustum and publishes information about the models
     /// on the sensor's topic.
+    ///
+    /// By default a model is detected when its origin lies in the frustum.
+    /// With occlusion enabled, models that were associated with objects of
+    /// a CPU scene are tested by their bounds instead, and rays are cast
+    /// towards sample points in the bounds to find how much of the model
+    /// is visible. Models without scene objects are still tested by their
+    /// origin and are considered fully visible.
     class IGNITION_SENSORS_LOGICAL_CAMERA_VISIBLE LogicalCameraSensor
       : public Sensor
     {
@@ -73,6 +82,12 @@ namespace ignition
       /// \return true if the update was successfull
       public: virtual bool Update(const common::Time &_now) override;
 
+      // Documentation inherited
+      public: virtual bool HasSubscribers() const override;
+
+      // Documentation inherited
+      public: virtual SensorMemoryUsage MemoryUsage() const override;
+
       /// \brief Get the near distance. This is the distance from the
       /// frustum's vertex to the closest plane.
       /// \return Near distance.
@@ -87,6 +102,57 @@ namespace ignition
       /// \param[in] _models A map of model names to their world pose.
       public: void SetModelPoses(std::map<std::string, math::Pose3d> &&_models);
 
+      /// \brief Set the scene used to test occlusion. The scene can be
+      /// shared with other sensors.
+      /// \param[in] _scene Scene, or null to remove it.
+      public: void SetCpuScene(RayScenePtr _scene);
+
+      /// \brief Get the scene used to test occlusion.
+      /// \return Scene, or null if none was set.
+      public: RayScenePtr CpuScene() const;
+
+      /// \brief Set the CPU scene objects that make up each model. The
+      /// bounds of a model are the union of the bounds of its objects.
+      /// \param[in] _objects A map of model names to scene object ids.
+      public: void SetModelObjects(
+                  std::map<std::string, std::vector<RayObjectId>> &&_objects);
+
+      /// \brief Enable or disable occlusion testing. It is disabled by
+      /// default, and needs a CPU scene.
+      /// \param[in] _enabled True to enable occlusion testing.
+      public: void SetOcclusionEnabled(bool _enabled);
+
+      /// \brief Get whether occlusion testing is enabled.
+      /// \return True if occlusion testing is enabled.
+      public: bool OcclusionEnabled() const;
+
+      /// \brief Set the number of rays cast towards each model. Defaults
+      /// to 32.
+      /// \param[in] _samples Number of rays, at least one.
+      public: void SetOcclusionSamples(unsigned int _samples);
+
+      /// \brief Get the number of rays cast towards each model.
+      /// \return Number of rays.
+      public: unsigned int OcclusionSamples() const;
+
+      /// \brief Set the visible fraction a model needs to be detected.
+      /// Models are only detected if some part of them is visible, so the
+      /// default of zero detects any partially visible model.
+      /// \param[in] _fraction Minimum fraction between 0 and 1.
+      public: void SetMinVisibleFraction(double _fraction);
+
+      /// \brief Get the visible fraction a model needs to be detected.
+      /// \return Minimum fraction.
+      public: double MinVisibleFraction() const;
+
+      /// \brief Get the visible fraction of a model in the latest image.
+      /// This is the fraction of rays that reach the model rather than an
+      /// occluder in front of it.
+      /// \param[in] _name Name of the model.
+      /// \return Visible fraction between 0 and 1, 0 if the model wasn't
+      /// detected.
+      public: double VisibleFraction(const std::string &_name) const;
+
       /// \brief Get the horizontal field of view. The field of view is the
       /// angle between the frustum's vertex and the edges of the near or far
       /// plane. This value represents the horizontal angle.
@@ -100,6 +166,8 @@ namespace ignition
 
       /// \brief Get the latest image. An image is an instance of
       /// msgs::LogicalCameraImage, which contains a list of detected models.
+      /// With occlusion enabled, the header has a "visible_fraction" entry
+      /// with one value per model.
       /// \return List of detected models.
       public: msgs::LogicalCameraImage Image() const;
 
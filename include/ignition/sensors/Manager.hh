@@ -17,9 +17,15 @@
 #ifndef IGNITION_SENSORS_MANAGER_HH_
 #define IGNITION_SENSORS_MANAGER_HH_
 
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <map>
 #include <memory>
+#include <ostream>
 #include <string>
 #include <type_traits>
+#include <utility>
 #include <vector>
 #include <sdf/sdf.hh>
 #include <ignition/common/Time.hh>
@@ -27,6 +33,7 @@
 #include <ignition/sensors/config.hh>
 #include <ignition/sensors/Export.hh>
 #include <ignition/sensors/Sensor.hh>
+#include <ignition/sensors/SensorConfigCache.hh>
 
 namespace ignition
 {
@@ -37,6 +44,49 @@ namespace ignition
     // Forward declarations
     class ManagerPrivate;
 
+    /// \brief Statistics of the Manager's update rate governor.
+    /// \sa Manager::SetRateGovernorEnabled()
+    struct RateGovernorStatistics
+    {
+      /// \brief Smoothed wall time taken by the sensor updates of a
+      /// RunOnce() call, in seconds.
+      double stepTime = 0.0;
+
+      /// \brief Fraction of their nominal rate sensors with subscribers run
+      /// at. It is lowered while the step time exceeds the budget.
+      double loadScale = 1.0;
+
+      /// \brief Number of sensors whose data isn't consumed.
+      unsigned int idleSensors = 0;
+
+      /// \brief Number of sensors running below their nominal rate.
+      unsigned int throttledSensors = 0;
+
+      /// \brief Effective update rate of each sensor, in Hz. Zero means
+      /// the sensor updates every step.
+      std::map<SensorId, double> effectiveRates;
+    };
+
+    /// \brief A step submitted to the sensor thread of a Manager. The pose
+    /// and state updates are applied in order, on the sensor thread, before
+    /// the sensors update.
+    /// \sa Manager::SubmitStep()
+    struct SensorStep
+    {
+      /// \brief The simulated time of the step.
+      common::Time time;
+
+      /// \brief Force all sensors to update, see Manager::RunOnce().
+      bool force = false;
+
+      /// \brief New sensor poses.
+      std::vector<std::pair<SensorId, math::Pose3d>> poses;
+
+      /// \brief Functions that set the state of a sensor, such as the
+      /// velocity of an IMU. Updates of unknown sensors are skipped.
+      std::vector<std::pair<SensorId, std::function<void(Sensor &)>>> states;
+    };
+
     /// \brief Loads and runs sensors
     ///
     ///   This class is responsible for loading and running sensors, and
@@ -172,6 +222,14 @@ namespace ignition
       /// is returned on erro.
       public: ignition::sensors::SensorId CreateSensor(const sdf::Sensor &_sdf);
 
+      /// \brief Add a sensor that was created outside of the Manager, such
+      /// as a sensor class that isn't loaded from a plugin. The Manager
+      /// takes ownership of the sensor and updates it like the others.
+      /// \param[in] _sensor Sensor to add.
+      /// \return Id of the sensor, NO_SENSOR if the sensor is null or a
+      /// sensor with the same id was already added.
+      public: ignition::sensors::SensorId AddSensor(
+                  std::unique_ptr<ignition::sensors::Sensor> _sensor);
 
       /// \brief Get an instance of a loaded sensor by sensor id
       /// \param[in] _id Idenitifier of the sensor.
@@ -179,6 +237,10 @@ namespace ignition
       public: ignition::sensors::Sensor *Sensor(
                   ignition::sensors::SensorId _id);
 
+      /// \brief Get the ids of the loaded sensors.
+      /// \return Sensor ids, in creation order.
+      public: std::vector<SensorId> SensorIds() const;
+
       /// \brief Remove a sensor by ID
       /// \param[in] _sensorId ID of the sensor to remove
       /// \return True if the sensor exists and removed.
@@ -188,9 +250,234 @@ namespace ignition
       /// \param _time: The current simulated time
       /// \param _force: If true, all sensors are forced to update. Otherwise
       ///        a sensor will update based on it's Hz rate.
+      /// \remarks While the sensor thread runs, the step is submitted to it
+      /// and this waits for it to complete.
       public: void RunOnce(const ignition::common::Time &_time,
                   bool _force = false);
 
+      /// \brief Start running sensors on a dedicated sensor thread.
+      ///
+      ///   Steps submitted with SubmitStep() are passed to the sensor thread
+      ///   through a lock-free queue and processed in order, so the caller,
+      ///   typically the physics loop, can compute the next step while the
+      ///   sensors of the previous one are generated. The max lag bounds the
+      ///   number of submitted steps that aren't completed yet.
+      ///
+      ///   While the thread runs, sensors may only be accessed directly
+      ///   after waiting for the steps that use them, for example with
+      ///   Flush(). Creating and removing sensors and bundles is
+      ///   synchronized with the sensor thread.
+      /// \param[in] _maxLag Maximum number of pending steps, at least one.
+      /// \return False if the thread is already running.
+      public: bool StartSensorThread(unsigned int _maxLag = 1u);
+
+      /// \brief Complete the pending steps and stop the sensor thread.
+      /// Called by the destructor.
+      public: void StopSensorThread();
+
+      /// \brief Get whether the sensor thread runs.
+      /// \return True if steps run on the sensor thread.
+      public: bool SensorThreadRunning() const;
+
+      /// \brief Get the maximum number of pending steps.
+      /// \return Max lag of the running sensor thread, zero if it isn't
+      /// running.
+      public: unsigned int MaxLag() const;
+
+      /// \brief Submit a step to the sensor thread. Blocks while the max
+      /// lag is reached. Must be called from one thread at a time.
+      /// \param[in,out] _step The step. It is swapped with an earlier
+      /// step, whose vectors keep their memory for the next step.
+      /// \return Fence of the step, to wait for with WaitForFence(). Zero
+      /// if the sensor thread isn't running.
+      public: uint64_t SubmitStep(SensorStep &_step);
+
+      /// \brief Get the fence of the last completed step.
+      /// \return Completed fence, zero before the first step.
+      public: uint64_t CompletedFence() const;
+
+      /// \brief Wait for a step to complete.
+      /// \param[in] _fence Fence returned by SubmitStep().
+      /// \param[in] _timeout Maximum wall time to wait, zero to wait until
+      /// the step completes.
+      /// \return True if the step completed.
+      public: bool WaitForFence(uint64_t _fence,
+                  const common::Time &_timeout = common::Time::Zero) const;
+
+      /// \brief Wait for all submitted steps to complete.
+      public: void Flush();
+
+      /// \brief Publish the messages of a group of sensors as one bundle.
+      ///
+      ///   The messages the sensors produce are no longer published on
+      ///   their own topics. Instead, RunOnce() publishes the messages
+      ///   produced since the last bundle as one msgs::SerializedState on
+      ///   the bundle topic:
+      ///
+      ///   * The header stamp is the time given to RunOnce(), and the
+      ///     "seq" entry counts the bundles.
+      ///   * There is one entity per sensor that produced messages, whose id
+      ///     is the sensor id.
+      ///   * There is one component per message, in the order the sensor
+      ///     produced them. Its type is BundleComponentType() of the message
+      ///     type name, and it holds the serialized message, with the
+      ///     sensor's own header and sequence number.
+      ///
+      ///   No bundle is published in steps where no sensor of the group
+      ///   produced a message. A sensor can belong to one bundle at a time.
+      /// \param[in] _topic Topic of the bundle.
+      /// \param[in] _sensors Sensors in the bundle.
+      /// \return False if the topic is empty or already used by a bundle,
+      /// if a sensor doesn't exist or is already in a bundle, or if the
+      /// topic can't be advertised.
+      public: bool AddBundle(const std::string &_topic,
+                  const std::vector<SensorId> &_sensors);
+
+      /// \brief Remove a bundle, its sensors publish on their own topics
+      /// again.
+      /// \param[in] _topic Topic of the bundle.
+      /// \return True if the bundle existed and was removed.
+      public: bool RemoveBundle(const std::string &_topic);
+
+      /// \brief Get the topics of the bundles.
+      /// \return Bundle topics.
+      public: std::vector<std::string> Bundles() const;
+
+      /// \brief Get the component type identifying a message type in a
+      /// bundle. It is the 64-bit FNV-1a hash of the type name.
+      /// \param[in] _typeName Full message type name, such as
+      /// "ignition.msgs.IMU".
+      /// \return Component type.
+      public: static uint64_t BundleComponentType(
+                  const std::string &_typeName);
+
+      /// \brief Enable the update rate governor, disabled by default.
+      ///
+      ///   While enabled, each RunOnce() lowers the update rate of sensors
+      ///   whose data isn't consumed (see Sensor::HasSubscribers()) to the
+      ///   rate floor. When a step budget is set, the rates of the other
+      ///   sensors are scaled down while the sensor updates take longer
+      ///   than the budget, and raised back to their nominal rate once they
+      ///   take less. Sensors that update every step are only lowered when
+      ///   idle.
+      ///
+      ///   The effective rate is set with Sensor::SetUpdateRate(). Setting a
+      ///   new rate on a sensor changes its nominal rate. Disabling the
+      ///   governor restores the nominal rates.
+      /// \param[in] _enabled True to enable the governor.
+      public: void SetRateGovernorEnabled(bool _enabled);
+
+      /// \brief Get whether the update rate governor is enabled.
+      /// \return True if enabled.
+      public: bool RateGovernorEnabled() const;
+
+      /// \brief Set the wall time budget of the sensor updates of a
+      /// RunOnce() call.
+      /// \param[in] _seconds Budget in seconds, zero to only govern rates
+      /// by subscriber demand, which is the default.
+      public: void SetStepBudget(double _seconds);
+
+      /// \brief Get the wall time budget of the sensor updates.
+      /// \return Budget in seconds.
+      public: double StepBudget() const;
+
+      /// \brief Set the lowest rate the governor lowers sensors to. Sensors
+      /// with a lower nominal rate keep it. Defaults to 1 Hz.
+      /// \param[in] _hz Rate floor in Hz, greater than zero.
+      public: void SetRateFloor(double _hz);
+
+      /// \brief Get the lowest rate the governor lowers sensors to.
+      /// \return Rate floor in Hz.
+      public: double RateFloor() const;
+
+      /// \brief Get the rate a sensor runs at, after governing.
+      /// \param[in] _id Sensor id.
+      /// \return Update rate in Hz, zero for every step or an unknown
+      /// sensor.
+      public: double EffectiveUpdateRate(SensorId _id) const;
+
+      /// \brief Get the rate a sensor is configured to run at.
+      /// \param[in] _id Sensor id.
+      /// \return Update rate in Hz, zero for every step or an unknown
+      /// sensor.
+      public: double NominalUpdateRate(SensorId _id) const;
+
+      /// \brief Get the statistics of the update rate governor.
+      /// \return Statistics as of the last RunOnce() call.
+      public: RateGovernorStatistics RateGovernorStats() const;
+
+      /// \brief Get the memory held by all sensors, to budget memory or
+      /// to catch buffers that grow, for example after resolution changes.
+      /// Submitted steps are flushed first. Use Sensor::MemoryUsage() for
+      /// the memory of a single sensor.
+      /// \return Sum of the memory of the sensors, by category.
+      public: SensorMemoryUsage MemoryUsage();
+
+      /// \brief Write the runtime state of all sensors to a binary
+      /// snapshot, to resume them later with LoadState().
+      ///
+      ///   The snapshot holds what re-creating the sensors from SDF loses,
+      ///   as written by Sensor::SaveState(): next update times, sequence
+      ///   numbers, noise biases and random number streams, and state such
+      ///   as the previous IMU step. Submitted steps are flushed first. The
+      ///   snapshot uses the host byte order.
+      /// \param[out] _out Binary output stream.
+      /// \return False if a sensor failed to write its state or the stream
+      /// failed.
+      public: bool SaveState(std::ostream &_out);
+
+      /// \brief Restore the runtime state of sensors from a snapshot
+      /// written by SaveState().
+      ///
+      ///   The sensors must have been created from the same SDF. Each
+      ///   sensor of the snapshot is matched by its parent and name, in
+      ///   creation order among sensors with the same parent and name.
+      ///   Sensors of the snapshot that don't exist anymore are skipped.
+      /// \param[in] _in Binary input stream.
+      /// \return False if the snapshot is invalid, or if some sensor
+      /// didn't exist or failed to restore its state. The other sensors are
+      /// still restored.
+      public: bool LoadState(std::istream &_in);
+
+      /// \brief Record the messages of all sensors, including sensors
+      /// created later, until StopRecording() is called.
+      ///
+      ///   Messages are serialized once, into a memory-mapped recording
+      ///   written by Recorder, and are still published. Sensors produce
+      ///   the messages they only produce on demand while recording. Use
+      ///   Replay to read the recording back.
+      /// \param[in] _path Path of the recording, overwritten if it exists.
+      /// \return False if the recording couldn't be created.
+      public: bool StartRecording(const std::string &_path);
+
+      /// \brief Stop recording, once the submitted steps completed, and
+      /// write the index of the recording.
+      /// \return False if no recording was started or the index couldn't
+      /// be written.
+      public: bool StopRecording();
+
+      /// \brief Get whether the messages of the sensors are recorded.
+      /// \return True between StartRecording() and StopRecording().
+      public: bool Recording() const;
+
+      /// \brief Write the configurations of all sensors to a compiled
+      /// cache, to create them later with CreateSensors() without parsing
+      /// SDF.
+      /// \param[in] _path Path of the cache file.
+      /// \return False if the file couldn't be written, or if some sensor
+      /// isn't supported by SensorConfigCache. The other sensors are still
+      /// written.
+      public: bool SaveConfigCache(const std::string &_path) const;
+
+      /// \brief Create the sensors of a compiled config cache, setting
+      /// their parents.
+      /// \param[in] _cache Sensor configurations, see
+      /// SensorConfigCache::Open().
+      /// \return An id for each entry of the cache, NO_SENSOR for entries
+      /// that failed to decode or to create a sensor.
+      public: std::vector<SensorId> CreateSensors(
+                  const SensorConfigCache &_cache);
+
       /// \brief Adds colon delimited paths sensor plugins may be
       public: void AddPluginPaths(const std::string &_path);
 
@@ -19,6 +19,8 @@
 #define IGNITION_SENSORS_NOISE_HH_
 
 #include <functional>
+#include <istream>
+#include <ostream>
 #include <string>
 #include <vector>
 
@@ -116,6 +118,20 @@ namespace ignition
       /// \param[in] _out Output stream
       public: virtual void Print(std::ostream &_out) const;
 
+      /// \brief Write the runtime state of the noise model, such as its
+      /// random number stream, in binary form. The base class has no
+      /// state and writes nothing.
+      /// \param[in] _out Output stream.
+      /// \return False if the state couldn't be written.
+      /// \sa Manager::SaveState
+      public: virtual bool SaveState(std::ostream &_out) const;
+
+      /// \brief Restore the runtime state written by SaveState() on a noise
+      /// model loaded from the same SDF.
+      /// \param[in] _in Input stream.
+      /// \return False if the state couldn't be read.
+      public: virtual bool LoadState(std::istream &_in);
+
       /// \brief Private data pointer
       private: NoisePrivate *dataPtr = nullptr;
     };
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef IGNITION_SENSORS_RAYSCENE_HH_
+#define IGNITION_SENSORS_RAYSCENE_HH_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <ignition/common/Mesh.hh>
+#include <ignition/math/AxisAlignedBox.hh>
+#include <ignition/math/Pose3.hh>
+#include <ignition/math/Vector3.hh>
+
+#include <ignition/sensors/config.hh>
+#include <ignition/sensors/Export.hh>
+
+namespace ignition
+{
+  namespace sensors
+  {
+    // Inline bracket to help doxygen filtering.
+    inline namespace IGNITION_SENSORS_VERSION_NAMESPACE {
+    //
+    /// \brief forward declarations
+    class RayScenePrivate;
+
+    /// \brief Identifies an object in a RayScene
+    using RayObjectId = std::size_t;
+    const RayObjectId NO_RAY_OBJECT = 0;
+
+    /// \brief Result of casting a single ray into a RayScene
+    struct RayHit
+    {
+      /// \brief Distance from the ray origin to the closest hit. Infinity
+      /// if nothing was hit within range.
+      float range;
+
+      /// \brief Retro-reflectance of the object that was hit, zero if
+      /// nothing was hit.
+      float retro;
+
+      /// \brief Object that was hit, NO_RAY_OBJECT if nothing was hit.
+      RayObjectId object;
+    };
+
+    /// \brief Scene geometry for casting rays on the CPU.
+    ///
+    ///   A RayScene holds boxes, spheres, cylinders and triangle meshes,
+    /// each with a world pose. Meshes are stored in a bounding volume
+    /// hierarchy in their own frame, and a second hierarchy is built over
+    /// the world bounds of all objects. Changing only object poses refits
+    /// the top hierarchy instead of rebuilding it.
+    ///
+    ///   Rays are traced in packets of neighbouring rays, and batches of
+    /// packets are spread across worker threads. A scene can be shared by
+    /// several sensors, see RenderingSensor::SetCpuScene.
+    class IGNITION_SENSORS_VISIBLE RayScene
+    {
+      /// \brief Constructor
+      public: RayScene();
+
+      /// \brief Destructor
+      public: ~RayScene();
+
+      /// \brief Add a box centered at its pose.
+      /// \param[in] _size Size of the box.
+      /// \param[in] _pose World pose of the box.
+      /// \return Id of the new object.
+      public: RayObjectId AddBox(const math::Vector3d &_size,
+                  const math::Pose3d &_pose);
+
+      /// \brief Add a sphere centered at its pose.
+      /// \param[in] _radius Radius of the sphere.
+      /// \param[in] _pose World pose of the sphere.
+      /// \return Id of the new object.
+      public: RayObjectId AddSphere(double _radius,
+                  const math::Pose3d &_pose);
+
+      /// \brief Add a cylinder centered at its pose, with its axis along z.
+      /// \param[in] _radius Radius of the cylinder.
+      /// \param[in] _length Length of the cylinder.
+      /// \param[in] _pose World pose of the cylinder.
+      /// \return Id of the new object.
+      public: RayObjectId AddCylinder(double _radius, double _length,
+                  const math::Pose3d &_pose);
+
+      /// \brief Add the triangles of a mesh. Submeshes that don't contain
+      /// triangle lists are ignored.
+      /// \param[in] _mesh Mesh to add.
+      /// \param[in] _pose World pose of the mesh.
+      /// \param[in] _scale Scale applied to the mesh vertices.
+      /// \return Id of the new object, NO_RAY_OBJECT if the mesh has no
+      /// triangles.
+      public: RayObjectId AddMesh(const common::Mesh &_mesh,
+                  const math::Pose3d &_pose,
+                  const math::Vector3d &_scale = math::Vector3d::One);
+
+      /// \brief Add a triangle mesh.
+      /// \param[in] _vertices Vertex positions.
+      /// \param[in] _indices Three vertex indices per triangle.
+      /// \param[in] _pose World pose of the mesh.
+      /// \param[in] _scale Scale applied to the vertices.
+      /// \return Id of the new object, NO_RAY_OBJECT if there are no valid
+      /// triangles.
+      public: RayObjectId AddMesh(
+                  const std::vector<math::Vector3d> &_vertices,
+                  const std::vector<unsigned int> &_indices,
+                  const math::Pose3d &_pose,
+                  const math::Vector3d &_scale = math::Vector3d::One);
+
+      /// \brief Remove an object.
+      /// \param[in] _id Id of the object.
+      /// \return True if the object existed.
+      public: bool RemoveObject(RayObjectId _id);
+
+      /// \brief Set the world pose of an object. This only refits the
+      /// scene hierarchy on the next cast.
+      /// \param[in] _id Id of the object.
+      /// \param[in] _pose New world pose.
+      /// \return True if the object exists.
+      public: bool SetObjectPose(RayObjectId _id, const math::Pose3d &_pose);
+
+      /// \brief Get the world pose of an object.
+      /// \param[in] _id Id of the object.
+      /// \return World pose, or identity if the object doesn't exist.
+      public: math::Pose3d ObjectPose(RayObjectId _id) const;
+
+      /// \brief Get the world bounds of an object.
+      /// \param[in] _id Id of the object.
+      /// \return Axis aligned box in world frame, or an empty box if the
+      /// object doesn't exist.
+      public: math::AxisAlignedBox ObjectBoundingBox(RayObjectId _id) const;
+
+      /// \brief Set the retro-reflectance reported for hits on an object.
+      /// Defaults to zero.
+      /// \param[in] _id Id of the object.
+      /// \param[in] _retro Retro-reflectance value.
+      /// \return True if the object exists.
+      public: bool SetObjectRetro(RayObjectId _id, double _retro);
+
+      /// \brief Get the number of objects in the scene.
+      /// \return Number of objects.
+      public: std::size_t ObjectCount() const;
+
+      /// \brief Get the revision of the scene. The revision increases every
+      /// time an object is added, removed or changed.
+      /// \return Scene revision.
+      public: uint64_t Revision() const;
+
+      /// \brief Set the number of threads used to cast rays. Defaults to
+      /// the number of hardware threads.
+      /// \param[in] _count Number of threads, values below one cast on the
+      /// calling thread.
+      public: void SetThreadCount(unsigned int _count);
+
+      /// \brief Get the number of threads used to cast rays.
+      /// \return Number of threads.
+      public: unsigned int ThreadCount() const;
+
+      /// \brief Cast rays that share an origin. Neighbouring directions
+      /// should be stored next to each other, which keeps ray packets
+      /// coherent.
+      /// \param[in] _origin World pose of the ray origin.
+      /// \param[in] _directions Unit ray directions in the origin frame.
+      /// \param[in] _minRange Distance at which rays start.
+      /// \param[in] _maxRange Distance at which rays end.
+      /// \param[out] _hits One result per direction.
+      public: void CastRays(const math::Pose3d &_origin,
+                  const std::vector<math::Vector3d> &_directions,
+                  double _minRange, double _maxRange,
+                  std::vector<RayHit> &_hits);
+
+      /// \internal
+      /// \brief Private data pointer.
+      private: std::unique_ptr<RayScenePrivate> dataPtr;
+    };
+
+    /// \brief Shared pointer to RayScene
+    typedef std::shared_ptr<RayScene> RayScenePtr;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef IGNITION_SENSORS_RECORDER_HH_
+#define IGNITION_SENSORS_RECORDER_HH_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <google/protobuf/message.h>
+
+#include <ignition/common/Time.hh>
+
+#include "ignition/sensors/config.hh"
+#include "ignition/sensors/Export.hh"
+
+namespace ignition
+{
+  namespace sensors
+  {
+    // Inline bracket to help doxygen filtering.
+    inline namespace IGNITION_SENSORS_VERSION_NAMESPACE {
+    //
+    /// \brief forward declarations
+    class RecorderPrivate;
+
+    /// \brief Appends sensor messages to a recording, to be read back with
+    /// Replay.
+    ///
+    ///   The recording is a log of fixed size chunks that are mapped in
+    ///   memory one at a time, and messages are serialized directly into
+    ///   the mapped chunk. Each message belongs to a channel, identified by
+    ///   the sensor name, topic and message type. Close() appends an index
+    ///   of the messages sorted by stamp. A recording that wasn't closed,
+    ///   for example after a crash, can still be replayed. This class is
+    ///   thread safe.
+    /// \sa Manager::StartRecording
+    class IGNITION_SENSORS_VISIBLE Recorder
+    {
+      /// \brief Constructor
+      public: Recorder();
+
+      /// \brief Destructor, closes the recording.
+      public: ~Recorder();
+
+      /// \brief Create a recording, closing the current one.
+      /// \param[in] _path Path of the file, overwritten if it exists.
+      /// \param[in] _chunkSize Size of the chunks in bytes, rounded up to
+      /// the page size. Messages larger than a chunk get a chunk of their
+      /// own.
+      /// \return False if the file couldn't be created.
+      public: bool Open(const std::string &_path,
+                  std::size_t _chunkSize = 4u * 1024u * 1024u);
+
+      /// \brief Get whether a recording is open.
+      /// \return True between Open() and Close().
+      public: bool IsOpen() const;
+
+      /// \brief Append a message.
+      /// \param[in] _sensor Name of the sensor that produced the message.
+      /// \param[in] _topic Topic of the sensor.
+      /// \param[in] _msg The message.
+      /// \param[in] _stamp Stamp of the message.
+      /// \return False if no recording is open or it couldn't grow.
+      public: bool Add(const std::string &_sensor, const std::string &_topic,
+                  const google::protobuf::Message &_msg,
+                  const common::Time &_stamp);
+
+      /// \brief Append a message, stamped with the stamp of its header.
+      /// Messages without a header field of type msgs::Header are stamped
+      /// with zero.
+      /// \param[in] _sensor Name of the sensor that produced the message.
+      /// \param[in] _topic Topic of the sensor.
+      /// \param[in] _msg The message.
+      /// \return False if no recording is open or it couldn't grow.
+      public: bool Add(const std::string &_sensor, const std::string &_topic,
+                  const google::protobuf::Message &_msg);
+
+      /// \brief Get the number of messages in the recording.
+      /// \return Number of messages added since Open().
+      public: uint64_t MessageCount() const;
+
+      /// \brief Write the index and close the recording.
+      /// \return False if no recording was open or the index couldn't be
+      /// written.
+      public: bool Close();
+
+      /// \internal
+      /// \brief Private data pointer.
+      private: std::unique_ptr<RecorderPrivate> dataPtr;
+    };
+    }
+  }
+}
+
+#endif
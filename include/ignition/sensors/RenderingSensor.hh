@@ -17,12 +17,16 @@
 #ifndef IGNITION_SENSORS_RENDERINGSENSOR_HH_
 #define IGNITION_SENSORS_RENDERINGSENSOR_HH_
 
+#include <cstdint>
+#include <functional>
 #include <memory>
 
+#include <ignition/common/Time.hh>
 #include <ignition/rendering/Scene.hh>
 #include <ignition/rendering/Sensor.hh>
 
 #include "ignition/sensors/rendering/Export.hh"
+#include "ignition/sensors/RayScene.hh"
 #include "ignition/sensors/Sensor.hh"
 
 namespace ignition
@@ -35,6 +39,21 @@ namespace ignition
     /// \brief forward declarations
     class RenderingSensorPrivate;
 
+    /// \brief What a rendering sensor does on an update when nothing it
+    /// sees has changed since its last frame.
+    /// \sa RenderingSensor::SetFrameReuse
+    enum class IGNITION_SENSORS_RENDERING_VISIBLE FrameReusePolicy : int
+    {
+      /// \brief Always render a new frame.
+      NEVER = 0,
+
+      /// \brief Publish the last frame again with the new time stamp.
+      REPUBLISH = 1,
+
+      /// \brief Don't publish anything.
+      SKIP = 2
+    };
+
     /// \brief a rendering sensor class
     ///
     ///   This class is a base for all rendering sensor classes. It provides
@@ -56,6 +75,19 @@ namespace ignition
       /// \brief Get the rendering scene.
       public: rendering::ScenePtr Scene() const;
 
+      /// \brief Set a scene to cast rays against on the CPU. Sensors that
+      /// support it generate data from this scene instead of the rendering
+      /// scene, so they don't need a GPU. The same scene may be shared by
+      /// several sensors.
+      /// \param[in] _scene Scene to cast rays against, null to use the
+      /// rendering scene.
+      public: void SetCpuScene(RayScenePtr _scene);
+
+      /// \brief Get the scene used to cast rays on the CPU.
+      /// \return Scene, null if not set.
+      /// \sa SetCpuScene
+      public: RayScenePtr CpuScene() const;
+
       /// \brief Render update. This performs the actual render operation.
       public: void Render();
 
@@ -71,11 +103,110 @@ namespace ignition
       /// \sa SetManualSceneUpdate
       public: bool ManualSceneUpdate() const;
 
+      /// \brief Set the number of frames whose post-processing may run on
+      /// a worker thread while the next frame is rendered. Post-processing
+      /// covers copying data out of the frame buffers, converting it,
+      /// filling messages and publishing. A value of zero, which is the
+      /// default, performs all of the work inside Update. Any frames that
+      /// are still queued are published before the depth changes.
+      ///
+      /// When the depth is greater than zero, messages are published and
+      /// callbacks are triggered from the pipeline thread, in frame order.
+      /// \param[in] _depth Maximum number of frames waiting to be
+      /// post-processed.
+      public: void SetPipelineDepth(unsigned int _depth);
+
+      /// \brief Get the number of frames that may be post-processed while
+      /// the next frame is rendered.
+      /// \return Pipeline depth, zero when pipelining is disabled.
+      /// \sa SetPipelineDepth
+      public: unsigned int PipelineDepth() const;
+
+      /// \brief Set the maximum amount of simulation time a frame may wait
+      /// in the pipeline. When a new frame is queued, any frame stamped
+      /// earlier than the new stamp minus this bound is published first.
+      /// A zero bound, the default, limits the pipeline by depth only.
+      /// \param[in] _latency Latency bound in simulation time.
+      public: void SetPipelineLatency(const common::Time &_latency);
+
+      /// \brief Get the maximum amount of simulation time a frame may wait
+      /// in the pipeline.
+      /// \return Latency bound, zero when unbounded.
+      /// \sa SetPipelineLatency
+      public: common::Time PipelineLatency() const;
+
+      /// \brief Block until every queued frame has been post-processed.
+      public: void FlushPipeline();
+
+      /// \brief Set what to do when an update finds that neither the
+      /// sensor pose nor the scene changed since the last rendered frame.
+      /// Reusing a frame skips both rendering and copying the frame out of
+      /// the rendering engine. Scene changes are detected through
+      /// SetSceneRevision, or through the revision of the CPU scene, so a
+      /// frame is never reused until one of them is available. Defaults to
+      /// FrameReusePolicy::NEVER.
+      /// \param[in] _policy Frame reuse policy.
+      public: void SetFrameReuse(FrameReusePolicy _policy);
+
+      /// \brief Get what to do when nothing changed since the last frame.
+      /// \return Frame reuse policy.
+      /// \sa SetFrameReuse
+      public: FrameReusePolicy FrameReuse() const;
+
+      /// \brief Set the revision of the rendering scene. The host should
+      /// change the revision whenever something visible changes, such as a
+      /// node transform or a material. Calling this enables frame reuse for
+      /// sensors that render the rendering scene.
+      /// \param[in] _revision Scene revision.
+      /// \sa SetFrameReuse
+      public: void SetSceneRevision(uint64_t _revision);
+
+      /// \brief Get the revision of the rendering scene set by the host.
+      /// \return Scene revision, zero if it was never set.
+      public: uint64_t SceneRevision() const;
+
+      /// \brief Get the number of updates that reused the last frame
+      /// instead of rendering a new one.
+      /// \return Number of reused frames.
+      public: uint64_t ReusedFrameCount() const;
+
       /// \brief Add a rendering::Sensor. Its render updates will be handled
       /// by this base class.
       /// \param[in] _sensor Sensor to add.
       protected: void AddSensor(rendering::SensorPtr _sensor);
 
+      /// \brief Post-process a rendered frame. The work runs immediately if
+      /// the pipeline depth is zero. Otherwise it is queued behind earlier
+      /// frames, and this function only blocks when the pipeline is full
+      /// or when an older frame exceeds the latency bound.
+      ///
+      /// The work must not access data that the next render overwrites.
+      /// Use NextPipelineSlot() to select per-frame buffers.
+      /// \param[in] _stamp Simulation time of the frame.
+      /// \param[in] _work Function that converts and publishes the frame.
+      protected: void PostProcess(const common::Time &_stamp,
+                     std::function<void()> _work);
+
+      /// \brief Advance to the next per-frame buffer slot. Slots cycle
+      /// through PipelineDepth() + 1 values, so the slot returned is never
+      /// in use by a queued frame. Call this once per rendered frame,
+      /// before rendering into the buffers.
+      /// \return Index of the buffer slot for the frame about to render.
+      protected: unsigned int NextPipelineSlot();
+
+      /// \brief Check whether the current update has to render a new
+      /// frame. This is always the case unless frame reuse is enabled,
+      /// there is a previous frame, and neither the sensor pose nor the
+      /// scene revision changed since then. When a new frame is needed,
+      /// the current pose and revision are recorded for it.
+      /// \return True to render, false to reuse the last frame.
+      /// \sa SetFrameReuse
+      protected: bool FrameDirty();
+
+      /// \brief Make the next update render a new frame, for example after
+      /// the image size changed.
+      protected: void InvalidateFrame();
+
       /// \internal
       /// \brief Data pointer for private data
       private: std::unique_ptr<RenderingSensorPrivate> dataPtr;
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef IGNITION_SENSORS_REPLAY_HH_
+#define IGNITION_SENSORS_REPLAY_HH_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <google/protobuf/message.h>
+
+#include <ignition/common/Time.hh>
+
+#include "ignition/sensors/config.hh"
+#include "ignition/sensors/Export.hh"
+
+namespace ignition
+{
+  namespace sensors
+  {
+    // Inline bracket to help doxygen filtering.
+    inline namespace IGNITION_SENSORS_VERSION_NAMESPACE {
+    //
+    /// \brief forward declarations
+    class ReplayPrivate;
+
+    /// \brief A message read from a recording. The data points into the
+    /// mapped recording and stays valid until the replay is closed.
+    struct IGNITION_SENSORS_VISIBLE ReplayMessage
+    {
+      /// \brief Name of the sensor that produced the message.
+      std::string sensor;
+
+      /// \brief Topic of the sensor.
+      std::string topic;
+
+      /// \brief Type name of the message, such as "ignition.msgs.IMU".
+      std::string type;
+
+      /// \brief Stamp of the message.
+      common::Time stamp;
+
+      /// \brief Serialized message.
+      const char *data = nullptr;
+
+      /// \brief Size of the serialized message.
+      std::size_t size = 0u;
+
+      /// \brief Parse the message.
+      /// \param[out] _msg Message of the recorded type.
+      /// \return False if the type differs or the data is invalid.
+      public: bool Parse(google::protobuf::Message &_msg) const;
+    };
+
+    /// \brief Reads a recording written by Recorder, to iterate over its
+    /// messages or play them back.
+    ///
+    ///   The recording is mapped in memory and messages are returned in
+    ///   stamp order. A time table built when opening the recording makes
+    ///   Seek() take constant time for recordings with steady rates.
+    class IGNITION_SENSORS_VISIBLE Replay
+    {
+      /// \brief Constructor
+      public: Replay();
+
+      /// \brief Destructor
+      public: ~Replay();
+
+      /// \brief Map a recording, closing the current one. Recordings that
+      /// weren't closed are indexed by scanning their chunks.
+      /// \param[in] _path Path of the recording.
+      /// \return False if the file can't be read or isn't a recording.
+      public: bool Open(const std::string &_path);
+
+      /// \brief Unmap the recording.
+      public: void Close();
+
+      /// \brief Get the number of messages.
+      /// \return Number of messages in the recording.
+      public: uint64_t MessageCount() const;
+
+      /// \brief Get the stamp of the first message.
+      /// \return Stamp, zero if there are no messages.
+      public: common::Time StartTime() const;
+
+      /// \brief Get the stamp of the last message.
+      /// \return Stamp, zero if there are no messages.
+      public: common::Time EndTime() const;
+
+      /// \brief Move to the first message stamped at or after a time.
+      /// \param[in] _time Time to seek to.
+      /// \return False if all messages are stamped before the time.
+      public: bool Seek(const common::Time &_time);
+
+      /// \brief Read the next message.
+      /// \param[out] _msg The message.
+      /// \return False at the end of the recording.
+      public: bool Next(ReplayMessage &_msg);
+
+      /// \brief Play the messages from the current position to the end,
+      /// blocking until done or Stop() is called. Messages are passed to a
+      /// callback, or published on the topics they were recorded from.
+      /// Messages of a sensor with another type than the first one
+      /// published on its topic, such as point clouds of depth cameras,
+      /// are published on "<topic>/<type>", where type is the lowercase
+      /// name of the message type.
+      /// \param[in] _speed Factor of the recorded rate to play at, zero or
+      /// less to play as fast as possible.
+      /// \param[in] _callback Function receiving the messages, nullptr to
+      /// publish them.
+      /// \return Number of messages played.
+      public: uint64_t Play(double _speed,
+          const std::function<void(const ReplayMessage &)> &_callback =
+          nullptr);
+
+      /// \brief Stop Play(). This can be called from another thread or from
+      /// the callback.
+      public: void Stop();
+
+      /// \internal
+      /// \brief Private data pointer.
+      private: std::unique_ptr<ReplayPrivate> dataPtr;
+    };
+    }
+  }
+}
+
+#endif
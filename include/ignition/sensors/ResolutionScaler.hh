@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef IGNITION_SENSORS_RESOLUTIONSCALER_HH_
+#define IGNITION_SENSORS_RESOLUTIONSCALER_HH_
+
+#include <memory>
+
+#include "ignition/sensors/config.hh"
+#include "ignition/sensors/Export.hh"
+
+namespace ignition
+{
+  namespace sensors
+  {
+    // Inline bracket to help doxygen filtering.
+    inline namespace IGNITION_SENSORS_VERSION_NAMESPACE {
+    //
+    /// \brief forward declarations
+    class ResolutionScalerPrivate;
+
+    /// \brief Chooses the resolution of rendered images from the time
+    /// taken to render them.
+    ///
+    ///   The scale applies to both the width and the height of the images.
+    /// It is lowered while the smoothed render time exceeds the target, and
+    /// raised when it is well below, within the scale bounds. The scale
+    /// moves in steps of 1/20, and settles for a few frames after each
+    /// change, so images aren't resized every frame.
+    class IGNITION_SENSORS_VISIBLE ResolutionScaler
+    {
+      /// \brief Constructor
+      public: ResolutionScaler();
+
+      /// \brief Destructor
+      public: ~ResolutionScaler();
+
+      /// \brief Set the bounds of the scale. The scale starts at the upper
+      /// bound. Both default to 1, which disables scaling.
+      /// \param[in] _min Lower bound, greater than zero.
+      /// \param[in] _max Upper bound, not less than the lower bound.
+      /// \return False if the bounds are invalid.
+      public: bool SetBounds(double _min, double _max);
+
+      /// \brief Get the lower bound of the scale.
+      /// \return Lower bound.
+      public: double MinScale() const;
+
+      /// \brief Get the upper bound of the scale.
+      /// \return Upper bound.
+      public: double MaxScale() const;
+
+      /// \brief Set the render time to aim for.
+      /// \param[in] _seconds Target time in seconds, zero to keep the
+      /// scale at its upper bound, which is the default.
+      public: void SetTargetTime(double _seconds);
+
+      /// \brief Get the render time to aim for.
+      /// \return Target time in seconds.
+      public: double TargetTime() const;
+
+      /// \brief Get whether images may be scaled, either because a target
+      /// time is set or because the upper bound isn't 1.
+      /// \return True if scaling is enabled.
+      public: bool Enabled() const;
+
+      /// \brief Get the current scale.
+      /// \return Scale of the image width and height.
+      public: double Scale() const;
+
+      /// \brief Get a scaled image dimension.
+      /// \param[in] _size Full width or height in pixels.
+      /// \return Scaled size, at least one pixel.
+      public: unsigned int Scaled(unsigned int _size) const;
+
+      /// \brief Add the time taken to render a frame at the current scale.
+      /// \param[in] _seconds Render time in seconds.
+      /// \return True if the scale changed.
+      public: bool AddSample(double _seconds);
+
+      /// \brief Forget the render times and go back to the upper bound.
+      public: void Reset();
+
+      /// \internal
+      /// \brief Private data pointer.
+      private: std::unique_ptr<ResolutionScalerPrivate> dataPtr;
+    };
+    }
+  }
+}
+
+#endif
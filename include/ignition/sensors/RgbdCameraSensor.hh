@@ -18,6 +18,7 @@
 #define IGNITION_SENSORS_RGBDCAMERASENSOR_HH_
 
 #include <memory>
+#include <string>
 
 #include <sdf/sdf.hh>
 
@@ -45,6 +46,9 @@ namespace ignition
     /// * Depth image (same as DepthCamera)
     /// * (future / todo) Color point cloud
     /// The scene  must be created in advance and given to Manager::Init().
+    /// Without a rendering scene, data is rendered on the CPU by casting
+    /// rays into the scene set with SetCpuScene. The CPU scene has no
+    /// materials, so the RGB image shows hits in white.
     /// It offers both an ignition-transport interface and a direct C++ API
     /// to access the image data. The API works by setting a callback to be
     /// called with image data.
@@ -71,6 +75,47 @@ namespace ignition
       /// \return true if the update was successful
       public: virtual bool Update(const common::Time &_now) override;
 
+      // Documentation inherited
+      public: virtual bool HasSubscribers() const override;
+
+      // Documentation inherited
+      public: virtual SensorMemoryUsage MemoryUsage() const override;
+
+      /// \brief Set whether the point cloud keeps only the pixels with a
+      /// finite depth. The cloud is then unorganized and dense. Otherwise
+      /// it has a point per pixel, including pixels beyond the clip planes.
+      /// \param[in] _dense True to drop pixels without a depth.
+      /// \sa SetDensePointCloudIndex
+      public: void SetDensePointCloud(bool _dense);
+
+      /// \brief Get whether the point cloud is compacted into a dense cloud.
+      /// \return True if invalid points are dropped.
+      public: bool DensePointCloud() const;
+
+      /// \brief Set whether a dense point cloud has UINT16 "row" and
+      /// "column" fields with the position of the pixel of each point.
+      /// \param[in] _index True to add the fields.
+      /// \sa SetDensePointCloud
+      public: void SetDensePointCloudIndex(bool _index);
+
+      /// \brief Get whether a dense point cloud has row and column fields.
+      /// \return True if the fields are added.
+      public: bool DensePointCloudIndex() const;
+
+      /// \brief Set the frame the point cloud is published in. When set,
+      /// points are transformed into the frame using the camera pose, see
+      /// Sensor::Pose(). The images aren't affected.
+      /// \param[in] _frameId Target frame id, or empty for the camera
+      /// frame, the default.
+      /// \param[in] _targetPoseInWorld Pose of the target frame in the
+      /// frame Pose() is relative to, the world by default.
+      public: void SetPointCloudFrame(const std::string &_frameId,
+          const math::Pose3d &_targetPoseInWorld = math::Pose3d::Zero);
+
+      /// \brief Get the frame the point cloud is published in.
+      /// \return Target frame id, empty for the sensor frame.
+      public: std::string PointCloudFrame() const;
+
       /// \brief Set the rendering scene.
       /// \param[in] _scene Pointer to the scene
       public: virtual void SetScene(
@@ -88,6 +133,10 @@ namespace ignition
       /// \return True on success.
       private: bool CreateCameras();
 
+      /// \brief Set up rendering on the CPU from the camera SDF.
+      /// \return True on success.
+      private: bool CreateCpuCameras();
+
       /// \brief Data pointer for private data
       /// \internal
       private: std::unique_ptr<RgbdCameraSensorPrivate> dataPtr;
@@ -19,11 +19,17 @@
 
 #include <ignition/msgs/header.pb.h>
 
+#include <cstddef>
+#include <istream>
 #include <memory>
+#include <ostream>
 #include <string>
 
+#include <google/protobuf/message.h>
+
 #include <ignition/common/Time.hh>
 #include <ignition/math/Pose3.hh>
+#include <ignition/transport/Node.hh>
 #include <ignition/sensors/config.hh>
 #include <ignition/sensors/Export.hh>
 #include <sdf/sdf.hh>
@@ -40,8 +46,53 @@ namespace ignition
     const SensorId NO_SENSOR = 0;
 
     /// \brief forward declarations
+    class Sensor;
     class SensorPrivate;
 
+    /// \brief Receives the messages of sensors in place of their
+    /// publishers, for example to bundle them. See
+    /// Sensor::SetMessageSink().
+    class IGNITION_SENSORS_VISIBLE MessageSink
+    {
+      /// \brief Destructor
+      public: virtual ~MessageSink() = default;
+
+      /// \brief Take a message produced by a sensor. This may be called
+      /// from a sensor's rendering pipeline thread.
+      /// \param[in] _sensor Sensor that produced the message.
+      /// \param[in] _msg The message.
+      public: virtual void Add(const Sensor &_sensor,
+                  const google::protobuf::Message &_msg) = 0;
+
+      /// \brief Get whether the messages are consumed. Sensors skip the
+      /// messages they only produce on demand when this is false.
+      /// \return True if the messages have subscribers.
+      public: virtual bool HasConnections() const = 0;
+    };
+
+    /// \brief Memory held by a sensor, in bytes. See Sensor::MemoryUsage().
+    struct IGNITION_SENSORS_VISIBLE SensorMemoryUsage
+    {
+      /// \brief Frame buffers, images, rays and other data the sensor
+      /// produces or renders.
+      std::size_t buffers = 0u;
+
+      /// \brief Messages kept by the sensor between updates.
+      std::size_t messages = 0u;
+
+      /// \brief Configuration: the SDF, names, topics and sequences.
+      std::size_t config = 0u;
+
+      /// \brief Get the memory of all categories.
+      /// \return Sum of the categories.
+      std::size_t Total() const;
+
+      /// \brief Add the memory of another sensor.
+      /// \param[in] _usage Memory to add.
+      /// \return Reference to this.
+      SensorMemoryUsage &operator+=(const SensorMemoryUsage &_usage);
+    };
+
     /// \brief a base sensor class
     ///
     ///   This class is a base for all sensor classes. It parses some common
@@ -86,6 +137,11 @@ namespace ignition
       /// \brief Return the next time the sensor will generate data
       public: common::Time NextUpdateTime() const;
 
+      /// \brief Set the next time the sensor will generate data, for example
+      /// to update sooner after its update rate was raised.
+      /// \param[in] _time Next update time.
+      public: void SetNextUpdateTime(const common::Time &_time);
+
       /// \brief Update the sensor.
       ///
       ///   This is called by the manager, and is responsible for determining
@@ -132,6 +188,13 @@ namespace ignition
       /// \return Topic sensor publishes data to
       public: std::string Topic() const;
 
+      /// \brief Get whether the data of this sensor is consumed, by topic
+      /// subscribers or by callbacks. Sensors that can't tell return true,
+      /// which is the default.
+      /// \return True if the sensor data is consumed.
+      /// \sa Manager::SetRateGovernorEnabled()
+      public: virtual bool HasSubscribers() const;
+
       /// \brief Get parent link of the sensor.
       /// \return Parent link of sensor.
       public: std::string Parent() const;
@@ -145,6 +208,11 @@ namespace ignition
       /// information for this sensor.
       public: sdf::ElementPtr SDF() const;
 
+      /// \brief Get the SDF sensor DOM object used to load this sensor.
+      /// \return The DOM object passed to Load(), or an empty one if the
+      /// sensor wasn't loaded.
+      public: const sdf::Sensor &SDFSensor() const;
+
       /// \brief Add a sequence number to an ignition::msgs::Header. This
       /// function can be called by a sensor that wants to add a sequence
       /// number to a sensor message in order to have improved
@@ -166,6 +234,99 @@ namespace ignition
       public: void AddSequence(ignition::msgs::Header *_msg,
                   const std::string &_seqKey = "default");
 
+      /// \brief Write the runtime state of the sensor in binary form: the
+      /// next update time, the sequence numbers and, in sensors that
+      /// override this function, their own state such as noise models.
+      /// Subclasses must call the base class first.
+      /// \param[in] _out Output stream.
+      /// \return False if the state couldn't be written.
+      /// \sa Manager::SaveState
+      public: virtual bool SaveState(std::ostream &_out) const;
+
+      /// \brief Restore the runtime state written by SaveState() on a
+      /// sensor loaded from the same SDF. Subclasses must call the base
+      /// class first.
+      /// \param[in] _in Input stream.
+      /// \return False if the state couldn't be read or doesn't match the
+      /// sensor.
+      public: virtual bool LoadState(std::istream &_in);
+
+      /// \brief Get the memory held by this sensor. The base class counts
+      /// its configuration; sensors that keep buffers or messages override
+      /// this function and add them. The memory is estimated from the
+      /// capacity of buffers and the space used by messages, and doesn't
+      /// include GPU memory or scenes shared with other sensors.
+      /// \return Memory by category.
+      /// \sa Manager::MemoryUsage
+      public: virtual SensorMemoryUsage MemoryUsage() const;
+
+      /// \brief Send the messages of this sensor to a sink instead of its
+      /// publishers. The sink isn't owned by the sensor and must outlive
+      /// it, or be unset first.
+      /// \param[in] _sink The sink, nullptr to publish messages again.
+      public: void SetMessageSink(MessageSink *_sink);
+
+      /// \brief Get the sink receiving the messages of this sensor.
+      /// \return The sink, nullptr if messages are published.
+      public: MessageSink *Sink() const;
+
+      /// \brief Pass the messages of this sensor to a tap, in addition to
+      /// publishing them or passing them to the message sink. Messages
+      /// produced on demand are produced while the tap has connections.
+      /// The tap isn't owned by the sensor and must outlive it, or be unset
+      /// first.
+      /// \param[in] _tap The tap, nullptr to remove it.
+      public: void SetMessageTap(MessageSink *_tap);
+
+      /// \brief Get the tap receiving the messages of this sensor.
+      /// \return The tap, nullptr if there is none.
+      public: MessageSink *Tap() const;
+
+      /// \brief Publish a message, or pass it to the message sink if one is
+      /// set, and pass it to the message tap if one is set. Sensors should
+      /// publish their data through this function.
+      /// \param[in] _pub Publisher of the message.
+      /// \param[in] _msg The message.
+      /// \return True if the message was published or passed to the sink.
+      /// \sa SetMessageSink()
+      protected: bool Publish(transport::Node::Publisher &_pub,
+                     const google::protobuf::Message &_msg);
+
+      /// \brief Get whether a message of a publisher would be consumed,
+      /// either because the publisher has subscribers, or because the
+      /// message sink or tap does.
+      /// \param[in] _pub Publisher of the message.
+      /// \return True if the message would be consumed.
+      protected: bool HasConnections(
+                     const transport::Node::Publisher &_pub) const;
+
+      /// \brief Get a message to fill and publish during an update, instead
+      /// of constructing a new one every update.
+      ///
+      /// There is one message per type and per thread, and each call resets
+      /// it with ResetFrameMessage. Once a sensor has published a few
+      /// messages, filling the same fields again doesn't allocate memory.
+      /// The message must be published before the next call for the same
+      /// type on the same thread.
+      /// \return A reset message.
+      protected: template<typename T>
+                 static T &FrameMessage()
+      {
+        thread_local T msg;
+        ResetFrameMessage(msg);
+        return msg;
+      }
+
+      /// \brief Empty a message while keeping the memory it allocated.
+      /// Scalars are set to their default, strings and repeated fields are
+      /// emptied without releasing their buffers and elements, and
+      /// sub-messages are reset recursively. Unlike Clear(), sub-messages
+      /// that were set stay set, so a message should always be filled with
+      /// the same sub-messages.
+      /// \param[in,out] _msg Message to reset.
+      protected: static void ResetFrameMessage(
+                     google::protobuf::Message &_msg);
+
       /// \internal
       /// \brief Data pointer for private data
       private: std::unique_ptr<SensorPrivate> dataPtr;
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef IGNITION_SENSORS_SENSORCONFIGCACHE_HH_
+#define IGNITION_SENSORS_SENSORCONFIGCACHE_HH_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <sdf/sdf.hh>
+
+#include "ignition/sensors/config.hh"
+#include "ignition/sensors/Export.hh"
+
+namespace ignition
+{
+  namespace sensors
+  {
+    // Inline bracket to help doxygen filtering.
+    inline namespace IGNITION_SENSORS_VERSION_NAMESPACE {
+    //
+    /// \brief forward declarations
+    class SensorConfigCachePrivate;
+
+    /// \brief Compiled sensor configurations, to create sensors without
+    /// parsing SDF.
+    ///
+    ///   Each entry holds the sdf::Sensor fields the sensors of this library
+    ///   use, along with the sensor's parent. Air pressure, altimeter,
+    ///   camera, depth camera, GPU lidar, IMU, lidar, magnetometer, RGBD
+    ///   camera and thermal camera sensors are supported. Sensors created
+    ///   from a cache have no SDF element, see Sensor::SDF().
+    ///
+    ///   The file starts with a header holding a magic number, the format
+    ///   version, the number of entries and a checksum of the entries, and
+    ///   uses the host byte order. Open() maps the file in memory and
+    ///   indexes the entries, which are decoded on demand.
+    /// \sa Manager::SaveConfigCache, Manager::CreateSensors
+    class IGNITION_SENSORS_VISIBLE SensorConfigCache
+    {
+      /// \brief Constructor
+      public: SensorConfigCache();
+
+      /// \brief Destructor
+      public: ~SensorConfigCache();
+
+      /// \brief Get the version of the format written by Save(). Open()
+      /// rejects files of other versions.
+      /// \return Format version.
+      public: static uint32_t FormatVersion();
+
+      /// \brief Get whether a sensor can be stored in a cache.
+      /// \param[in] _sdf SDF sensor DOM object.
+      /// \return True if the type of the sensor is supported and it has
+      /// the matching sensor DOM, such as sdf::Sensor::ImuSensor().
+      public: static bool Supported(const sdf::Sensor &_sdf);
+
+      /// \brief Add a sensor configuration.
+      /// \param[in] _sdf SDF sensor DOM object.
+      /// \param[in] _parent Name of the parent of the sensor.
+      /// \return False if the sensor isn't supported.
+      public: bool Add(const sdf::Sensor &_sdf,
+                  const std::string &_parent = "");
+
+      /// \brief Get the number of sensor configurations.
+      /// \return Number of entries.
+      public: std::size_t Count() const;
+
+      /// \brief Decode a sensor configuration.
+      /// \param[in] _index Index of the entry, less than Count().
+      /// \param[out] _sdf SDF sensor DOM object.
+      /// \param[out] _parent Name of the parent of the sensor.
+      /// \return False if the index is out of range or the entry is
+      /// invalid.
+      public: bool Entry(std::size_t _index, sdf::Sensor &_sdf,
+                  std::string &_parent) const;
+
+      /// \brief Write the configurations to a file.
+      /// \param[in] _path Path of the file.
+      /// \return False if the file couldn't be written.
+      public: bool Save(const std::string &_path) const;
+
+      /// \brief Map a file written by Save(), replacing the current
+      /// configurations.
+      /// \param[in] _path Path of the file.
+      /// \return False if the file can't be read, isn't a cache of the
+      /// current version, or fails its checksum. The cache is empty then.
+      public: bool Open(const std::string &_path);
+
+      /// \brief Remove all configurations, unmapping the file if one was
+      /// opened.
+      public: void Clear();
+
+      /// \internal
+      /// \brief Private data pointer.
+      private: std::unique_ptr<SensorConfigCachePrivate> dataPtr;
+    };
+    }
+  }
+}
+
+#endif
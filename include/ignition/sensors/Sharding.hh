@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef IGNITION_SENSORS_SHARDING_HH_
+#define IGNITION_SENSORS_SHARDING_HH_
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sdf/sdf.hh>
+
+#include <ignition/common/Time.hh>
+#include <ignition/math/Pose3.hh>
+
+#include "ignition/sensors/config.hh"
+#include "ignition/sensors/Export.hh"
+#include "ignition/sensors/Manager.hh"
+#include "ignition/sensors/Sensor.hh"
+
+namespace ignition
+{
+  namespace sensors
+  {
+    // Inline bracket to help doxygen filtering.
+    inline namespace IGNITION_SENSORS_VERSION_NAMESPACE {
+    //
+    /// \brief forward declarations
+    class ShardCoordinatorPrivate;
+    class ShardWorkerPrivate;
+
+    /// \brief How a ShardCoordinator chooses the worker of a new sensor.
+    enum class ShardPlacement
+    {
+      /// \brief Sensors of the same type go to the same worker. Each new
+      /// type goes to the worker with the fewest types, unless it was
+      /// assigned with ShardCoordinator::AssignType().
+      BY_TYPE,
+
+      /// \brief Sensors go to the worker with the lowest estimated load.
+      /// The load of a sensor is its update rate, with sensors that update
+      /// every step counting as 1 kHz, times 100 for rendering sensors.
+      BY_LOAD
+    };
+
+    /// \brief Statistics a worker reports after each step.
+    struct ShardStatistics
+    {
+      /// \brief Number of sensors on the worker.
+      unsigned int sensors = 0;
+
+      /// \brief Estimated load of the sensors, see ShardPlacement::BY_LOAD.
+      double load = 0.0;
+
+      /// \brief Number of steps the worker completed.
+      uint64_t completedSteps = 0;
+
+      /// \brief Simulated time of the last completed step.
+      common::Time stepTime;
+
+      /// \brief Wall time taken by the sensor updates of the last step, in
+      /// seconds.
+      double updateTime = 0.0;
+    };
+
+    /// \brief Distributes sensors over worker processes and steps them.
+    ///
+    ///   Each worker is a ShardWorker, in the same process or in another
+    ///   process or host reachable by ignition-transport. The coordinator
+    ///   sends the SDF of each new sensor to the worker chosen by the
+    ///   placement, which creates it with its own Manager. Sensors publish
+    ///   from the worker on the topics of their SDF, so subscribers don't
+    ///   need to know where they run.
+    ///
+    ///   RunOnce() sends each worker the step time and the poses of its
+    ///   sensors set since the previous step. Workers step asynchronously
+    ///   and report ShardStatistics back.
+    ///
+    ///   Communication uses these topics and services, under
+    ///   `<namespace>/<worker name>`:
+    ///
+    ///   * `create` service: msgs::StringMsg with the sensor SDF, replies a
+    ///     msgs::UInt64 with the worker's sensor id, zero on failure.
+    ///   * `remove` service: msgs::UInt64 with the worker's sensor id,
+    ///     replies a msgs::Boolean.
+    ///   * `step` topic: msgs::Pose_V whose header stamp is the step time,
+    ///     with a "force" header entry if sensors must update, and whose
+    ///     poses have the worker's sensor ids.
+    ///   * `stats` topic: msgs::Param with the ShardStatistics fields. The
+    ///     completed step count is a double, exact up to 2^53 steps.
+    class IGNITION_SENSORS_VISIBLE ShardCoordinator
+    {
+      /// \brief Constructor
+      /// \param[in] _namespace Namespace of the worker topics.
+      public: explicit ShardCoordinator(
+                  const std::string &_namespace = "/sensors/shards");
+
+      /// \brief Destructor. Sensors are left on the workers.
+      public: ~ShardCoordinator();
+
+      /// \brief Add a worker. Its ShardWorker needs to run with the same
+      /// namespace by the time sensors are placed on it.
+      /// \param[in] _name Name of the worker.
+      /// \return False if the name is empty, already added, or if its step
+      /// topic can't be advertised.
+      public: bool AddWorker(const std::string &_name);
+
+      /// \brief Get the names of the workers.
+      /// \return Worker names.
+      public: std::vector<std::string> Workers() const;
+
+      /// \brief Set how the worker of new sensors is chosen. Defaults to
+      /// ShardPlacement::BY_LOAD.
+      /// \param[in] _placement Placement.
+      public: void SetPlacement(ShardPlacement _placement);
+
+      /// \brief Get how the worker of new sensors is chosen.
+      /// \return Placement.
+      public: ShardPlacement Placement() const;
+
+      /// \brief Place all new sensors of a type on a worker, with
+      /// ShardPlacement::BY_TYPE.
+      /// \param[in] _type Sensor type, as in the SDF, such as "camera".
+      /// \param[in] _worker Name of the worker.
+      /// \return False if the worker wasn't added.
+      public: bool AssignType(const std::string &_type,
+                  const std::string &_worker);
+
+      /// \brief Set how long to wait for a worker to create or remove a
+      /// sensor, or to subscribe to its first step. Defaults to 5 seconds,
+      /// which also gives the transport time to discover new workers.
+      /// \param[in] _ms Timeout in milliseconds.
+      public: void SetRequestTimeout(unsigned int _ms);
+
+      /// \brief Create a sensor on a worker.
+      /// \param[in] _sdf SDF <sensor> element.
+      /// \return Id of the sensor for this coordinator, NO_SENSOR on error.
+      public: SensorId CreateSensor(sdf::ElementPtr _sdf);
+
+      /// \brief Create a sensor on a worker.
+      /// \param[in] _sdf SDF sensor DOM object, loaded from an element.
+      /// \return Id of the sensor for this coordinator, NO_SENSOR on error.
+      public: SensorId CreateSensor(const sdf::Sensor &_sdf);
+
+      /// \brief Remove a sensor from its worker.
+      /// \param[in] _id Id of the sensor.
+      /// \return True if the sensor existed and the worker removed it.
+      public: bool Remove(SensorId _id);
+
+      /// \brief Get the worker a sensor was placed on.
+      /// \param[in] _id Id of the sensor.
+      /// \return Worker name, empty for an unknown sensor.
+      public: std::string SensorWorker(SensorId _id) const;
+
+      /// \brief Set the pose of a sensor. Poses are sent with the next
+      /// step.
+      /// \param[in] _id Id of the sensor.
+      /// \param[in] _pose Pose of the sensor.
+      /// \return False for an unknown sensor.
+      public: bool SetPose(SensorId _id, const math::Pose3d &_pose);
+
+      /// \brief Send a step to the workers, with the poses set since the
+      /// previous step. Doesn't wait for the workers to run it. Before the
+      /// first step of a worker with sensors, waits up to the request
+      /// timeout for the worker to subscribe to its steps, so that a worker
+      /// in another process doesn't miss the first steps.
+      /// \param[in] _time The current simulated time.
+      /// \param[in] _force Force all sensors to update.
+      public: void RunOnce(const common::Time &_time, bool _force = false);
+
+      /// \brief Get the last statistics each worker reported.
+      /// \return Statistics by worker name.
+      public: std::map<std::string, ShardStatistics> Statistics() const;
+
+      /// \internal
+      /// \brief Private data pointer.
+      private: std::unique_ptr<ShardCoordinatorPrivate> dataPtr;
+    };
+
+    /// \brief Hosts the sensors a ShardCoordinator places on it.
+    ///
+    ///   To run a worker as its own process, use the
+    ///   ign-sensors<version>-shard-worker executable.
+    ///
+    ///   Sensors are created by its own Manager, which can be configured,
+    ///   for example with plugin paths, before Start(). Steps are run on
+    ///   the transport thread as they arrive.
+    class IGNITION_SENSORS_VISIBLE ShardWorker
+    {
+      /// \brief Constructor
+      /// \param[in] _name Name of the worker.
+      /// \param[in] _namespace Namespace of the worker topics.
+      public: explicit ShardWorker(const std::string &_name,
+                  const std::string &_namespace = "/sensors/shards");
+
+      /// \brief Destructor
+      public: ~ShardWorker();
+
+      /// \brief Get the name of the worker.
+      /// \return Worker name.
+      public: std::string Name() const;
+
+      /// \brief Get the manager of the sensors. It must not be used while
+      /// the worker runs steps.
+      /// \return The manager.
+      public: Manager &SensorManager();
+
+      /// \brief Start accepting sensors and steps from the coordinator.
+      /// \return False if a topic or service can't be advertised.
+      public: bool Start();
+
+      /// \brief Get the number of steps the worker completed.
+      /// \return Completed steps.
+      public: uint64_t CompletedSteps() const;
+
+      /// \internal
+      /// \brief Private data pointer.
+      private: std::unique_ptr<ShardWorkerPrivate> dataPtr;
+    };
+    }
+  }
+}
+
+#endif
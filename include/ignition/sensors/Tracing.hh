@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef IGNITION_SENSORS_TRACING_HH_
+#define IGNITION_SENSORS_TRACING_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include <ignition/common/Profiler.hh>
+
+#include "ignition/sensors/config.hh"
+#include "ignition/sensors/Export.hh"
+
+namespace ignition
+{
+  namespace sensors
+  {
+    // Inline bracket to help doxygen filtering.
+    inline namespace IGNITION_SENSORS_VERSION_NAMESPACE {
+    //
+    /// \brief Identifies a sensor, see Sensor::Id().
+    using SensorId = std::size_t;
+
+    /// \brief Records the profiling zones of the library in memory, to dump
+    /// them as Chrome Trace Event JSON. The dump can be opened in
+    /// chrome://tracing or Perfetto. Unlike the Remotery profiler, this
+    /// needs no connection to a viewer.
+    ///
+    ///   Each thread records its zones in its own ring buffer, which keeps
+    ///   the latest events when it's full. Zones of sensors are tagged
+    ///   with the sensor name and id.
+    ///
+    ///   Setting the IGN_SENSORS_TRACE environment variable to a path
+    ///   starts tracing when the library is loaded, and dumps the trace
+    ///   to that path when the process exits.
+    class IGNITION_SENSORS_VISIBLE Tracing
+    {
+      /// \brief Start recording zones.
+      /// \param[in] _capacity Number of events kept per thread. It applies
+      /// to threads that record their first zone afterwards.
+      public: static void Start(std::size_t _capacity = 65536u);
+
+      /// \brief Stop recording zones. Recorded events are kept.
+      public: static void Stop();
+
+      /// \brief Get whether zones are recorded.
+      /// \return True between Start() and Stop().
+      public: static bool Enabled();
+
+      /// \brief Discard the recorded events.
+      public: static void Clear();
+
+      /// \brief Get the number of recorded events.
+      /// \return Events held by the ring buffers of all threads.
+      public: static std::size_t EventCount();
+
+      /// \brief Write the recorded events as Chrome Trace Event JSON.
+      /// Zones can still be recorded while dumping; the events of a thread
+      /// that are overwritten during the dump are left out.
+      /// \param[in] _out Stream to write to.
+      /// \return False if the stream failed.
+      public: static bool Dump(std::ostream &_out);
+
+      /// \brief Write the recorded events to a file.
+      /// \param[in] _path Path of the file.
+      /// \return False if the file couldn't be written.
+      public: static bool Dump(const std::string &_path);
+
+      /// \brief Set the name shown for the calling thread.
+      /// \param[in] _name Name of the thread.
+      public: static void SetThreadName(const std::string &_name);
+
+      /// \brief Set the name the zones of a sensor are tagged with. Called
+      /// when sensors are loaded. Names are kept after the sensor is
+      /// destroyed, so its events can still be dumped.
+      /// \param[in] _id Id of the sensor.
+      /// \param[in] _name Name of the sensor.
+      public: static void SetSensorName(SensorId _id,
+                  const std::string &_name);
+
+      /// \brief Record a zone.
+      /// \param[in] _name Name of the zone, a string literal.
+      /// \param[in] _start Start time, from Now().
+      /// \param[in] _sensor Id of the sensor the zone belongs to, zero for
+      /// none.
+      public: static void Record(const char *_name, int64_t _start,
+                  SensorId _sensor);
+
+      /// \brief Get the time used to stamp zones.
+      /// \return Monotonic time in nanoseconds.
+      public: static int64_t Now();
+    };
+
+    /// \brief Records a zone from its construction to its destruction,
+    /// while tracing is enabled. Use IGN_SENSORS_PROFILE() instead.
+    class IGNITION_SENSORS_VISIBLE TraceZone
+    {
+      /// \brief Constructor, starts the zone.
+      /// \param[in] _name Name of the zone, a string literal.
+      /// \param[in] _sensor Id of the sensor the zone belongs to, zero for
+      /// none.
+      public: explicit TraceZone(const char *_name, SensorId _sensor = 0u);
+
+      /// \brief Destructor, records the zone.
+      public: ~TraceZone();
+
+      /// \brief Name of the zone, null if tracing was disabled.
+      private: const char *name;
+
+      /// \brief Id of the sensor.
+      private: SensorId sensor;
+
+      /// \brief Start time of the zone.
+      private: int64_t start = 0;
+    };
+    }
+  }
+}
+
+#define IGN_SENSORS_TRACE_CONCAT2(a, b) a ## b
+#define IGN_SENSORS_TRACE_CONCAT(a, b) IGN_SENSORS_TRACE_CONCAT2(a, b)
+
+/// \brief Profile the rest of the scope with the ign-common profiler, and
+/// record it in the trace. The name must be a string literal.
+#define IGN_SENSORS_PROFILE(name) \
+  IGN_PROFILE(name); \
+  ignition::sensors::TraceZone \
+    IGN_SENSORS_TRACE_CONCAT(ignSensorsTraceZone, __LINE__)(name)
+
+/// \brief Profile the rest of the scope like IGN_SENSORS_PROFILE(), and
+/// tag it with a sensor.
+#define IGN_SENSORS_PROFILE_SENSOR(name, id) \
+  IGN_PROFILE(name); \
+  ignition::sensors::TraceZone \
+    IGN_SENSORS_TRACE_CONCAT(ignSensorsTraceZone, __LINE__)(name, id)
+
+/// \brief Name the calling thread in the profiler and in the trace.
+#define IGN_SENSORS_PROFILE_THREAD_NAME(name) \
+  IGN_PROFILE_THREAD_NAME(name); \
+  ignition::sensors::Tracing::SetThreadName(name)
+
+#endif
@@ -16,7 +16,6 @@
 */
 
 #include <ignition/msgs/fluid_pressure.pb.h>
-#include <ignition/common/Profiler.hh>
 #include <ignition/transport/Node.hh>
 
 #include "ignition/sensors/GaussianNoiseModel.hh"
@@ -24,6 +23,9 @@
 #include "ignition/sensors/SensorTypes.hh"
 #include "ignition/sensors/SensorFactory.hh"
 #include "ignition/sensors/AirPressureSensor.hh"
+#include "ignition/sensors/Tracing.hh"
+
+#include "StateStream.hh"
 
 using namespace ignition;
 using namespace sensors;
@@ -135,14 +137,14 @@ bool AirPressureSensor::Load(sdf::ElementPtr _sdf)
 //////////////////////////////////////////////////
 bool AirPressureSensor::Update(const ignition::common::Time &_now)
 {
-  IGN_PROFILE("AirPressureSensor::Update");
+  IGN_SENSORS_PROFILE_SENSOR("AirPressureSensor::Update", this->Id());
   if (!this->dataPtr->initialized)
   {
     ignerr << "Not initialized, update ignored.\n";
     return false;
   }
 
-  msgs::FluidPressure msg;
+  auto &msg = this->FrameMessage<msgs::FluidPressure>();
   msg.mutable_header()->mutable_stamp()->set_sec(_now.sec);
   msg.mutable_header()->mutable_stamp()->set_nsec(_now.nsec);
   auto frame = msg.mutable_header()->add_data();
@@ -191,11 +193,31 @@ bool AirPressureSensor::Update(const ignition::common::Time &_now)
 
   // publish
   this->AddSequence(msg.mutable_header());
-  this->dataPtr->pub.Publish(msg);
+  this->Publish(this->dataPtr->pub, msg);
 
   return true;
 }
 
+//////////////////////////////////////////////////
+bool AirPressureSensor::HasSubscribers() const
+{
+  return this->HasConnections(this->dataPtr->pub);
+}
+
+//////////////////////////////////////////////////
+bool AirPressureSensor::SaveState(std::ostream &_out) const
+{
+  return this->Sensor::SaveState(_out) &&
+      state::WriteNoises(_out, this->dataPtr->noises);
+}
+
+//////////////////////////////////////////////////
+bool AirPressureSensor::LoadState(std::istream &_in)
+{
+  return this->Sensor::LoadState(_in) &&
+      state::ReadNoises(_in, this->dataPtr->noises);
+}
+
 //////////////////////////////////////////////////
 void AirPressureSensor::SetReferenceAltitude(double _reference)
 {
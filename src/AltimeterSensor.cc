@@ -15,13 +15,15 @@
  *
 */
 
-#include <ignition/common/Profiler.hh>
 #include <ignition/transport/Node.hh>
 
 #include "ignition/sensors/Noise.hh"
 #include "ignition/sensors/SensorTypes.hh"
 #include "ignition/sensors/SensorFactory.hh"
 #include "ignition/sensors/AltimeterSensor.hh"
+#include "ignition/sensors/Tracing.hh"
+
+#include "StateStream.hh"
 
 using namespace ignition;
 using namespace sensors;
@@ -133,14 +135,14 @@ bool AltimeterSensor::Load(sdf::ElementPtr _sdf)
 //////////////////////////////////////////////////
 bool AltimeterSensor::Update(const ignition::common::Time &_now)
 {
-  IGN_PROFILE("AltimeterSensor::Update");
+  IGN_SENSORS_PROFILE_SENSOR("AltimeterSensor::Update", this->Id());
   if (!this->dataPtr->initialized)
   {
     ignerr << "Not initialized, update ignored.\n";
     return false;
   }
 
-  msgs::Altimeter msg;
+  auto &msg = this->FrameMessage<msgs::Altimeter>();
   msg.mutable_header()->mutable_stamp()->set_sec(_now.sec);
   msg.mutable_header()->mutable_stamp()->set_nsec(_now.nsec);
   auto frame = msg.mutable_header()->add_data();
@@ -173,11 +175,31 @@ bool AltimeterSensor::Update(const ignition::common::Time &_now)
 
   // publish
   this->AddSequence(msg.mutable_header());
-  this->dataPtr->pub.Publish(msg);
+  this->Publish(this->dataPtr->pub, msg);
 
   return true;
 }
 
+//////////////////////////////////////////////////
+bool AltimeterSensor::HasSubscribers() const
+{
+  return this->HasConnections(this->dataPtr->pub);
+}
+
+//////////////////////////////////////////////////
+bool AltimeterSensor::SaveState(std::ostream &_out) const
+{
+  return this->Sensor::SaveState(_out) &&
+      state::WriteNoises(_out, this->dataPtr->noises);
+}
+
+//////////////////////////////////////////////////
+bool AltimeterSensor::LoadState(std::istream &_in)
+{
+  return this->Sensor::LoadState(_in) &&
+      state::ReadNoises(_in, this->dataPtr->noises);
+}
+
 //////////////////////////////////////////////////
 void AltimeterSensor::SetVerticalReference(double _reference)
 {
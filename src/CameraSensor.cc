@@ -16,12 +16,14 @@
 */
 #include <ignition/msgs/camera_info.pb.h>
 
+#include <chrono>
 #include <mutex>
+#include <string>
+#include <vector>
 
 #include <ignition/common/Console.hh>
 #include <ignition/common/Event.hh>
 #include <ignition/common/Image.hh>
-#include <ignition/common/Profiler.hh>
 #include <ignition/common/StringUtils.hh>
 #include <ignition/math/Angle.hh>
 #include <ignition/transport/Node.hh>
@@ -29,12 +31,17 @@
 #include <ignition/math/Helpers.hh>
 
 #include "ignition/sensors/CameraSensor.hh"
+#include "ignition/sensors/ImageDelta.hh"
 #include "ignition/sensors/ImageGaussianNoiseModel.hh"
 #include "ignition/sensors/ImageNoise.hh"
 #include "ignition/sensors/Manager.hh"
 #include "ignition/sensors/RenderingEvents.hh"
+#include "ignition/sensors/ResolutionScaler.hh"
 #include "ignition/sensors/SensorFactory.hh"
 #include "ignition/sensors/SensorTypes.hh"
+#include "ignition/sensors/Tracing.hh"
+
+#include "MemoryUsage.hh"
 
 using namespace ignition;
 using namespace sensors;
@@ -69,8 +76,12 @@ class ignition::sensors::CameraSensorPrivate
   /// \brief Rendering camera
   public: ignition::rendering::CameraPtr camera;
 
-  /// \brief Pointer to an image to be published
-  public: ignition::rendering::Image image;
+  /// \brief Images to be published, one for each frame that may be in
+  /// the post-processing pipeline.
+  public: std::vector<ignition::rendering::Image> images;
+
+  /// \brief Slot of the last rendered image.
+  public: unsigned int imageSlot = 0u;
 
   /// \brief Noise added to sensor data
   public: std::map<SensorNoiseType, NoisePtr> noises;
@@ -104,11 +115,62 @@ class ignition::sensors::CameraSensorPrivate
   /// \brief Camera information message.
   public: msgs::CameraInfo infoMsg;
 
+  /// \brief Camera information of the full image size, as populated from
+  /// SDF.
+  public: msgs::CameraInfo infoUnscaled;
+
+  /// \brief Serialized camera information message without a time stamp.
+  public: std::string infoData;
+
+  /// \brief True if infoMsg changed since it was serialized.
+  public: bool infoDirty = true;
+
+  /// \brief True if the info changed since it was last published.
+  public: bool infoChanged = true;
+
+  /// \brief True to only publish camera info when it changes.
+  public: bool infoOnChange = false;
+
+  /// \brief Period at which unchanged camera info is published again.
+  public: common::Time infoHeartbeat;
+
+  /// \brief Time camera info was last published.
+  public: common::Time infoTime;
+
+  /// \brief True if the info topic had subscribers on the last frame.
+  public: bool infoConnected = false;
+
+  /// \brief Protects the camera info, which is published from the
+  /// pipeline thread.
+  public: std::mutex infoMutex;
+
   /// \brief Topic for info message.
   public: std::string infoTopic{""};
 
   /// \brief Baseline for stereo cameras.
   public: double baseline{0.0};
+
+  /// \brief Publisher of delta images, invalid when disabled.
+  public: transport::Node::Publisher deltaPub;
+
+  /// \brief Encodes the images published on the delta topic.
+  public: ImageDeltaEncoder deltaEncoder;
+
+  /// \brief Delta image message, reused between frames.
+  public: msgs::Image deltaMsg;
+
+  /// \brief Protects the delta image publisher and encoder, which are
+  /// used from the pipeline thread.
+  public: std::mutex deltaMutex;
+
+  /// \brief Chooses the resolution scale from render times.
+  public: ResolutionScaler scaler;
+
+  /// \brief Scale of the last image size returned by ScaledImageSize.
+  public: double appliedScale = 1.0;
+
+  /// \brief Protects the resolution scaler.
+  public: mutable std::mutex scaleMutex;
 };
 
 //////////////////////////////////////////////////
@@ -187,7 +249,7 @@ bool CameraSensor::CreateCamera()
       break;
   }
 
-  this->dataPtr->image = this->dataPtr->camera->CreateImage();
+  this->dataPtr->images.clear();
 
   this->Scene()->RootVisual()->AddChild(this->dataPtr->camera);
 
@@ -211,6 +273,7 @@ CameraSensor::CameraSensor()
 //////////////////////////////////////////////////
 CameraSensor::~CameraSensor()
 {
+  this->FlushPipeline();
 }
 
 //////////////////////////////////////////////////
@@ -302,7 +365,7 @@ void CameraSensor::SetScene(ignition::rendering::ScenePtr _scene)
 //////////////////////////////////////////////////
 bool CameraSensor::Update(const ignition::common::Time &_now)
 {
-  IGN_PROFILE("CameraSensor::Update");
+  IGN_SENSORS_PROFILE_SENSOR("CameraSensor::Update", this->Id());
   if (!this->dataPtr->initialized)
   {
     ignerr << "Not initialized, update ignored.\n";
@@ -320,78 +383,191 @@ bool CameraSensor::Update(const ignition::common::Time &_now)
   // move the camera to the current pose
   this->dataPtr->camera->SetLocalPose(this->Pose());
 
-  // generate sensor data
-  this->Render();
+  // Resize the camera to the current resolution scale
+  const sdf::Camera *cameraSdf = this->dataPtr->sdfSensor.CameraSensor();
+  unsigned int scaledWidth = cameraSdf->ImageWidth();
+  unsigned int scaledHeight = cameraSdf->ImageHeight();
+  const bool scaling = this->ScaledImageSize(scaledWidth, scaledHeight);
+  if (scaling && (scaledWidth != this->dataPtr->camera->ImageWidth() ||
+      scaledHeight != this->dataPtr->camera->ImageHeight()))
   {
-    IGN_PROFILE("CameraSensor::Update Copy image");
-    this->dataPtr->camera->Copy(this->dataPtr->image);
+    // Frames in the pipeline publish the camera info of their own size
+    this->FlushPipeline();
+    this->dataPtr->camera->SetImageWidth(scaledWidth);
+    this->dataPtr->camera->SetImageHeight(scaledHeight);
+    this->ScaleInfo(scaledWidth, scaledHeight);
+    this->InvalidateFrame();
   }
+  const double scale = this->ResolutionScale();
 
   unsigned int width = this->dataPtr->camera->ImageWidth();
   unsigned int height = this->dataPtr->camera->ImageHeight();
-  unsigned char *data = this->dataPtr->image.Data<unsigned char>();
-
-  ignition::common::Image::PixelFormatType
-      format{common::Image::UNKNOWN_PIXEL_FORMAT};
-  msgs::PixelFormatType msgsPixelFormat =
-    msgs::PixelFormatType::UNKNOWN_PIXEL_FORMAT;
+  rendering::PixelFormat renderFormat = this->dataPtr->camera->ImageFormat();
+  unsigned int memorySize = this->dataPtr->camera->ImageMemorySize();
 
-  switch (this->dataPtr->camera->ImageFormat())
+  // Reuse the last image if nothing changed since it was rendered
+  if (!this->FrameDirty())
   {
-    case ignition::rendering::PF_R8G8B8:
-      format = ignition::common::Image::RGB_INT8;
-      msgsPixelFormat = msgs::PixelFormatType::RGB_INT8;
-      break;
-    default:
-      ignerr << "Unsupported pixel format ["
-        << this->dataPtr->camera->ImageFormat() << "]\n";
-      break;
+    if (this->FrameReuse() == FrameReusePolicy::SKIP)
+      return true;
   }
-
-  // create message
-  ignition::msgs::Image msg;
+  else
   {
-    IGN_PROFILE("CameraSensor::Update Message");
-    msg.set_width(width);
-    msg.set_height(height);
-    msg.set_step(width * rendering::PixelUtil::BytesPerPixel(
-                 this->dataPtr->camera->ImageFormat()));
-    msg.set_pixel_format_type(msgsPixelFormat);
-    msg.mutable_header()->mutable_stamp()->set_sec(_now.sec);
-    msg.mutable_header()->mutable_stamp()->set_nsec(_now.nsec);
-    auto frame = msg.mutable_header()->add_data();
-    frame->set_key("frame_id");
-    frame->add_value(this->Name());
-    msg.set_data(data, this->dataPtr->camera->ImageMemorySize());
+    // Each frame waiting in the pipeline keeps its own image buffer.
+    unsigned int slot = this->NextPipelineSlot();
+    if (this->dataPtr->images.size() != this->PipelineDepth() + 1u)
+      this->dataPtr->images.resize(this->PipelineDepth() + 1u);
+    rendering::Image &newImage = this->dataPtr->images[slot];
+    if (newImage.Width() != width || newImage.Height() != height ||
+        newImage.Format() != renderFormat)
+    {
+      newImage = this->dataPtr->camera->CreateImage();
+    }
+
+    // generate sensor data
+    auto renderStart = std::chrono::steady_clock::now();
+    this->Render();
+    {
+      IGN_SENSORS_PROFILE("CameraSensor::Update Copy image");
+      this->dataPtr->camera->Copy(newImage);
+    }
+    this->dataPtr->imageSlot = slot;
+    if (scaling)
+    {
+      this->AddRenderTime(std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - renderStart).count());
+    }
   }
+  const rendering::Image &image =
+      this->dataPtr->images[this->dataPtr->imageSlot];
 
-  // publish the image message
+  // Convert and publish, possibly while the next frame renders. The image
+  // is captured by value, which shares its buffer with the slot.
+  this->PostProcess(_now, [this, _now, width, height, renderFormat,
+      memorySize, image, scaling, scale]() mutable
   {
-    this->AddSequence(msg.mutable_header());
-    IGN_PROFILE("CameraSensor::Update Publish");
-    this->dataPtr->pub.Publish(msg);
+    const unsigned char *data = image.Data<unsigned char>();
 
-    // publish the camera info message
-    this->PublishInfo(_now);
-  }
+    ignition::common::Image::PixelFormatType
+        format{common::Image::UNKNOWN_PIXEL_FORMAT};
+    msgs::PixelFormatType msgsPixelFormat =
+      msgs::PixelFormatType::UNKNOWN_PIXEL_FORMAT;
 
-  // Trigger callbacks.
-  try
-  {
-    this->dataPtr->imageEvent(msg);
-  }
-  catch(...)
+    switch (renderFormat)
+    {
+      case ignition::rendering::PF_R8G8B8:
+        format = ignition::common::Image::RGB_INT8;
+        msgsPixelFormat = msgs::PixelFormatType::RGB_INT8;
+        break;
+      default:
+        ignerr << "Unsupported pixel format ["
+          << renderFormat << "]\n";
+        break;
+    }
+
+    // create message
+    auto &msg = this->FrameMessage<msgs::Image>();
+    {
+      IGN_SENSORS_PROFILE("CameraSensor::Update Message");
+      msg.set_width(width);
+      msg.set_height(height);
+      msg.set_step(width * rendering::PixelUtil::BytesPerPixel(
+                   renderFormat));
+      msg.set_pixel_format_type(msgsPixelFormat);
+      msg.mutable_header()->mutable_stamp()->set_sec(_now.sec);
+      msg.mutable_header()->mutable_stamp()->set_nsec(_now.nsec);
+      auto frame = msg.mutable_header()->add_data();
+      frame->set_key("frame_id");
+      frame->add_value(this->Name());
+      if (scaling)
+      {
+        auto scaleData = msg.mutable_header()->add_data();
+        scaleData->set_key("resolution_scale");
+        scaleData->add_value(std::to_string(scale));
+      }
+      // Assign rather than set_data, which copies through a temporary
+      msg.mutable_data()->assign(reinterpret_cast<const char *>(data),
+          memorySize);
+    }
+
+    // publish the image message
+    {
+      this->AddSequence(msg.mutable_header());
+      IGN_SENSORS_PROFILE("CameraSensor::Update Publish");
+      this->Publish(this->dataPtr->pub, msg);
+
+      // publish the camera info message
+      this->PublishInfo(_now);
+    }
+
+    // publish the changed tiles
+    {
+      std::lock_guard<std::mutex> deltaLock(this->dataPtr->deltaMutex);
+      if (this->dataPtr->deltaPub &&
+          this->dataPtr->deltaPub.HasConnections())
+      {
+        IGN_SENSORS_PROFILE("CameraSensor::Update Publish delta");
+        this->dataPtr->deltaEncoder.Encode(msg, this->dataPtr->deltaMsg);
+        this->dataPtr->deltaPub.Publish(this->dataPtr->deltaMsg);
+      }
+      else
+      {
+        // The next subscriber starts with a keyframe
+        this->dataPtr->deltaEncoder.Reset();
+      }
+    }
+
+    // Trigger callbacks.
+    try
+    {
+      this->dataPtr->imageEvent(msg);
+    }
+    catch(...)
+    {
+      ignerr << "Exception thrown in an image callback.\n";
+    }
+
+    // Save image
+    if (this->dataPtr->saveImage)
+    {
+      this->dataPtr->SaveImage(data, width, height, format);
+    }
+  });
+
+  return true;
+}
+
+//////////////////////////////////////////////////
+bool CameraSensor::HasSubscribers() const
+{
+  return this->HasConnections(this->dataPtr->pub) ||
+      this->dataPtr->infoPub.HasConnections() ||
+      (this->dataPtr->deltaPub && this->dataPtr->deltaPub.HasConnections()) ||
+      this->dataPtr->imageEvent.ConnectionCount() > 0;
+}
+
+//////////////////////////////////////////////////
+SensorMemoryUsage CameraSensor::MemoryUsage() const
+{
+  SensorMemoryUsage usage = this->RenderingSensor::MemoryUsage();
+  for (const auto &image : this->dataPtr->images)
+    usage.buffers += image.MemorySize();
+  usage.buffers += memory::Bytes(this->dataPtr->images);
   {
-    ignerr << "Exception thrown in an image callback.\n";
+    std::lock_guard<std::mutex> lock(this->dataPtr->deltaMutex);
+    usage.buffers += this->dataPtr->deltaEncoder.MemoryUsage();
+    usage.messages += memory::Bytes(this->dataPtr->deltaMsg);
   }
-
-  // Save image
-  if (this->dataPtr->saveImage)
   {
-    this->dataPtr->SaveImage(data, width, height, format);
+    std::lock_guard<std::mutex> lock(this->dataPtr->infoMutex);
+    usage.messages += memory::Bytes(this->dataPtr->infoMsg) +
+        memory::Bytes(this->dataPtr->infoUnscaled) +
+        memory::Bytes(this->dataPtr->infoData);
   }
-
-  return true;
+  usage.config += memory::Bytes(this->dataPtr->saveImagePath) +
+      memory::Bytes(this->dataPtr->saveImagePrefix) +
+      memory::Bytes(this->dataPtr->infoTopic);
+  return usage;
 }
 
 //////////////////////////////////////////////////
@@ -440,6 +616,58 @@ rendering::CameraPtr CameraSensor::RenderingCamera() const
   return this->dataPtr->camera;
 }
 
+//////////////////////////////////////////////////
+bool CameraSensor::SetDeltaImagesEnabled(bool _enabled)
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->deltaMutex);
+  if (!_enabled)
+  {
+    this->dataPtr->deltaPub = transport::Node::Publisher();
+    return true;
+  }
+
+  if (this->dataPtr->deltaPub)
+    return true;
+
+  const std::string topic = this->DeltaTopic();
+  this->dataPtr->deltaPub =
+      this->dataPtr->node.Advertise<ignition::msgs::Image>(topic);
+  if (!this->dataPtr->deltaPub)
+  {
+    ignerr << "Unable to create publisher on topic[" << topic << "].\n";
+    return false;
+  }
+  this->dataPtr->deltaEncoder.Reset();
+  return true;
+}
+
+//////////////////////////////////////////////////
+bool CameraSensor::DeltaImagesEnabled() const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->deltaMutex);
+  return static_cast<bool>(this->dataPtr->deltaPub);
+}
+
+//////////////////////////////////////////////////
+std::string CameraSensor::DeltaTopic() const
+{
+  return this->Topic() + "/delta";
+}
+
+//////////////////////////////////////////////////
+void CameraSensor::SetDeltaTileSize(unsigned int _size)
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->deltaMutex);
+  this->dataPtr->deltaEncoder.SetTileSize(_size);
+}
+
+//////////////////////////////////////////////////
+void CameraSensor::SetDeltaKeyframeInterval(unsigned int _interval)
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->deltaMutex);
+  this->dataPtr->deltaEncoder.SetKeyframeInterval(_interval);
+}
+
 //////////////////////////////////////////////////
 std::string CameraSensor::InfoTopic() const
 {
@@ -493,10 +721,69 @@ bool CameraSensor::AdvertiseInfo(const std::string &_topic)
 //////////////////////////////////////////////////
 void CameraSensor::PublishInfo(const ignition::common::Time &_now)
 {
-  this->dataPtr->infoMsg.mutable_header()->mutable_stamp()->set_sec(_now.sec);
-  this->dataPtr->infoMsg.mutable_header()->mutable_stamp()->set_nsec(
-      _now.nsec);
-  this->dataPtr->infoPub.Publish(this->dataPtr->infoMsg);
+  IGN_SENSORS_PROFILE("CameraSensor::PublishInfo");
+  std::lock_guard<std::mutex> lock(this->dataPtr->infoMutex);
+  if (this->dataPtr->infoDirty)
+  {
+    this->dataPtr->infoMsg.mutable_header()->clear_stamp();
+    this->dataPtr->infoMsg.SerializeToString(&this->dataPtr->infoData);
+    this->dataPtr->infoDirty = false;
+    this->dataPtr->infoChanged = true;
+  }
+
+  if (this->dataPtr->infoOnChange)
+  {
+    const bool connected = this->dataPtr->infoPub.HasConnections();
+    const bool newConnection = connected && !this->dataPtr->infoConnected;
+    this->dataPtr->infoConnected = connected;
+
+    const common::Time &period = this->dataPtr->infoHeartbeat;
+    const bool heartbeat = period != common::Time::Zero &&
+        (_now < this->dataPtr->infoTime ||
+         _now - this->dataPtr->infoTime >= period);
+    if (!this->dataPtr->infoChanged && !newConnection && !heartbeat)
+      return;
+  }
+
+  // Serialized messages are merged when they are concatenated, so only the
+  // stamp needs to be serialized for each frame.
+  msgs::CameraInfo stampMsg;
+  stampMsg.mutable_header()->mutable_stamp()->set_sec(_now.sec);
+  stampMsg.mutable_header()->mutable_stamp()->set_nsec(_now.nsec);
+  std::string data = this->dataPtr->infoData;
+  stampMsg.AppendToString(&data);
+  this->dataPtr->infoPub.PublishRaw(data, this->dataPtr->infoMsg.GetTypeName());
+
+  this->dataPtr->infoTime = _now;
+  this->dataPtr->infoChanged = false;
+}
+
+//////////////////////////////////////////////////
+void CameraSensor::SetInfoOnChange(bool _onChange)
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->infoMutex);
+  this->dataPtr->infoOnChange = _onChange;
+}
+
+//////////////////////////////////////////////////
+bool CameraSensor::InfoOnChange() const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->infoMutex);
+  return this->dataPtr->infoOnChange;
+}
+
+//////////////////////////////////////////////////
+void CameraSensor::SetInfoHeartbeat(const common::Time &_period)
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->infoMutex);
+  this->dataPtr->infoHeartbeat = _period;
+}
+
+//////////////////////////////////////////////////
+common::Time CameraSensor::InfoHeartbeat() const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->infoMutex);
+  return this->dataPtr->infoHeartbeat;
 }
 
 //////////////////////////////////////////////////
@@ -505,6 +792,12 @@ void CameraSensor::PopulateInfo(const sdf::Camera *_cameraSdf)
   unsigned int width = _cameraSdf->ImageWidth();
   unsigned int height = _cameraSdf->ImageHeight();
 
+  std::lock_guard<std::mutex> lock(this->dataPtr->infoMutex);
+
+  // The camera may be recreated, start from an empty message
+  this->dataPtr->infoMsg.Clear();
+  this->dataPtr->infoDirty = true;
+
   msgs::CameraInfo::Distortion *distortion =
     this->dataPtr->infoMsg.mutable_distortion();
 
@@ -572,11 +865,14 @@ void CameraSensor::PopulateInfo(const sdf::Camera *_cameraSdf)
 
   this->dataPtr->infoMsg.set_width(width);
   this->dataPtr->infoMsg.set_height(height);
+
+  this->dataPtr->infoUnscaled = this->dataPtr->infoMsg;
 }
 
 //////////////////////////////////////////////////
 void CameraSensor::SetBaseline(double _baseline)
 {
+  std::lock_guard<std::mutex> lock(this->dataPtr->infoMutex);
   this->dataPtr->baseline = _baseline;
 
   // Also update message
@@ -584,14 +880,128 @@ void CameraSensor::SetBaseline(double _baseline)
       this->dataPtr->infoMsg.projection().p_size() == 12)
   {
     auto fx = this->dataPtr->infoMsg.projection().p(0);
-    this->dataPtr->infoMsg.mutable_projection()->set_p(3, -fx * _baseline);
+    if (this->dataPtr->infoMsg.projection().p(3) != -fx * _baseline)
+    {
+      this->dataPtr->infoMsg.mutable_projection()->set_p(3, -fx * _baseline);
+      this->dataPtr->infoDirty = true;
+    }
   }
 }
 
 //////////////////////////////////////////////////
 double CameraSensor::Baseline() const
 {
+  std::lock_guard<std::mutex> lock(this->dataPtr->infoMutex);
   return this->dataPtr->baseline;
 }
 
+//////////////////////////////////////////////////
+void CameraSensor::ScaleInfo(unsigned int _width, unsigned int _height)
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->infoMutex);
+  const msgs::CameraInfo &full = this->dataPtr->infoUnscaled;
+  msgs::CameraInfo &info = this->dataPtr->infoMsg;
+  if (full.width() == 0u || full.height() == 0u ||
+      full.intrinsics().k_size() != 9 || full.projection().p_size() != 12 ||
+      info.intrinsics().k_size() != 9 || info.projection().p_size() != 12)
+  {
+    return;
+  }
+
+  if (info.width() == _width && info.height() == _height)
+    return;
+
+  const double sx = static_cast<double>(_width) / full.width();
+  const double sy = static_cast<double>(_height) / full.height();
+  const double fx = full.intrinsics().k(0) * sx;
+
+  info.set_width(_width);
+  info.set_height(_height);
+
+  auto intrinsics = info.mutable_intrinsics();
+  intrinsics->set_k(0, fx);
+  intrinsics->set_k(2, full.intrinsics().k(2) * sx);
+  intrinsics->set_k(4, full.intrinsics().k(4) * sy);
+  intrinsics->set_k(5, full.intrinsics().k(5) * sy);
+
+  auto proj = info.mutable_projection();
+  proj->set_p(0, full.projection().p(0) * sx);
+  proj->set_p(2, full.projection().p(2) * sx);
+  proj->set_p(3, -proj->p(0) * this->dataPtr->baseline);
+  proj->set_p(5, full.projection().p(5) * sy);
+  proj->set_p(6, full.projection().p(6) * sy);
+
+  this->dataPtr->infoDirty = true;
+}
+
+//////////////////////////////////////////////////
+bool CameraSensor::SetResolutionScaleBounds(double _min, double _max)
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->scaleMutex);
+  return this->dataPtr->scaler.SetBounds(_min, _max);
+}
+
+//////////////////////////////////////////////////
+double CameraSensor::MinResolutionScale() const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->scaleMutex);
+  return this->dataPtr->scaler.MinScale();
+}
+
+//////////////////////////////////////////////////
+double CameraSensor::MaxResolutionScale() const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->scaleMutex);
+  return this->dataPtr->scaler.MaxScale();
+}
+
+//////////////////////////////////////////////////
+void CameraSensor::SetTargetRenderTime(const common::Time &_time)
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->scaleMutex);
+  this->dataPtr->scaler.SetTargetTime(_time.Double());
+}
+
+//////////////////////////////////////////////////
+common::Time CameraSensor::TargetRenderTime() const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->scaleMutex);
+  return common::Time(this->dataPtr->scaler.TargetTime());
+}
+
+//////////////////////////////////////////////////
+double CameraSensor::ResolutionScale() const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->scaleMutex);
+  return this->dataPtr->scaler.Scale();
+}
+
+//////////////////////////////////////////////////
+bool CameraSensor::ScaledImageSize(unsigned int &_width,
+    unsigned int &_height)
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->scaleMutex);
+  const ResolutionScaler &scaler = this->dataPtr->scaler;
+
+  // Keep resizing after scaling is disabled, until the size is restored
+  if (!scaler.Enabled() && math::equal(this->dataPtr->appliedScale, 1.0))
+    return false;
+
+  _width = scaler.Scaled(_width);
+  _height = scaler.Scaled(_height);
+  this->dataPtr->appliedScale = scaler.Scale();
+  return true;
+}
+
+//////////////////////////////////////////////////
+void CameraSensor::AddRenderTime(double _seconds)
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->scaleMutex);
+  if (this->dataPtr->scaler.AddSample(_seconds))
+  {
+    igndbg << "Resolution scale of [" << this->Name() << "] changed to ["
+           << this->dataPtr->scaler.Scale() << "].\n";
+  }
+}
+
 IGN_SENSORS_REGISTER_SENSOR(CameraSensor)
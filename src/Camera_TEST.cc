@@ -17,6 +17,13 @@
 #include <gtest/gtest.h>
 #include <sdf/sdf.hh>
 
+#include <atomic>
+#include <mutex>
+
+#include <ignition/common/Time.hh>
+#include <ignition/msgs/camera_info.pb.h>
+#include <ignition/transport/Node.hh>
+
 #include <ignition/sensors/Export.hh>
 #include <ignition/sensors/CameraSensor.hh>
 #include <ignition/sensors/Manager.hh>
@@ -157,6 +164,146 @@ TEST(Camera_TEST, CreateCamera)
   EXPECT_TRUE(badCam == nullptr);
 }
 
+/// \brief Camera that exposes camera info publishing.
+class InfoTestCamera : public ignition::sensors::CameraSensor
+{
+  public: using ignition::sensors::CameraSensor::PublishInfo;
+  public: using ignition::sensors::CameraSensor::PopulateInfo;
+  public: using ignition::sensors::CameraSensor::ScaleInfo;
+  public: using ignition::sensors::CameraSensor::ScaledImageSize;
+};
+
+/// \brief Number of camera info messages received.
+std::atomic<int> g_infoCount{0};
+
+/// \brief Stamp of the last camera info message.
+std::atomic<int> g_infoSec{0};
+
+/// \brief Last camera info message.
+ignition::msgs::CameraInfo g_infoMsg;
+
+/// \brief Protects the last camera info message.
+std::mutex g_infoMutex;
+
+/// \brief Camera info callback.
+/// \param[in] _msg Camera info message.
+void OnCameraInfo(const ignition::msgs::CameraInfo &_msg)
+{
+  {
+    std::lock_guard<std::mutex> lock(g_infoMutex);
+    g_infoMsg = _msg;
+  }
+  g_infoSec = _msg.header().stamp().sec();
+  ++g_infoCount;
+}
+
+/// \brief Wait for a number of camera info messages.
+/// \param[in] _count Number of messages.
+/// \return True if the messages arrived.
+bool WaitForInfo(int _count)
+{
+  for (int i = 0; i < 100 && g_infoCount < _count; ++i)
+    ignition::common::Time::Sleep(ignition::common::Time(0.01));
+  return g_infoCount == _count;
+}
+
+//////////////////////////////////////////////////
+TEST(Camera_TEST, InfoOnChange)
+{
+  sdf::ElementPtr camSdf = cameraToSdf("camera", "info_camera", 60.0,
+      "/info_test/image", true, true);
+
+  InfoTestCamera cam;
+  ASSERT_TRUE(cam.Load(camSdf));
+  EXPECT_FALSE(cam.InfoOnChange());
+  EXPECT_EQ(ignition::common::Time::Zero, cam.InfoHeartbeat());
+
+  ignition::transport::Node node;
+  ASSERT_TRUE(node.Subscribe(cam.InfoTopic(), &OnCameraInfo));
+
+  // Published with every frame by default
+  for (int i = 1; i <= 3; ++i)
+    cam.PublishInfo(ignition::common::Time(i, 0));
+  EXPECT_TRUE(WaitForInfo(3));
+  EXPECT_EQ(3, g_infoSec);
+
+  // Published once for the new subscriber, then only when it changes
+  cam.SetInfoOnChange(true);
+  EXPECT_TRUE(cam.InfoOnChange());
+  for (int i = 4; i <= 6; ++i)
+    cam.PublishInfo(ignition::common::Time(i, 0));
+  EXPECT_TRUE(WaitForInfo(4));
+  EXPECT_EQ(4, g_infoSec);
+
+  // Published again at the heartbeat period
+  cam.SetInfoHeartbeat(ignition::common::Time(2, 0));
+  EXPECT_EQ(ignition::common::Time(2, 0), cam.InfoHeartbeat());
+  for (int i = 7; i <= 10; ++i)
+    cam.PublishInfo(ignition::common::Time(i, 0));
+  EXPECT_TRUE(WaitForInfo(6));
+  EXPECT_EQ(9, g_infoSec);
+}
+
+//////////////////////////////////////////////////
+TEST(Camera_TEST, ResolutionScale)
+{
+  sdf::ElementPtr camSdf = cameraToSdf("camera", "scale_camera", 60.0,
+      "/scale_test/image", true, true);
+
+  InfoTestCamera cam;
+  ASSERT_TRUE(cam.Load(camSdf));
+
+  // Disabled by default
+  EXPECT_DOUBLE_EQ(1.0, cam.MinResolutionScale());
+  EXPECT_DOUBLE_EQ(1.0, cam.MaxResolutionScale());
+  EXPECT_DOUBLE_EQ(1.0, cam.ResolutionScale());
+  EXPECT_EQ(ignition::common::Time::Zero, cam.TargetRenderTime());
+  unsigned int width = 640u;
+  unsigned int height = 480u;
+  EXPECT_FALSE(cam.ScaledImageSize(width, height));
+  EXPECT_EQ(640u, width);
+  EXPECT_EQ(480u, height);
+
+  EXPECT_FALSE(cam.SetResolutionScaleBounds(0.0, 1.0));
+  EXPECT_FALSE(cam.SetResolutionScaleBounds(1.0, 0.5));
+  EXPECT_TRUE(cam.SetResolutionScaleBounds(0.25, 0.5));
+  EXPECT_DOUBLE_EQ(0.25, cam.MinResolutionScale());
+  EXPECT_DOUBLE_EQ(0.5, cam.MaxResolutionScale());
+  EXPECT_DOUBLE_EQ(0.5, cam.ResolutionScale());
+  cam.SetTargetRenderTime(ignition::common::Time(0, 10000000));
+  EXPECT_EQ(ignition::common::Time(0, 10000000), cam.TargetRenderTime());
+
+  EXPECT_TRUE(cam.ScaledImageSize(width, height));
+  EXPECT_EQ(320u, width);
+  EXPECT_EQ(240u, height);
+
+  // Intrinsics are scaled with the image
+  sdf::Sensor sdfSensor;
+  sdfSensor.Load(camSdf);
+  cam.PopulateInfo(sdfSensor.CameraSensor());
+  cam.ScaleInfo(width, height);
+
+  ignition::transport::Node node;
+  ASSERT_TRUE(node.Subscribe(cam.InfoTopic(), &OnCameraInfo));
+  const int count = g_infoCount + 1;
+  cam.PublishInfo(ignition::common::Time(1, 0));
+  for (int i = 0; i < 100 && g_infoCount < count; ++i)
+    ignition::common::Time::Sleep(ignition::common::Time(0.01));
+
+  std::lock_guard<std::mutex> lock(g_infoMutex);
+  ASSERT_EQ(count, g_infoCount);
+  EXPECT_EQ(320u, g_infoMsg.width());
+  EXPECT_EQ(240u, g_infoMsg.height());
+  ASSERT_EQ(9, g_infoMsg.intrinsics().k_size());
+  EXPECT_DOUBLE_EQ(140.0, g_infoMsg.intrinsics().k(0));
+  EXPECT_DOUBLE_EQ(81.0, g_infoMsg.intrinsics().k(2));
+  EXPECT_DOUBLE_EQ(140.5, g_infoMsg.intrinsics().k(4));
+  EXPECT_DOUBLE_EQ(62.0, g_infoMsg.intrinsics().k(5));
+  ASSERT_EQ(12, g_infoMsg.projection().p_size());
+  EXPECT_DOUBLE_EQ(140.0, g_infoMsg.projection().p(0));
+  EXPECT_DOUBLE_EQ(62.0, g_infoMsg.projection().p(6));
+}
+
 //////////////////////////////////////////////////
 int main(int argc, char **argv)
 {
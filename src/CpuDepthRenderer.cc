@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "ignition/sensors/Tracing.hh"
+
+#include "CpuDepthRenderer.hh"
+#include "MemoryUsage.hh"
+
+// undefine near and far macros from windows.h
+#ifdef _WIN32
+  #undef near
+  #undef far
+#endif
+
+namespace
+{
+  /// \brief Width and height of the pixel tiles. A tile fills one batch
+  /// of ray packets in RayScene.
+  const unsigned int kTileSize = 16u;
+
+  /// \brief Pack an RGBA color into a float the way rendering::DepthCamera
+  /// does.
+  /// \param[in] _rgba Color with red in the most significant byte.
+  /// \return Packed color.
+  float PackColor(uint32_t _rgba)
+  {
+    float packed;
+    std::memcpy(&packed, &_rgba, sizeof(packed));
+    return packed;
+  }
+}
+
+/// \brief Private data for CpuDepthRenderer
+class ignition::sensors::CpuDepthRendererPrivate
+{
+  /// \brief Compute ray directions in tile order.
+  public: void UpdateRays();
+
+  /// \brief Image width.
+  public: unsigned int width = 0u;
+
+  /// \brief Image height.
+  public: unsigned int height = 0u;
+
+  /// \brief Horizontal field of view.
+  public: double hfov = 0.0;
+
+  /// \brief Near clip distance.
+  public: double near = 0.0;
+
+  /// \brief Far clip distance.
+  public: double far = 0.0;
+
+  /// \brief Linear reuse tolerance.
+  public: double linearTolerance = 0.0;
+
+  /// \brief Angular reuse tolerance.
+  public: double angularTolerance = 0.0;
+
+  /// \brief Unit ray directions in tile order.
+  public: std::vector<math::Vector3d> directions;
+
+  /// \brief Pixel index of each ray.
+  public: std::vector<unsigned int> pixels;
+
+  /// \brief Ratio of depth to range for each ray.
+  public: std::vector<float> depthScale;
+
+  /// \brief Ray cast results.
+  public: std::vector<RayHit> hits;
+
+  /// \brief Depth image.
+  public: std::vector<float> depth;
+
+  /// \brief Point cloud.
+  public: std::vector<float> pointCloud;
+
+  /// \brief Focal length in pixels.
+  public: double focal = 0.0;
+
+  /// \brief True if the last frame is valid.
+  public: bool hasFrame = false;
+
+  /// \brief Pose of the last frame.
+  public: math::Pose3d lastPose;
+
+  /// \brief Scene revision of the last frame.
+  public: uint64_t lastRevision = 0u;
+
+  /// \brief Scene of the last frame.
+  public: const RayScene *lastScene = nullptr;
+};
+
+using namespace ignition;
+using namespace sensors;
+
+//////////////////////////////////////////////////
+void CpuDepthRendererPrivate::UpdateRays()
+{
+  const std::size_t count = static_cast<std::size_t>(this->width) *
+      this->height;
+  this->directions.clear();
+  this->directions.reserve(count);
+  this->pixels.clear();
+  this->pixels.reserve(count);
+  this->depthScale.clear();
+  this->depthScale.reserve(count);
+  this->depth.assign(count, 0.0f);
+  this->pointCloud.assign(count * 4u, 0.0f);
+  this->hasFrame = false;
+
+  // Same projection as PointCloudUtil::FillMsg
+  this->focal = this->width / (2.0 * std::tan(this->hfov / 2.0));
+  for (unsigned int ty = 0; ty < this->height; ty += kTileSize)
+  {
+    for (unsigned int tx = 0; tx < this->width; tx += kTileSize)
+    {
+      for (unsigned int j = ty; j < std::min(ty + kTileSize, this->height);
+          ++j)
+      {
+        for (unsigned int i = tx; i < std::min(tx + kTileSize, this->width);
+            ++i)
+        {
+          math::Vector3d dir(this->focal, 0.5 * (this->width - 1) - i,
+              0.5 * (this->height - 1) - j);
+          const double length = dir.Length();
+          this->directions.push_back(dir / length);
+          this->pixels.push_back(j * this->width + i);
+          this->depthScale.push_back(
+              static_cast<float>(this->focal / length));
+        }
+      }
+    }
+  }
+}
+
+//////////////////////////////////////////////////
+CpuDepthRenderer::CpuDepthRenderer()
+  : dataPtr(new CpuDepthRendererPrivate)
+{
+}
+
+//////////////////////////////////////////////////
+CpuDepthRenderer::~CpuDepthRenderer()
+{
+}
+
+//////////////////////////////////////////////////
+void CpuDepthRenderer::SetCamera(unsigned int _width, unsigned int _height,
+    double _hfov, double _near, double _far)
+{
+  this->dataPtr->width = _width;
+  this->dataPtr->height = _height;
+  this->dataPtr->hfov = _hfov;
+  this->dataPtr->near = _near;
+  this->dataPtr->far = _far;
+  this->dataPtr->UpdateRays();
+}
+
+//////////////////////////////////////////////////
+unsigned int CpuDepthRenderer::Width() const
+{
+  return this->dataPtr->width;
+}
+
+//////////////////////////////////////////////////
+unsigned int CpuDepthRenderer::Height() const
+{
+  return this->dataPtr->height;
+}
+
+//////////////////////////////////////////////////
+void CpuDepthRenderer::SetReuseTolerance(double _linear, double _angular)
+{
+  this->dataPtr->linearTolerance = _linear;
+  this->dataPtr->angularTolerance = _angular;
+}
+
+//////////////////////////////////////////////////
+bool CpuDepthRenderer::Render(RayScene &_scene, const math::Pose3d &_pose)
+{
+  IGN_SENSORS_PROFILE("CpuDepthRenderer::Render");
+
+  // Reuse the last frame if nothing visible changed
+  const uint64_t revision = _scene.Revision();
+  if (this->dataPtr->hasFrame && this->dataPtr->lastScene == &_scene &&
+      this->dataPtr->lastRevision == revision)
+  {
+    const double linear =
+        (_pose.Pos() - this->dataPtr->lastPose.Pos()).Length();
+    const math::Quaterniond delta =
+        this->dataPtr->lastPose.Rot().Inverse() * _pose.Rot();
+    const double angular =
+        2.0 * std::acos(std::min(1.0, std::fabs(delta.W())));
+    if (linear <= this->dataPtr->linearTolerance &&
+        angular <= this->dataPtr->angularTolerance)
+    {
+      return false;
+    }
+  }
+
+  // Rays reach the far clip plane at the edges of the image
+  float minScale = 1.0f;
+  for (float scale : this->dataPtr->depthScale)
+    minScale = std::min(minScale, scale);
+  _scene.CastRays(_pose, this->dataPtr->directions, 0.0,
+      this->dataPtr->far / minScale, this->dataPtr->hits);
+
+  const float near = static_cast<float>(this->dataPtr->near);
+  const float far = static_cast<float>(this->dataPtr->far);
+  const float inf = std::numeric_limits<float>::infinity();
+  const float white = PackColor(0xFFFFFFFFu);
+  const float black = PackColor(0x000000FFu);
+  const float focal = static_cast<float>(this->dataPtr->focal);
+  const float cx = 0.5f * (this->dataPtr->width - 1);
+  const float cy = 0.5f * (this->dataPtr->height - 1);
+  for (std::size_t r = 0; r < this->dataPtr->hits.size(); ++r)
+  {
+    const unsigned int pixel = this->dataPtr->pixels[r];
+    float d = this->dataPtr->hits[r].range * this->dataPtr->depthScale[r];
+    if (d > far)
+      d = inf;
+    else if (d < near)
+      d = -inf;
+    this->dataPtr->depth[pixel] = d;
+
+    float *point = &this->dataPtr->pointCloud[pixel * 4u];
+    if (std::isinf(d))
+    {
+      point[0] = point[1] = point[2] = d;
+      point[3] = black;
+    }
+    else
+    {
+      const unsigned int i = pixel % this->dataPtr->width;
+      const unsigned int j = pixel / this->dataPtr->width;
+      point[0] = d;
+      point[1] = d * (cx - i) / focal;
+      point[2] = d * (cy - j) / focal;
+      point[3] = white;
+    }
+  }
+
+  this->dataPtr->hasFrame = true;
+  this->dataPtr->lastScene = &_scene;
+  this->dataPtr->lastRevision = revision;
+  this->dataPtr->lastPose = _pose;
+  return true;
+}
+
+//////////////////////////////////////////////////
+const float *CpuDepthRenderer::Depth() const
+{
+  return this->dataPtr->depth.data();
+}
+
+//////////////////////////////////////////////////
+const float *CpuDepthRenderer::PointCloud() const
+{
+  return this->dataPtr->pointCloud.data();
+}
+
+//////////////////////////////////////////////////
+std::size_t CpuDepthRenderer::MemoryUsage() const
+{
+  return memory::Bytes(this->dataPtr->directions) +
+      memory::Bytes(this->dataPtr->pixels) +
+      memory::Bytes(this->dataPtr->depthScale) +
+      memory::Bytes(this->dataPtr->hits) +
+      memory::Bytes(this->dataPtr->depth) +
+      memory::Bytes(this->dataPtr->pointCloud);
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef IGNITION_SENSORS_CPUDEPTHRENDERER_HH_
+#define IGNITION_SENSORS_CPUDEPTHRENDERER_HH_
+
+#include <cstddef>
+#include <memory>
+
+#include <ignition/math/Pose3.hh>
+
+#include "ignition/sensors/config.hh"
+#include "ignition/sensors/Export.hh"
+#include "ignition/sensors/RayScene.hh"
+
+namespace ignition
+{
+  namespace sensors
+  {
+    // Inline bracket to help doxygen filtering.
+    inline namespace IGNITION_SENSORS_VERSION_NAMESPACE {
+    //
+    /// \brief forward declarations
+    class CpuDepthRendererPrivate;
+
+    /// \brief Helper class that renders depth images and point clouds by
+    /// casting rays into a RayScene. The DepthCameraSensor and
+    /// RgbdCameraSensor classes use this when they have a CPU scene.
+    ///
+    /// The output matches the format of rendering::DepthCamera. Depth is
+    /// the distance along the camera x axis, +inf beyond the far clip and
+    /// -inf before the near clip. The point cloud has four floats per
+    /// pixel: x, y and z in the camera frame, and an RGBA color packed into
+    /// a float. The scene has no materials, so hits are white and misses
+    /// are black.
+    ///
+    /// Rays are cast in 16x16 pixel tiles, each handled by one thread.
+    /// A frame is reused if the scene revision is unchanged and the camera
+    /// moved less than the reuse tolerance.
+    class IGNITION_SENSORS_VISIBLE CpuDepthRenderer
+    {
+      /// \brief Constructor
+      public: CpuDepthRenderer();
+
+      /// \brief Destructor
+      public: ~CpuDepthRenderer();
+
+      /// \brief Set the camera parameters.
+      /// \param[in] _width Image width in pixels.
+      /// \param[in] _height Image height in pixels.
+      /// \param[in] _hfov Horizontal field of view in radians.
+      /// \param[in] _near Near clip distance.
+      /// \param[in] _far Far clip distance.
+      public: void SetCamera(unsigned int _width, unsigned int _height,
+                  double _hfov, double _near, double _far);
+
+      /// \brief Get the image width.
+      /// \return Width in pixels.
+      public: unsigned int Width() const;
+
+      /// \brief Get the image height.
+      /// \return Height in pixels.
+      public: unsigned int Height() const;
+
+      /// \brief Set how far the camera may move before a frame of an
+      /// unchanged scene is rendered again. Defaults to zero, which only
+      /// reuses frames when the pose is identical.
+      /// \param[in] _linear Position tolerance in meters.
+      /// \param[in] _angular Orientation tolerance in radians.
+      public: void SetReuseTolerance(double _linear, double _angular);
+
+      /// \brief Render a frame.
+      /// \param[in] _scene Scene to cast rays into.
+      /// \param[in] _pose World pose of the camera.
+      /// \return True if a new frame was rendered, false if the previous
+      /// frame was reused.
+      public: bool Render(RayScene &_scene, const math::Pose3d &_pose);
+
+      /// \brief Get the depth image of the last frame.
+      /// \return Width * height depth values, row by row.
+      public: const float *Depth() const;
+
+      /// \brief Get the point cloud of the last frame.
+      /// \return Width * height * 4 values, row by row.
+      public: const float *PointCloud() const;
+
+      /// \brief Get the memory held by the rays and frame buffers.
+      /// \return Bytes held.
+      public: std::size_t MemoryUsage() const;
+
+      /// \internal
+      /// \brief Private data pointer.
+      private: std::unique_ptr<CpuDepthRendererPrivate> dataPtr;
+    };
+    }
+  }
+}
+#endif
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include <ignition/math/Helpers.hh>
+
+#include "CpuDepthRenderer.hh"
+#include "PointCloudUtil.hh"
+
+using namespace ignition;
+using namespace sensors;
+
+//////////////////////////////////////////////////
+TEST(CpuDepthRenderer_TEST, Wall)
+{
+  const unsigned int width = 40u;
+  const unsigned int height = 30u;
+  RayScene scene;
+  scene.AddBox(math::Vector3d(0.2, 20, 20), math::Pose3d(2.1, 0, 0, 0, 0, 0));
+
+  CpuDepthRenderer renderer;
+  renderer.SetCamera(width, height, 1.0, 0.1, 10.0);
+  EXPECT_EQ(width, renderer.Width());
+  EXPECT_EQ(height, renderer.Height());
+  EXPECT_TRUE(renderer.Render(scene, math::Pose3d::Zero));
+
+  // Depth is measured along the camera axis, so a wall facing the camera
+  // has the same depth everywhere.
+  const float *depth = renderer.Depth();
+  const float *points = renderer.PointCloud();
+  PointCloudUtil util;
+  double focal = width / (2.0 * std::tan(0.5));
+  for (unsigned int j = 0; j < height; ++j)
+  {
+    for (unsigned int i = 0; i < width; ++i)
+    {
+      unsigned int index = j * width + i;
+      EXPECT_NEAR(2.0, depth[index], 1e-4);
+      EXPECT_NEAR(2.0, points[index * 4], 1e-4);
+      EXPECT_NEAR(2.0 * (0.5 * (width - 1) - i) / focal,
+          points[index * 4 + 1], 1e-4);
+      EXPECT_NEAR(2.0 * (0.5 * (height - 1) - j) / focal,
+          points[index * 4 + 2], 1e-4);
+
+      uint8_t r, g, b, a;
+      util.DecodeRGBAFromFloat(points[index * 4 + 3], r, g, b, a);
+      EXPECT_EQ(255u, r);
+      EXPECT_EQ(255u, a);
+    }
+  }
+}
+
+//////////////////////////////////////////////////
+TEST(CpuDepthRenderer_TEST, Clip)
+{
+  const unsigned int width = 20u;
+  const unsigned int height = 10u;
+  RayScene scene;
+  RayObjectId box = scene.AddBox(math::Vector3d(0.2, 20, 20),
+      math::Pose3d(0.15, 0, 0, 0, 0, 0));
+
+  CpuDepthRenderer renderer;
+  renderer.SetCamera(width, height, 1.0, 0.5, 10.0);
+
+  // Closer than the near clip
+  renderer.Render(scene, math::Pose3d::Zero);
+  for (unsigned int i = 0; i < width * height; ++i)
+  {
+    EXPECT_TRUE(std::isinf(renderer.Depth()[i]));
+    EXPECT_LT(renderer.Depth()[i], 0.0f);
+  }
+
+  // Further than the far clip
+  scene.SetObjectPose(box, math::Pose3d(12, 0, 0, 0, 0, 0));
+  renderer.Render(scene, math::Pose3d::Zero);
+  for (unsigned int i = 0; i < width * height; ++i)
+  {
+    EXPECT_TRUE(std::isinf(renderer.Depth()[i]));
+    EXPECT_GT(renderer.Depth()[i], 0.0f);
+    EXPECT_TRUE(std::isinf(renderer.PointCloud()[i * 4]));
+  }
+}
+
+//////////////////////////////////////////////////
+TEST(CpuDepthRenderer_TEST, Reuse)
+{
+  RayScene scene;
+  RayObjectId sphere = scene.AddSphere(1.0, math::Pose3d(5, 0, 0, 0, 0, 0));
+
+  CpuDepthRenderer renderer;
+  renderer.SetCamera(32u, 24u, 1.2, 0.1, 20.0);
+  EXPECT_TRUE(renderer.Render(scene, math::Pose3d::Zero));
+
+  // Nothing changed
+  EXPECT_FALSE(renderer.Render(scene, math::Pose3d::Zero));
+
+  // The camera moved
+  math::Pose3d moved(0.01, 0, 0, 0, 0, 0.01);
+  EXPECT_TRUE(renderer.Render(scene, moved));
+
+  // Small moves are tolerated
+  renderer.SetReuseTolerance(0.05, 0.05);
+  EXPECT_FALSE(renderer.Render(scene, math::Pose3d::Zero));
+  EXPECT_TRUE(renderer.Render(scene, math::Pose3d(0.1, 0, 0, 0, 0, 0)));
+
+  // The scene changed
+  scene.SetObjectPose(sphere, math::Pose3d(6, 0, 0, 0, 0, 0));
+  EXPECT_TRUE(renderer.Render(scene, math::Pose3d(0.1, 0, 0, 0, 0, 0)));
+  float center = renderer.Depth()[12 * 32 + 16];
+  EXPECT_NEAR(4.9, center, 0.02);
+
+  // New camera parameters always render
+  renderer.SetCamera(16u, 12u, 1.2, 0.1, 20.0);
+  EXPECT_TRUE(renderer.Render(scene, math::Pose3d(0.1, 0, 0, 0, 0, 0)));
+}
+
+//////////////////////////////////////////////////
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
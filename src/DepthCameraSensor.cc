@@ -17,11 +17,13 @@
 
 #include <ignition/msgs/pointcloud_packed.pb.h>
 
+#include <chrono>
 #include <mutex>
+#include <string>
+#include <vector>
 
 #include <ignition/common/Console.hh>
 #include <ignition/common/Image.hh>
-#include <ignition/common/Profiler.hh>
 #include <ignition/common/SystemPaths.hh>
 
 #include <ignition/math/Angle.hh>
@@ -35,7 +37,10 @@
 #include "ignition/sensors/ImageGaussianNoiseModel.hh"
 #include "ignition/sensors/ImageNoise.hh"
 #include "ignition/sensors/RenderingEvents.hh"
+#include "ignition/sensors/Tracing.hh"
 
+#include "CpuDepthRenderer.hh"
+#include "MemoryUsage.hh"
 #include "PointCloudUtil.hh"
 
 // undefine near and far macros from windows.h
@@ -79,14 +84,28 @@ class ignition::sensors::DepthCameraSensorPrivate
     /// \brief Rendering camera
   public: ignition::rendering::DepthCameraPtr depthCamera;
 
-  /// \brief Depth data buffer.
-  public: float *depthBuffer = nullptr;
+  /// \brief Renders depth on the CPU when there is no rendering camera.
+  public: CpuDepthRenderer cpuRenderer;
 
-  /// \brief point cloud data buffer.
-  public: float *pointCloudBuffer = nullptr;
+  /// \brief Depth and point cloud data of a rendered frame.
+  public: struct FrameData
+  {
+    /// \brief Depth data buffer.
+    std::vector<float> depth;
+
+    /// \brief Point cloud data buffer.
+    std::vector<float> pointCloud;
+  };
+
+  /// \brief Frame data, one for each frame that may be in the
+  /// post-processing pipeline.
+  public: std::vector<FrameData> frames;
+
+  /// \brief Index of the frame that receives data from the depth camera.
+  public: unsigned int frameSlot = 0u;
 
   /// \brief xyz data buffer.
-  public: float *xyzBuffer = nullptr;
+  public: std::vector<float> xyzBuffer;
 
   /// \brief Near clip distance.
   public: float near = 0.0;
@@ -136,6 +155,22 @@ class ignition::sensors::DepthCameraSensorPrivate
   /// image and depth data.
   public: PointCloudUtil pointsUtil;
 
+  /// \brief Whether the point cloud is compacted into a dense cloud.
+  public: bool densePointCloud = false;
+
+  /// \brief Whether the dense point cloud has row and column fields.
+  public: bool densePointCloudIndex = false;
+
+  /// \brief The dense point cloud message, compacted from pointMsg.
+  public: msgs::PointCloudPacked denseMsg;
+
+  /// \brief Frame the point cloud is published in, empty for the sensor
+  /// frame.
+  public: std::string pointCloudFrame;
+
+  /// \brief Pose of the point cloud frame in the world.
+  public: math::Pose3d pointCloudFramePose;
+
   /// \brief publisher to publish point cloud
   public: transport::Node::Publisher pointPub;
 };
@@ -214,14 +249,10 @@ DepthCameraSensor::DepthCameraSensor()
 //////////////////////////////////////////////////
 DepthCameraSensor::~DepthCameraSensor()
 {
+  this->FlushPipeline();
+
   this->dataPtr->depthConnection.reset();
   this->dataPtr->pointCloudConnection.reset();
-  if (this->dataPtr->depthBuffer)
-    delete [] this->dataPtr->depthBuffer;
-  if (this->dataPtr->pointCloudBuffer)
-    delete [] this->dataPtr->pointCloudBuffer;
-  if (this->dataPtr->xyzBuffer)
-    delete [] this->dataPtr->xyzBuffer;
 }
 
 //////////////////////////////////////////////////
@@ -420,6 +451,54 @@ bool DepthCameraSensor::CreateCamera()
   return true;
 }
 
+//////////////////////////////////////////////////
+bool DepthCameraSensor::CreateCpuCamera()
+{
+  const sdf::Camera *cameraSdf = this->dataPtr->sdfSensor.CameraSensor();
+
+  if (!cameraSdf)
+  {
+    ignerr << "Unable to access camera SDF element\n";
+    return false;
+  }
+
+  math::Angle angle = cameraSdf->HorizontalFov();
+  if (angle < 0.01 || angle > IGN_PI*2)
+  {
+    ignerr << "Invalid horizontal field of view [" << angle << "]\n";
+    return false;
+  }
+
+  this->PopulateInfo(cameraSdf);
+
+  if (cameraSdf->ImageNoise().Type() != sdf::NoiseType::NONE)
+  {
+    ignwarn << "Image noise is not applied to depth images rendered on the "
+            << "CPU." << std::endl;
+  }
+
+  this->dataPtr->near = cameraSdf->NearClip();
+  this->dataPtr->cpuRenderer.SetCamera(cameraSdf->ImageWidth(),
+      cameraSdf->ImageHeight(), angle.Radian(), cameraSdf->NearClip(),
+      cameraSdf->FarClip());
+
+  // Create the directory to store frames
+  if (cameraSdf->SaveFrames())
+  {
+    this->dataPtr->saveImagePath = cameraSdf->SaveFramesPath();
+    this->dataPtr->saveImagePrefix = this->Name() + "_";
+    this->dataPtr->saveImage = true;
+  }
+
+  // Set the values of the point message based on the camera information.
+  this->dataPtr->pointMsg.set_width(this->ImageWidth());
+  this->dataPtr->pointMsg.set_height(this->ImageHeight());
+  this->dataPtr->pointMsg.set_row_step(
+      this->dataPtr->pointMsg.point_step() * this->ImageWidth());
+
+  return true;
+}
+
 /////////////////////////////////////////////////
 void DepthCameraSensor::OnNewDepthFrame(const float *_scan,
                     unsigned int _width, unsigned int _height,
@@ -434,10 +513,13 @@ void DepthCameraSensor::OnNewDepthFrame(const float *_scan,
   ignition::common::Image::PixelFormatType format =
     ignition::common::Image::ConvertPixelFormat(_format);
 
-  if (!this->dataPtr->depthBuffer)
-    this->dataPtr->depthBuffer = new float[depthSamples];
+  if (this->dataPtr->frames.empty())
+    this->dataPtr->frames.resize(1);
+  std::vector<float> &depthBuffer =
+      this->dataPtr->frames[this->dataPtr->frameSlot].depth;
+  depthBuffer.resize(depthSamples);
 
-  memcpy(this->dataPtr->depthBuffer, _scan, depthBufferSize);
+  memcpy(depthBuffer.data(), _scan, depthBufferSize);
 
   // Save image
   if (this->dataPtr->saveImage)
@@ -459,10 +541,13 @@ void DepthCameraSensor::OnNewRgbPointCloud(const float *_scan,
   unsigned int pointCloudBufferSize = pointCloudSamples * _channels *
       sizeof(float);
 
-  if (!this->dataPtr->pointCloudBuffer)
-    this->dataPtr->pointCloudBuffer = new float[pointCloudSamples * _channels];
+  if (this->dataPtr->frames.empty())
+    this->dataPtr->frames.resize(1);
+  std::vector<float> &pointCloudBuffer =
+      this->dataPtr->frames[this->dataPtr->frameSlot].pointCloud;
+  pointCloudBuffer.resize(pointCloudSamples * _channels);
 
-  memcpy(this->dataPtr->pointCloudBuffer, _scan, pointCloudBufferSize);
+  memcpy(pointCloudBuffer.data(), _scan, pointCloudBufferSize);
 }
 
 /////////////////////////////////////////////////
@@ -497,118 +582,308 @@ void DepthCameraSensor::SetScene(ignition::rendering::ScenePtr _scene)
 //////////////////////////////////////////////////
 bool DepthCameraSensor::Update(const ignition::common::Time &_now)
 {
-  IGN_PROFILE("DepthCameraSensor::Update");
+  IGN_SENSORS_PROFILE_SENSOR("DepthCameraSensor::Update", this->Id());
   if (!this->dataPtr->initialized)
   {
     ignerr << "Not initialized, update ignored.\n";
     return false;
   }
 
-  if (!this->dataPtr->depthCamera)
+  RayScenePtr cpuScene = this->CpuScene();
+  if (!this->dataPtr->depthCamera && !cpuScene)
   {
     ignerr << "Camera doesn't exist.\n";
     return false;
   }
 
-  // generate sensor data
-  this->Render();
-
-  unsigned int width = this->dataPtr->depthCamera->ImageWidth();
-  unsigned int height = this->dataPtr->depthCamera->ImageHeight();
-
-  auto msgsFormat = msgs::PixelFormatType::R_FLOAT32;
-
-  // create message
-  ignition::msgs::Image msg;
-  msg.set_width(width);
-  msg.set_height(height);
-  msg.set_step(width * rendering::PixelUtil::BytesPerPixel(
-               rendering::PF_FLOAT32_R));
-  msg.set_pixel_format_type(msgsFormat);
-  msg.mutable_header()->mutable_stamp()->set_sec(_now.sec);
-  msg.mutable_header()->mutable_stamp()->set_nsec(_now.nsec);
-  auto frame = msg.mutable_header()->add_data();
-  frame->set_key("frame_id");
-  frame->add_value(this->Name());
-
-  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
-  msg.set_data(this->dataPtr->depthBuffer,
-      rendering::PixelUtil::MemorySize(rendering::PF_FLOAT32_R,
-      width, height));
+  if (!this->dataPtr->depthCamera && this->dataPtr->cpuRenderer.Width() == 0u &&
+      !this->CreateCpuCamera())
+  {
+    return false;
+  }
 
-  // publish
-  this->AddSequence(msg.mutable_header(), "default");
-  this->dataPtr->pub.Publish(msg);
+  // Resize the camera to the current resolution scale
+  const sdf::Camera *cameraSdf = this->dataPtr->sdfSensor.CameraSensor();
+  unsigned int scaledWidth = cameraSdf->ImageWidth();
+  unsigned int scaledHeight = cameraSdf->ImageHeight();
+  const bool scaling = this->ScaledImageSize(scaledWidth, scaledHeight);
+  if (scaling && (scaledWidth != this->ImageWidth() ||
+      scaledHeight != this->ImageHeight()))
+  {
+    // Frames in the pipeline publish the camera info of their own size
+    this->FlushPipeline();
+    if (this->dataPtr->depthCamera)
+    {
+      this->dataPtr->depthCamera->SetImageWidth(scaledWidth);
+      this->dataPtr->depthCamera->SetImageHeight(scaledHeight);
+      this->dataPtr->depthCamera->CreateDepthTexture();
+    }
+    else
+    {
+      this->dataPtr->cpuRenderer.SetCamera(scaledWidth, scaledHeight,
+          cameraSdf->HorizontalFov().Radian(), cameraSdf->NearClip(),
+          cameraSdf->FarClip());
+    }
+    this->ScaleInfo(scaledWidth, scaledHeight);
+    this->InvalidateFrame();
+  }
+  const double scale = this->ResolutionScale();
 
-  // publish the camera info message
-  this->PublishInfo(_now);
+  unsigned int width = this->ImageWidth();
+  unsigned int height = this->ImageHeight();
 
-  // Trigger callbacks.
-  try
+  // Reuse the last frame if nothing changed since it was rendered
+  unsigned int slot;
+  if (!this->FrameDirty())
   {
-    this->dataPtr->imageEvent(msg);
+    if (this->FrameReuse() == FrameReusePolicy::SKIP)
+      return true;
+    std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+    slot = this->dataPtr->frameSlot;
   }
-  catch(...)
+  else
   {
-    ignerr << "Exception thrown in an image callback.\n";
+    // Each frame that may be in the pipeline receives data in its own slot.
+    slot = this->NextPipelineSlot();
+    {
+      std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+      if (this->dataPtr->frames.size() != this->PipelineDepth() + 1u)
+        this->dataPtr->frames.resize(this->PipelineDepth() + 1u);
+      this->dataPtr->frameSlot = slot;
+    }
+
+    // generate sensor data
+    auto renderStart = std::chrono::steady_clock::now();
+    if (this->dataPtr->depthCamera)
+    {
+      this->Render();
+    }
+    else
+    {
+      // Feed the CPU frame through the same callbacks as the rendering
+      // camera. A reused frame is copied again, since the slot may hold an
+      // older one.
+      this->dataPtr->cpuRenderer.Render(*cpuScene, this->Pose());
+      this->OnNewDepthFrame(this->dataPtr->cpuRenderer.Depth(), width,
+          height, 1, "FLOAT32");
+      this->OnNewRgbPointCloud(this->dataPtr->cpuRenderer.PointCloud(),
+          width, height, 4, "PF_FLOAT32_RGBA");
+    }
+    if (scaling)
+    {
+      this->AddRenderTime(std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - renderStart).count());
+    }
   }
 
-  if (this->dataPtr->pointPub.HasConnections() &&
-      this->dataPtr->pointCloudBuffer)
+  // Convert and publish, possibly while the next frame renders.
+  const math::Pose3d pose = this->Pose();
+  this->PostProcess(_now, [this, _now, width, height, slot, scaling,
+      scale, pose]()
   {
-    // Set the time stamp
-    this->dataPtr->pointMsg.mutable_header()->mutable_stamp()->set_sec(
-        _now.sec);
-    this->dataPtr->pointMsg.mutable_header()->mutable_stamp()->set_nsec(
-        _now.nsec);
-    this->dataPtr->pointMsg.set_is_dense(true);
-
-    if (!this->dataPtr->xyzBuffer)
-      this->dataPtr->xyzBuffer = new float[width*height*3];
-
-    if (this->dataPtr->image.Width() != width
-        || this->dataPtr->image.Height() != height)
+    const DepthCameraSensorPrivate::FrameData &frameData =
+        this->dataPtr->frames[slot];
+    if (frameData.depth.empty())
+      return;
+
+    auto msgsFormat = msgs::PixelFormatType::R_FLOAT32;
+
+    // create message
+    auto &msg = this->FrameMessage<msgs::Image>();
+    msg.set_width(width);
+    msg.set_height(height);
+    msg.set_step(width * rendering::PixelUtil::BytesPerPixel(
+                 rendering::PF_FLOAT32_R));
+    msg.set_pixel_format_type(msgsFormat);
+    msg.mutable_header()->mutable_stamp()->set_sec(_now.sec);
+    msg.mutable_header()->mutable_stamp()->set_nsec(_now.nsec);
+    auto frame = msg.mutable_header()->add_data();
+    frame->set_key("frame_id");
+    frame->add_value(this->Name());
+    if (scaling)
     {
-      this->dataPtr->image =
-          rendering::Image(width, height, rendering::PF_R8G8B8);
+      auto scaleData = msg.mutable_header()->add_data();
+      scaleData->set_key("resolution_scale");
+      scaleData->add_value(std::to_string(scale));
     }
 
-    // extract image data from point cloud data
-    this->dataPtr->pointsUtil.XYZFromPointCloud(
-        this->dataPtr->xyzBuffer,
-        this->dataPtr->pointCloudBuffer,
-        width, height);
+    msg.mutable_data()->assign(
+        reinterpret_cast<const char *>(frameData.depth.data()),
+        rendering::PixelUtil::MemorySize(rendering::PF_FLOAT32_R,
+        width, height));
 
-    // convert depth to grayscale rgb image
-    this->dataPtr->ConvertDepthToImage(this->dataPtr->depthBuffer,
-        this->dataPtr->image.Data<unsigned char>(), width, height);
+    // publish
+    this->AddSequence(msg.mutable_header(), "default");
+    this->Publish(this->dataPtr->pub, msg);
 
-    // fill the point cloud msg with data from xyz and rgb buffer
-    this->dataPtr->pointsUtil.FillMsg(this->dataPtr->pointMsg,
-        this->dataPtr->xyzBuffer,
-        this->dataPtr->image.Data<unsigned char>());
+    // publish the camera info message
+    this->PublishInfo(_now);
 
-    this->AddSequence(this->dataPtr->pointMsg.mutable_header(), "pointMsg");
-    this->dataPtr->pointPub.Publish(this->dataPtr->pointMsg);
-  }
+    // Trigger callbacks.
+    try
+    {
+      this->dataPtr->imageEvent(msg);
+    }
+    catch(...)
+    {
+      ignerr << "Exception thrown in an image callback.\n";
+    }
+
+    if (this->HasConnections(this->dataPtr->pointPub) &&
+        !frameData.pointCloud.empty())
+    {
+      // Set the time stamp
+      this->dataPtr->pointMsg.mutable_header()->mutable_stamp()->set_sec(
+          _now.sec);
+      this->dataPtr->pointMsg.mutable_header()->mutable_stamp()->set_nsec(
+          _now.nsec);
+      // Pixels without a depth are kept, so the cloud isn't dense
+      this->dataPtr->pointMsg.set_is_dense(false);
+
+      this->dataPtr->xyzBuffer.resize(width * height * 3);
+      if (this->dataPtr->pointMsg.width() != width ||
+          this->dataPtr->pointMsg.height() != height)
+      {
+        this->dataPtr->pointMsg.set_width(width);
+        this->dataPtr->pointMsg.set_height(height);
+        this->dataPtr->pointMsg.set_row_step(
+            this->dataPtr->pointMsg.point_step() * width);
+      }
+
+      if (this->dataPtr->image.Width() != width
+          || this->dataPtr->image.Height() != height)
+      {
+        this->dataPtr->image =
+            rendering::Image(width, height, rendering::PF_R8G8B8);
+      }
+
+      // extract image data from point cloud data
+      this->dataPtr->pointsUtil.XYZFromPointCloud(
+          this->dataPtr->xyzBuffer.data(),
+          frameData.pointCloud.data(),
+          width, height);
+
+      // convert depth to grayscale rgb image
+      this->dataPtr->ConvertDepthToImage(frameData.depth.data(),
+          this->dataPtr->image.Data<unsigned char>(), width, height);
+
+      // fill the point cloud msg with data from xyz and rgb buffer
+      this->dataPtr->pointsUtil.SetTargetFrame(this->dataPtr->pointMsg,
+          this->Name(), this->dataPtr->pointCloudFrame, pose,
+          this->dataPtr->pointCloudFramePose);
+      this->dataPtr->pointsUtil.FillMsg(this->dataPtr->pointMsg,
+          this->dataPtr->xyzBuffer.data(),
+          this->dataPtr->image.Data<unsigned char>());
+
+      this->AddSequence(this->dataPtr->pointMsg.mutable_header(), "pointMsg");
+      if (this->dataPtr->densePointCloud)
+      {
+        this->dataPtr->pointsUtil.Compact(this->dataPtr->pointMsg,
+            this->dataPtr->densePointCloudIndex, this->dataPtr->denseMsg);
+        this->Publish(this->dataPtr->pointPub, this->dataPtr->denseMsg);
+      }
+      else
+      {
+        this->Publish(this->dataPtr->pointPub, this->dataPtr->pointMsg);
+      }
+    }
+  });
   return true;
 }
 
+//////////////////////////////////////////////////
+bool DepthCameraSensor::HasSubscribers() const
+{
+  return this->HasConnections(this->dataPtr->pub) ||
+      this->HasConnections(this->dataPtr->pointPub) ||
+      this->dataPtr->imageEvent.ConnectionCount() > 0 ||
+      this->CameraSensor::HasSubscribers();
+}
+
+//////////////////////////////////////////////////
+SensorMemoryUsage DepthCameraSensor::MemoryUsage() const
+{
+  SensorMemoryUsage usage = this->CameraSensor::MemoryUsage();
+
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  usage.buffers += memory::Bytes(this->dataPtr->frames);
+  for (const auto &frame : this->dataPtr->frames)
+  {
+    usage.buffers += memory::Bytes(frame.depth) +
+        memory::Bytes(frame.pointCloud);
+  }
+  usage.buffers += memory::Bytes(this->dataPtr->xyzBuffer) +
+      this->dataPtr->image.MemorySize() +
+      this->dataPtr->cpuRenderer.MemoryUsage();
+  usage.messages += memory::Bytes(this->dataPtr->pointMsg) +
+      memory::Bytes(this->dataPtr->denseMsg);
+  usage.config += memory::Bytes(this->dataPtr->saveImagePath) +
+      memory::Bytes(this->dataPtr->saveImagePrefix);
+  return usage;
+}
+
+//////////////////////////////////////////////////
+void DepthCameraSensor::SetDensePointCloud(bool _dense)
+{
+  this->dataPtr->densePointCloud = _dense;
+}
+
+//////////////////////////////////////////////////
+bool DepthCameraSensor::DensePointCloud() const
+{
+  return this->dataPtr->densePointCloud;
+}
+
+//////////////////////////////////////////////////
+void DepthCameraSensor::SetDensePointCloudIndex(bool _index)
+{
+  this->dataPtr->densePointCloudIndex = _index;
+}
+
+//////////////////////////////////////////////////
+bool DepthCameraSensor::DensePointCloudIndex() const
+{
+  return this->dataPtr->densePointCloudIndex;
+}
+
+//////////////////////////////////////////////////
+void DepthCameraSensor::SetPointCloudFrame(const std::string &_frameId,
+    const math::Pose3d &_targetPoseInWorld)
+{
+  this->dataPtr->pointCloudFrame = _frameId;
+  this->dataPtr->pointCloudFramePose = _targetPoseInWorld;
+}
+
+//////////////////////////////////////////////////
+std::string DepthCameraSensor::PointCloudFrame() const
+{
+  return this->dataPtr->pointCloudFrame;
+}
+
 //////////////////////////////////////////////////
 unsigned int DepthCameraSensor::ImageWidth() const
 {
+  if (!this->dataPtr->depthCamera)
+    return this->dataPtr->cpuRenderer.Width();
   return this->dataPtr->depthCamera->ImageWidth();
 }
 
 //////////////////////////////////////////////////
 unsigned int DepthCameraSensor::ImageHeight() const
 {
+  if (!this->dataPtr->depthCamera)
+    return this->dataPtr->cpuRenderer.Height();
   return this->dataPtr->depthCamera->ImageHeight();
 }
 
 //////////////////////////////////////////////////
 double DepthCameraSensor::FarClip() const
 {
+  if (!this->dataPtr->depthCamera)
+  {
+    const sdf::Camera *cameraSdf = this->dataPtr->sdfSensor.CameraSensor();
+    return cameraSdf ? cameraSdf->FarClip() : 0.0;
+  }
   return this->dataPtr->depthCamera->FarClipPlane();
 }
 
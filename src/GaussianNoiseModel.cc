@@ -21,11 +21,19 @@
 #endif
 
 #include "ignition/sensors/GaussianNoiseModel.hh"
+
+#include <limits>
+#include <random>
+#include <sstream>
+#include <vector>
+
 #include <ignition/math/Helpers.hh>
 #include <ignition/math/Rand.hh>
 
 #include "ignition/common/Console.hh"
 
+#include "StateStream.hh"
+
 using namespace ignition;
 using namespace sensors;
 
@@ -56,6 +64,21 @@ class ignition::sensors::GaussianNoiseModelPrivate
 
   /// \brief True if the type is GAUSSIAN_QUANTIZED
   public: bool quantized = false;
+
+  /// \brief Random number stream of the model.
+  public: std::mt19937 engine;
+
+  /// \brief Draw from a normal distribution.
+  /// \param[in] _mean Mean of the distribution.
+  /// \param[in] _stdDev Standard deviation of the distribution.
+  /// \return Sample.
+  public: double Normal(double _mean, double _stdDev)
+  {
+    // The distribution requires a positive standard deviation
+    if (_stdDev <= 0.0)
+      return _mean;
+    return std::normal_distribution<double>(_mean, _stdDev)(this->engine);
+  }
 };
 
 //////////////////////////////////////////////////
@@ -82,17 +105,22 @@ void GaussianNoiseModel::Load(const sdf::Noise &_sdf)
   this->dataPtr->dynamicBiasStdDev = _sdf.DynamicBiasStdDev();
   this->dataPtr->dynamicBiasCorrTime = _sdf.DynamicBiasCorrelationTime();
 
+  // Seeding from the global generator keeps math::Rand::Seed() reproducible
+  this->dataPtr->engine.seed(static_cast<std::mt19937::result_type>(
+      ignition::math::Rand::IntUniform(0, std::numeric_limits<int>::max())));
+
   // Sample the bias
   double biasMean = 0;
   double biasStdDev = 0;
   biasMean = _sdf.BiasMean();
   biasStdDev = _sdf.BiasStdDev();
-  this->dataPtr->bias = ignition::math::Rand::DblNormal(biasMean, biasStdDev);
+  this->dataPtr->bias = this->dataPtr->Normal(biasMean, biasStdDev);
 
   // With equal probability, we pick a negative bias (by convention,
   // rateBiasMean should be positive, though it would work fine if
   // negative).
-  if (ignition::math::Rand::DblUniform() < 0.5)
+  if (std::uniform_real_distribution<double>(0.0, 1.0)(
+      this->dataPtr->engine) < 0.5)
     this->dataPtr->bias = -this->dataPtr->bias;
 
   this->Print(out);
@@ -108,7 +136,7 @@ void GaussianNoiseModel::Load(const sdf::Noise &_sdf)
 double GaussianNoiseModel::ApplyImpl(double _in, double _dt)
 {
   // Generate independent (uncorrelated) Gaussian noise to each input value.
-  double whiteNoise = ignition::math::Rand::DblNormal(
+  double whiteNoise = this->dataPtr->Normal(
       this->dataPtr->mean, this->dataPtr->stdDev);
 
   // Generate varying (correlated) bias to each input value.
@@ -132,7 +160,7 @@ double GaussianNoiseModel::ApplyImpl(double _in, double _dt)
         tau / 2 * expm1(-2 * _dt / tau));
     double phi_d = exp(-_dt / tau);
     this->dataPtr->bias = phi_d * this->dataPtr->bias +
-      ignition::math::Rand::DblNormal(0, sigma_b_d);
+      this->dataPtr->Normal(0, sigma_b_d);
   }
 
   double output = _in + this->dataPtr->bias + whiteNoise;
@@ -176,3 +204,55 @@ void GaussianNoiseModel::Print(std::ostream &_out) const
     << "precision[" << this->dataPtr->precision << "] "
     << "quantized[" << this->dataPtr->quantized << "]";
 }
+
+//////////////////////////////////////////////////
+bool GaussianNoiseModel::SaveState(std::ostream &_out) const
+{
+  state::Write(_out, this->dataPtr->bias);
+
+  // The textual form of the engine is its sequence of state words, which
+  // are stored as binary integers
+  std::ostringstream engineStream;
+  engineStream << this->dataPtr->engine;
+  std::istringstream words(engineStream.str());
+  std::vector<uint32_t> values;
+  uint64_t word = 0u;
+  while (words >> word)
+    values.push_back(static_cast<uint32_t>(word));
+
+  state::Write(_out, static_cast<uint32_t>(values.size()));
+  for (uint32_t value : values)
+    state::Write(_out, value);
+  return static_cast<bool>(_out);
+}
+
+//////////////////////////////////////////////////
+bool GaussianNoiseModel::LoadState(std::istream &_in)
+{
+  double bias = 0.0;
+  uint32_t count = 0u;
+  if (!state::Read(_in, bias) || !state::Read(_in, count) ||
+      count > std::mt19937::state_size + 1u)
+  {
+    return false;
+  }
+
+  std::ostringstream engineStream;
+  for (uint32_t i = 0u; i < count; ++i)
+  {
+    uint32_t value = 0u;
+    if (!state::Read(_in, value))
+      return false;
+    engineStream << value << ' ';
+  }
+
+  std::istringstream words(engineStream.str());
+  std::mt19937 engine;
+  words >> engine;
+  if (words.fail())
+    return false;
+
+  this->dataPtr->bias = bias;
+  this->dataPtr->engine = engine;
+  return true;
+}
@@ -18,10 +18,17 @@
 #include <ignition/msgs/Utility.hh>
 #include <ignition/transport/Node.hh>
 
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
 #include <ignition/common/Console.hh>
-#include <ignition/common/Profiler.hh>
 #include "ignition/sensors/GpuLidarSensor.hh"
 #include "ignition/sensors/SensorFactory.hh"
+#include "ignition/sensors/Tracing.hh"
+
+#include "MemoryUsage.hh"
+#include "PointCloudUtil.hh"
 
 using namespace ignition::sensors;
 
@@ -29,22 +36,57 @@ using namespace ignition::sensors;
 class ignition::sensors::GpuLidarSensorPrivate
 {
   /// \brief Fill the point cloud packed message
-  public: void FillPointCloudMsg();
+  /// \param[in] _laserBuffer Range, intensity and retro data of the scan,
+  /// three channels per ray.
+  public: void FillPointCloudMsg(const float *_laserBuffer);
 
   /// \brief Rendering camera
   public: ignition::rendering::GpuRaysPtr gpuRays;
 
+  /// \brief Whether a frame callback was connected.
+  public: bool frameCallbacks = false;
+
   /// \brief Connection to the Manager's scene change event.
   public: ignition::common::ConnectionPtr sceneChangeConnection;
 
   /// \brief The point cloud message.
   public: msgs::PointCloudPacked pointMsg;
 
+  /// \brief Helper class that compacts the point cloud.
+  public: PointCloudUtil pointsUtil;
+
+  /// \brief Whether the point cloud is compacted into a dense cloud.
+  public: bool densePointCloud = false;
+
+  /// \brief Whether the dense point cloud has row and column fields.
+  public: bool densePointCloudIndex = false;
+
+  /// \brief The dense point cloud message, compacted from pointMsg.
+  public: msgs::PointCloudPacked denseMsg;
+
+  /// \brief Frame the point cloud is published in, empty for the sensor
+  /// frame.
+  public: std::string pointCloudFrame;
+
+  /// \brief Pose of the point cloud frame in the world.
+  public: math::Pose3d pointCloudFramePose;
+
   /// \brief Transport node.
   public: transport::Node node;
 
   /// \brief Publisher for the publish point cloud message.
   public: transport::Node::Publisher pointPub;
+
+  /// \brief Scan buffers, one for each frame that may be in the
+  /// post-processing pipeline.
+  public: std::vector<std::vector<float>> scans;
+
+  /// \brief Slot of the last rendered scan.
+  public: unsigned int scanSlot = 0u;
+
+  /// \brief Rendered rays, when the scan has more ranges than rays and
+  /// the ranges are interpolated from the rays.
+  public: std::vector<float> rays;
 };
 
 //////////////////////////////////////////////////
@@ -56,6 +98,8 @@ GpuLidarSensor::GpuLidarSensor()
 //////////////////////////////////////////////////
 GpuLidarSensor::~GpuLidarSensor()
 {
+  this->FlushPipeline();
+
   this->RemoveGpuRays(this->Scene());
 
   this->dataPtr->sceneChangeConnection.reset();
@@ -74,6 +118,8 @@ void GpuLidarSensor::SetScene(ignition::rendering::ScenePtr _scene)
   // APIs make it possible for the scene pointer to change
   if (this->Scene() != _scene)
   {
+    // Queued frames read the rays' properties.
+    this->FlushPipeline();
     this->RemoveGpuRays(this->Scene());
     RenderingSensor::SetScene(_scene);
 
@@ -188,10 +234,10 @@ bool GpuLidarSensor::CreateLidar()
   this->Scene()->RootVisual()->AddChild(
       this->dataPtr->gpuRays);
 
-  // Set the values on the point message.
-  this->dataPtr->pointMsg.set_width(this->dataPtr->gpuRays->RangeCount());
-  this->dataPtr->pointMsg.set_height(
-      this->dataPtr->gpuRays->VerticalRangeCount());
+  // Set the values on the point message. It holds a point per range, like
+  // laserBuffer.
+  this->dataPtr->pointMsg.set_width(this->RangeCount());
+  this->dataPtr->pointMsg.set_height(this->VerticalRangeCount());
   this->dataPtr->pointMsg.set_row_step(
       this->dataPtr->pointMsg.point_step() *
       this->dataPtr->pointMsg.width());
@@ -204,7 +250,7 @@ bool GpuLidarSensor::CreateLidar()
 //////////////////////////////////////////////////
 bool GpuLidarSensor::Update(const ignition::common::Time &_now)
 {
-  IGN_PROFILE("GpuLidarSensor::Update");
+  IGN_SENSORS_PROFILE_SENSOR("GpuLidarSensor::Update", this->Id());
   if (!this->initialized)
   {
     ignerr << "Not initialized, update ignored.\n";
@@ -217,48 +263,196 @@ bool GpuLidarSensor::Update(const ignition::common::Time &_now)
     return false;
   }
 
-  int len = this->dataPtr->gpuRays->RayCount() *
-    this->dataPtr->gpuRays->VerticalRayCount() * 3;
+  const unsigned int rayCount = this->dataPtr->gpuRays->RayCount();
+  const unsigned int verticalRayCount =
+      this->dataPtr->gpuRays->VerticalRayCount();
+  const int len = rayCount * verticalRayCount * 3;
+
+  // With a resolution above one, fewer rays are rendered than there are
+  // ranges, and the ranges are interpolated on the CPU
+  const unsigned int width = this->RangeCount();
+  const unsigned int height = this->VerticalRangeCount();
+  const bool upsample = width != rayCount || height != verticalRayCount;
 
   if (this->laserBuffer == nullptr)
   {
-    this->laserBuffer = new float[len];
+    this->laserBuffer = new float[width * height * 3];
   }
 
-  this->Render();
-
-  /// \todo(anyone) It would be nice to remove this copy.
-  this->dataPtr->gpuRays->Copy(this->laserBuffer);
-
-  this->PublishLidarScan(_now);
+  // Without pipelining the scan is copied straight into the laser buffer,
+  // or into the rays buffer when upsampling. Otherwise each frame that may
+  // be in the pipeline has its own buffer. A reused scan is still in the
+  // buffer it was copied to.
+  const float *scan = upsample ? this->dataPtr->rays.data() :
+      this->laserBuffer;
+  if (!this->FrameDirty())
+  {
+    if (this->FrameReuse() == FrameReusePolicy::SKIP)
+      return true;
+    if (this->PipelineDepth() > 0u)
+      scan = this->dataPtr->scans[this->dataPtr->scanSlot].data();
+  }
+  else if (this->PipelineDepth() == 0u)
+  {
+    this->Render();
 
-  if (this->dataPtr->pointPub.HasConnections())
+    /// \todo(anyone) It would be nice to remove this copy.
+    if (upsample)
+    {
+      this->dataPtr->rays.resize(len);
+      this->dataPtr->gpuRays->Copy(this->dataPtr->rays.data());
+      scan = this->dataPtr->rays.data();
+    }
+    else
+    {
+      this->dataPtr->gpuRays->Copy(this->laserBuffer);
+    }
+  }
+  else
   {
-    // Set the time stamp
-    this->dataPtr->pointMsg.mutable_header()->mutable_stamp()->set_sec(
-        _now.sec);
-    this->dataPtr->pointMsg.mutable_header()->mutable_stamp()->set_nsec(
-        _now.nsec);
+    this->Render();
+
+    unsigned int slot = this->NextPipelineSlot();
+    if (this->dataPtr->scans.size() != this->PipelineDepth() + 1u)
+      this->dataPtr->scans.resize(this->PipelineDepth() + 1u);
+    this->dataPtr->scans[slot].resize(len);
+    this->dataPtr->gpuRays->Copy(this->dataPtr->scans[slot].data());
+    scan = this->dataPtr->scans[slot].data();
+    this->dataPtr->scanSlot = slot;
+  }
 
-    this->dataPtr->pointMsg.set_is_dense(true);
+  // Publish, possibly while the next frame renders.
+  const ignition::math::Pose3d pose = this->Pose();
+  this->PostProcess(_now, [this, _now, scan, len, rayCount, verticalRayCount,
+      width, height, upsample, pose]()
+  {
+    if (upsample)
+    {
+      std::lock_guard<std::mutex> lock(this->lidarMutex);
+      this->UpsampleScan(scan, rayCount, verticalRayCount,
+          this->laserBuffer, width, height);
+    }
+    else if (scan != this->laserBuffer)
+    {
+      std::lock_guard<std::mutex> lock(this->lidarMutex);
+      std::copy(scan, scan + len, this->laserBuffer);
+    }
 
-    this->dataPtr->FillPointCloudMsg();
+    this->NotifyScan(_now, this->laserBuffer, width, height);
+    this->PublishLidarScan(_now);
 
+    if (this->HasConnections(this->dataPtr->pointPub))
     {
-      this->AddSequence(this->dataPtr->pointMsg.mutable_header());
-      IGN_PROFILE("GpuLidarSensor::Update Publish point cloud");
-      this->dataPtr->pointPub.Publish(this->dataPtr->pointMsg);
+      // Set the time stamp
+      this->dataPtr->pointMsg.mutable_header()->mutable_stamp()->set_sec(
+          _now.sec);
+      this->dataPtr->pointMsg.mutable_header()->mutable_stamp()->set_nsec(
+          _now.nsec);
+
+      // Rays without a return are kept, so the cloud isn't dense
+      this->dataPtr->pointMsg.set_is_dense(false);
+
+      this->dataPtr->pointsUtil.SetTargetFrame(this->dataPtr->pointMsg,
+          this->Name(), this->dataPtr->pointCloudFrame, pose,
+          this->dataPtr->pointCloudFramePose);
+      this->dataPtr->FillPointCloudMsg(this->laserBuffer);
+
+      {
+        this->AddSequence(this->dataPtr->pointMsg.mutable_header());
+        IGN_SENSORS_PROFILE("GpuLidarSensor::Update Publish point cloud");
+        if (this->dataPtr->densePointCloud)
+        {
+          this->dataPtr->pointsUtil.Compact(this->dataPtr->pointMsg,
+              this->dataPtr->densePointCloudIndex, this->dataPtr->denseMsg);
+          this->Publish(this->dataPtr->pointPub, this->dataPtr->denseMsg);
+        }
+        else
+        {
+          this->Publish(this->dataPtr->pointPub, this->dataPtr->pointMsg);
+        }
+      }
     }
-  }
+  });
   return true;
 }
 
+//////////////////////////////////////////////////
+bool GpuLidarSensor::HasSubscribers() const
+{
+  // Frame callbacks are connected to the rendering rays directly, so they
+  // can't be counted once connected
+  return this->dataPtr->frameCallbacks ||
+      this->HasConnections(this->dataPtr->pointPub) ||
+      this->Lidar::HasSubscribers();
+}
+
+/////////////////////////////////////////////////
+bool GpuLidarSensor::SupportsPackets() const
+{
+  return false;
+}
+
+/////////////////////////////////////////////////
+SensorMemoryUsage GpuLidarSensor::MemoryUsage() const
+{
+  SensorMemoryUsage usage = this->Lidar::MemoryUsage();
+  usage.buffers += memory::Bytes(this->dataPtr->scans) +
+      memory::Bytes(this->dataPtr->rays);
+  if (this->laserBuffer && this->dataPtr->gpuRays)
+  {
+    usage.buffers += this->RangeCount() * this->VerticalRangeCount() * 3u *
+        sizeof(float);
+  }
+  usage.messages += memory::Bytes(this->dataPtr->pointMsg) +
+      memory::Bytes(this->dataPtr->denseMsg);
+  return usage;
+}
+
+//////////////////////////////////////////////////
+void GpuLidarSensor::SetDensePointCloud(bool _dense)
+{
+  this->dataPtr->densePointCloud = _dense;
+}
+
+//////////////////////////////////////////////////
+bool GpuLidarSensor::DensePointCloud() const
+{
+  return this->dataPtr->densePointCloud;
+}
+
+//////////////////////////////////////////////////
+void GpuLidarSensor::SetDensePointCloudIndex(bool _index)
+{
+  this->dataPtr->densePointCloudIndex = _index;
+}
+
+//////////////////////////////////////////////////
+bool GpuLidarSensor::DensePointCloudIndex() const
+{
+  return this->dataPtr->densePointCloudIndex;
+}
+
+//////////////////////////////////////////////////
+void GpuLidarSensor::SetPointCloudFrame(const std::string &_frameId,
+    const math::Pose3d &_targetPoseInWorld)
+{
+  this->dataPtr->pointCloudFrame = _frameId;
+  this->dataPtr->pointCloudFramePose = _targetPoseInWorld;
+}
+
+//////////////////////////////////////////////////
+std::string GpuLidarSensor::PointCloudFrame() const
+{
+  return this->dataPtr->pointCloudFrame;
+}
+
 /////////////////////////////////////////////////
 ignition::common::ConnectionPtr GpuLidarSensor::ConnectNewLidarFrame(
           std::function<void(const float *_scan, unsigned int _width,
                   unsigned int _height, unsigned int _channels,
                   const std::string &/*_format*/)> _subscriber)
 {
+  this->dataPtr->frameCallbacks = true;
   return this->dataPtr->gpuRays->ConnectNewGpuRaysFrame(_subscriber);
 }
 
@@ -287,20 +481,19 @@ ignition::math::Angle GpuLidarSensor::VFOV() const
 }
 
 //////////////////////////////////////////////////
-void GpuLidarSensorPrivate::FillPointCloudMsg()
+void GpuLidarSensorPrivate::FillPointCloudMsg(const float *_laserBuffer)
 {
-  IGN_PROFILE("GpuLidarSensorPrivate::FillPointCloudMsg");
+  IGN_SENSORS_PROFILE("GpuLidarSensorPrivate::FillPointCloudMsg");
   uint32_t width = this->pointMsg.width();
   uint32_t height = this->pointMsg.height();
   unsigned int channels = 3;
 
-  float angleStep =
+  float angleStep = width > 1u ?
     (this->gpuRays->AngleMax() - this->gpuRays->AngleMin()).Radian() /
-    (this->gpuRays->RangeCount()-1);
+    (width - 1) : 0.0f;
 
-  float verticleAngleStep = (this->gpuRays->VerticalAngleMax() -
-      this->gpuRays->VerticalAngleMin()).Radian() /
-    (this->gpuRays->VerticalRangeCount()-1);
+  float verticleAngleStep = height > 1u ? (this->gpuRays->VerticalAngleMax() -
+      this->gpuRays->VerticalAngleMin()).Radian() / (height - 1) : 0.0f;
 
   // Angles of ray currently processing, azimuth is horizontal, inclination
   // is vertical
@@ -311,50 +504,58 @@ void GpuLidarSensorPrivate::FillPointCloudMsg()
       this->pointMsg.height());
   char *msgBufferIndex = msgBuffer->data();
 
-  // Iterate over scan and populate point cloud
-  for (uint32_t j = 0; j < height; ++j)
-  {
-    float azimuth = this->gpuRays->AngleMin().Radian();
+  // The layout of the points doesn't change within the cloud
+  const uint32_t pointStep = this->pointMsg.point_step();
+  const uint32_t xOffset = this->pointMsg.field(0).offset();
+  const uint32_t yOffset = this->pointMsg.field(1).offset();
+  const uint32_t zOffset = this->pointMsg.field(2).offset();
+  const uint32_t intensityOffset = this->pointMsg.field(3).offset();
+  const uint32_t ringOffset = this->pointMsg.field(4).offset();
+  const float azimuthMin = this->gpuRays->AngleMin().Radian();
 
-    for (uint32_t i = 0; i < width; ++i)
+  this->pointsUtil.WithTransform([&](const auto &_transform)
+  {
+    // Iterate over scan and populate point cloud
+    for (uint32_t j = 0; j < height; ++j)
     {
-      // Index of current point, and the depth value at that point
-      auto index = j * width * channels + i * channels;
-      float depth = this->gpuRays->Data()[index];
-      float intensity = this->gpuRays->Data()[index + 1];
-      uint16_t ring = j;
-
-      int fieldIndex = 0;
-
-      // Convert spherical coordinates to Cartesian for pointcloud
-      // See https://en.wikipedia.org/wiki/Spherical_coordinate_system
-      *reinterpret_cast<float *>(msgBufferIndex +
-          this->pointMsg.field(fieldIndex++).offset()) =
-        depth * std::cos(inclination) * std::cos(azimuth);
-
-      *reinterpret_cast<float *>(msgBufferIndex +
-          this->pointMsg.field(fieldIndex++).offset()) =
-        depth * std::cos(inclination) * std::sin(azimuth);
-
-      *reinterpret_cast<float *>(msgBufferIndex +
-          this->pointMsg.field(fieldIndex++).offset()) =
-        depth * std::sin(inclination);
-
-      // Intensity
-      *reinterpret_cast<float *>(msgBufferIndex +
-          this->pointMsg.field(fieldIndex++).offset()) = intensity;
-
-      // Ring
-      *reinterpret_cast<uint16_t *>(msgBufferIndex +
-          this->pointMsg.field(fieldIndex++).offset()) = ring;
-
-      // Move the index to the next point.
-      msgBufferIndex += this->pointMsg.point_step();
-
-      azimuth += angleStep;
+      float azimuth = azimuthMin;
+      const float cosInclination = std::cos(inclination);
+      const float sinInclination = std::sin(inclination);
+
+      for (uint32_t i = 0; i < width; ++i)
+      {
+        // Index of current point, and the depth value at that point
+        auto index = j * width * channels + i * channels;
+        float depth = _laserBuffer[index];
+        float intensity = _laserBuffer[index + 1];
+        uint16_t ring = j;
+
+        // Convert spherical coordinates to Cartesian for pointcloud
+        // See https://en.wikipedia.org/wiki/Spherical_coordinate_system
+        float x = depth * cosInclination * std::cos(azimuth);
+        float y = depth * cosInclination * std::sin(azimuth);
+        float z = depth * sinInclination;
+        _transform(x, y, z);
+
+        *reinterpret_cast<float *>(msgBufferIndex + xOffset) = x;
+        *reinterpret_cast<float *>(msgBufferIndex + yOffset) = y;
+        *reinterpret_cast<float *>(msgBufferIndex + zOffset) = z;
+
+        // Intensity
+        *reinterpret_cast<float *>(msgBufferIndex + intensityOffset) =
+            intensity;
+
+        // Ring
+        *reinterpret_cast<uint16_t *>(msgBufferIndex + ringOffset) = ring;
+
+        // Move the index to the next point.
+        msgBufferIndex += pointStep;
+
+        azimuth += angleStep;
+      }
+      inclination += verticleAngleStep;
     }
-    inclination += verticleAngleStep;
-  }
+  });
 }
 
 IGN_SENSORS_REGISTER_SENSOR(GpuLidarSensor)
@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "ignition/sensors/ImageDelta.hh"
+
+using namespace ignition;
+using namespace sensors;
+
+/// \brief Create an RGB image with a gradient.
+/// \param[in] _width Image width.
+/// \param[in] _height Image height.
+/// \return Image message.
+msgs::Image MakeImage(unsigned int _width, unsigned int _height)
+{
+  msgs::Image image;
+  image.set_width(_width);
+  image.set_height(_height);
+  image.set_step(_width * 3);
+  image.set_pixel_format_type(msgs::PixelFormatType::RGB_INT8);
+  std::string data(_width * _height * 3, '\0');
+  for (std::size_t i = 0; i < data.size(); ++i)
+    data[i] = static_cast<char>(i % 251);
+  image.set_data(data);
+  auto frame = image.mutable_header()->add_data();
+  frame->set_key("frame_id");
+  frame->add_value("camera");
+  return image;
+}
+
+/// \brief Get a header value.
+/// \param[in] _image Image to search.
+/// \param[in] _key Header key.
+/// \return Number of values, -1 if the key doesn't exist.
+int ValueCount(const msgs::Image &_image, const std::string &_key)
+{
+  for (const auto &data : _image.header().data())
+  {
+    if (data.key() == _key)
+      return data.value_size();
+  }
+  return -1;
+}
+
+//////////////////////////////////////////////////
+TEST(ImageDelta_TEST, RoundTrip)
+{
+  // 100x70 with 32 pixel tiles has partial tiles on the right and bottom
+  msgs::Image image = MakeImage(100u, 70u);
+  ImageDeltaEncoder encoder;
+  encoder.SetTileSize(32u);
+  EXPECT_EQ(32u, encoder.TileSize());
+  encoder.SetKeyframeInterval(0u);
+  EXPECT_EQ(0u, encoder.KeyframeInterval());
+  ImageDeltaDecoder decoder;
+
+  // The first image is a keyframe
+  msgs::Image delta;
+  EXPECT_EQ(12u, encoder.Encode(image, delta));
+  EXPECT_EQ(image.data(), delta.data());
+  EXPECT_TRUE(decoder.Decode(delta));
+  EXPECT_EQ(image.data(), decoder.Image().data());
+  EXPECT_EQ(1, ValueCount(decoder.Image(), "frame_id"));
+  EXPECT_EQ(-1, ValueCount(decoder.Image(), "delta_keyframe"));
+
+  // Nothing changed
+  image.mutable_header()->mutable_stamp()->set_sec(1);
+  EXPECT_EQ(0u, encoder.Encode(image, delta));
+  EXPECT_TRUE(delta.data().empty());
+  EXPECT_TRUE(decoder.Decode(delta));
+  EXPECT_EQ(image.data(), decoder.Image().data());
+  EXPECT_EQ(1, decoder.Image().header().stamp().sec());
+
+  // Change a pixel in the first tile and one in the bottom right tile
+  (*image.mutable_data())[0] = 'x';
+  (*image.mutable_data())[image.data().size() - 1] = 'y';
+  EXPECT_EQ(2u, encoder.Encode(image, delta));
+  EXPECT_EQ(2, ValueCount(delta, "delta_tiles"));
+  EXPECT_EQ(32u * 32u * 3u + 4u * 6u * 3u, delta.data().size());
+  EXPECT_TRUE(decoder.Decode(delta));
+  EXPECT_EQ(image.data(), decoder.Image().data());
+
+  // A change in size is a keyframe
+  msgs::Image small = MakeImage(40u, 30u);
+  EXPECT_EQ(2u, encoder.Encode(small, delta));
+  EXPECT_TRUE(decoder.Decode(delta));
+  EXPECT_EQ(small.data(), decoder.Image().data());
+  EXPECT_EQ(40u, decoder.Image().width());
+}
+
+//////////////////////////////////////////////////
+TEST(ImageDelta_TEST, Keyframes)
+{
+  msgs::Image image = MakeImage(64u, 64u);
+  ImageDeltaEncoder encoder;
+  EXPECT_EQ(64u, encoder.TileSize());
+  EXPECT_EQ(30u, encoder.KeyframeInterval());
+  encoder.SetKeyframeInterval(3u);
+  encoder.SetTileSize(16u);
+
+  msgs::Image delta;
+  EXPECT_EQ(16u, encoder.Encode(image, delta));
+  EXPECT_EQ(0u, encoder.Encode(image, delta));
+  EXPECT_EQ(0u, encoder.Encode(image, delta));
+  EXPECT_EQ(16u, encoder.Encode(image, delta));
+  EXPECT_EQ(0u, encoder.Encode(image, delta));
+
+  encoder.Reset();
+  EXPECT_EQ(16u, encoder.Encode(image, delta));
+
+  // A decoder that missed the keyframe can't reconstruct deltas
+  ImageDeltaDecoder decoder;
+  EXPECT_EQ(0u, encoder.Encode(image, delta));
+  EXPECT_FALSE(decoder.Decode(delta));
+  EXPECT_EQ(0u, decoder.Image().width());
+
+  // Malformed deltas are rejected
+  encoder.Reset();
+  encoder.Encode(image, delta);
+  EXPECT_TRUE(decoder.Decode(delta));
+  (*image.mutable_data())[5] = 'z';
+  encoder.Encode(image, delta);
+  msgs::Image truncated = delta;
+  truncated.mutable_data()->resize(10);
+  EXPECT_FALSE(decoder.Decode(truncated));
+  EXPECT_FALSE(decoder.Decode(msgs::Image()));
+  EXPECT_TRUE(decoder.Decode(delta));
+  EXPECT_EQ(image.data(), decoder.Image().data());
+}
+
+//////////////////////////////////////////////////
+TEST(ImageDelta_TEST, LostDelta)
+{
+  msgs::Image image = MakeImage(64u, 64u);
+  ImageDeltaEncoder encoder;
+  encoder.SetTileSize(16u);
+  encoder.SetKeyframeInterval(0u);
+  ImageDeltaDecoder decoder;
+
+  msgs::Image delta;
+  encoder.Encode(image, delta);
+  EXPECT_EQ(1, ValueCount(delta, "delta_seq"));
+  EXPECT_TRUE(decoder.Decode(delta));
+  EXPECT_EQ(-1, ValueCount(decoder.Image(), "delta_seq"));
+
+  // The first delta is lost
+  (*image.mutable_data())[0] = 'a';
+  EXPECT_EQ(1u, encoder.Encode(image, delta));
+
+  // The next ones can't be applied to the stale image
+  (*image.mutable_data())[image.data().size() - 1] = 'b';
+  EXPECT_EQ(1u, encoder.Encode(image, delta));
+  EXPECT_FALSE(decoder.Decode(delta));
+  EXPECT_NE(image.data(), decoder.Image().data());
+  EXPECT_EQ(0u, encoder.Encode(image, delta));
+  EXPECT_FALSE(decoder.Decode(delta));
+
+  // Until a keyframe arrives
+  encoder.Reset();
+  encoder.Encode(image, delta);
+  EXPECT_TRUE(decoder.Decode(delta));
+  EXPECT_EQ(image.data(), decoder.Image().data());
+  (*image.mutable_data())[1] = 'c';
+  EXPECT_EQ(1u, encoder.Encode(image, delta));
+  EXPECT_TRUE(decoder.Decode(delta));
+  EXPECT_EQ(image.data(), decoder.Image().data());
+}
+
+//////////////////////////////////////////////////
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -16,13 +16,15 @@
 */
 
 #include <ignition/msgs/imu.pb.h>
-#include <ignition/common/Profiler.hh>
 #include <ignition/transport/Node.hh>
 
 #include "ignition/sensors/Noise.hh"
 #include "ignition/sensors/SensorFactory.hh"
 #include "ignition/sensors/SensorTypes.hh"
 #include "ignition/sensors/ImuSensor.hh"
+#include "ignition/sensors/Tracing.hh"
+
+#include "StateStream.hh"
 
 using namespace ignition;
 using namespace sensors;
@@ -149,7 +151,7 @@ bool ImuSensor::Load(sdf::ElementPtr _sdf)
 //////////////////////////////////////////////////
 bool ImuSensor::Update(const ignition::common::Time &_now)
 {
-  IGN_PROFILE("ImuSensor::Update");
+  IGN_SENSORS_PROFILE_SENSOR("ImuSensor::Update", this->Id());
   if (!this->dataPtr->initialized)
   {
     ignerr << "Not initialized, update ignored.\n";
@@ -200,7 +202,7 @@ bool ImuSensor::Update(const ignition::common::Time &_now)
       this->dataPtr->orientationReference.Inverse() *
       this->dataPtr->worldPose.Rot();
 
-  msgs::IMU msg;
+  auto &msg = this->FrameMessage<msgs::IMU>();
   msg.mutable_header()->mutable_stamp()->set_sec(_now.sec);
   msg.mutable_header()->mutable_stamp()->set_nsec(_now.nsec);
   msg.set_entity_name(this->Name());
@@ -214,12 +216,46 @@ bool ImuSensor::Update(const ignition::common::Time &_now)
 
   // publish
   this->AddSequence(msg.mutable_header());
-  this->dataPtr->pub.Publish(msg);
+  this->Publish(this->dataPtr->pub, msg);
   this->dataPtr->prevStep = _now;
   this->dataPtr->timeInitialized = true;
   return true;
 }
 
+//////////////////////////////////////////////////
+bool ImuSensor::HasSubscribers() const
+{
+  return this->HasConnections(this->dataPtr->pub);
+}
+
+//////////////////////////////////////////////////
+bool ImuSensor::SaveState(std::ostream &_out) const
+{
+  if (!this->Sensor::SaveState(_out))
+    return false;
+
+  state::WriteTime(_out, this->dataPtr->prevStep);
+  state::Write(_out, static_cast<uint8_t>(this->dataPtr->timeInitialized));
+  return state::WriteNoises(_out, this->dataPtr->noises);
+}
+
+//////////////////////////////////////////////////
+bool ImuSensor::LoadState(std::istream &_in)
+{
+  common::Time prevStep;
+  uint8_t timeInitialized = 0u;
+  if (!this->Sensor::LoadState(_in) ||
+      !state::ReadTime(_in, prevStep) ||
+      !state::Read(_in, timeInitialized))
+  {
+    return false;
+  }
+
+  this->dataPtr->prevStep = prevStep;
+  this->dataPtr->timeInitialized = timeInitialized != 0u;
+  return state::ReadNoises(_in, this->dataPtr->noises);
+}
+
 //////////////////////////////////////////////////
 void ImuSensor::SetAngularVelocity(const math::Vector3d &_angularVel)
 {
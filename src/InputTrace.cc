@@ -0,0 +1,1259 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <utility>
+
+#include <ignition/common/Console.hh>
+
+#include "ignition/sensors/AirPressureSensor.hh"
+#include "ignition/sensors/AltimeterSensor.hh"
+#include "ignition/sensors/ImuSensor.hh"
+#include "ignition/sensors/InputTrace.hh"
+#include "ignition/sensors/LogicalCameraSensor.hh"
+#include "ignition/sensors/MagnetometerSensor.hh"
+#include "ignition/sensors/Tracing.hh"
+
+#include "RecordingFormat.hh"
+#include "StateStream.hh"
+
+using namespace ignition;
+using namespace sensors;
+
+namespace
+{
+  /// \brief First bytes of recorded inputs.
+  const char kInputMagic[8] = {'I', 'G', 'N', 'S', 'I', 'N', 'P', '\0'};
+
+  /// \brief Version of the recorded inputs.
+  const uint32_t kInputVersion = 1u;
+
+  /// \brief Sensor index of the events that don't target a sensor.
+  const uint32_t kNoSensorIndex = 0xffffffffu;
+
+  /// \brief FNV-1a offset basis.
+  const uint64_t kFnvOffset = 14695981039346656037ull;
+
+  /// \brief FNV-1a prime.
+  const uint64_t kFnvPrime = 1099511628211ull;
+
+  /// \brief Types of the recorded events. An event is its type, the index
+  /// of its sensor or kNoSensorIndex, and the arguments of the input it
+  /// records.
+  enum EventType : uint8_t
+  {
+    kStep = 0,
+    kPose,
+    kWorldPose,
+    kLinearAcceleration,
+    kAngularVelocity,
+    kGravity,
+    kOrientationReference,
+    kMagneticField,
+    kVerticalPosition,
+    kVerticalVelocity,
+    kVerticalReference,
+    kReferenceAltitude,
+    kModelPoses,
+    kModelObjects,
+    kOcclusionEnabled,
+    kCpuScene,
+    kAddBox,
+    kAddSphere,
+    kAddCylinder,
+    kRemoveObject,
+    kObjectPose,
+    kObjectRetro
+  };
+
+  /// \brief Result of applying an event.
+  enum class EventStatus
+  {
+    /// \brief The event was applied.
+    APPLIED,
+
+    /// \brief The event targets a sensor that is missing or has another
+    /// type, or an object that doesn't exist.
+    SKIPPED,
+
+    /// \brief The event is a step, to be run by the caller.
+    STEP,
+
+    /// \brief There are no more events.
+    END,
+
+    /// \brief The event couldn't be read.
+    INVALID
+  };
+
+  /// \brief Digest of the messages of a step.
+  struct StepDigest
+  {
+    /// \brief FNV-1a hash of the sensor names and serialized messages.
+    uint64_t hash;
+
+    /// \brief Number of messages.
+    uint32_t messages;
+
+    /// \brief Unused.
+    uint32_t reserved;
+  };
+
+  /// \brief Hash bytes with FNV-1a.
+  /// \param[in] _hash Hash to continue.
+  /// \param[in] _data Bytes to hash.
+  /// \param[in] _size Number of bytes.
+  /// \return Updated hash.
+  uint64_t Fnv(uint64_t _hash, const char *_data, std::size_t _size)
+  {
+    for (std::size_t i = 0u; i < _size; ++i)
+    {
+      _hash ^= static_cast<unsigned char>(_data[i]);
+      _hash *= kFnvPrime;
+    }
+    return _hash;
+  }
+
+  /// \brief Write a vector.
+  /// \param[in] _out Stream to write to.
+  /// \param[in] _vec Vector.
+  void WriteVector(std::ostream &_out, const math::Vector3d &_vec)
+  {
+    state::Write(_out, _vec.X());
+    state::Write(_out, _vec.Y());
+    state::Write(_out, _vec.Z());
+  }
+
+  /// \brief Write a quaternion.
+  /// \param[in] _out Stream to write to.
+  /// \param[in] _quat Quaternion.
+  void WriteQuaternion(std::ostream &_out, const math::Quaterniond &_quat)
+  {
+    state::Write(_out, _quat.W());
+    state::Write(_out, _quat.X());
+    state::Write(_out, _quat.Y());
+    state::Write(_out, _quat.Z());
+  }
+
+  /// \brief Write a pose.
+  /// \param[in] _out Stream to write to.
+  /// \param[in] _pose Pose.
+  void WritePose(std::ostream &_out, const math::Pose3d &_pose)
+  {
+    WriteVector(_out, _pose.Pos());
+    WriteQuaternion(_out, _pose.Rot());
+  }
+
+  /// \brief Read a vector written by WriteVector().
+  /// \param[in] _in Reader.
+  /// \param[out] _vec Vector.
+  /// \return False if the memory ended.
+  bool ReadVector(recording::MemoryReader &_in, math::Vector3d &_vec)
+  {
+    double x, y, z;
+    if (!_in.Read(x) || !_in.Read(y) || !_in.Read(z))
+      return false;
+    _vec.Set(x, y, z);
+    return true;
+  }
+
+  /// \brief Read a quaternion written by WriteQuaternion().
+  /// \param[in] _in Reader.
+  /// \param[out] _quat Quaternion.
+  /// \return False if the memory ended.
+  bool ReadQuaternion(recording::MemoryReader &_in, math::Quaterniond &_quat)
+  {
+    double w, x, y, z;
+    if (!_in.Read(w) || !_in.Read(x) || !_in.Read(y) || !_in.Read(z))
+      return false;
+    _quat = math::Quaterniond(w, x, y, z);
+    return true;
+  }
+
+  /// \brief Read a pose written by WritePose().
+  /// \param[in] _in Reader.
+  /// \param[out] _pose Pose.
+  /// \return False if the memory ended.
+  bool ReadPose(recording::MemoryReader &_in, math::Pose3d &_pose)
+  {
+    math::Vector3d pos;
+    math::Quaterniond rot;
+    if (!ReadVector(_in, pos) || !ReadQuaternion(_in, rot))
+      return false;
+    _pose = math::Pose3d(pos, rot);
+    return true;
+  }
+
+  /// \brief Passes the messages of the sensors of a manager to the tap set
+  /// before it, and hashes them.
+  class DigestTap : public MessageSink
+  {
+    /// \brief Destructor
+    public: ~DigestTap() override
+    {
+      this->Detach();
+    }
+
+    /// \brief Set this tap on the sensors of a manager that don't have it
+    /// yet.
+    /// \param[in] _mgr The manager.
+    public: void Attach(Manager &_mgr)
+    {
+      this->mgr = &_mgr;
+      for (SensorId id : _mgr.SensorIds())
+      {
+        Sensor *sensor = _mgr.Sensor(id);
+        if (sensor->Tap() == this)
+          continue;
+
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->previous[id] = sensor->Tap();
+        sensor->SetMessageTap(this);
+      }
+    }
+
+    /// \brief Restore the previous taps.
+    public: void Detach()
+    {
+      if (!this->mgr)
+        return;
+
+      for (const auto &prev : this->previous)
+      {
+        Sensor *sensor = this->mgr->Sensor(prev.first);
+        if (sensor && sensor->Tap() == this)
+          sensor->SetMessageTap(prev.second);
+      }
+      this->previous.clear();
+      this->mgr = nullptr;
+    }
+
+    /// \brief Get the digest of the messages since the last call, and
+    /// start a new one.
+    /// \return The digest.
+    public: StepDigest Take()
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      StepDigest result = this->digest;
+      this->digest = StepDigest{kFnvOffset, 0u, 0u};
+      return result;
+    }
+
+    /// \brief Get the wall time spent digesting messages since the last
+    /// call, and start counting again.
+    /// \return Time in seconds.
+    public: double TakeTime()
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      double result = this->seconds;
+      this->seconds = 0.0;
+      return result;
+    }
+
+    // Documentation inherited
+    public: void Add(const Sensor &_sensor,
+                const google::protobuf::Message &_msg) override
+    {
+      MessageSink *next = nullptr;
+      {
+        auto start = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(this->mutex);
+        _msg.SerializeToString(&this->buffer);
+        const std::string &name = _sensor.Name();
+        this->digest.hash = Fnv(this->digest.hash, name.data(), name.size());
+        this->digest.hash = Fnv(this->digest.hash, this->buffer.data(),
+            this->buffer.size());
+        ++this->digest.messages;
+
+        auto it = this->previous.find(_sensor.Id());
+        if (it != this->previous.end())
+          next = it->second;
+        this->seconds += std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+      }
+
+      if (next)
+        next->Add(_sensor, _msg);
+    }
+
+    // Documentation inherited
+    public: bool HasConnections() const override
+    {
+      return true;
+    }
+
+    /// \brief Manager of the tapped sensors.
+    private: Manager *mgr = nullptr;
+
+    /// \brief Taps set before this one, by sensor id.
+    private: std::map<SensorId, MessageSink *> previous;
+
+    /// \brief Digest of the current step.
+    private: StepDigest digest{kFnvOffset, 0u, 0u};
+
+    /// \brief Serialized message, kept to reuse its memory.
+    private: std::string buffer;
+
+    /// \brief Wall time spent digesting messages, in seconds.
+    private: double seconds = 0.0;
+
+    /// \brief Protects the digest, since sensors may publish from their
+    /// own threads.
+    private: std::mutex mutex;
+  };
+
+  /// \brief State shared by the events applied to a manager.
+  struct EventContext
+  {
+    /// \brief Get a sensor by its recorded index.
+    /// \param[in] _index Index of the sensor.
+    /// \return The sensor, nullptr if it's missing or has another type.
+    template<typename T>
+    T *SensorAt(uint32_t _index) const
+    {
+      if (_index >= this->sensors.size())
+        return nullptr;
+      return dynamic_cast<T *>(this->sensors[_index]);
+    }
+
+    /// \brief Get the object of the scene that was recorded with an id.
+    /// \param[in] _id Recorded id.
+    /// \return Object id, NO_RAY_OBJECT if there is none.
+    RayObjectId Object(uint64_t _id) const
+    {
+      auto it = this->objects.find(_id);
+      return it != this->objects.end() ? it->second : NO_RAY_OBJECT;
+    }
+
+    /// \brief Sensors by recorded index, nullptr if missing.
+    std::vector<Sensor *> sensors;
+
+    /// \brief Scene changed by the scene events.
+    RayScenePtr scene = std::make_shared<RayScene>();
+
+    /// \brief Object ids of the scene by recorded id.
+    std::map<uint64_t, RayObjectId> objects;
+
+    /// \brief Time of the last step event.
+    common::Time time;
+
+    /// \brief Force flag of the last step event.
+    bool force = false;
+  };
+
+  /// \brief Read the geometry of an object event and add the object.
+  /// \param[in] _type Type of the event.
+  /// \param[in] _in Reader positioned after the event header.
+  /// \param[in] _scene Scene to add the object to.
+  /// \param[out] _id Id of the new object.
+  /// \return False if the event couldn't be read.
+  bool AddObject(uint8_t _type, recording::MemoryReader &_in,
+      RayScene &_scene, RayObjectId &_id)
+  {
+    math::Pose3d pose;
+    switch (_type)
+    {
+      case kAddBox:
+      {
+        math::Vector3d size;
+        if (!ReadVector(_in, size) || !ReadPose(_in, pose))
+          return false;
+        _id = _scene.AddBox(size, pose);
+        return true;
+      }
+      case kAddSphere:
+      {
+        double radius;
+        if (!_in.Read(radius) || !ReadPose(_in, pose))
+          return false;
+        _id = _scene.AddSphere(radius, pose);
+        return true;
+      }
+      case kAddCylinder:
+      {
+        double radius, length;
+        if (!_in.Read(radius) || !_in.Read(length) || !ReadPose(_in, pose))
+          return false;
+        _id = _scene.AddCylinder(radius, length, pose);
+        return true;
+      }
+      default:
+        return false;
+    }
+  }
+
+  /// \brief Read an event and apply it.
+  /// \param[in] _in Reader positioned at the event.
+  /// \param[in,out] _ctx Sensors and scene the event applies to.
+  /// \return Result of the event.
+  EventStatus ApplyEvent(recording::MemoryReader &_in, EventContext &_ctx)
+  {
+    if (_in.Remaining() == 0u)
+      return EventStatus::END;
+
+    uint8_t type;
+    uint32_t index;
+    if (!_in.Read(type) || !_in.Read(index))
+      return EventStatus::INVALID;
+
+    auto applied = [](bool _ok)
+    {
+      return _ok ? EventStatus::APPLIED : EventStatus::SKIPPED;
+    };
+
+    math::Pose3d pose;
+    math::Vector3d vec;
+    double value;
+    switch (type)
+    {
+      case kStep:
+      {
+        int32_t sec, nsec;
+        uint8_t force;
+        if (!_in.Read(sec) || !_in.Read(nsec) || !_in.Read(force))
+          return EventStatus::INVALID;
+        _ctx.time = common::Time(sec, nsec);
+        _ctx.force = force != 0u;
+        return EventStatus::STEP;
+      }
+      case kPose:
+      {
+        if (!ReadPose(_in, pose))
+          return EventStatus::INVALID;
+        Sensor *sensor = _ctx.SensorAt<Sensor>(index);
+        if (sensor)
+          sensor->SetPose(pose);
+        return applied(sensor != nullptr);
+      }
+      case kWorldPose:
+      {
+        if (!ReadPose(_in, pose))
+          return EventStatus::INVALID;
+        if (auto imu = _ctx.SensorAt<ImuSensor>(index))
+        {
+          imu->SetWorldPose(pose);
+          return EventStatus::APPLIED;
+        }
+        if (auto mag = _ctx.SensorAt<MagnetometerSensor>(index))
+        {
+          mag->SetWorldPose(pose);
+          return EventStatus::APPLIED;
+        }
+        return EventStatus::SKIPPED;
+      }
+      case kLinearAcceleration:
+      case kAngularVelocity:
+      case kGravity:
+      {
+        if (!ReadVector(_in, vec))
+          return EventStatus::INVALID;
+        auto imu = _ctx.SensorAt<ImuSensor>(index);
+        if (!imu)
+          return EventStatus::SKIPPED;
+        if (type == kLinearAcceleration)
+          imu->SetLinearAcceleration(vec);
+        else if (type == kAngularVelocity)
+          imu->SetAngularVelocity(vec);
+        else
+          imu->SetGravity(vec);
+        return EventStatus::APPLIED;
+      }
+      case kOrientationReference:
+      {
+        math::Quaterniond orient;
+        if (!ReadQuaternion(_in, orient))
+          return EventStatus::INVALID;
+        auto imu = _ctx.SensorAt<ImuSensor>(index);
+        if (imu)
+          imu->SetOrientationReference(orient);
+        return applied(imu != nullptr);
+      }
+      case kMagneticField:
+      {
+        if (!ReadVector(_in, vec))
+          return EventStatus::INVALID;
+        auto mag = _ctx.SensorAt<MagnetometerSensor>(index);
+        if (mag)
+          mag->SetWorldMagneticField(vec);
+        return applied(mag != nullptr);
+      }
+      case kVerticalPosition:
+      case kVerticalVelocity:
+      case kVerticalReference:
+      {
+        if (!_in.Read(value))
+          return EventStatus::INVALID;
+        auto altimeter = _ctx.SensorAt<AltimeterSensor>(index);
+        if (!altimeter)
+          return EventStatus::SKIPPED;
+        if (type == kVerticalPosition)
+          altimeter->SetPosition(value);
+        else if (type == kVerticalVelocity)
+          altimeter->SetVerticalVelocity(value);
+        else
+          altimeter->SetVerticalReference(value);
+        return EventStatus::APPLIED;
+      }
+      case kReferenceAltitude:
+      {
+        if (!_in.Read(value))
+          return EventStatus::INVALID;
+        auto pressure = _ctx.SensorAt<AirPressureSensor>(index);
+        if (pressure)
+          pressure->SetReferenceAltitude(value);
+        return applied(pressure != nullptr);
+      }
+      case kModelPoses:
+      {
+        uint32_t count;
+        if (!_in.Read(count))
+          return EventStatus::INVALID;
+        std::map<std::string, math::Pose3d> models;
+        std::string name;
+        for (uint32_t i = 0u; i < count; ++i)
+        {
+          if (!_in.ReadString(name) || !ReadPose(_in, pose))
+            return EventStatus::INVALID;
+          models.emplace_hint(models.end(), name, pose);
+        }
+        auto camera = _ctx.SensorAt<LogicalCameraSensor>(index);
+        if (camera)
+          camera->SetModelPoses(std::move(models));
+        return applied(camera != nullptr);
+      }
+      case kModelObjects:
+      {
+        uint32_t count;
+        if (!_in.Read(count))
+          return EventStatus::INVALID;
+        std::map<std::string, std::vector<RayObjectId>> objects;
+        std::string name;
+        for (uint32_t i = 0u; i < count; ++i)
+        {
+          uint32_t size;
+          if (!_in.ReadString(name) || !_in.Read(size))
+            return EventStatus::INVALID;
+          std::vector<RayObjectId> &ids = objects[name];
+          for (uint32_t j = 0u; j < size; ++j)
+          {
+            uint64_t id;
+            if (!_in.Read(id))
+              return EventStatus::INVALID;
+            ids.push_back(_ctx.Object(id));
+          }
+        }
+        auto camera = _ctx.SensorAt<LogicalCameraSensor>(index);
+        if (camera)
+          camera->SetModelObjects(std::move(objects));
+        return applied(camera != nullptr);
+      }
+      case kOcclusionEnabled:
+      {
+        uint8_t enabled;
+        if (!_in.Read(enabled))
+          return EventStatus::INVALID;
+        auto camera = _ctx.SensorAt<LogicalCameraSensor>(index);
+        if (camera)
+          camera->SetOcclusionEnabled(enabled != 0u);
+        return applied(camera != nullptr);
+      }
+      case kCpuScene:
+      {
+        auto camera = _ctx.SensorAt<LogicalCameraSensor>(index);
+        if (camera)
+          camera->SetCpuScene(_ctx.scene);
+        return applied(camera != nullptr);
+      }
+      case kAddBox:
+      case kAddSphere:
+      case kAddCylinder:
+      {
+        RayObjectId id;
+        uint64_t recorded;
+        if (!AddObject(type, _in, *_ctx.scene, id) || !_in.Read(recorded))
+          return EventStatus::INVALID;
+        _ctx.objects[recorded] = id;
+        return EventStatus::APPLIED;
+      }
+      case kRemoveObject:
+      {
+        uint64_t recorded;
+        if (!_in.Read(recorded))
+          return EventStatus::INVALID;
+        bool removed = _ctx.scene->RemoveObject(_ctx.Object(recorded));
+        _ctx.objects.erase(recorded);
+        return applied(removed);
+      }
+      case kObjectPose:
+      {
+        uint64_t recorded;
+        if (!_in.Read(recorded) || !ReadPose(_in, pose))
+          return EventStatus::INVALID;
+        return applied(_ctx.scene->SetObjectPose(_ctx.Object(recorded),
+            pose));
+      }
+      case kObjectRetro:
+      {
+        uint64_t recorded;
+        if (!_in.Read(recorded) || !_in.Read(value))
+          return EventStatus::INVALID;
+        return applied(_ctx.scene->SetObjectRetro(_ctx.Object(recorded),
+            value));
+      }
+      default:
+        return EventStatus::INVALID;
+    }
+  }
+
+  /// \brief Get the scoped name of a sensor.
+  /// \param[in] _parent Parent of the sensor.
+  /// \param[in] _name Name of the sensor.
+  /// \return Scoped name.
+  std::string ScopedName(const std::string &_parent, const std::string &_name)
+  {
+    return _parent.empty() ? _name : _parent + "::" + _name;
+  }
+}
+
+/// \brief Private data for InputRecorder
+class ignition::sensors::InputRecorderPrivate
+{
+  /// \brief Get the index of a sensor, adding it to the sensor table.
+  /// \param[in] _id Id of the sensor.
+  /// \param[out] _index Index of the sensor.
+  /// \return False if the sensor doesn't exist.
+  public: bool Index(SensorId _id, uint32_t &_index);
+
+  /// \brief Start encoding an event for a sensor.
+  /// \param[in] _type Type of the event.
+  /// \param[in] _id Id of the sensor.
+  /// \return False if the sensor doesn't exist.
+  public: bool Begin(uint8_t _type, SensorId _id);
+
+  /// \brief Start encoding an event that doesn't target a sensor.
+  /// \param[in] _type Type of the event.
+  public: void Begin(uint8_t _type);
+
+  /// \brief Apply the encoded event, and append it to the events if it
+  /// was applied.
+  /// \return False if the event was skipped.
+  public: bool Commit();
+
+  /// \brief Add an object to the scene and record the event.
+  /// \param[in] _type Type of the event.
+  /// \param[in] _geometry Encoded geometry and pose of the object.
+  /// \return Id of the new object.
+  public: RayObjectId AddObject(uint8_t _type, const std::string &_geometry);
+
+  /// \brief Manager of the sensors.
+  public: Manager *mgr = nullptr;
+
+  /// \brief Sensors and scene the events apply to.
+  public: EventContext ctx;
+
+  /// \brief Ids of the sensors in the sensor table.
+  public: std::vector<SensorId> ids;
+
+  /// \brief Parents and names of the sensors in the sensor table.
+  public: std::vector<std::pair<std::string, std::string>> names;
+
+  /// \brief Runtime state of the sensors when recording started.
+  public: std::string initialState;
+
+  /// \brief Recorded events.
+  public: std::string events;
+
+  /// \brief Event being encoded.
+  public: std::ostringstream event;
+
+  /// \brief Digests of the recorded steps.
+  public: std::vector<StepDigest> digests;
+
+  /// \brief Tap hashing the messages.
+  public: DigestTap tap;
+};
+
+/// \brief Private data for InputReplay
+class ignition::sensors::InputReplayPrivate
+{
+  /// \brief Parents and names of the recorded sensors.
+  public: std::vector<std::pair<std::string, std::string>> names;
+
+  /// \brief Runtime state of the sensors when recording started.
+  public: std::string initialState;
+
+  /// \brief Recorded events.
+  public: std::string events;
+
+  /// \brief Digests of the recorded steps.
+  public: std::vector<StepDigest> digests;
+
+  /// \brief Whether Run() digests the messages to compare them.
+  public: bool equivalenceCheck = true;
+};
+
+//////////////////////////////////////////////////
+bool InputRecorderPrivate::Index(SensorId _id, uint32_t &_index)
+{
+  auto it = std::find(this->ids.begin(), this->ids.end(), _id);
+  if (it != this->ids.end())
+  {
+    _index = static_cast<uint32_t>(it - this->ids.begin());
+    return true;
+  }
+
+  Sensor *sensor = this->mgr->Sensor(_id);
+  if (!sensor)
+    return false;
+
+  _index = static_cast<uint32_t>(this->ids.size());
+  this->ids.push_back(_id);
+  this->names.emplace_back(sensor->Parent(), sensor->Name());
+  this->ctx.sensors.push_back(sensor);
+  return true;
+}
+
+//////////////////////////////////////////////////
+bool InputRecorderPrivate::Begin(uint8_t _type, SensorId _id)
+{
+  uint32_t index;
+  if (!this->Index(_id, index))
+    return false;
+
+  this->event.str("");
+  state::Write(this->event, _type);
+  state::Write(this->event, index);
+  return true;
+}
+
+//////////////////////////////////////////////////
+void InputRecorderPrivate::Begin(uint8_t _type)
+{
+  this->event.str("");
+  state::Write(this->event, _type);
+  state::Write(this->event, kNoSensorIndex);
+}
+
+//////////////////////////////////////////////////
+bool InputRecorderPrivate::Commit()
+{
+  std::string data = this->event.str();
+  recording::MemoryReader reader(data.data(), data.size());
+  if (ApplyEvent(reader, this->ctx) == EventStatus::SKIPPED)
+    return false;
+
+  this->events += data;
+  return true;
+}
+
+//////////////////////////////////////////////////
+RayObjectId InputRecorderPrivate::AddObject(uint8_t _type,
+    const std::string &_geometry)
+{
+  // The object is added before encoding the event, which records its id
+  recording::MemoryReader reader(_geometry.data(), _geometry.size());
+  RayObjectId id = NO_RAY_OBJECT;
+  ::AddObject(_type, reader, *this->ctx.scene, id);
+  this->ctx.objects[id] = id;
+
+  this->Begin(_type);
+  this->event.write(_geometry.data(), _geometry.size());
+  state::Write(this->event, static_cast<uint64_t>(id));
+  this->events += this->event.str();
+  return id;
+}
+
+//////////////////////////////////////////////////
+InputRecorder::InputRecorder(Manager &_mgr)
+  : dataPtr(new InputRecorderPrivate)
+{
+  this->dataPtr->mgr = &_mgr;
+
+  std::ostringstream initialState;
+  if (!_mgr.SaveState(initialState))
+    ignwarn << "Failed to save the state of the sensors, replays may differ "
+            << "from the recording.\n";
+  this->dataPtr->initialState = initialState.str();
+  this->dataPtr->tap.Attach(_mgr);
+}
+
+//////////////////////////////////////////////////
+InputRecorder::~InputRecorder()
+{
+  this->dataPtr->mgr->Flush();
+}
+
+//////////////////////////////////////////////////
+bool InputRecorder::SetPose(SensorId _id, const math::Pose3d &_pose)
+{
+  if (!this->dataPtr->Begin(kPose, _id))
+    return false;
+  WritePose(this->dataPtr->event, _pose);
+  return this->dataPtr->Commit();
+}
+
+//////////////////////////////////////////////////
+bool InputRecorder::SetWorldPose(SensorId _id, const math::Pose3d &_pose)
+{
+  if (!this->dataPtr->Begin(kWorldPose, _id))
+    return false;
+  WritePose(this->dataPtr->event, _pose);
+  return this->dataPtr->Commit();
+}
+
+//////////////////////////////////////////////////
+bool InputRecorder::SetLinearAcceleration(SensorId _id,
+    const math::Vector3d &_acc)
+{
+  if (!this->dataPtr->Begin(kLinearAcceleration, _id))
+    return false;
+  WriteVector(this->dataPtr->event, _acc);
+  return this->dataPtr->Commit();
+}
+
+//////////////////////////////////////////////////
+bool InputRecorder::SetAngularVelocity(SensorId _id,
+    const math::Vector3d &_vel)
+{
+  if (!this->dataPtr->Begin(kAngularVelocity, _id))
+    return false;
+  WriteVector(this->dataPtr->event, _vel);
+  return this->dataPtr->Commit();
+}
+
+//////////////////////////////////////////////////
+bool InputRecorder::SetGravity(SensorId _id, const math::Vector3d &_gravity)
+{
+  if (!this->dataPtr->Begin(kGravity, _id))
+    return false;
+  WriteVector(this->dataPtr->event, _gravity);
+  return this->dataPtr->Commit();
+}
+
+//////////////////////////////////////////////////
+bool InputRecorder::SetOrientationReference(SensorId _id,
+    const math::Quaterniond &_orient)
+{
+  if (!this->dataPtr->Begin(kOrientationReference, _id))
+    return false;
+  WriteQuaternion(this->dataPtr->event, _orient);
+  return this->dataPtr->Commit();
+}
+
+//////////////////////////////////////////////////
+bool InputRecorder::SetWorldMagneticField(SensorId _id,
+    const math::Vector3d &_field)
+{
+  if (!this->dataPtr->Begin(kMagneticField, _id))
+    return false;
+  WriteVector(this->dataPtr->event, _field);
+  return this->dataPtr->Commit();
+}
+
+//////////////////////////////////////////////////
+bool InputRecorder::SetVerticalPosition(SensorId _id, double _pos)
+{
+  if (!this->dataPtr->Begin(kVerticalPosition, _id))
+    return false;
+  state::Write(this->dataPtr->event, _pos);
+  return this->dataPtr->Commit();
+}
+
+//////////////////////////////////////////////////
+bool InputRecorder::SetVerticalVelocity(SensorId _id, double _vel)
+{
+  if (!this->dataPtr->Begin(kVerticalVelocity, _id))
+    return false;
+  state::Write(this->dataPtr->event, _vel);
+  return this->dataPtr->Commit();
+}
+
+//////////////////////////////////////////////////
+bool InputRecorder::SetVerticalReference(SensorId _id, double _reference)
+{
+  if (!this->dataPtr->Begin(kVerticalReference, _id))
+    return false;
+  state::Write(this->dataPtr->event, _reference);
+  return this->dataPtr->Commit();
+}
+
+//////////////////////////////////////////////////
+bool InputRecorder::SetReferenceAltitude(SensorId _id, double _reference)
+{
+  if (!this->dataPtr->Begin(kReferenceAltitude, _id))
+    return false;
+  state::Write(this->dataPtr->event, _reference);
+  return this->dataPtr->Commit();
+}
+
+//////////////////////////////////////////////////
+bool InputRecorder::SetModelPoses(SensorId _id,
+    const std::map<std::string, math::Pose3d> &_models)
+{
+  if (!this->dataPtr->Begin(kModelPoses, _id))
+    return false;
+  state::Write(this->dataPtr->event, static_cast<uint32_t>(_models.size()));
+  for (const auto &model : _models)
+  {
+    state::WriteString(this->dataPtr->event, model.first);
+    WritePose(this->dataPtr->event, model.second);
+  }
+  return this->dataPtr->Commit();
+}
+
+//////////////////////////////////////////////////
+bool InputRecorder::SetModelObjects(SensorId _id,
+    const std::map<std::string, std::vector<RayObjectId>> &_objects)
+{
+  if (!this->dataPtr->Begin(kModelObjects, _id))
+    return false;
+  state::Write(this->dataPtr->event, static_cast<uint32_t>(_objects.size()));
+  for (const auto &model : _objects)
+  {
+    state::WriteString(this->dataPtr->event, model.first);
+    state::Write(this->dataPtr->event,
+        static_cast<uint32_t>(model.second.size()));
+    for (RayObjectId id : model.second)
+      state::Write(this->dataPtr->event, static_cast<uint64_t>(id));
+  }
+  return this->dataPtr->Commit();
+}
+
+//////////////////////////////////////////////////
+bool InputRecorder::SetOcclusionEnabled(SensorId _id, bool _enabled)
+{
+  if (!this->dataPtr->Begin(kOcclusionEnabled, _id))
+    return false;
+  state::Write(this->dataPtr->event, static_cast<uint8_t>(_enabled));
+  return this->dataPtr->Commit();
+}
+
+//////////////////////////////////////////////////
+bool InputRecorder::SetCpuScene(SensorId _id)
+{
+  if (!this->dataPtr->Begin(kCpuScene, _id))
+    return false;
+  return this->dataPtr->Commit();
+}
+
+//////////////////////////////////////////////////
+RayObjectId InputRecorder::AddBox(const math::Vector3d &_size,
+    const math::Pose3d &_pose)
+{
+  std::ostringstream geometry;
+  WriteVector(geometry, _size);
+  WritePose(geometry, _pose);
+  return this->dataPtr->AddObject(kAddBox, geometry.str());
+}
+
+//////////////////////////////////////////////////
+RayObjectId InputRecorder::AddSphere(double _radius,
+    const math::Pose3d &_pose)
+{
+  std::ostringstream geometry;
+  state::Write(geometry, _radius);
+  WritePose(geometry, _pose);
+  return this->dataPtr->AddObject(kAddSphere, geometry.str());
+}
+
+//////////////////////////////////////////////////
+RayObjectId InputRecorder::AddCylinder(double _radius, double _length,
+    const math::Pose3d &_pose)
+{
+  std::ostringstream geometry;
+  state::Write(geometry, _radius);
+  state::Write(geometry, _length);
+  WritePose(geometry, _pose);
+  return this->dataPtr->AddObject(kAddCylinder, geometry.str());
+}
+
+//////////////////////////////////////////////////
+bool InputRecorder::RemoveObject(RayObjectId _object)
+{
+  this->dataPtr->Begin(kRemoveObject);
+  state::Write(this->dataPtr->event, static_cast<uint64_t>(_object));
+  return this->dataPtr->Commit();
+}
+
+//////////////////////////////////////////////////
+bool InputRecorder::SetObjectPose(RayObjectId _object,
+    const math::Pose3d &_pose)
+{
+  this->dataPtr->Begin(kObjectPose);
+  state::Write(this->dataPtr->event, static_cast<uint64_t>(_object));
+  WritePose(this->dataPtr->event, _pose);
+  return this->dataPtr->Commit();
+}
+
+//////////////////////////////////////////////////
+bool InputRecorder::SetObjectRetro(RayObjectId _object, double _retro)
+{
+  this->dataPtr->Begin(kObjectRetro);
+  state::Write(this->dataPtr->event, static_cast<uint64_t>(_object));
+  state::Write(this->dataPtr->event, _retro);
+  return this->dataPtr->Commit();
+}
+
+//////////////////////////////////////////////////
+RayScenePtr InputRecorder::Scene() const
+{
+  return this->dataPtr->ctx.scene;
+}
+
+//////////////////////////////////////////////////
+void InputRecorder::RunOnce(const common::Time &_time, bool _force)
+{
+  IGN_SENSORS_PROFILE("InputRecorder::RunOnce");
+  this->dataPtr->Begin(kStep);
+  state::WriteTime(this->dataPtr->event, _time);
+  state::Write(this->dataPtr->event, static_cast<uint8_t>(_force));
+  this->dataPtr->events += this->dataPtr->event.str();
+
+  // Sensors created since the last step are tapped too. Their inputs
+  // aren't covered by the initial state, but their output is compared.
+  this->dataPtr->tap.Attach(*this->dataPtr->mgr);
+  this->dataPtr->mgr->RunOnce(_time, _force);
+  this->dataPtr->digests.push_back(this->dataPtr->tap.Take());
+}
+
+//////////////////////////////////////////////////
+uint64_t InputRecorder::StepCount() const
+{
+  return this->dataPtr->digests.size();
+}
+
+//////////////////////////////////////////////////
+bool InputRecorder::Save(std::ostream &_out) const
+{
+  _out.write(kInputMagic, sizeof(kInputMagic));
+  state::Write(_out, kInputVersion);
+
+  state::Write(_out, static_cast<uint32_t>(this->dataPtr->names.size()));
+  for (const auto &name : this->dataPtr->names)
+  {
+    state::WriteString(_out, name.first);
+    state::WriteString(_out, name.second);
+  }
+
+  state::WriteString(_out, this->dataPtr->initialState);
+  state::WriteString(_out, this->dataPtr->events);
+
+  state::Write(_out, static_cast<uint64_t>(this->dataPtr->digests.size()));
+  for (const StepDigest &digest : this->dataPtr->digests)
+    state::Write(_out, digest);
+  return static_cast<bool>(_out);
+}
+
+//////////////////////////////////////////////////
+InputReplay::InputReplay()
+  : dataPtr(new InputReplayPrivate)
+{
+}
+
+//////////////////////////////////////////////////
+InputReplay::~InputReplay() = default;
+
+//////////////////////////////////////////////////
+bool InputReplay::Load(std::istream &_in)
+{
+  InputReplayPrivate data;
+
+  char magic[sizeof(kInputMagic)];
+  uint32_t version = 0u;
+  if (!_in.read(magic, sizeof(magic)) ||
+      std::memcmp(magic, kInputMagic, sizeof(magic)) != 0 ||
+      !state::Read(_in, version) || version != kInputVersion)
+  {
+    ignerr << "Stream doesn't hold recorded sensor inputs.\n";
+    return false;
+  }
+
+  uint32_t sensorCount = 0u;
+  if (!state::Read(_in, sensorCount))
+    return false;
+  for (uint32_t i = 0u; i < sensorCount; ++i)
+  {
+    std::pair<std::string, std::string> name;
+    if (!state::ReadString(_in, name.first) ||
+        !state::ReadString(_in, name.second))
+    {
+      ignerr << "Recorded sensor inputs are truncated.\n";
+      return false;
+    }
+    data.names.push_back(std::move(name));
+  }
+
+  uint64_t stepCount = 0u;
+  if (!state::ReadString(_in, data.initialState) ||
+      !state::ReadString(_in, data.events) ||
+      !state::Read(_in, stepCount))
+  {
+    ignerr << "Recorded sensor inputs are truncated.\n";
+    return false;
+  }
+
+  for (uint64_t i = 0u; i < stepCount; ++i)
+  {
+    StepDigest digest;
+    if (!state::Read(_in, digest))
+    {
+      ignerr << "Recorded sensor inputs are truncated.\n";
+      return false;
+    }
+    data.digests.push_back(digest);
+  }
+
+  *this->dataPtr = std::move(data);
+  return true;
+}
+
+//////////////////////////////////////////////////
+uint64_t InputReplay::StepCount() const
+{
+  return this->dataPtr->digests.size();
+}
+
+//////////////////////////////////////////////////
+void InputReplay::SetEquivalenceCheck(bool _check)
+{
+  this->dataPtr->equivalenceCheck = _check;
+}
+
+//////////////////////////////////////////////////
+bool InputReplay::EquivalenceCheck() const
+{
+  return this->dataPtr->equivalenceCheck;
+}
+
+//////////////////////////////////////////////////
+InputReplayReport InputReplay::Run(Manager &_mgr)
+{
+  IGN_SENSORS_PROFILE("InputReplay::Run");
+  InputReplayReport report;
+
+  if (!this->dataPtr->initialState.empty())
+  {
+    std::istringstream initialState(this->dataPtr->initialState);
+    if (!_mgr.LoadState(initialState))
+      ignwarn << "Failed to restore the recorded state of the sensors.\n";
+  }
+
+  // Match the recorded sensors by parent and name, in creation order
+  EventContext ctx;
+  std::vector<SensorId> ids = _mgr.SensorIds();
+  std::vector<bool> used(ids.size(), false);
+  for (const auto &name : this->dataPtr->names)
+  {
+    Sensor *match = nullptr;
+    for (std::size_t i = 0u; i < ids.size() && !match; ++i)
+    {
+      Sensor *sensor = _mgr.Sensor(ids[i]);
+      if (!used[i] && sensor->Parent() == name.first &&
+          sensor->Name() == name.second)
+      {
+        used[i] = true;
+        match = sensor;
+      }
+    }
+    if (!match)
+      report.missingSensors.push_back(ScopedName(name.first, name.second));
+    ctx.sensors.push_back(match);
+  }
+
+  // The tap makes every sensor produce its messages, and digesting them
+  // takes time that is measured and left out of the latencies
+  const bool check = this->dataPtr->equivalenceCheck;
+  DigestTap tap;
+  if (check)
+    tap.Attach(_mgr);
+
+  std::vector<double> latencies;
+  latencies.reserve(this->dataPtr->digests.size());
+
+  const std::string &events = this->dataPtr->events;
+  recording::MemoryReader reader(events.data(), events.size());
+  auto stepStart = std::chrono::steady_clock::now();
+  bool valid = true;
+  while (valid)
+  {
+    EventStatus status = ApplyEvent(reader, ctx);
+    if (status == EventStatus::END)
+      break;
+    if (status == EventStatus::INVALID)
+    {
+      ignerr << "Recorded sensor inputs are corrupt, stopping after step ["
+             << report.steps << "].\n";
+      valid = false;
+      break;
+    }
+    if (status != EventStatus::STEP)
+      continue;
+
+    _mgr.RunOnce(ctx.time, ctx.force);
+    auto stepEnd = std::chrono::steady_clock::now();
+    double digestTime = tap.TakeTime();
+    report.digestTime += digestTime;
+    latencies.push_back(std::max(0.0,
+        std::chrono::duration<double>(stepEnd - stepStart).count() -
+        digestTime));
+
+    if (check)
+    {
+      StepDigest digest = tap.Take();
+      report.messages += digest.messages;
+      if (report.steps >= this->dataPtr->digests.size() ||
+          digest.hash != this->dataPtr->digests[report.steps].hash ||
+          digest.messages != this->dataPtr->digests[report.steps].messages)
+      {
+        if (report.firstMismatch < 0)
+          report.firstMismatch = static_cast<int64_t>(report.steps);
+        ++report.mismatches;
+      }
+    }
+    ++report.steps;
+
+    // Inputs applied before the next step are part of its latency
+    stepStart = std::chrono::steady_clock::now();
+  }
+  tap.Detach();
+
+  if (!latencies.empty())
+  {
+    for (double latency : latencies)
+      report.wallTime += latency;
+    report.stepsPerSecond = report.wallTime > 0.0 ?
+        static_cast<double>(report.steps) / report.wallTime : 0.0;
+    report.meanLatency = report.wallTime / latencies.size();
+
+    std::sort(latencies.begin(), latencies.end());
+    report.medianLatency = latencies[latencies.size() / 2u];
+    std::size_t p99 = static_cast<std::size_t>(
+        std::ceil(0.99 * latencies.size())) - 1u;
+    report.p99Latency = latencies[p99];
+    report.maxLatency = latencies.back();
+  }
+
+  report.equivalent = check && valid && report.mismatches == 0u &&
+      report.missingSensors.empty() &&
+      report.steps == this->dataPtr->digests.size();
+  return report;
+}
@@ -14,9 +14,16 @@
  * limitations under the License.
  *
 */
+#include <ignition/msgs/image.pb.h>
+#include <ignition/msgs/pointcloud_packed.pb.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 #include <ignition/common/Console.hh>
 #include <ignition/common/Event.hh>
-#include <ignition/common/Profiler.hh>
+#include <ignition/msgs/Utility.hh>
 #include <ignition/transport/Node.hh>
 #include <sdf/Lidar.hh>
 
@@ -25,6 +32,10 @@
 #include "ignition/sensors/SensorFactory.hh"
 #include "ignition/sensors/SensorTypes.hh"
 #include "ignition/sensors/GaussianNoiseModel.hh"
+#include "ignition/sensors/Tracing.hh"
+
+#include "MemoryUsage.hh"
+#include "StateStream.hh"
 
 using namespace ignition::sensors;
 
@@ -45,8 +56,135 @@ class ignition::sensors::LidarPrivate
 
   /// \brief Sdf sensor.
   public: sdf::Lidar sdfLidar;
+
+  /// \brief Direction of each ray in the sensor frame, used when casting
+  /// rays on the CPU.
+  public: std::vector<ignition::math::Vector3d> rayDirections;
+
+  /// \brief Results of the last CPU ray cast.
+  public: std::vector<RayHit> rayHits;
+
+  /// \brief True when the scan angles changed and the ray directions must
+  /// be recomputed.
+  public: bool raysDirty = true;
+
+  /// \brief Publisher of the scan packets.
+  public: transport::Node::Publisher packetPub;
+
+  /// \brief Packet message, reused between packets.
+  public: msgs::PointCloudPacked packetMsg;
+
+  /// \brief Number of packets per scan, zero when packets are disabled.
+  public: unsigned int packetCount = 0u;
+
+  /// \brief Sweep time in seconds, zero to sweep during an update period.
+  public: double sweepTime = 0.0;
+
+  /// \brief Ray directions of each packet, row by row, used to cast the
+  /// rays of one packet at a time on the CPU.
+  public: std::vector<std::vector<ignition::math::Vector3d>>
+          packetDirections;
+
+  /// \brief Event called with each filled scan.
+  public: ignition::common::EventT<void(const common::Time &, const float *,
+              unsigned int, unsigned int)> scanEvent;
+
+  /// \brief Largest relative range difference to interpolate across when
+  /// upsampling a scan.
+  public: double upsampleEdgeThreshold = 0.1;
+
+  /// \brief Publisher of the range images.
+  public: transport::Node::Publisher rangeImagePub;
+
+  /// \brief Publisher of the intensity images.
+  public: transport::Node::Publisher intensityImagePub;
+
+  /// \brief Whether the range and intensity images are published.
+  public: bool rangeImageEnabled = false;
+
+  /// \brief Units of the L_INT16 range image in meters, zero for an
+  /// R_FLOAT32 image.
+  public: double rangeImageQuantization = 0.0;
 };
 
+namespace
+{
+  /// \brief Get the columns of a packet of a scan.
+  /// \param[in] _packet Index of the packet.
+  /// \param[in] _count Number of packets, at most _width.
+  /// \param[in] _width Number of columns of the scan.
+  /// \param[out] _begin First column of the packet.
+  /// \param[out] _end Column after the last column of the packet.
+  void PacketColumns(unsigned int _packet, unsigned int _count,
+      unsigned int _width, unsigned int &_begin, unsigned int &_end)
+  {
+    _begin = static_cast<unsigned int>(
+        static_cast<uint64_t>(_packet) * _width / _count);
+    _end = static_cast<unsigned int>(
+        static_cast<uint64_t>(_packet + 1u) * _width / _count);
+  }
+
+  /// \brief Copy a channel of a scan into a single channel image.
+  /// \param[in] _scan Scan, three channels per ray.
+  /// \param[in] _count Number of rays.
+  /// \param[in] _channel Channel to copy.
+  /// \param[out] _image Image with a value per ray.
+  void CopyChannel(const float *_scan, std::size_t _count,
+      unsigned int _channel, float *_image)
+  {
+    const float *value = _scan + _channel;
+    for (std::size_t k = 0u; k < _count; ++k)
+      _image[k] = value[k * 3u];
+  }
+
+  /// \brief Quantize the ranges of a scan into an unsigned 16 bit image.
+  /// \param[in] _scan Scan, three channels per ray.
+  /// \param[in] _count Number of rays.
+  /// \param[in] _scale Units per meter.
+  /// \param[out] _image Image with a range per ray, zero for misses and
+  /// ranges that don't fit.
+  void QuantizeRanges(const float *_scan, std::size_t _count, float _scale,
+      uint16_t *_image)
+  {
+    for (std::size_t k = 0u; k < _count; ++k)
+    {
+      // Infinite and NaN ranges fail the test
+      const float units = _scan[k * 3u] * _scale + 0.5f;
+      const bool valid = units >= 1.0f && units < 65536.0f;
+      _image[k] = static_cast<uint16_t>(valid ? units : 0.0f);
+    }
+  }
+
+  /// \brief Compute where each upsampled range lies between the rays of
+  /// a row or column, keeping the first and last rays in place.
+  /// \param[in] _rays Number of rays.
+  /// \param[in] _ranges Number of upsampled ranges.
+  /// \param[out] _low Index of the ray before each range.
+  /// \param[out] _high Index of the ray after each range, same as _low
+  /// when the range falls on a ray.
+  /// \param[out] _weight Weight of the ray after each range.
+  void UpsampleTable(unsigned int _rays, unsigned int _ranges,
+      std::vector<unsigned int> &_low, std::vector<unsigned int> &_high,
+      std::vector<float> &_weight)
+  {
+    _low.resize(_ranges);
+    _high.resize(_ranges);
+    _weight.resize(_ranges);
+    const double step = _ranges > 1u ?
+        static_cast<double>(_rays - 1u) / (_ranges - 1u) : 0.0;
+    for (unsigned int i = 0u; i < _ranges; ++i)
+    {
+      const double position = i * step;
+      const unsigned int low = std::min(
+          static_cast<unsigned int>(position), _rays - 1u);
+      const float weight = static_cast<float>(position - low);
+      _low[i] = low;
+      _high[i] = weight > 0.0f ? std::min(low + 1u, _rays - 1u) : low;
+      _weight[i] = weight;
+    }
+  }
+}
+
 //////////////////////////////////////////////////
 Lidar::Lidar()
   : dataPtr(new LidarPrivate())
@@ -68,6 +206,7 @@ bool Lidar::Init()
 //////////////////////////////////////////////////
 void Lidar::Fini()
 {
+  std::lock_guard<std::mutex> lock(this->lidarMutex);
   if (this->laserBuffer)
   {
     delete [] this->laserBuffer;
@@ -78,7 +217,46 @@ void Lidar::Fini()
 //////////////////////////////////////////////////
 bool Lidar::CreateLidar()
 {
-  return false;
+  // Without a GPU backend, rays are cast against the CPU scene
+  if (!this->CpuScene())
+    return false;
+
+  // One ray is cast per range, so no interpolation is needed
+  const unsigned int width = this->RangeCount();
+  const unsigned int height = this->VerticalRangeCount();
+  if (width == 0u || height == 0u)
+  {
+    ignerr << "Unable to create a lidar with 0 rays.\n";
+    return false;
+  }
+
+  this->dataPtr->rayDirections.clear();
+  this->dataPtr->rayDirections.reserve(width * height);
+  for (unsigned int j = 0; j < height; ++j)
+  {
+    double vAngle = this->VerticalAngleMin().Radian();
+    if (height > 1u)
+      vAngle += j * this->VerticalAngleResolution();
+
+    for (unsigned int i = 0; i < width; ++i)
+    {
+      double hAngle = this->AngleMin().Radian();
+      if (width > 1u)
+        hAngle += i * this->AngleResolution();
+
+      this->dataPtr->rayDirections.emplace_back(
+          std::cos(vAngle) * std::cos(hAngle),
+          std::cos(vAngle) * std::sin(hAngle),
+          std::sin(vAngle));
+    }
+  }
+  this->dataPtr->raysDirty = false;
+  this->dataPtr->packetDirections.clear();
+
+  std::lock_guard<std::mutex> lock(this->lidarMutex);
+  delete [] this->laserBuffer;
+  this->laserBuffer = new float[width * height * 3];
+  return true;
 }
 
 //////////////////////////////////////////////////
@@ -117,6 +295,38 @@ bool Lidar::Load(const sdf::Sensor &_sdf)
   }
   ignmsg << "Publishing laser scans on [" << this->Topic() << "]" << std::endl;
 
+  if (this->SupportsPackets())
+  {
+    this->dataPtr->packetPub =
+        this->dataPtr->node.Advertise<ignition::msgs::PointCloudPacked>(
+          this->Topic() + "/packets");
+    if (!this->dataPtr->packetPub)
+    {
+      ignerr << "Unable to create publisher on topic["
+        << this->Topic() + "/packets" << "].\n";
+      return false;
+    }
+  }
+  msgs::InitPointCloudPacked(this->dataPtr->packetMsg, this->Name(), true,
+      {{"xyz", msgs::PointCloudPacked::Field::FLOAT32},
+      {"intensity", msgs::PointCloudPacked::Field::FLOAT32},
+      {"ring", msgs::PointCloudPacked::Field::UINT16},
+      {"time", msgs::PointCloudPacked::Field::FLOAT32}});
+
+  this->dataPtr->rangeImagePub =
+      this->dataPtr->node.Advertise<ignition::msgs::Image>(
+        this->Topic() + "/range_image");
+  this->dataPtr->intensityImagePub =
+      this->dataPtr->node.Advertise<ignition::msgs::Image>(
+        this->Topic() + "/intensity_image");
+  if (!this->dataPtr->rangeImagePub || !this->dataPtr->intensityImagePub)
+  {
+    ignerr << "Unable to create publishers on topics["
+      << this->Topic() + "/range_image" << "] and ["
+      << this->Topic() + "/intensity_image" << "].\n";
+    return false;
+  }
+
   // Load ray atributes
   this->dataPtr->sdfLidar = *_sdf.LidarSensor();
 
@@ -183,16 +393,394 @@ ignition::common::ConnectionPtr Lidar::ConnectNewLidarFrame(
 }
 
 //////////////////////////////////////////////////
-bool Lidar::Update(const ignition::common::Time &/*_now*/)
+bool Lidar::Update(const ignition::common::Time &_now)
+{
+  IGN_SENSORS_PROFILE_SENSOR("Lidar::Update", this->Id());
+  RayScenePtr scene = this->CpuScene();
+  if (!scene)
+  {
+    ignerr << "No lidar data being updated.\n";
+    return false;
+  }
+
+  const bool resized = this->dataPtr->raysDirty || !this->laserBuffer;
+  if (resized && !this->CreateLidar())
+    return false;
+
+  const unsigned int width = this->RangeCount();
+  const unsigned int height = this->VerticalRangeCount();
+  const unsigned int packets = this->PacketsEnabled() ?
+      std::min(this->dataPtr->packetCount, width) : 0u;
+
+  // Reuse the last scan if nothing changed since it was cast
+  if (!resized && !this->FrameDirty())
+  {
+    if (this->FrameReuse() == FrameReusePolicy::SKIP)
+      return true;
+    for (unsigned int p = 0u; p < packets; ++p)
+      this->PublishPacket(_now, this->laserBuffer, width, height, p);
+    this->NotifyScan(_now, this->laserBuffer, width, height);
+    return this->PublishLidarScan(_now);
+  }
+
+  if (packets == 0u)
+  {
+    scene->CastRays(this->Pose(), this->dataPtr->rayDirections,
+        this->RangeMin(), this->RangeMax(), this->dataPtr->rayHits);
+
+    std::lock_guard<std::mutex> lock(this->lidarMutex);
+    for (std::size_t i = 0; i < this->dataPtr->rayHits.size(); ++i)
+    {
+      this->laserBuffer[i * 3] = this->dataPtr->rayHits[i].range;
+      this->laserBuffer[i * 3 + 1] = this->dataPtr->rayHits[i].retro;
+      this->laserBuffer[i * 3 + 2] = 0.0f;
+    }
+  }
+  else
+  {
+    // Split the ray directions into the columns of each packet
+    if (this->dataPtr->packetDirections.size() != packets)
+    {
+      this->dataPtr->packetDirections.assign(packets, {});
+      for (unsigned int p = 0u; p < packets; ++p)
+      {
+        unsigned int begin, end;
+        PacketColumns(p, packets, width, begin, end);
+        auto &directions = this->dataPtr->packetDirections[p];
+        directions.reserve((end - begin) * height);
+        for (unsigned int j = 0u; j < height; ++j)
+        {
+          directions.insert(directions.end(),
+              this->dataPtr->rayDirections.begin() + j * width + begin,
+              this->dataPtr->rayDirections.begin() + j * width + end);
+        }
+      }
+    }
+
+    // Cast and publish each packet before casting the next one
+    for (unsigned int p = 0u; p < packets; ++p)
+    {
+      IGN_SENSORS_PROFILE("Lidar::Update Packet");
+      scene->CastRays(this->Pose(), this->dataPtr->packetDirections[p],
+          this->RangeMin(), this->RangeMax(), this->dataPtr->rayHits);
+
+      unsigned int begin, end;
+      PacketColumns(p, packets, width, begin, end);
+      {
+        std::lock_guard<std::mutex> lock(this->lidarMutex);
+        const RayHit *hit = this->dataPtr->rayHits.data();
+        for (unsigned int j = 0u; j < height; ++j)
+        {
+          for (unsigned int i = begin; i < end; ++i, ++hit)
+          {
+            const std::size_t index = (j * width + i) * 3u;
+            this->laserBuffer[index] = hit->range;
+            this->laserBuffer[index + 1] = hit->retro;
+            this->laserBuffer[index + 2] = 0.0f;
+          }
+        }
+      }
+      this->PublishPacket(_now, this->laserBuffer, width, height, p);
+    }
+  }
+
+  this->NotifyScan(_now, this->laserBuffer, width, height);
+  return this->PublishLidarScan(_now);
+}
+
+//////////////////////////////////////////////////
+void Lidar::SetPacketCount(unsigned int _count)
+{
+  if (_count > 0u && !this->SupportsPackets())
+  {
+    ignwarn << "Lidar [" << this->Name() << "] produces whole scans, it "
+            << "doesn't publish packets.\n";
+    return;
+  }
+  this->dataPtr->packetCount = _count;
+  this->dataPtr->packetDirections.clear();
+}
+
+//////////////////////////////////////////////////
+unsigned int Lidar::PacketCount() const
+{
+  return this->dataPtr->packetCount;
+}
+
+//////////////////////////////////////////////////
+void Lidar::SetSweepTime(double _seconds)
+{
+  this->dataPtr->sweepTime = std::max(0.0, _seconds);
+}
+
+//////////////////////////////////////////////////
+double Lidar::SweepTime() const
+{
+  return this->dataPtr->sweepTime;
+}
+
+//////////////////////////////////////////////////
+void Lidar::SetUpsampleEdgeThreshold(double _threshold)
+{
+  this->dataPtr->upsampleEdgeThreshold = _threshold;
+}
+
+//////////////////////////////////////////////////
+double Lidar::UpsampleEdgeThreshold() const
+{
+  return this->dataPtr->upsampleEdgeThreshold;
+}
+
+//////////////////////////////////////////////////
+void Lidar::SetRangeImageEnabled(bool _enabled)
+{
+  this->dataPtr->rangeImageEnabled = _enabled;
+}
+
+//////////////////////////////////////////////////
+bool Lidar::RangeImageEnabled() const
+{
+  return this->dataPtr->rangeImageEnabled;
+}
+
+//////////////////////////////////////////////////
+void Lidar::SetRangeImageQuantization(double _meters)
+{
+  this->dataPtr->rangeImageQuantization = std::max(_meters, 0.0);
+}
+
+//////////////////////////////////////////////////
+double Lidar::RangeImageQuantization() const
+{
+  return this->dataPtr->rangeImageQuantization;
+}
+
+//////////////////////////////////////////////////
+bool Lidar::UpsampleScan(const float *_rays, unsigned int _rayCount,
+    unsigned int _verticalRayCount, float *_ranges, unsigned int _rangeCount,
+    unsigned int _verticalRangeCount) const
+{
+  if (!_rays || !_ranges || _rayCount == 0u || _verticalRayCount == 0u ||
+      _rangeCount == 0u || _verticalRangeCount == 0u)
+  {
+    return false;
+  }
+
+  IGN_SENSORS_PROFILE("Lidar::UpsampleScan");
+  if (_rayCount == _rangeCount && _verticalRayCount == _verticalRangeCount)
+  {
+    std::copy(_rays, _rays + _rayCount * _verticalRayCount * 3u, _ranges);
+    return true;
+  }
+
+  std::vector<unsigned int> columnLow, columnHigh, rowLow, rowHigh;
+  std::vector<float> columnWeight, rowWeight;
+  UpsampleTable(_rayCount, _rangeCount, columnLow, columnHigh, columnWeight);
+  UpsampleTable(_verticalRayCount, _verticalRangeCount, rowLow, rowHigh,
+      rowWeight);
+
+  // Bilinear interpolation between the four surrounding rays, unless
+  // their ranges differ too much. The loop is free of branches so that it
+  // vectorizes, both results are computed and one is selected.
+  const float threshold =
+      static_cast<float>(this->dataPtr->upsampleEdgeThreshold);
+  for (unsigned int j = 0u; j < _verticalRangeCount; ++j)
+  {
+    const float *row0 = _rays + rowLow[j] * _rayCount * 3u;
+    const float *row1 = _rays + rowHigh[j] * _rayCount * 3u;
+    const float fy = rowWeight[j];
+    const float *nearRow = fy < 0.5f ? row0 : row1;
+    float *out = _ranges + j * _rangeCount * 3u;
+    for (unsigned int i = 0u; i < _rangeCount; ++i)
+    {
+      const unsigned int a = columnLow[i] * 3u;
+      const unsigned int b = columnHigh[i] * 3u;
+      const float fx = columnWeight[i];
+      const float low = std::min(std::min(row0[a], row0[b]),
+          std::min(row1[a], row1[b]));
+      const float high = std::max(std::max(row0[a], row0[b]),
+          std::max(row1[a], row1[b]));
+
+      // Infinite ranges fail the test too, so misses aren't blended
+      const bool smooth = high - low <= threshold * low;
+      const float *nearest = nearRow + (fx < 0.5f ? a : b);
+      for (unsigned int c = 0u; c < 3u; ++c)
+      {
+        const float top = row0[a + c] + fx * (row0[b + c] - row0[a + c]);
+        const float bottom = row1[a + c] + fx * (row1[b + c] - row1[a + c]);
+        const float blend = top + fy * (bottom - top);
+        out[i * 3u + c] = smooth ? blend : nearest[c];
+      }
+    }
+  }
+  return true;
+}
+
+//////////////////////////////////////////////////
+ignition::common::ConnectionPtr Lidar::ConnectScanCallback(
+    std::function<void(const common::Time &_stamp, const float *_scan,
+        unsigned int _width, unsigned int _height)> _callback)
+{
+  return this->dataPtr->scanEvent.Connect(_callback);
+}
+
+//////////////////////////////////////////////////
+void Lidar::NotifyScan(const common::Time &_now, const float *_scan,
+    unsigned int _width, unsigned int _height)
+{
+  if (this->dataPtr->scanEvent.ConnectionCount() == 0u)
+    return;
+
+  IGN_SENSORS_PROFILE("Lidar::NotifyScan");
+  this->dataPtr->scanEvent(_now, _scan, _width, _height);
+}
+
+//////////////////////////////////////////////////
+bool Lidar::SupportsPackets() const
+{
+  return true;
+}
+
+//////////////////////////////////////////////////
+bool Lidar::PacketsEnabled() const
 {
-  ignerr << "No lidar data being updated.\n";
-  return false;
+  return this->dataPtr->packetCount > 0u &&
+      this->HasConnections(this->dataPtr->packetPub);
+}
+
+//////////////////////////////////////////////////
+bool Lidar::PublishPacket(const common::Time &_now, const float *_scan,
+    unsigned int _width, unsigned int _height, unsigned int _packet)
+{
+  IGN_SENSORS_PROFILE("Lidar::PublishPacket");
+  const unsigned int count = std::min(this->dataPtr->packetCount, _width);
+  if (!_scan || _packet >= count)
+    return false;
+
+  unsigned int begin, end;
+  PacketColumns(_packet, count, _width, begin, end);
+
+  msgs::PointCloudPacked &msg = this->dataPtr->packetMsg;
+  msg.mutable_header()->mutable_stamp()->set_sec(_now.sec);
+  msg.mutable_header()->mutable_stamp()->set_nsec(_now.nsec);
+  msg.mutable_header()->clear_data();
+  auto frame = msg.mutable_header()->add_data();
+  frame->set_key("frame_id");
+  frame->add_value(this->Name());
+  auto packet = msg.mutable_header()->add_data();
+  packet->set_key("packet");
+  packet->add_value(std::to_string(_packet));
+
+  // Rays that miss are kept, so the packet is organized but not dense
+  msg.set_width(end - begin);
+  msg.set_height(_height);
+  msg.set_row_step(msg.point_step() * msg.width());
+  msg.set_is_dense(false);
+
+  const uint32_t xOffset = msg.field(0).offset();
+  const uint32_t yOffset = msg.field(1).offset();
+  const uint32_t zOffset = msg.field(2).offset();
+  const uint32_t intensityOffset = msg.field(3).offset();
+  const uint32_t ringOffset = msg.field(4).offset();
+  const uint32_t timeOffset = msg.field(5).offset();
+
+  const double angleMin = this->AngleMin().Radian();
+  const double angleStep = _width > 1u ?
+      (this->AngleMax() - this->AngleMin()).Radian() / (_width - 1u) : 0.0;
+  const double verticalAngleMin = this->VerticalAngleMin().Radian();
+  const double verticalAngleStep = _height > 1u ?
+      (this->VerticalAngleMax() - this->VerticalAngleMin()).Radian() /
+      (_height - 1u) : 0.0;
+
+  double sweep = this->dataPtr->sweepTime;
+  if (sweep <= 0.0 && this->UpdateRate() > 0.0)
+    sweep = 1.0 / this->UpdateRate();
+  const double columnTime = sweep / _width;
+
+  std::string *data = msg.mutable_data();
+  data->resize(msg.row_step() * msg.height());
+  char *point = &(*data)[0];
+  for (unsigned int j = 0u; j < _height; ++j)
+  {
+    const double inclination = verticalAngleMin + j * verticalAngleStep;
+    const double cosInclination = std::cos(inclination);
+    const double sinInclination = std::sin(inclination);
+    for (unsigned int i = begin; i < end; ++i)
+    {
+      const float *ray = _scan + (j * _width + i) * 3u;
+      const double azimuth = angleMin + i * angleStep;
+      const float range = ray[0];
+
+      *reinterpret_cast<float *>(point + xOffset) =
+          range * cosInclination * std::cos(azimuth);
+      *reinterpret_cast<float *>(point + yOffset) =
+          range * cosInclination * std::sin(azimuth);
+      *reinterpret_cast<float *>(point + zOffset) = range * sinInclination;
+      *reinterpret_cast<float *>(point + intensityOffset) = ray[1];
+      *reinterpret_cast<uint16_t *>(point + ringOffset) =
+          static_cast<uint16_t>(j);
+      *reinterpret_cast<float *>(point + timeOffset) =
+          static_cast<float>(i * columnTime);
+      point += msg.point_step();
+    }
+  }
+
+  this->AddSequence(msg.mutable_header(), "packets");
+  return this->Publish(this->dataPtr->packetPub, msg);
+}
+
+//////////////////////////////////////////////////
+bool Lidar::HasSubscribers() const
+{
+  return this->HasConnections(this->dataPtr->pub) ||
+      (this->dataPtr->packetCount > 0u &&
+       this->HasConnections(this->dataPtr->packetPub)) ||
+      this->dataPtr->scanEvent.ConnectionCount() > 0u ||
+      (this->dataPtr->rangeImageEnabled &&
+       (this->HasConnections(this->dataPtr->rangeImagePub) ||
+        this->HasConnections(this->dataPtr->intensityImagePub)));
+}
+
+//////////////////////////////////////////////////
+bool Lidar::SaveState(std::ostream &_out) const
+{
+  return this->Sensor::SaveState(_out) &&
+      state::WriteNoises(_out, this->dataPtr->noises);
+}
+
+//////////////////////////////////////////////////
+bool Lidar::LoadState(std::istream &_in)
+{
+  return this->Sensor::LoadState(_in) &&
+      state::ReadNoises(_in, this->dataPtr->noises);
+}
+
+//////////////////////////////////////////////////
+SensorMemoryUsage Lidar::MemoryUsage() const
+{
+  SensorMemoryUsage usage = this->Sensor::MemoryUsage();
+
+  std::lock_guard<std::mutex> lock(this->lidarMutex);
+  usage.buffers += memory::Bytes(this->dataPtr->rayDirections) +
+      memory::Bytes(this->dataPtr->rayHits);
+
+  // CreateLidar() allocates three floats per ray. Subclasses that
+  // allocate the laser buffer themselves count it.
+  if (this->laserBuffer)
+  {
+    usage.buffers +=
+        this->dataPtr->rayDirections.size() * 3u * sizeof(float);
+  }
+  usage.buffers += memory::Bytes(this->dataPtr->packetDirections);
+  usage.messages += memory::Bytes(this->dataPtr->laserMsg) +
+      memory::Bytes(this->dataPtr->packetMsg);
+  return usage;
 }
 
 //////////////////////////////////////////////////
 bool Lidar::PublishLidarScan(const ignition::common::Time &_now)
 {
-  IGN_PROFILE("Lidar::PublishLidarScan");
+  IGN_SENSORS_PROFILE("Lidar::PublishLidarScan");
   if (!this->laserBuffer)
     return false;
 
@@ -213,7 +801,7 @@ bool Lidar::PublishLidarScan(const ignition::common::Time &_now)
   msgs::Set(this->dataPtr->laserMsg.mutable_world_pose(),
       this->Pose());
 
-  const int numRays = this->RayCount() * this->VerticalRayCount();
+  const int numRays = this->RangeCount() * this->VerticalRangeCount();
   if (this->dataPtr->laserMsg.ranges_size() != numRays)
   {
     // igndbg << "Size mismatch; allocating memory\n";
@@ -250,11 +838,82 @@ bool Lidar::PublishLidarScan(const ignition::common::Time &_now)
 
   // publish
   this->AddSequence(this->dataPtr->laserMsg.mutable_header());
-  this->dataPtr->pub.Publish(this->dataPtr->laserMsg);
+  this->Publish(this->dataPtr->pub, this->dataPtr->laserMsg);
 
+  this->PublishRangeImages(_now);
   return true;
 }
 
+//////////////////////////////////////////////////
+void Lidar::PublishRangeImages(const ignition::common::Time &_now)
+{
+  if (!this->dataPtr->rangeImageEnabled)
+    return;
+
+  const bool ranges = this->HasConnections(this->dataPtr->rangeImagePub);
+  const bool intensities =
+      this->HasConnections(this->dataPtr->intensityImagePub);
+  if (!ranges && !intensities)
+    return;
+
+  IGN_SENSORS_PROFILE("Lidar::PublishRangeImages");
+  const unsigned int width = this->RangeCount();
+  const unsigned int height = this->VerticalRangeCount();
+  const std::size_t count = static_cast<std::size_t>(width) * height;
+
+  auto fillHeader = [&](msgs::Image &_msg)
+  {
+    _msg.set_width(width);
+    _msg.set_height(height);
+    _msg.mutable_header()->mutable_stamp()->set_sec(_now.sec);
+    _msg.mutable_header()->mutable_stamp()->set_nsec(_now.nsec);
+    auto frame = _msg.mutable_header()->add_data();
+    frame->set_key("frame_id");
+    frame->add_value(this->Name());
+  };
+
+  if (ranges)
+  {
+    auto &msg = this->FrameMessage<msgs::Image>();
+    fillHeader(msg);
+    std::string *data = msg.mutable_data();
+    const double quantization = this->dataPtr->rangeImageQuantization;
+    if (quantization > 0.0)
+    {
+      msg.set_step(width * sizeof(uint16_t));
+      msg.set_pixel_format_type(msgs::PixelFormatType::L_INT16);
+      data->resize(count * sizeof(uint16_t));
+      QuantizeRanges(this->laserBuffer, count,
+          static_cast<float>(1.0 / quantization),
+          reinterpret_cast<uint16_t *>(&(*data)[0]));
+    }
+    else
+    {
+      msg.set_step(width * sizeof(float));
+      msg.set_pixel_format_type(msgs::PixelFormatType::R_FLOAT32);
+      data->resize(count * sizeof(float));
+      CopyChannel(this->laserBuffer, count, 0u,
+          reinterpret_cast<float *>(&(*data)[0]));
+    }
+    this->AddSequence(msg.mutable_header(), "range_image");
+    this->Publish(this->dataPtr->rangeImagePub, msg);
+  }
+
+  if (intensities)
+  {
+    auto &msg = this->FrameMessage<msgs::Image>();
+    fillHeader(msg);
+    msg.set_step(width * sizeof(float));
+    msg.set_pixel_format_type(msgs::PixelFormatType::R_FLOAT32);
+    std::string *data = msg.mutable_data();
+    data->resize(count * sizeof(float));
+    CopyChannel(this->laserBuffer, count, 1u,
+        reinterpret_cast<float *>(&(*data)[0]));
+    this->AddSequence(msg.mutable_header(), "intensity_image");
+    this->Publish(this->dataPtr->intensityImagePub, msg);
+  }
+}
+
 //////////////////////////////////////////////////
 bool Lidar::IsHorizontal() const
 {
@@ -278,6 +937,7 @@ ignition::math::Angle Lidar::AngleMin() const
 void Lidar::SetAngleMin(double _angle)
 {
   this->dataPtr->sdfLidar.SetHorizontalScanMinAngle(_angle);
+  this->dataPtr->raysDirty = true;
 }
 
 //////////////////////////////////////////////////
@@ -290,6 +950,7 @@ ignition::math::Angle Lidar::AngleMax() const
 void Lidar::SetAngleMax(double _angle)
 {
   this->dataPtr->sdfLidar.SetHorizontalScanMaxAngle(_angle);
+  this->dataPtr->raysDirty = true;
 }
 
 //////////////////////////////////////////////////
@@ -362,6 +1023,7 @@ ignition::math::Angle Lidar::VerticalAngleMin() const
 void Lidar::SetVerticalAngleMin(const double _angle)
 {
   this->dataPtr->sdfLidar.SetVerticalScanMinAngle(_angle);
+  this->dataPtr->raysDirty = true;
 }
 
 //////////////////////////////////////////////////
@@ -381,6 +1043,7 @@ double Lidar::VerticalAngleResolution() const
 void Lidar::SetVerticalAngleMax(const double _angle)
 {
   this->dataPtr->sdfLidar.SetVerticalScanMaxAngle(_angle);
+  this->dataPtr->raysDirty = true;
 }
 
 //////////////////////////////////////////////////
@@ -0,0 +1,427 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <ignition/msgs/pointcloud_packed.pb.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include <ignition/common/Console.hh>
+#include <ignition/msgs/Utility.hh>
+#include <ignition/transport/Node.hh>
+
+#include "ignition/sensors/LidarFusion.hh"
+#include "ignition/sensors/Tracing.hh"
+
+using namespace ignition;
+using namespace sensors;
+
+namespace
+{
+/// \brief A lidar merged by the fusion, and its latest scan.
+struct FusionSource
+{
+  /// \brief The lidar.
+  Lidar *lidar = nullptr;
+
+  /// \brief Pose of the lidar in the common frame.
+  math::Pose3d extrinsic;
+
+  /// \brief Connection to the scans of the lidar.
+  common::ConnectionPtr connection;
+
+  /// \brief Direction of each ray in the common frame, one array per
+  /// axis so that the transform loops vectorize.
+  std::vector<float> dirX, dirY, dirZ;
+
+  /// \brief Columns and rows the directions were computed for.
+  unsigned int width = 0u, height = 0u;
+
+  /// \brief Stamp of the latest scan.
+  common::Time stamp;
+
+  /// \brief Whether a scan arrived since the last merged cloud.
+  bool pending = false;
+
+  /// \brief Packed points of the latest scan.
+  std::string points;
+};
+
+/// \brief Compute the direction of each ray of a lidar, rotated into the
+/// common frame.
+/// \param[in,out] _source The source, whose directions are filled.
+/// \param[in] _width Number of columns of the scans.
+/// \param[in] _height Number of rows of the scans.
+void ComputeDirections(FusionSource &_source, unsigned int _width,
+    unsigned int _height)
+{
+  const Lidar *lidar = _source.lidar;
+  const double angleMin = lidar->AngleMin().Radian();
+  const double angleStep = _width > 1u ?
+      (lidar->AngleMax() - lidar->AngleMin()).Radian() / (_width - 1u) : 0.0;
+  const double verticalAngleMin = lidar->VerticalAngleMin().Radian();
+  const double verticalAngleStep = _height > 1u ?
+      (lidar->VerticalAngleMax() - lidar->VerticalAngleMin()).Radian() /
+      (_height - 1u) : 0.0;
+
+  const std::size_t count = static_cast<std::size_t>(_width) * _height;
+  _source.dirX.resize(count);
+  _source.dirY.resize(count);
+  _source.dirZ.resize(count);
+  for (unsigned int j = 0u; j < _height; ++j)
+  {
+    const double inclination = verticalAngleMin + j * verticalAngleStep;
+    for (unsigned int i = 0u; i < _width; ++i)
+    {
+      const double azimuth = angleMin + i * angleStep;
+      const math::Vector3d dir = _source.extrinsic.Rot().RotateVector(
+          math::Vector3d(std::cos(inclination) * std::cos(azimuth),
+                         std::cos(inclination) * std::sin(azimuth),
+                         std::sin(inclination)));
+      const std::size_t index = j * _width + i;
+      _source.dirX[index] = static_cast<float>(dir.X());
+      _source.dirY[index] = static_cast<float>(dir.Y());
+      _source.dirZ[index] = static_cast<float>(dir.Z());
+    }
+  }
+  _source.width = _width;
+  _source.height = _height;
+}
+}
+
+/// \brief Private data for LidarFusion
+class ignition::sensors::LidarFusionPrivate
+{
+  /// \brief Handle a scan of a lidar.
+  /// \param[in] _index Index of the lidar.
+  /// \param[in] _stamp Stamp of the scan.
+  /// \param[in] _scan Range, intensity and retro data of the scan.
+  /// \param[in] _width Number of columns of the scan.
+  /// \param[in] _height Number of rows of the scan.
+  public: void OnScan(std::size_t _index, const common::Time &_stamp,
+              const float *_scan, unsigned int _width, unsigned int _height);
+
+  /// \brief Transform the points of a scan into the common frame, and pack
+  /// the points that hit something.
+  /// \param[in] _index Index of the lidar.
+  /// \param[in] _scan Range, intensity and retro data of the scan.
+  public: void PackScan(std::size_t _index, const float *_scan);
+
+  /// \brief Merge and publish the latest scans if every lidar has a new
+  /// scan and their stamps are within the sync tolerance.
+  public: void TryMerge();
+
+  /// \brief Frame id of the merged clouds.
+  public: std::string frameId;
+
+  /// \brief Node to create the publisher.
+  public: transport::Node node;
+
+  /// \brief Publisher of the merged clouds.
+  public: transport::Node::Publisher pub;
+
+  /// \brief Merged cloud, reused between scans.
+  public: msgs::PointCloudPacked cloudMsg;
+
+  /// \brief The lidars, in the order they were added.
+  public: std::vector<FusionSource> sources;
+
+  /// \brief Largest difference between the stamps of merged scans.
+  public: common::Time syncTolerance;
+
+  /// \brief Stamp of the last merged cloud.
+  public: common::Time lastStamp;
+
+  /// \brief Number of clouds merged.
+  public: uint64_t cloudCount = 0u;
+
+  /// \brief Scratch coordinates of the scan being packed.
+  public: std::vector<float> scratchX, scratchY, scratchZ;
+
+  /// \brief Event called with each merged cloud.
+  public: common::EventT<void(const msgs::PointCloudPacked &)> cloudEvent;
+
+  /// \brief Guards all the members, scans may arrive from several threads.
+  public: std::mutex mutex;
+};
+
+//////////////////////////////////////////////////
+LidarFusion::LidarFusion(const std::string &_topic,
+    const std::string &_frameId)
+  : dataPtr(new LidarFusionPrivate())
+{
+  this->dataPtr->frameId = _frameId;
+  this->dataPtr->pub =
+      this->dataPtr->node.Advertise<msgs::PointCloudPacked>(_topic);
+  if (!this->dataPtr->pub)
+  {
+    ignerr << "Unable to create publisher on topic[" << _topic << "].\n";
+  }
+
+  msgs::InitPointCloudPacked(this->dataPtr->cloudMsg, _frameId, true,
+      {{"xyz", msgs::PointCloudPacked::Field::FLOAT32},
+      {"intensity", msgs::PointCloudPacked::Field::FLOAT32},
+      {"ring", msgs::PointCloudPacked::Field::UINT16},
+      {"source", msgs::PointCloudPacked::Field::UINT16}});
+}
+
+//////////////////////////////////////////////////
+LidarFusion::~LidarFusion()
+{
+  // Disconnect before the private data goes away, a scan may be in flight
+  std::vector<common::ConnectionPtr> connections;
+  {
+    std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+    for (auto &source : this->dataPtr->sources)
+      connections.push_back(std::move(source.connection));
+  }
+  connections.clear();
+}
+
+//////////////////////////////////////////////////
+int LidarFusion::AddLidar(Lidar *_lidar, const math::Pose3d &_extrinsic)
+{
+  if (!_lidar)
+  {
+    ignerr << "Unable to add a null lidar to the fusion.\n";
+    return -1;
+  }
+
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  for (const auto &source : this->dataPtr->sources)
+  {
+    if (source.lidar == _lidar)
+    {
+      ignerr << "Lidar [" << _lidar->Name()
+        << "] was already added to the fusion.\n";
+      return -1;
+    }
+  }
+
+  const std::size_t index = this->dataPtr->sources.size();
+  FusionSource source;
+  source.lidar = _lidar;
+  source.extrinsic = _extrinsic;
+  this->dataPtr->sources.push_back(std::move(source));
+
+  LidarFusionPrivate *data = this->dataPtr.get();
+  this->dataPtr->sources.back().connection = _lidar->ConnectScanCallback(
+      [data, index](const common::Time &_stamp, const float *_scan,
+          unsigned int _width, unsigned int _height)
+      {
+        data->OnScan(index, _stamp, _scan, _width, _height);
+      });
+  return static_cast<int>(index);
+}
+
+//////////////////////////////////////////////////
+int LidarFusion::AddLidar(Lidar *_lidar)
+{
+  if (!_lidar)
+  {
+    ignerr << "Unable to add a null lidar to the fusion.\n";
+    return -1;
+  }
+  return this->AddLidar(_lidar, _lidar->Pose());
+}
+
+//////////////////////////////////////////////////
+unsigned int LidarFusion::LidarCount() const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  return static_cast<unsigned int>(this->dataPtr->sources.size());
+}
+
+//////////////////////////////////////////////////
+void LidarFusion::SetSyncTolerance(const common::Time &_tolerance)
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  this->dataPtr->syncTolerance = _tolerance;
+}
+
+//////////////////////////////////////////////////
+common::Time LidarFusion::SyncTolerance() const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->syncTolerance;
+}
+
+//////////////////////////////////////////////////
+uint64_t LidarFusion::CloudCount() const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->cloudCount;
+}
+
+//////////////////////////////////////////////////
+common::ConnectionPtr LidarFusion::ConnectCloudCallback(
+    std::function<void(const msgs::PointCloudPacked &)> _callback)
+{
+  return this->dataPtr->cloudEvent.Connect(_callback);
+}
+
+//////////////////////////////////////////////////
+void LidarFusionPrivate::OnScan(std::size_t _index,
+    const common::Time &_stamp, const float *_scan, unsigned int _width,
+    unsigned int _height)
+{
+  IGN_SENSORS_PROFILE("LidarFusion::OnScan");
+  if (!_scan || _width == 0u || _height == 0u)
+    return;
+
+  std::lock_guard<std::mutex> lock(this->mutex);
+  if (_index >= this->sources.size())
+    return;
+
+  FusionSource &source = this->sources[_index];
+  if (source.width != _width || source.height != _height)
+    ComputeDirections(source, _width, _height);
+
+  this->PackScan(_index, _scan);
+  source.stamp = _stamp;
+  source.pending = true;
+  this->TryMerge();
+}
+
+//////////////////////////////////////////////////
+void LidarFusionPrivate::PackScan(std::size_t _index, const float *_scan)
+{
+  FusionSource &source = this->sources[_index];
+  const std::size_t count =
+      static_cast<std::size_t>(source.width) * source.height;
+  this->scratchX.resize(count);
+  this->scratchY.resize(count);
+  this->scratchZ.resize(count);
+
+  // Transform every ray first, the loop has no branches and vectorizes
+  const float tx = static_cast<float>(source.extrinsic.Pos().X());
+  const float ty = static_cast<float>(source.extrinsic.Pos().Y());
+  const float tz = static_cast<float>(source.extrinsic.Pos().Z());
+  const float *dirX = source.dirX.data();
+  const float *dirY = source.dirY.data();
+  const float *dirZ = source.dirZ.data();
+  float *x = this->scratchX.data();
+  float *y = this->scratchY.data();
+  float *z = this->scratchZ.data();
+  for (std::size_t k = 0u; k < count; ++k)
+  {
+    const float range = _scan[k * 3u];
+    x[k] = range * dirX[k] + tx;
+    y[k] = range * dirY[k] + ty;
+    z[k] = range * dirZ[k] + tz;
+  }
+
+  // Then pack the rays that hit something
+  const msgs::PointCloudPacked &msg = this->cloudMsg;
+  const uint32_t pointStep = msg.point_step();
+  const uint32_t xOffset = msg.field(0).offset();
+  const uint32_t yOffset = msg.field(1).offset();
+  const uint32_t zOffset = msg.field(2).offset();
+  const uint32_t intensityOffset = msg.field(3).offset();
+  const uint32_t ringOffset = msg.field(4).offset();
+  const uint32_t sourceOffset = msg.field(5).offset();
+  const uint16_t sourceId = static_cast<uint16_t>(_index);
+
+  source.points.resize(count * pointStep);
+  char *point = &source.points[0];
+  for (unsigned int j = 0u; j < source.height; ++j)
+  {
+    const uint16_t ring = static_cast<uint16_t>(j);
+    for (unsigned int i = 0u; i < source.width; ++i)
+    {
+      const std::size_t k = static_cast<std::size_t>(j) * source.width + i;
+      if (!std::isfinite(x[k]) || !std::isfinite(y[k]) ||
+          !std::isfinite(z[k]))
+      {
+        continue;
+      }
+      std::memcpy(point + xOffset, &x[k], sizeof(float));
+      std::memcpy(point + yOffset, &y[k], sizeof(float));
+      std::memcpy(point + zOffset, &z[k], sizeof(float));
+      std::memcpy(point + intensityOffset, &_scan[k * 3u + 1u],
+          sizeof(float));
+      std::memcpy(point + ringOffset, &ring, sizeof(uint16_t));
+      std::memcpy(point + sourceOffset, &sourceId, sizeof(uint16_t));
+      point += pointStep;
+    }
+  }
+  source.points.resize(point - &source.points[0]);
+}
+
+//////////////////////////////////////////////////
+void LidarFusionPrivate::TryMerge()
+{
+  common::Time oldest, newest;
+  bool first = true;
+  for (const auto &source : this->sources)
+  {
+    if (!source.pending)
+      return;
+    if (first || source.stamp < oldest)
+      oldest = source.stamp;
+    if (first || source.stamp > newest)
+      newest = source.stamp;
+    first = false;
+  }
+  if (first || newest - oldest > this->syncTolerance ||
+      (this->cloudCount > 0u && newest <= this->lastStamp))
+  {
+    return;
+  }
+
+  IGN_SENSORS_PROFILE("LidarFusion::Merge");
+  msgs::PointCloudPacked &msg = this->cloudMsg;
+  msg.mutable_header()->mutable_stamp()->set_sec(newest.sec);
+  msg.mutable_header()->mutable_stamp()->set_nsec(newest.nsec);
+  msg.mutable_header()->clear_data();
+  auto frame = msg.mutable_header()->add_data();
+  frame->set_key("frame_id");
+  frame->add_value(this->frameId);
+  auto seq = msg.mutable_header()->add_data();
+  seq->set_key("seq");
+  seq->add_value(std::to_string(this->cloudCount));
+
+  std::size_t bytes = 0u;
+  for (const auto &source : this->sources)
+    bytes += source.points.size();
+
+  std::string *data = msg.mutable_data();
+  data->resize(bytes);
+  std::size_t offset = 0u;
+  for (auto &source : this->sources)
+  {
+    if (!source.points.empty())
+      std::memcpy(&(*data)[offset], source.points.data(), source.points.size());
+    offset += source.points.size();
+    source.pending = false;
+  }
+
+  // Missed rays were dropped, so the cloud is unorganized and dense
+  msg.set_width(static_cast<uint32_t>(bytes / msg.point_step()));
+  msg.set_height(1u);
+  msg.set_row_step(static_cast<uint32_t>(bytes));
+  msg.set_is_dense(true);
+
+  this->lastStamp = newest;
+  ++this->cloudCount;
+
+  if (this->pub)
+    this->pub.Publish(msg);
+  this->cloudEvent(msg);
+}
@@ -17,6 +17,12 @@
 #include <gtest/gtest.h>
 #include <sdf/sdf.hh>
 
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include <ignition/math/Angle.hh>
 #include <ignition/math/Helpers.hh>
 #include <ignition/msgs.hh>
@@ -24,6 +30,8 @@
 #include <ignition/sensors/Manager.hh>
 
 #include <ignition/sensors/Lidar.hh>
+#include <ignition/sensors/LidarFusion.hh>
+#include <ignition/sensors/RayScene.hh>
 
 
 sdf::ElementPtr LidarToSDF(const std::string &name, double update_rate,
@@ -145,6 +153,479 @@ TEST(Lidar_TEST, CreateLaser)
   EXPECT_TRUE(sensor->IsActive());
 }
 
+/////////////////////////////////////////////////
+/// \brief Test a Lidar sensor casting rays on the CPU
+TEST(Lidar_TEST, CpuScan)
+{
+  ignition::sensors::Manager mgr;
+
+  const std::string name = "TestCpuLidar";
+  const std::string topic = "/ignition/sensors/test/cpu_lidar";
+  const unsigned int horzSamples = 101;
+  const unsigned int vertSamples = 5;
+  sdf::ElementPtr lidarSDF = LidarToSDF(name, 10, topic,
+    horzSamples, 1, -0.5, 0.5, vertSamples, 1, -0.2, 0.2,
+    0.01, 0.1, 10.0, true, false);
+
+  ignition::sensors::Lidar *sensor =
+      mgr.CreateSensor<ignition::sensors::Lidar>(lidarSDF);
+  ASSERT_NE(nullptr, sensor);
+
+  // Without a scene, there's no data source
+  EXPECT_FALSE(sensor->CreateLidar());
+  EXPECT_FALSE(sensor->Update(ignition::common::Time(0.1)));
+
+  // Wall 2m in front of the sensor
+  auto scene = std::make_shared<ignition::sensors::RayScene>();
+  auto wall = scene->AddBox(ignition::math::Vector3d(0.2, 10, 10),
+      ignition::math::Pose3d(2.1, 0, 0, 0, 0, 0));
+  scene->SetObjectRetro(wall, 0.5);
+  sensor->SetCpuScene(scene);
+  EXPECT_EQ(scene, sensor->CpuScene());
+
+  EXPECT_TRUE(sensor->Update(ignition::common::Time(0.1)));
+  ASSERT_NE(nullptr, sensor->laserBuffer);
+
+  // The rays, the laser buffer and the scan message are accounted for
+  ignition::sensors::SensorMemoryUsage usage = sensor->MemoryUsage();
+  EXPECT_LE(horzSamples * vertSamples * (3u * sizeof(float) +
+      sizeof(ignition::math::Vector3d)), usage.buffers);
+  EXPECT_LE(horzSamples * vertSamples * sizeof(double), usage.messages);
+  EXPECT_LT(0u, usage.config);
+  EXPECT_EQ(usage.Total(), mgr.MemoryUsage().Total());
+
+  std::vector<double> ranges;
+  sensor->Ranges(ranges);
+  ASSERT_EQ(horzSamples * vertSamples, ranges.size());
+  for (unsigned int j = 0; j < vertSamples; ++j)
+  {
+    double vAngle = -0.2 + j * 0.1;
+    for (unsigned int i = 0; i < horzSamples; ++i)
+    {
+      double hAngle = -0.5 + i * 0.01;
+      unsigned int index = j * horzSamples + i;
+      EXPECT_NEAR(2.0 / (std::cos(hAngle) * std::cos(vAngle)),
+          ranges[index], 1e-3);
+      EXPECT_FLOAT_EQ(0.5f, sensor->laserBuffer[index * 3 + 1]);
+    }
+  }
+
+  // Turn the sensor away from the wall, rays don't hit anything
+  sensor->SetPose(ignition::math::Pose3d(0, 0, 0, 0, 0, IGN_PI));
+  EXPECT_TRUE(sensor->Update(ignition::common::Time(0.2)));
+  EXPECT_TRUE(std::isinf(sensor->Range(horzSamples / 2)));
+
+  // Move the wall behind the sensor, only its pose changes
+  scene->SetObjectPose(wall, ignition::math::Pose3d(-3.1, 0, 0, 0, 0, 0));
+  EXPECT_TRUE(sensor->Update(ignition::common::Time(0.3)));
+  EXPECT_NEAR(3.0, sensor->Range(2 * horzSamples + horzSamples / 2), 1e-3);
+}
+
+/// \brief Keeps the packets and counts the scans produced by a lidar.
+class PacketSink : public ignition::sensors::MessageSink
+{
+  // Documentation inherited
+  public: void Add(const ignition::sensors::Sensor &,
+              const google::protobuf::Message &_msg) override
+  {
+    auto packet =
+        dynamic_cast<const ignition::msgs::PointCloudPacked *>(&_msg);
+    if (packet)
+    {
+      // Packets are published before the scan
+      EXPECT_EQ(this->scans, 0u);
+      this->packets.push_back(*packet);
+    }
+    else
+    {
+      ++this->scans;
+    }
+  }
+
+  // Documentation inherited
+  public: bool HasConnections() const override
+  {
+    return true;
+  }
+
+  /// \brief Packets received.
+  public: std::vector<ignition::msgs::PointCloudPacked> packets;
+
+  /// \brief Number of scans received.
+  public: unsigned int scans = 0u;
+};
+
+/////////////////////////////////////////////////
+TEST(Lidar_TEST, Packets)
+{
+  ignition::sensors::Manager mgr;
+
+  const unsigned int horzSamples = 101;
+  const unsigned int vertSamples = 5;
+  sdf::ElementPtr lidarSDF = LidarToSDF("TestPacketLidar", 10,
+    "/ignition/sensors/test/packet_lidar", horzSamples, 1, -0.5, 0.5,
+    vertSamples, 1, -0.2, 0.2, 0.01, 0.1, 10.0, true, false);
+
+  ignition::sensors::Lidar *sensor =
+      mgr.CreateSensor<ignition::sensors::Lidar>(lidarSDF);
+  ASSERT_NE(nullptr, sensor);
+  EXPECT_EQ(0u, sensor->PacketCount());
+  EXPECT_DOUBLE_EQ(0.0, sensor->SweepTime());
+
+  auto scene = std::make_shared<ignition::sensors::RayScene>();
+  scene->AddBox(ignition::math::Vector3d(0.2, 10, 10),
+      ignition::math::Pose3d(2.1, 0, 0, 0, 0, 0));
+  sensor->SetCpuScene(scene);
+
+  PacketSink sink;
+  sensor->SetMessageSink(&sink);
+
+  // Without packets, only the scan is produced
+  EXPECT_TRUE(sensor->Update(ignition::common::Time(0.1)));
+  EXPECT_TRUE(sink.packets.empty());
+  EXPECT_EQ(1u, sink.scans);
+
+  sensor->SetPacketCount(4u);
+  sensor->SetSweepTime(0.05);
+  EXPECT_EQ(4u, sensor->PacketCount());
+  EXPECT_DOUBLE_EQ(0.05, sensor->SweepTime());
+  sink.scans = 0u;
+  sensor->SetPose(ignition::math::Pose3d(0, 0, 0.01, 0, 0, 0));
+  EXPECT_TRUE(sensor->Update(ignition::common::Time(0.2)));
+  ASSERT_EQ(4u, sink.packets.size());
+  EXPECT_EQ(1u, sink.scans);
+
+  std::vector<double> ranges;
+  sensor->Ranges(ranges);
+  ASSERT_EQ(horzSamples * vertSamples, ranges.size());
+
+  // The packets split the columns of the scan, and hold all rings
+  unsigned int column = 0u;
+  for (unsigned int p = 0u; p < sink.packets.size(); ++p)
+  {
+    const ignition::msgs::PointCloudPacked &packet = sink.packets[p];
+    EXPECT_DOUBLE_EQ(0.2,
+        ignition::msgs::Convert(packet.header().stamp()).Double());
+    ASSERT_EQ(3, packet.header().data_size());
+    EXPECT_EQ("packet", packet.header().data(1).key());
+    EXPECT_EQ(std::to_string(p), packet.header().data(1).value(0));
+    EXPECT_EQ(vertSamples, packet.height());
+    EXPECT_FALSE(packet.is_dense());
+    ASSERT_EQ(6, packet.field_size());
+    EXPECT_EQ("time", packet.field(5).name());
+    ASSERT_EQ(packet.row_step() * packet.height(), packet.data().size());
+
+    for (unsigned int j = 0u; j < packet.height(); ++j)
+    {
+      for (unsigned int i = 0u; i < packet.width(); ++i)
+      {
+        const char *point = packet.data().data() + j * packet.row_step() +
+            i * packet.point_step();
+        auto value = [&](int _field)
+        {
+          return *reinterpret_cast<const float *>(
+              point + packet.field(_field).offset());
+        };
+        ignition::math::Vector3d xyz(value(0), value(1), value(2));
+        EXPECT_NEAR(ranges[j * horzSamples + column + i], xyz.Length(),
+            1e-4);
+        EXPECT_NEAR(2.0, xyz.X(), 1e-4);
+        EXPECT_EQ(j, *reinterpret_cast<const uint16_t *>(
+            point + packet.field(4).offset()));
+        EXPECT_NEAR(0.05 * (column + i) / horzSamples, value(5), 1e-6);
+      }
+    }
+    column += packet.width();
+  }
+  EXPECT_EQ(horzSamples, column);
+
+  // Packets aren't produced without a consumer
+  sensor->SetMessageSink(nullptr);
+  sink.packets.clear();
+  EXPECT_TRUE(sensor->Update(ignition::common::Time(0.3)));
+  EXPECT_TRUE(sink.packets.empty());
+}
+
+/// \brief Lidar that produces whole scans, as GpuLidarSensor does.
+class WholeScanLidar : public ignition::sensors::Lidar
+{
+  // Documentation inherited
+  protected: bool SupportsPackets() const override
+  {
+    return false;
+  }
+};
+
+/////////////////////////////////////////////////
+TEST(Lidar_TEST, PacketsUnsupported)
+{
+  WholeScanLidar sensor;
+  sensor.SetPacketCount(4u);
+  EXPECT_EQ(0u, sensor.PacketCount());
+}
+
+/////////////////////////////////////////////////
+TEST(Lidar_TEST, Fusion)
+{
+  ignition::sensors::Manager mgr;
+
+  const unsigned int horzSamples = 21;
+  const unsigned int vertSamples = 3;
+  ignition::sensors::Lidar *front = mgr.CreateSensor<ignition::sensors::Lidar>(
+      LidarToSDF("TestFusionFront", 10, "/ignition/sensors/test/fusion_front",
+      horzSamples, 1, -0.5, 0.5, vertSamples, 1, -0.2, 0.2, 0.01, 0.1, 10.0,
+      true, false));
+  ignition::sensors::Lidar *top = mgr.CreateSensor<ignition::sensors::Lidar>(
+      LidarToSDF("TestFusionTop", 10, "/ignition/sensors/test/fusion_top",
+      horzSamples, 1, -0.5, 0.5, vertSamples, 1, -0.2, 0.2, 0.01, 0.1, 10.0,
+      true, false));
+  ASSERT_NE(nullptr, front);
+  ASSERT_NE(nullptr, top);
+
+  // Wall 2m in front of the vehicle, seen by both lidars
+  auto scene = std::make_shared<ignition::sensors::RayScene>();
+  scene->AddBox(ignition::math::Vector3d(0.2, 10, 10),
+      ignition::math::Pose3d(2.1, 0, 0, 0, 0, 0));
+  front->SetCpuScene(scene);
+  top->SetCpuScene(scene);
+  const ignition::math::Pose3d topPose(0.5, 0, 0.8, 0, 0, 0.2);
+  top->SetPose(topPose);
+
+  ignition::sensors::LidarFusion fusion("/ignition/sensors/test/fusion",
+      "base_link");
+  EXPECT_EQ(0, fusion.AddLidar(front, ignition::math::Pose3d::Zero));
+  EXPECT_EQ(1, fusion.AddLidar(top));
+  EXPECT_EQ(-1, fusion.AddLidar(top));
+  EXPECT_EQ(-1, fusion.AddLidar(nullptr));
+  EXPECT_EQ(2u, fusion.LidarCount());
+
+  std::vector<ignition::msgs::PointCloudPacked> clouds;
+  auto connection = fusion.ConnectCloudCallback(
+      [&clouds](const ignition::msgs::PointCloudPacked &_msg)
+      {
+        clouds.push_back(_msg);
+      });
+
+  // A cloud is merged once both lidars have a scan
+  EXPECT_TRUE(front->Update(ignition::common::Time(0.1)));
+  EXPECT_TRUE(clouds.empty());
+  EXPECT_TRUE(top->Update(ignition::common::Time(0.1)));
+  ASSERT_EQ(1u, clouds.size());
+  EXPECT_EQ(1u, fusion.CloudCount());
+
+  const ignition::msgs::PointCloudPacked &cloud = clouds[0];
+  EXPECT_DOUBLE_EQ(0.1,
+      ignition::msgs::Convert(cloud.header().stamp()).Double());
+  EXPECT_EQ("base_link", cloud.header().data(0).value(0));
+  EXPECT_EQ(1u, cloud.height());
+  EXPECT_TRUE(cloud.is_dense());
+  EXPECT_EQ(2u * horzSamples * vertSamples, cloud.width());
+  ASSERT_EQ(6, cloud.field_size());
+  EXPECT_EQ("source", cloud.field(5).name());
+  ASSERT_EQ(cloud.point_step() * cloud.width(), cloud.data().size());
+
+  // Points of both lidars lie on the wall in the vehicle frame
+  unsigned int fromTop = 0u;
+  for (unsigned int i = 0u; i < cloud.width(); ++i)
+  {
+    const char *point = cloud.data().data() + i * cloud.point_step();
+    EXPECT_NEAR(2.0, *reinterpret_cast<const float *>(
+        point + cloud.field(0).offset()), 1e-4);
+    if (*reinterpret_cast<const uint16_t *>(
+        point + cloud.field(5).offset()) == 1u)
+    {
+      ++fromTop;
+    }
+  }
+  EXPECT_EQ(horzSamples * vertSamples, fromTop);
+
+  // Scans further apart than the tolerance aren't merged
+  top->SetPose(ignition::math::Pose3d(topPose.Pos(),
+      ignition::math::Quaterniond(0, 0, IGN_PI)));
+  EXPECT_TRUE(top->Update(ignition::common::Time(0.2)));
+  EXPECT_TRUE(front->Update(ignition::common::Time(0.25)));
+  EXPECT_EQ(1u, clouds.size());
+
+  // Rays that miss are dropped
+  fusion.SetSyncTolerance(ignition::common::Time(0.1));
+  EXPECT_EQ(ignition::common::Time(0.1), fusion.SyncTolerance());
+  EXPECT_TRUE(front->Update(ignition::common::Time(0.3)));
+  ASSERT_EQ(2u, clouds.size());
+  EXPECT_DOUBLE_EQ(0.3,
+      ignition::msgs::Convert(clouds[1].header().stamp()).Double());
+  EXPECT_EQ(horzSamples * vertSamples, clouds[1].width());
+}
+
+/// \brief Keeps the images produced by a lidar.
+class ImageSink : public ignition::sensors::MessageSink
+{
+  // Documentation inherited
+  public: void Add(const ignition::sensors::Sensor &,
+              const google::protobuf::Message &_msg) override
+  {
+    auto image = dynamic_cast<const ignition::msgs::Image *>(&_msg);
+    if (image)
+      this->images.push_back(*image);
+  }
+
+  // Documentation inherited
+  public: bool HasConnections() const override
+  {
+    return true;
+  }
+
+  /// \brief Images received.
+  public: std::vector<ignition::msgs::Image> images;
+};
+
+/////////////////////////////////////////////////
+TEST(Lidar_TEST, RangeImage)
+{
+  ignition::sensors::Manager mgr;
+
+  const unsigned int horzSamples = 11;
+  const unsigned int vertSamples = 3;
+  sdf::ElementPtr lidarSDF = LidarToSDF("TestRangeImageLidar", 10,
+    "/ignition/sensors/test/range_image_lidar", horzSamples, 1, -0.5, 0.5,
+    vertSamples, 1, -0.2, 0.2, 0.01, 0.1, 10.0, true, false);
+
+  ignition::sensors::Lidar *sensor =
+      mgr.CreateSensor<ignition::sensors::Lidar>(lidarSDF);
+  ASSERT_NE(nullptr, sensor);
+  EXPECT_FALSE(sensor->RangeImageEnabled());
+  EXPECT_DOUBLE_EQ(0.0, sensor->RangeImageQuantization());
+
+  auto scene = std::make_shared<ignition::sensors::RayScene>();
+  auto wall = scene->AddBox(ignition::math::Vector3d(0.2, 10, 10),
+      ignition::math::Pose3d(2.1, 0, 0, 0, 0, 0));
+  scene->SetObjectRetro(wall, 0.5);
+  sensor->SetCpuScene(scene);
+
+  ImageSink sink;
+  sensor->SetMessageSink(&sink);
+
+  // Images are disabled by default
+  EXPECT_TRUE(sensor->Update(ignition::common::Time(0.1)));
+  EXPECT_TRUE(sink.images.empty());
+
+  // Range and intensity images have a row per ring
+  sensor->SetRangeImageEnabled(true);
+  EXPECT_TRUE(sensor->RangeImageEnabled());
+  EXPECT_TRUE(sensor->Update(ignition::common::Time(0.2)));
+  ASSERT_EQ(2u, sink.images.size());
+
+  std::vector<double> ranges;
+  sensor->Ranges(ranges);
+  ASSERT_EQ(horzSamples * vertSamples, ranges.size());
+  for (const auto &image : sink.images)
+  {
+    EXPECT_EQ(horzSamples, image.width());
+    EXPECT_EQ(vertSamples, image.height());
+    EXPECT_EQ(horzSamples * sizeof(float), image.step());
+    EXPECT_EQ(ignition::msgs::PixelFormatType::R_FLOAT32,
+        image.pixel_format_type());
+    ASSERT_EQ(image.step() * image.height(), image.data().size());
+    EXPECT_DOUBLE_EQ(0.2,
+        ignition::msgs::Convert(image.header().stamp()).Double());
+  }
+  const float *rangeData =
+      reinterpret_cast<const float *>(sink.images[0].data().data());
+  const float *intensityData =
+      reinterpret_cast<const float *>(sink.images[1].data().data());
+  for (unsigned int k = 0u; k < ranges.size(); ++k)
+  {
+    EXPECT_FLOAT_EQ(static_cast<float>(ranges[k]), rangeData[k]);
+    EXPECT_FLOAT_EQ(0.5f, intensityData[k]);
+  }
+
+  // Quantized ranges, in millimeters
+  sensor->SetRangeImageQuantization(0.001);
+  EXPECT_DOUBLE_EQ(0.001, sensor->RangeImageQuantization());
+  sink.images.clear();
+  sensor->SetPose(ignition::math::Pose3d(0, 0, 0.01, 0, 0, 0));
+  EXPECT_TRUE(sensor->Update(ignition::common::Time(0.3)));
+  ASSERT_EQ(2u, sink.images.size());
+  const ignition::msgs::Image &quantized = sink.images[0];
+  EXPECT_EQ(ignition::msgs::PixelFormatType::L_INT16,
+      quantized.pixel_format_type());
+  EXPECT_EQ(horzSamples * sizeof(uint16_t), quantized.step());
+  ASSERT_EQ(quantized.step() * quantized.height(), quantized.data().size());
+  sensor->Ranges(ranges);
+  const uint16_t *millimeters =
+      reinterpret_cast<const uint16_t *>(quantized.data().data());
+  for (unsigned int k = 0u; k < ranges.size(); ++k)
+    EXPECT_NEAR(ranges[k] * 1000.0, millimeters[k], 0.5);
+
+  // Rays without a return are zero
+  sink.images.clear();
+  sensor->SetPose(ignition::math::Pose3d(0, 0, 0, 0, 0, IGN_PI));
+  EXPECT_TRUE(sensor->Update(ignition::common::Time(0.4)));
+  ASSERT_EQ(2u, sink.images.size());
+  millimeters =
+      reinterpret_cast<const uint16_t *>(sink.images[0].data().data());
+  for (unsigned int k = 0u; k < ranges.size(); ++k)
+    EXPECT_EQ(0u, millimeters[k]);
+}
+
+/// \brief Lidar that exposes the upsampling of scans.
+class UpsampleLidar : public ignition::sensors::Lidar
+{
+  public: using ignition::sensors::Lidar::UpsampleScan;
+};
+
+/////////////////////////////////////////////////
+TEST(Lidar_TEST, Upsample)
+{
+  UpsampleLidar lidar;
+  EXPECT_DOUBLE_EQ(0.1, lidar.UpsampleEdgeThreshold());
+
+  // Two rows of three rays, with an edge before the last column and a
+  // miss in the last ray
+  const float inf = ignition::math::INF_F;
+  const float rays[] = {
+      2.0f, 10.0f, 0.0f,  2.1f, 20.0f, 0.0f,  5.0f, 50.0f, 0.0f,
+      2.05f, 10.0f, 0.0f,  2.15f, 20.0f, 0.0f,  inf, 0.0f, 0.0f};
+  std::vector<float> ranges(7u * 3u * 3u);
+  EXPECT_FALSE(lidar.UpsampleScan(nullptr, 3u, 2u, ranges.data(), 7u, 3u));
+  EXPECT_FALSE(lidar.UpsampleScan(rays, 3u, 2u, ranges.data(), 0u, 3u));
+  ASSERT_TRUE(lidar.UpsampleScan(rays, 3u, 2u, ranges.data(), 7u, 3u));
+  auto range = [&](unsigned int _i, unsigned int _j, unsigned int _c = 0u)
+  {
+    return ranges[(_j * 7u + _i) * 3u + _c];
+  };
+
+  // The first and last rays keep their place
+  EXPECT_FLOAT_EQ(2.0f, range(0u, 0u));
+  EXPECT_FLOAT_EQ(5.0f, range(6u, 0u));
+  EXPECT_FLOAT_EQ(2.05f, range(0u, 2u));
+  EXPECT_TRUE(std::isinf(range(6u, 2u)));
+
+  // Ranges are interpolated on smooth surfaces, with their intensities
+  EXPECT_FLOAT_EQ(2.0f + 0.1f / 3.0f, range(1u, 0u));
+  EXPECT_FLOAT_EQ(10.0f + 10.0f / 3.0f, range(1u, 0u, 1u));
+  EXPECT_FLOAT_EQ(2.025f, range(0u, 1u));
+  EXPECT_FLOAT_EQ(2.025f + 0.1f / 3.0f, range(1u, 1u));
+
+  // but not across the edge or the miss, the nearest ray is used
+  EXPECT_FLOAT_EQ(2.1f, range(4u, 0u));
+  EXPECT_FLOAT_EQ(20.0f, range(4u, 0u, 1u));
+  EXPECT_FLOAT_EQ(5.0f, range(5u, 0u));
+  EXPECT_FLOAT_EQ(2.15f, range(4u, 2u));
+  EXPECT_TRUE(std::isinf(range(5u, 2u)));
+  for (float value : ranges)
+    EXPECT_FALSE(std::isnan(value));
+
+  // Without a threshold, the nearest ray is always used
+  lidar.SetUpsampleEdgeThreshold(0.0);
+  ASSERT_TRUE(lidar.UpsampleScan(rays, 3u, 2u, ranges.data(), 7u, 3u));
+  EXPECT_FLOAT_EQ(2.0f, range(1u, 0u));
+
+  // Scans that aren't upsampled are copied
+  std::vector<float> copy(6u * 3u);
+  ASSERT_TRUE(lidar.UpsampleScan(rays, 3u, 2u, copy.data(), 3u, 2u));
+  EXPECT_TRUE(std::equal(copy.begin(), copy.end(), rays));
+}
+
 //////////////////////////////////////////////////
 int main(int argc, char **argv)
 {
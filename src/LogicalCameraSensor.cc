@@ -15,10 +15,15 @@
  *
 */
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <ignition/common/Console.hh>
-#include <ignition/common/Profiler.hh>
 
 #include <ignition/transport/Node.hh>
 
@@ -27,13 +32,72 @@
 
 #include "ignition/sensors/SensorFactory.hh"
 #include "ignition/sensors/LogicalCameraSensor.hh"
+#include "ignition/sensors/Tracing.hh"
+
+#include "MemoryUsage.hh"
 
 using namespace ignition;
 using namespace sensors;
 
+namespace
+{
+  /// \brief Radical inverse of an integer, used to spread sample points
+  /// evenly in a box.
+  /// \param[in] _index Sample index.
+  /// \param[in] _base Prime base.
+  /// \return Value in [0, 1).
+  double Halton(unsigned int _index, unsigned int _base)
+  {
+    double result = 0.0;
+    double f = 1.0 / _base;
+    for (unsigned int i = _index; i > 0; i /= _base)
+    {
+      result += f * (i % _base);
+      f /= _base;
+    }
+    return result;
+  }
+
+  /// \brief Get the distance at which a ray leaves a box.
+  /// \param[in] _origin Ray origin.
+  /// \param[in] _dir Unit ray direction.
+  /// \param[in] _box Box the ray passes through.
+  /// \return Exit distance.
+  double BoxExit(const math::Vector3d &_origin, const math::Vector3d &_dir,
+      const math::AxisAlignedBox &_box)
+  {
+    double exit = std::numeric_limits<double>::infinity();
+    for (int i = 0; i < 3; ++i)
+    {
+      if (std::fabs(_dir[i]) < 1e-12)
+        continue;
+      const double t0 = (_box.Min()[i] - _origin[i]) / _dir[i];
+      const double t1 = (_box.Max()[i] - _origin[i]) / _dir[i];
+      exit = std::min(exit, std::max(t0, t1));
+    }
+    return exit;
+  }
+}
+
 /// \brief Private data for LogicalCameraSensor
 class ignition::sensors::LogicalCameraSensorPrivate
 {
+  /// \brief Add a detected model to the message.
+  /// \param[in] _name Name of the model.
+  /// \param[in] _pose Pose of the model in the sensor frame.
+  /// \param[in] _fraction Visible fraction of the model.
+  public: void AddModel(const std::string &_name, const math::Pose3d &_pose,
+              double _fraction);
+
+  /// \brief Detect models by their origin.
+  /// \param[in] _pose Sensor world pose.
+  public: void DetectOrigins(const math::Pose3d &_pose);
+
+  /// \brief Detect models by their bounds and cast rays to test whether
+  /// they are occluded.
+  /// \param[in] _pose Sensor world pose.
+  public: void DetectVisible(const math::Pose3d &_pose);
+
   /// \brief node to create publisher
   public: transport::Node node;
 
@@ -57,8 +121,162 @@ class ignition::sensors::LogicalCameraSensorPrivate
 
   /// \brief Msg containg info on models detected by logical camera
   ignition::msgs::LogicalCameraImage msg;
+
+  /// \brief Scene used to test occlusion.
+  public: RayScenePtr scene;
+
+  /// \brief Scene objects of each model.
+  public: std::map<std::string, std::vector<RayObjectId>> modelObjects;
+
+  /// \brief True if occlusion testing is enabled.
+  public: bool occlusion = false;
+
+  /// \brief Number of rays cast towards each model.
+  public: unsigned int samples = 32u;
+
+  /// \brief Visible fraction a model needs to be detected.
+  public: double minFraction = 0.0;
+
+  /// \brief Visible fraction of the detected models.
+  public: std::map<std::string, double> fractions;
+
+  /// \brief Ray directions of all models, reused between updates.
+  public: std::vector<math::Vector3d> directions;
+
+  /// \brief Whether each ray goes through the frustum.
+  public: std::vector<char> inFrustum;
+
+  /// \brief Ray cast results.
+  public: std::vector<RayHit> hits;
 };
 
+//////////////////////////////////////////////////
+void LogicalCameraSensorPrivate::AddModel(const std::string &_name,
+    const math::Pose3d &_pose, double _fraction)
+{
+  msgs::LogicalCameraImage::Model *modelMsg = this->msg.add_model();
+  modelMsg->set_name(_name);
+  msgs::Set(modelMsg->mutable_pose(), _pose);
+  this->fractions[_name] = _fraction;
+}
+
+//////////////////////////////////////////////////
+void LogicalCameraSensorPrivate::DetectOrigins(const math::Pose3d &_pose)
+{
+  for (const auto &it : this->models)
+  {
+    if (this->frustum.Contains(it.second.Pos()))
+      this->AddModel(it.first, it.second - _pose, 1.0);
+  }
+}
+
+//////////////////////////////////////////////////
+void LogicalCameraSensorPrivate::DetectVisible(const math::Pose3d &_pose)
+{
+  IGN_SENSORS_PROFILE("LogicalCameraSensor::DetectVisible");
+
+  /// \brief A model whose bounds overlap the frustum
+  struct Candidate
+  {
+    /// \brief Model name and world pose.
+    std::map<std::string, math::Pose3d>::const_iterator model;
+
+    /// \brief World bounds.
+    math::AxisAlignedBox box;
+  };
+  std::vector<Candidate> candidates;
+  std::unordered_map<RayObjectId, std::size_t> owners;
+
+  const math::Vector3d origin = _pose.Pos();
+  double maxRange = 0.0;
+  this->directions.clear();
+  this->inFrustum.clear();
+  for (auto it = this->models.cbegin(); it != this->models.cend(); ++it)
+  {
+    auto objects = this->modelObjects.find(it->first);
+    if (objects == this->modelObjects.end() || objects->second.empty())
+    {
+      if (this->frustum.Contains(it->second.Pos()))
+        this->AddModel(it->first, it->second - _pose, 1.0);
+      continue;
+    }
+
+    math::AxisAlignedBox box;
+    for (RayObjectId id : objects->second)
+    {
+      const math::AxisAlignedBox objectBox =
+          this->scene->ObjectBoundingBox(id);
+      box.Min().Min(objectBox.Min());
+      box.Max().Max(objectBox.Max());
+    }
+    if (box.Min().X() > box.Max().X() || !this->frustum.Contains(box))
+      continue;
+
+    for (RayObjectId id : objects->second)
+      owners[id] = candidates.size();
+    candidates.push_back({it, box});
+
+    // Aim rays at points spread through the bounds
+    const math::Vector3d size = box.Max() - box.Min();
+    for (unsigned int i = 1; i <= this->samples; ++i)
+    {
+      const math::Vector3d point = box.Min() + size * math::Vector3d(
+          Halton(i, 2u), Halton(i, 3u), Halton(i, 5u));
+      math::Vector3d dir = point - origin;
+      const double length = dir.Length();
+      if (length > 0.0)
+        dir = dir / length;
+      else
+        dir = math::Vector3d::UnitX;
+      this->directions.push_back(dir);
+      this->inFrustum.push_back(this->frustum.Contains(point) ? 1 : 0);
+    }
+    maxRange = std::max(maxRange,
+        (box.Center() - origin).Length() + 0.5 * size.Length());
+  }
+
+  if (candidates.empty())
+    return;
+
+  // One batch for all models keeps the scene's worker threads busy
+  this->scene->CastRays(math::Pose3d(origin, math::Quaterniond::Identity),
+      this->directions, 0.0, maxRange, this->hits);
+
+  for (std::size_t c = 0; c < candidates.size(); ++c)
+  {
+    unsigned int visible = 0u;
+    unsigned int blocked = 0u;
+    for (std::size_t r = c * this->samples; r < (c + 1) * this->samples; ++r)
+    {
+      const RayHit &hit = this->hits[r];
+      auto owner = owners.find(hit.object);
+      if (owner != owners.end() && owner->second == c)
+      {
+        if (this->inFrustum[r])
+          ++visible;
+        else
+          ++blocked;
+      }
+      else if (hit.object != NO_RAY_OBJECT &&
+          hit.range < BoxExit(origin, this->directions[r], candidates[c].box))
+      {
+        // Something in front of the model, or inside its bounds
+        ++blocked;
+      }
+      // Otherwise the ray went past the model and tells us nothing
+    }
+
+    if (visible == 0u)
+      continue;
+    const double fraction = static_cast<double>(visible) / (visible + blocked);
+    if (fraction >= this->minFraction)
+    {
+      this->AddModel(candidates[c].model->first,
+          candidates[c].model->second - _pose, fraction);
+    }
+  }
+}
+
 //////////////////////////////////////////////////
 LogicalCameraSensor::LogicalCameraSensor()
   : dataPtr(new LogicalCameraSensorPrivate())
@@ -131,7 +349,7 @@ void LogicalCameraSensor::SetModelPoses(
 //////////////////////////////////////////////////
 bool LogicalCameraSensor::Update(const ignition::common::Time &_now)
 {
-  IGN_PROFILE("LogicalCameraSensor::Update");
+  IGN_SENSORS_PROFILE_SENSOR("LogicalCameraSensor::Update", this->Id());
   if (!this->dataPtr->initialized)
   {
     ignerr << "Not initialized, update ignored.\n";
@@ -146,16 +364,12 @@ bool LogicalCameraSensor::Update(const ignition::common::Time &_now)
   this->dataPtr->frustum.SetPose(this->Pose());
 
   this->dataPtr->msg.clear_model();
-  for (const auto &it : this->dataPtr->models)
-  {
-    if (this->dataPtr->frustum.Contains(it.second.Pos()))
-    {
-      msgs::LogicalCameraImage::Model *modelMsg =
-          this->dataPtr->msg.add_model();
-      modelMsg->set_name(it.first);
-      msgs::Set(modelMsg->mutable_pose(), it.second - this->Pose());
-    }
-  }
+  this->dataPtr->fractions.clear();
+  const bool occlusion = this->dataPtr->occlusion && this->dataPtr->scene;
+  if (occlusion)
+    this->dataPtr->DetectVisible(this->Pose());
+  else
+    this->dataPtr->DetectOrigins(this->Pose());
 
   this->dataPtr->msg.mutable_header()->mutable_stamp()->set_sec(_now.sec);
   this->dataPtr->msg.mutable_header()->mutable_stamp()->set_nsec(_now.nsec);
@@ -164,14 +378,120 @@ bool LogicalCameraSensor::Update(const ignition::common::Time &_now)
   auto frame = this->dataPtr->msg.mutable_header()->add_data();
   frame->set_key("frame_id");
   frame->add_value(this->Name());
+  if (occlusion)
+  {
+    auto visible = this->dataPtr->msg.mutable_header()->add_data();
+    visible->set_key("visible_fraction");
+    for (const auto &model : this->dataPtr->msg.model())
+    {
+      visible->add_value(
+          std::to_string(this->dataPtr->fractions[model.name()]));
+    }
+  }
 
   // publish
   this->AddSequence(this->dataPtr->msg.mutable_header());
-  this->dataPtr->pub.Publish(this->dataPtr->msg);
+  this->Publish(this->dataPtr->pub, this->dataPtr->msg);
 
   return true;
 }
 
+//////////////////////////////////////////////////
+bool LogicalCameraSensor::HasSubscribers() const
+{
+  return this->HasConnections(this->dataPtr->pub);
+}
+
+//////////////////////////////////////////////////
+SensorMemoryUsage LogicalCameraSensor::MemoryUsage() const
+{
+  SensorMemoryUsage usage = this->Sensor::MemoryUsage();
+
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  usage.buffers += memory::Bytes(this->dataPtr->models) +
+      memory::Bytes(this->dataPtr->modelObjects) +
+      memory::Bytes(this->dataPtr->fractions) +
+      memory::Bytes(this->dataPtr->directions) +
+      memory::Bytes(this->dataPtr->inFrustum) +
+      memory::Bytes(this->dataPtr->hits);
+  for (const auto &objects : this->dataPtr->modelObjects)
+    usage.buffers += memory::Bytes(objects.second);
+  usage.messages += memory::Bytes(this->dataPtr->msg);
+  return usage;
+}
+
+//////////////////////////////////////////////////
+void LogicalCameraSensor::SetCpuScene(RayScenePtr _scene)
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  this->dataPtr->scene = _scene;
+}
+
+//////////////////////////////////////////////////
+RayScenePtr LogicalCameraSensor::CpuScene() const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->scene;
+}
+
+//////////////////////////////////////////////////
+void LogicalCameraSensor::SetModelObjects(
+    std::map<std::string, std::vector<RayObjectId>> &&_objects)
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  this->dataPtr->modelObjects = std::move(_objects);
+}
+
+//////////////////////////////////////////////////
+void LogicalCameraSensor::SetOcclusionEnabled(bool _enabled)
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  this->dataPtr->occlusion = _enabled;
+}
+
+//////////////////////////////////////////////////
+bool LogicalCameraSensor::OcclusionEnabled() const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->occlusion;
+}
+
+//////////////////////////////////////////////////
+void LogicalCameraSensor::SetOcclusionSamples(unsigned int _samples)
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  this->dataPtr->samples = std::max(1u, _samples);
+}
+
+//////////////////////////////////////////////////
+unsigned int LogicalCameraSensor::OcclusionSamples() const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->samples;
+}
+
+//////////////////////////////////////////////////
+void LogicalCameraSensor::SetMinVisibleFraction(double _fraction)
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  this->dataPtr->minFraction = math::clamp(_fraction, 0.0, 1.0);
+}
+
+//////////////////////////////////////////////////
+double LogicalCameraSensor::MinVisibleFraction() const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->minFraction;
+}
+
+//////////////////////////////////////////////////
+double LogicalCameraSensor::VisibleFraction(const std::string &_name) const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  auto it = this->dataPtr->fractions.find(_name);
+  return it == this->dataPtr->fractions.end() ? 0.0 : it->second;
+}
+
 //////////////////////////////////////////////////
 double LogicalCameraSensor::Near() const
 {
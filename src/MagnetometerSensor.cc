@@ -16,7 +16,6 @@
 */
 
 #include <ignition/msgs/magnetometer.pb.h>
-#include <ignition/common/Profiler.hh>
 #include <ignition/transport/Node.hh>
 #include <sdf/Magnetometer.hh>
 
@@ -24,6 +23,9 @@
 #include "ignition/sensors/SensorFactory.hh"
 #include "ignition/sensors/SensorTypes.hh"
 #include "ignition/sensors/MagnetometerSensor.hh"
+#include "ignition/sensors/Tracing.hh"
+
+#include "StateStream.hh"
 
 using namespace ignition;
 using namespace sensors;
@@ -139,7 +141,7 @@ bool MagnetometerSensor::Load(sdf::ElementPtr _sdf)
 //////////////////////////////////////////////////
 bool MagnetometerSensor::Update(const ignition::common::Time &_now)
 {
-  IGN_PROFILE("MagnetometerSensor::Update");
+  IGN_SENSORS_PROFILE_SENSOR("MagnetometerSensor::Update", this->Id());
   if (!this->dataPtr->initialized)
   {
     ignerr << "Not initialized, update ignored.\n";
@@ -151,7 +153,7 @@ bool MagnetometerSensor::Update(const ignition::common::Time &_now)
       this->dataPtr->worldPose.Rot().Inverse().RotateVector(
       this->dataPtr->worldField);
 
-  msgs::Magnetometer msg;
+  auto &msg = this->FrameMessage<msgs::Magnetometer>();
   msg.mutable_header()->mutable_stamp()->set_sec(_now.sec);
   msg.mutable_header()->mutable_stamp()->set_nsec(_now.nsec);
   auto frame = msg.mutable_header()->add_data();
@@ -187,11 +189,31 @@ bool MagnetometerSensor::Update(const ignition::common::Time &_now)
 
   // publish
   this->AddSequence(msg.mutable_header());
-  this->dataPtr->pub.Publish(msg);
+  this->Publish(this->dataPtr->pub, msg);
 
   return true;
 }
 
+//////////////////////////////////////////////////
+bool MagnetometerSensor::HasSubscribers() const
+{
+  return this->HasConnections(this->dataPtr->pub);
+}
+
+//////////////////////////////////////////////////
+bool MagnetometerSensor::SaveState(std::ostream &_out) const
+{
+  return this->Sensor::SaveState(_out) &&
+      state::WriteNoises(_out, this->dataPtr->noises);
+}
+
+//////////////////////////////////////////////////
+bool MagnetometerSensor::LoadState(std::istream &_in)
+{
+  return this->Sensor::LoadState(_in) &&
+      state::ReadNoises(_in, this->dataPtr->noises);
+}
+
 //////////////////////////////////////////////////
 void MagnetometerSensor::SetWorldPose(const math::Pose3d _pose)
 {
@@ -16,19 +16,181 @@
 */
 
 #include "ignition/sensors/Manager.hh"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
 #include <unordered_map>
+#include <vector>
+#include <ignition/msgs/serialized.pb.h>
+#include <ignition/transport/Node.hh>
 #include <ignition/common/PluginLoader.hh>
 #include <ignition/common/Plugin.hh>
-#include <ignition/common/Profiler.hh>
 #include <ignition/common/SystemPaths.hh>
 #include <ignition/common/Console.hh>
+#include <ignition/math/Helpers.hh>
 
 #include "ignition/sensors/config.hh"
+#include "ignition/sensors/Recorder.hh"
 #include "ignition/sensors/SensorFactory.hh"
+#include "ignition/sensors/Tracing.hh"
+
+#include "SpscQueue.hh"
+#include "StateStream.hh"
 
 using namespace ignition::sensors;
 
+namespace
+{
+  /// \brief Factor applied to the load scale when a step exceeds the
+  /// budget.
+  const double kLoadDecrease = 0.75;
+
+  /// \brief Amount the load scale is raised by when a step is well within
+  /// the budget.
+  const double kLoadIncrease = 0.05;
+
+  /// \brief Fraction of the budget below which the load scale is raised.
+  const double kLoadHeadroom = 0.75;
+
+  /// \brief Lowest load scale.
+  const double kMinLoadScale = 0.01;
+
+  /// \brief Weight of the last step in the smoothed step time.
+  const double kStepTimeSmoothing = 0.2;
+
+  /// \brief First bytes of a state snapshot, "IGNS" in ASCII.
+  const uint32_t kStateMagic = 0x534e4749u;
+
+  /// \brief Format version of state snapshots.
+  const uint32_t kStateVersion = 1u;
+
+  /// \brief Rate governor state of a sensor.
+  struct GovernedRate
+  {
+    /// \brief Rate the sensor is configured to run at.
+    double nominal = 0.0;
+
+    /// \brief Rate last set on the sensor.
+    double effective = 0.0;
+
+    /// \brief Whether the sensor data was consumed.
+    bool demand = true;
+  };
+
+  /// \brief Collects the messages of a group of sensors and publishes them
+  /// as one msgs::SerializedState.
+  class Bundle : public MessageSink
+  {
+    // Documentation inherited
+    public: void Add(const ignition::sensors::Sensor &_sensor,
+                const google::protobuf::Message &_msg) override
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+
+      // Sensors usually produce their messages one after the other
+      ignition::msgs::SerializedEntity *entity = nullptr;
+      int count = this->msg.entities_size();
+      if (count > 0 && this->msg.entities(count - 1).id() == _sensor.Id())
+      {
+        entity = this->msg.mutable_entities(count - 1);
+      }
+      else
+      {
+        for (int i = 0; i < count - 1 && !entity; ++i)
+        {
+          if (this->msg.entities(i).id() == _sensor.Id())
+            entity = this->msg.mutable_entities(i);
+        }
+        if (!entity)
+        {
+          entity = this->msg.add_entities();
+          entity->set_id(_sensor.Id());
+        }
+      }
+
+      auto component = entity->add_components();
+      component->set_type(Manager::BundleComponentType(_msg.GetTypeName()));
+      _msg.SerializeToString(component->mutable_component());
+    }
+
+    // Documentation inherited
+    public: bool HasConnections() const override
+    {
+      return this->pub.HasConnections();
+    }
+
+    /// \brief Publish the messages collected since the last bundle.
+    /// \param[in] _time Stamp of the bundle.
+    public: void Publish(const ignition::common::Time &_time)
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      if (this->msg.entities_size() == 0)
+        return;
+
+      auto header = this->msg.mutable_header();
+      header->mutable_stamp()->set_sec(_time.sec);
+      header->mutable_stamp()->set_nsec(_time.nsec);
+      if (header->data_size() == 0)
+      {
+        auto seq = header->add_data();
+        seq->set_key("seq");
+        seq->add_value();
+      }
+      header->mutable_data(0)->set_value(0, std::to_string(this->sequence++));
+
+      this->pub.Publish(this->msg);
+
+      // Clearing the repeated field keeps the entities for the next bundle
+      this->msg.mutable_entities()->Clear();
+    }
+
+    /// \brief Publisher of the bundles.
+    public: ignition::transport::Node::Publisher pub;
+
+    /// \brief Sensors in the bundle.
+    public: std::vector<SensorId> sensors;
+
+    /// \brief Bundle being collected.
+    public: ignition::msgs::SerializedState msg;
+
+    /// \brief Number of bundles published.
+    public: uint64_t sequence = 0;
+
+    /// \brief Protects the bundle being collected, since rendering sensors
+    /// may produce messages from their pipeline thread.
+    public: std::mutex mutex;
+  };
+
+  /// \brief Records the messages of the sensors, see
+  /// Manager::StartRecording().
+  class RecordingTap : public MessageSink
+  {
+    // Documentation inherited
+    public: void Add(const ignition::sensors::Sensor &_sensor,
+                const google::protobuf::Message &_msg) override
+    {
+      this->recorder.Add(_sensor.Name(), _sensor.Topic(), _msg);
+    }
+
+    // Documentation inherited
+    public: bool HasConnections() const override
+    {
+      return true;
+    }
+
+    /// \brief The recording.
+    public: Recorder recorder;
+  };
+}
+
 class ignition::sensors::ManagerPrivate
 {
   /// \brief constructor
@@ -37,11 +199,110 @@ class ignition::sensors::ManagerPrivate
   /// \brief destructor
   public: ~ManagerPrivate();
 
+  /// \brief Bundles by topic. Declared before the sensors, so the sensors,
+  /// which may still be adding messages from their pipeline thread, are
+  /// destroyed first.
+  public: std::map<std::string, std::unique_ptr<Bundle>> bundles;
+
+  /// \brief Tap recording the messages of the sensors, null while not
+  /// recording. Declared before the sensors for the same reason as the
+  /// bundles.
+  public: std::unique_ptr<RecordingTap> recording;
+
+  /// \brief Node to advertise the bundles.
+  public: ignition::transport::Node node;
+
   /// \brief Loaded sensors.
   public: std::map<SensorId, std::unique_ptr<Sensor>> sensors;
 
   /// \brief Sensor factory for creating sensors from plugins;
   public: SensorFactory sensorFactory;
+
+  /// \brief Run the sensors one step, on the calling thread.
+  /// \param[in] _time The current simulated time.
+  /// \param[in] _force Force all sensors to update.
+  public: void RunOnce(const ignition::common::Time &_time, bool _force);
+
+  /// \brief Process the submitted steps until the sensor thread is
+  /// stopped and the queue is empty.
+  public: void RunSensorThread();
+
+  /// \brief Apply the updates of a step and run it.
+  /// \param[in] _step The step.
+  public: void RunStep(const SensorStep &_step);
+
+  /// \brief Steps submitted to the sensor thread, null while it isn't
+  /// running.
+  public: std::unique_ptr<SpscQueue<SensorStep>> steps;
+
+  /// \brief The sensor thread.
+  public: std::thread sensorThread;
+
+  /// \brief Held by the sensor thread while it runs a step, and by the
+  /// functions that add or remove sensors and bundles.
+  public: std::mutex stepMutex;
+
+  /// \brief Lets the sensor thread sleep while the queue is empty.
+  public: std::mutex wakeMutex;
+
+  /// \brief Wakes the sensor thread up.
+  public: std::condition_variable wakeCondition;
+
+  /// \brief Whether the sensor thread waits for a step, so the submitting
+  /// thread only locks wakeMutex when needed.
+  public: std::atomic<bool> sleeping{false};
+
+  /// \brief Tells the sensor thread to stop once the queue is empty.
+  /// Protected by wakeMutex.
+  public: bool stopping = false;
+
+  /// \brief Maximum number of pending steps.
+  public: unsigned int maxLag = 0u;
+
+  /// \brief Fence of the last submitted step, only written by the
+  /// submitting thread.
+  public: std::atomic<uint64_t> submittedFence{0u};
+
+  /// \brief Fence of the last completed step.
+  public: std::atomic<uint64_t> completedFence{0u};
+
+  /// \brief Lets threads wait for a fence.
+  public: mutable std::mutex fenceMutex;
+
+  /// \brief Notified when a step completes.
+  public: mutable std::condition_variable fenceCondition;
+
+  /// \brief Step reused by RunOnce() while the sensor thread runs.
+  public: SensorStep runOnceStep;
+
+  /// \brief Set the effective rates of the sensors.
+  /// \param[in] _time The current simulated time.
+  public: void GovernRates(const ignition::common::Time &_time);
+
+  /// \brief Update the load scale from the time taken by a step.
+  /// \param[in] _seconds Wall time of the sensor updates.
+  public: void UpdateLoad(double _seconds);
+
+  /// \brief Restore the nominal rates and reset the governor.
+  public: void ResetGovernor();
+
+  /// \brief Whether the rate governor is enabled.
+  public: bool governorEnabled = false;
+
+  /// \brief Wall time budget of the sensor updates, in seconds.
+  public: double stepBudget = 0.0;
+
+  /// \brief Lowest governed rate, in Hz.
+  public: double rateFloor = 1.0;
+
+  /// \brief Fraction of the nominal rates allowed by the step budget.
+  public: double loadScale = 1.0;
+
+  /// \brief Smoothed wall time of the sensor updates, in seconds.
+  public: double stepTime = 0.0;
+
+  /// \brief Governor state by sensor.
+  public: std::map<SensorId, GovernedRate> rates;
 };
 
 //////////////////////////////////////////////////
@@ -54,6 +315,174 @@ ManagerPrivate::~ManagerPrivate()
 {
 }
 
+//////////////////////////////////////////////////
+void ManagerPrivate::GovernRates(const ignition::common::Time &_time)
+{
+  for (auto &s : this->sensors)
+  {
+    auto it = this->rates.find(s.first);
+    if (it == this->rates.end())
+    {
+      GovernedRate rate;
+      rate.nominal = s.second->UpdateRate();
+      rate.effective = rate.nominal;
+      it = this->rates.emplace(s.first, rate).first;
+    }
+    GovernedRate &rate = it->second;
+
+    // The rate was changed since the governor last set it
+    if (!ignition::math::equal(s.second->UpdateRate(), rate.effective))
+      rate.nominal = s.second->UpdateRate();
+
+    rate.demand = s.second->HasSubscribers();
+
+    double effective = rate.nominal;
+    if (!rate.demand)
+    {
+      if (rate.nominal <= 0.0 || rate.nominal > this->rateFloor)
+        effective = this->rateFloor;
+    }
+    else if (rate.nominal > 0.0)
+    {
+      effective = std::max(rate.nominal * this->loadScale,
+          std::min(this->rateFloor, rate.nominal));
+    }
+
+    double current = s.second->UpdateRate();
+    rate.effective = effective;
+    if (ignition::math::equal(effective, current))
+      continue;
+
+    // When the rate is raised, update sooner than the old rate planned
+    bool raised = effective <= 0.0 || (current > 0.0 && effective > current);
+    s.second->SetUpdateRate(effective);
+    if (raised && s.second->NextUpdateTime() > _time)
+      s.second->SetNextUpdateTime(_time);
+  }
+}
+
+//////////////////////////////////////////////////
+void ManagerPrivate::UpdateLoad(double _seconds)
+{
+  if (this->stepTime <= 0.0)
+    this->stepTime = _seconds;
+  else
+  {
+    this->stepTime += kStepTimeSmoothing * (_seconds - this->stepTime);
+  }
+
+  if (this->stepBudget <= 0.0)
+    this->loadScale = 1.0;
+  else if (this->stepTime > this->stepBudget)
+    this->loadScale = std::max(kMinLoadScale, this->loadScale * kLoadDecrease);
+  else if (this->stepTime < kLoadHeadroom * this->stepBudget)
+    this->loadScale = std::min(1.0, this->loadScale + kLoadIncrease);
+}
+
+//////////////////////////////////////////////////
+void ManagerPrivate::ResetGovernor()
+{
+  for (const auto &rate : this->rates)
+  {
+    auto it = this->sensors.find(rate.first);
+    if (it != this->sensors.end() &&
+        ignition::math::equal(it->second->UpdateRate(), rate.second.effective))
+    {
+      it->second->SetUpdateRate(rate.second.nominal);
+    }
+  }
+  this->rates.clear();
+  this->loadScale = 1.0;
+  this->stepTime = 0.0;
+}
+
+//////////////////////////////////////////////////
+void ManagerPrivate::RunOnce(const ignition::common::Time &_time,
+    bool _force)
+{
+  IGN_SENSORS_PROFILE("SensorManager::RunOnce");
+  if (this->governorEnabled)
+    this->GovernRates(_time);
+
+  auto start = std::chrono::steady_clock::now();
+  for (auto &s : this->sensors)
+  {
+    s.second->Update(_time, _force);
+  }
+
+  if (this->governorEnabled)
+  {
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    this->UpdateLoad(elapsed.count());
+  }
+
+  for (auto &bundle : this->bundles)
+  {
+    IGN_SENSORS_PROFILE("SensorManager::RunOnce Bundle");
+    bundle.second->Publish(_time);
+  }
+}
+
+//////////////////////////////////////////////////
+void ManagerPrivate::RunSensorThread()
+{
+  IGN_SENSORS_PROFILE_THREAD_NAME("SensorThread");
+
+  // Popping swaps the step with the slot, so the vectors of processed
+  // steps go back to the submitting thread with their memory
+  SensorStep step;
+  while (true)
+  {
+    if (!this->steps->Pop(step))
+    {
+      std::unique_lock<std::mutex> lock(this->wakeMutex);
+      this->sleeping = true;
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      this->wakeCondition.wait(lock, [this]
+      {
+        return this->stopping || !this->steps->Empty();
+      });
+      this->sleeping = false;
+      if (this->stopping && this->steps->Empty())
+        break;
+      continue;
+    }
+
+    this->RunStep(step);
+    step.poses.clear();
+    step.states.clear();
+
+    {
+      std::lock_guard<std::mutex> lock(this->fenceMutex);
+      this->completedFence.fetch_add(1u, std::memory_order_release);
+    }
+    this->fenceCondition.notify_all();
+  }
+}
+
+//////////////////////////////////////////////////
+void ManagerPrivate::RunStep(const SensorStep &_step)
+{
+  IGN_SENSORS_PROFILE("SensorManager::RunStep");
+  std::lock_guard<std::mutex> lock(this->stepMutex);
+  for (const auto &pose : _step.poses)
+  {
+    auto it = this->sensors.find(pose.first);
+    if (it != this->sensors.end())
+      it->second->SetPose(pose.second);
+  }
+
+  for (const auto &state : _step.states)
+  {
+    auto it = this->sensors.find(state.first);
+    if (it != this->sensors.end() && state.second)
+      state.second(*it->second);
+  }
+
+  this->RunOnce(_step.time, _step.force);
+}
+
 //////////////////////////////////////////////////
 Manager::Manager() :
   dataPtr(new ManagerPrivate)
@@ -63,6 +492,7 @@ Manager::Manager() :
 //////////////////////////////////////////////////
 Manager::~Manager()
 {
+  this->StopSensorThread();
 }
 
 //////////////////////////////////////////////////
@@ -79,6 +509,16 @@ ignition::sensors::Sensor *Manager::Sensor(
   return iter != this->dataPtr->sensors.end() ? iter->second.get() : nullptr;
 }
 
+//////////////////////////////////////////////////
+std::vector<SensorId> Manager::SensorIds() const
+{
+  std::vector<SensorId> ids;
+  ids.reserve(this->dataPtr->sensors.size());
+  for (const auto &s : this->dataPtr->sensors)
+    ids.push_back(s.first);
+  return ids;
+}
+
 //////////////////////////////////////////////////
 void Manager::AddPluginPaths(const std::string &_paths)
 {
@@ -88,39 +528,569 @@ void Manager::AddPluginPaths(const std::string &_paths)
 //////////////////////////////////////////////////
 bool Manager::Remove(const ignition::sensors::SensorId _id)
 {
+  std::lock_guard<std::mutex> lock(this->dataPtr->stepMutex);
+  for (auto &bundle : this->dataPtr->bundles)
+  {
+    auto &ids = bundle.second->sensors;
+    ids.erase(std::remove(ids.begin(), ids.end(), _id), ids.end());
+  }
+  this->dataPtr->rates.erase(_id);
+
   return this->dataPtr->sensors.erase(_id) > 0;
 }
 
 //////////////////////////////////////////////////
 void Manager::RunOnce(const ignition::common::Time &_time, bool _force)
 {
-  IGN_PROFILE("SensorManager::RunOnce");
+  if (!this->dataPtr->steps)
+  {
+    this->dataPtr->RunOnce(_time, _force);
+    return;
+  }
+
+  SensorStep &step = this->dataPtr->runOnceStep;
+  step.time = _time;
+  step.force = _force;
+  step.poses.clear();
+  step.states.clear();
+  this->WaitForFence(this->SubmitStep(step));
+}
+
+//////////////////////////////////////////////////
+bool Manager::StartSensorThread(unsigned int _maxLag)
+{
+  if (this->dataPtr->steps)
+  {
+    ignerr << "The sensor thread is already running.\n";
+    return false;
+  }
+
+  this->dataPtr->maxLag = std::max(1u, _maxLag);
+  this->dataPtr->steps.reset(
+      new SpscQueue<SensorStep>(this->dataPtr->maxLag));
+  this->dataPtr->stopping = false;
+  this->dataPtr->sensorThread =
+      std::thread(&ManagerPrivate::RunSensorThread, this->dataPtr.get());
+  return true;
+}
+
+//////////////////////////////////////////////////
+void Manager::StopSensorThread()
+{
+  if (!this->dataPtr->steps)
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(this->dataPtr->wakeMutex);
+    this->dataPtr->stopping = true;
+  }
+  this->dataPtr->wakeCondition.notify_one();
+  this->dataPtr->sensorThread.join();
+
+  this->dataPtr->steps.reset();
+  this->dataPtr->maxLag = 0u;
+}
+
+//////////////////////////////////////////////////
+bool Manager::SensorThreadRunning() const
+{
+  return static_cast<bool>(this->dataPtr->steps);
+}
+
+//////////////////////////////////////////////////
+unsigned int Manager::MaxLag() const
+{
+  return this->dataPtr->maxLag;
+}
+
+//////////////////////////////////////////////////
+uint64_t Manager::SubmitStep(SensorStep &_step)
+{
+  if (!this->dataPtr->steps)
+  {
+    ignerr << "The sensor thread isn't running, step ignored.\n";
+    return 0u;
+  }
+
+  // Bound the number of pending steps, the queue always has room after
+  uint64_t fence = this->dataPtr->submittedFence + 1u;
+  if (fence > this->dataPtr->maxLag)
+    this->WaitForFence(fence - this->dataPtr->maxLag);
+  while (!this->dataPtr->steps->Push(_step))
+    std::this_thread::yield();
+  this->dataPtr->submittedFence = fence;
+
+  // Only wake the sensor thread up if it may be waiting for a step
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (this->dataPtr->sleeping)
+  {
+    {
+      std::lock_guard<std::mutex> lock(this->dataPtr->wakeMutex);
+    }
+    this->dataPtr->wakeCondition.notify_one();
+  }
+  return fence;
+}
+
+//////////////////////////////////////////////////
+uint64_t Manager::CompletedFence() const
+{
+  return this->dataPtr->completedFence.load(std::memory_order_acquire);
+}
+
+//////////////////////////////////////////////////
+bool Manager::WaitForFence(uint64_t _fence,
+    const ignition::common::Time &_timeout) const
+{
+  if (this->CompletedFence() >= _fence)
+    return true;
+
+  // A step that wasn't submitted never completes
+  if (_fence > this->dataPtr->submittedFence)
+    return false;
+
+  auto done = [this, _fence]
+  {
+    return this->CompletedFence() >= _fence;
+  };
+
+  std::unique_lock<std::mutex> lock(this->dataPtr->fenceMutex);
+  if (_timeout == ignition::common::Time::Zero)
+  {
+    this->dataPtr->fenceCondition.wait(lock, done);
+    return true;
+  }
+  return this->dataPtr->fenceCondition.wait_for(lock,
+      std::chrono::duration<double>(_timeout.Double()), done);
+}
+
+//////////////////////////////////////////////////
+void Manager::Flush()
+{
+  this->WaitForFence(this->dataPtr->submittedFence);
+}
+
+//////////////////////////////////////////////////
+bool Manager::AddBundle(const std::string &_topic,
+    const std::vector<SensorId> &_sensors)
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->stepMutex);
+  if (_topic.empty())
+  {
+    ignerr << "Empty bundle topic.\n";
+    return false;
+  }
+
+  if (this->dataPtr->bundles.find(_topic) != this->dataPtr->bundles.end())
+  {
+    ignerr << "Bundle [" << _topic << "] already exists.\n";
+    return false;
+  }
+
+  for (auto id : _sensors)
+  {
+    auto sensor = this->Sensor(id);
+    if (!sensor)
+    {
+      ignerr << "Sensor [" << id << "] of bundle [" << _topic
+             << "] doesn't exist.\n";
+      return false;
+    }
+    if (sensor->Sink())
+    {
+      ignerr << "Sensor [" << sensor->Name() << "] is already in a bundle.\n";
+      return false;
+    }
+  }
+
+  std::unique_ptr<Bundle> bundle(new Bundle);
+  bundle->pub = this->dataPtr->node.Advertise<ignition::msgs::SerializedState>(
+      _topic);
+  if (!bundle->pub)
+  {
+    ignerr << "Unable to advertise bundle topic [" << _topic << "].\n";
+    return false;
+  }
+
+  bundle->sensors = _sensors;
+  for (auto id : _sensors)
+    this->Sensor(id)->SetMessageSink(bundle.get());
+
+  this->dataPtr->bundles[_topic] = std::move(bundle);
+  return true;
+}
+
+//////////////////////////////////////////////////
+bool Manager::RemoveBundle(const std::string &_topic)
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->stepMutex);
+  auto it = this->dataPtr->bundles.find(_topic);
+  if (it == this->dataPtr->bundles.end())
+    return false;
+
+  // Once unset, no sensor can be adding a message to the bundle
+  for (auto id : it->second->sensors)
+  {
+    auto sensor = this->Sensor(id);
+    if (sensor)
+      sensor->SetMessageSink(nullptr);
+  }
+
+  this->dataPtr->bundles.erase(it);
+  return true;
+}
+
+//////////////////////////////////////////////////
+std::vector<std::string> Manager::Bundles() const
+{
+  std::vector<std::string> topics;
+  for (const auto &bundle : this->dataPtr->bundles)
+    topics.push_back(bundle.first);
+  return topics;
+}
+
+//////////////////////////////////////////////////
+void Manager::SetRateGovernorEnabled(bool _enabled)
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->stepMutex);
+  if (!_enabled && this->dataPtr->governorEnabled)
+    this->dataPtr->ResetGovernor();
+  this->dataPtr->governorEnabled = _enabled;
+}
+
+//////////////////////////////////////////////////
+bool Manager::RateGovernorEnabled() const
+{
+  return this->dataPtr->governorEnabled;
+}
+
+//////////////////////////////////////////////////
+void Manager::SetStepBudget(double _seconds)
+{
+  this->dataPtr->stepBudget = std::max(0.0, _seconds);
+}
+
+//////////////////////////////////////////////////
+double Manager::StepBudget() const
+{
+  return this->dataPtr->stepBudget;
+}
+
+//////////////////////////////////////////////////
+void Manager::SetRateFloor(double _hz)
+{
+  if (_hz <= 0.0)
+  {
+    ignerr << "Rate floor must be greater than zero, got [" << _hz << "].\n";
+    return;
+  }
+  this->dataPtr->rateFloor = _hz;
+}
+
+//////////////////////////////////////////////////
+double Manager::RateFloor() const
+{
+  return this->dataPtr->rateFloor;
+}
+
+//////////////////////////////////////////////////
+double Manager::EffectiveUpdateRate(SensorId _id) const
+{
+  auto it = this->dataPtr->sensors.find(_id);
+  if (it == this->dataPtr->sensors.end())
+    return 0.0;
+  return it->second->UpdateRate();
+}
+
+//////////////////////////////////////////////////
+double Manager::NominalUpdateRate(SensorId _id) const
+{
+  auto it = this->dataPtr->sensors.find(_id);
+  if (it == this->dataPtr->sensors.end())
+    return 0.0;
+
+  auto rate = this->dataPtr->rates.find(_id);
+  if (rate != this->dataPtr->rates.end() &&
+      ignition::math::equal(it->second->UpdateRate(), rate->second.effective))
+  {
+    return rate->second.nominal;
+  }
+  return it->second->UpdateRate();
+}
+
+//////////////////////////////////////////////////
+RateGovernorStatistics Manager::RateGovernorStats() const
+{
+  RateGovernorStatistics stats;
+  stats.stepTime = this->dataPtr->stepTime;
+  stats.loadScale = this->dataPtr->loadScale;
+  for (const auto &s : this->dataPtr->sensors)
+  {
+    double effective = s.second->UpdateRate();
+    stats.effectiveRates[s.first] = effective;
+
+    auto rate = this->dataPtr->rates.find(s.first);
+    if (rate == this->dataPtr->rates.end())
+      continue;
+
+    if (!rate->second.demand)
+      ++stats.idleSensors;
+
+    double nominal = this->NominalUpdateRate(s.first);
+    if ((nominal <= 0.0 && effective > 0.0) ||
+        (nominal > 0.0 && effective < nominal))
+    {
+      ++stats.throttledSensors;
+    }
+  }
+  return stats;
+}
+
+//////////////////////////////////////////////////
+SensorMemoryUsage Manager::MemoryUsage()
+{
+  IGN_SENSORS_PROFILE("Manager::MemoryUsage");
+  this->Flush();
+  std::lock_guard<std::mutex> lock(this->dataPtr->stepMutex);
+
+  SensorMemoryUsage usage;
+  for (const auto &s : this->dataPtr->sensors)
+    usage += s.second->MemoryUsage();
+  return usage;
+}
+
+//////////////////////////////////////////////////
+bool Manager::SaveState(std::ostream &_out)
+{
+  IGN_SENSORS_PROFILE("Manager::SaveState");
+  this->Flush();
+  std::lock_guard<std::mutex> lock(this->dataPtr->stepMutex);
+
+  state::Write(_out, kStateMagic);
+  state::Write(_out, kStateVersion);
+  state::Write(_out, static_cast<uint32_t>(this->dataPtr->sensors.size()));
+
+  // Each sensor state is prefixed with its size, so that sensors that
+  // can't be matched on load are skipped
+  std::ostringstream sensorState;
+  for (const auto &s : this->dataPtr->sensors)
+  {
+    sensorState.str("");
+    if (!s.second->SaveState(sensorState))
+    {
+      ignerr << "Failed to save the state of sensor [" << s.second->Name()
+             << "].\n";
+      return false;
+    }
+
+    state::WriteString(_out, s.second->Parent());
+    state::WriteString(_out, s.second->Name());
+    state::WriteString(_out, sensorState.str());
+  }
+  return static_cast<bool>(_out);
+}
+
+//////////////////////////////////////////////////
+bool Manager::LoadState(std::istream &_in)
+{
+  IGN_SENSORS_PROFILE("Manager::LoadState");
+  this->Flush();
+  std::lock_guard<std::mutex> lock(this->dataPtr->stepMutex);
+
+  uint32_t magic = 0u;
+  uint32_t version = 0u;
+  uint32_t count = 0u;
+  if (!state::Read(_in, magic) || magic != kStateMagic ||
+      !state::Read(_in, version) || version != kStateVersion ||
+      !state::Read(_in, count))
+  {
+    ignerr << "Invalid sensor state snapshot.\n";
+    return false;
+  }
+
+  std::set<SensorId> restored;
+  std::string data;
+  bool result = true;
+  for (uint32_t i = 0u; i < count; ++i)
+  {
+    std::string parent;
+    std::string name;
+    if (!state::ReadString(_in, parent) || !state::ReadString(_in, name) ||
+        !state::ReadString(_in, data))
+    {
+      ignerr << "Truncated sensor state snapshot.\n";
+      return false;
+    }
+
+    // Sensors are stored in creation order, so the first sensor with the
+    // same parent and name that wasn't restored yet is the match
+    ignition::sensors::Sensor *sensor = nullptr;
+    for (const auto &s : this->dataPtr->sensors)
+    {
+      if (s.second->Name() == name && s.second->Parent() == parent &&
+          restored.find(s.first) == restored.end())
+      {
+        sensor = s.second.get();
+        break;
+      }
+    }
+
+    if (!sensor)
+    {
+      ignwarn << "Sensor [" << name << "] of the state snapshot doesn't "
+              << "exist, skipping it.\n";
+      result = false;
+      continue;
+    }
+    restored.insert(sensor->Id());
+
+    std::istringstream sensorState(data);
+    if (!sensor->LoadState(sensorState) ||
+        sensorState.peek() != std::char_traits<char>::eof())
+    {
+      ignerr << "Failed to restore the state of sensor [" << name
+             << "], it doesn't match the snapshot.\n";
+      result = false;
+    }
+  }
+  return result;
+}
+
+//////////////////////////////////////////////////
+bool Manager::StartRecording(const std::string &_path)
+{
+  if (this->Recording())
+    this->StopRecording();
+
+  auto tap = std::make_unique<RecordingTap>();
+  if (!tap->recorder.Open(_path))
+    return false;
+
+  std::lock_guard<std::mutex> lock(this->dataPtr->stepMutex);
   for (auto &s : this->dataPtr->sensors)
+    s.second->SetMessageTap(tap.get());
+  this->dataPtr->recording = std::move(tap);
+  return true;
+}
+
+//////////////////////////////////////////////////
+bool Manager::StopRecording()
+{
+  if (!this->Recording())
+    return false;
+
+  // Record the messages of the submitted steps
+  this->Flush();
+
+  std::unique_ptr<RecordingTap> tap;
   {
-    s.second->Update(_time, _force);
+    std::lock_guard<std::mutex> lock(this->dataPtr->stepMutex);
+    for (auto &s : this->dataPtr->sensors)
+      s.second->SetMessageTap(nullptr);
+    tap = std::move(this->dataPtr->recording);
   }
+  return tap->recorder.Close();
+}
+
+//////////////////////////////////////////////////
+bool Manager::Recording() const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->stepMutex);
+  return this->dataPtr->recording != nullptr;
+}
+
+//////////////////////////////////////////////////
+bool Manager::SaveConfigCache(const std::string &_path) const
+{
+  IGN_SENSORS_PROFILE("Manager::SaveConfigCache");
+  SensorConfigCache cache;
+  bool result = true;
+  {
+    std::lock_guard<std::mutex> lock(this->dataPtr->stepMutex);
+    for (const auto &s : this->dataPtr->sensors)
+    {
+      const sdf::Sensor &sdfSensor = s.second->SDFSensor();
+      if (!SensorConfigCache::Supported(sdfSensor))
+      {
+        ignwarn << "Sensor [" << s.second->Name() << "] of type ["
+                << sdfSensor.TypeStr() << "] can't be stored in a config "
+                << "cache, skipping it.\n";
+        result = false;
+        continue;
+      }
+      cache.Add(sdfSensor, s.second->Parent());
+    }
+  }
+  return cache.Save(_path) && result;
+}
+
+//////////////////////////////////////////////////
+std::vector<SensorId> Manager::CreateSensors(const SensorConfigCache &_cache)
+{
+  IGN_SENSORS_PROFILE("Manager::CreateSensors");
+  std::vector<SensorId> ids;
+  ids.reserve(_cache.Count());
+
+  sdf::Sensor sdfSensor;
+  std::string parent;
+  for (std::size_t i = 0u; i < _cache.Count(); ++i)
+  {
+    if (!_cache.Entry(i, sdfSensor, parent))
+    {
+      ignerr << "Invalid entry [" << i << "] in sensor config cache.\n";
+      ids.push_back(NO_SENSOR);
+      continue;
+    }
+
+    SensorId id = this->CreateSensor(sdfSensor);
+    if (id != NO_SENSOR && !parent.empty())
+      this->Sensor(id)->SetParent(parent);
+    ids.push_back(id);
+  }
+  return ids;
+}
+
+//////////////////////////////////////////////////
+uint64_t Manager::BundleComponentType(const std::string &_typeName)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  for (char c : _typeName)
+  {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
 }
 
 /////////////////////////////////////////////////
 ignition::sensors::SensorId Manager::CreateSensor(const sdf::Sensor &_sdf)
 {
-  auto sensor = this->dataPtr->sensorFactory.CreateSensor(_sdf);
-  if (!sensor)
-    return NO_SENSOR;
-
-  SensorId id = sensor->Id();
-  this->dataPtr->sensors[id] = std::move(sensor);
-  return id;
+  return this->AddSensor(this->dataPtr->sensorFactory.CreateSensor(_sdf));
 }
 
 /////////////////////////////////////////////////
 ignition::sensors::SensorId Manager::CreateSensor(sdf::ElementPtr _sdf)
 {
-  auto sensor = this->dataPtr->sensorFactory.CreateSensor(_sdf);
-  if (!sensor)
+  return this->AddSensor(this->dataPtr->sensorFactory.CreateSensor(_sdf));
+}
+
+/////////////////////////////////////////////////
+ignition::sensors::SensorId Manager::AddSensor(
+    std::unique_ptr<ignition::sensors::Sensor> _sensor)
+{
+  if (!_sensor)
     return NO_SENSOR;
 
-  SensorId id = sensor->Id();
-  this->dataPtr->sensors[id] = std::move(sensor);
+  SensorId id = _sensor->Id();
+  std::lock_guard<std::mutex> lock(this->dataPtr->stepMutex);
+  if (this->dataPtr->sensors.find(id) != this->dataPtr->sensors.end())
+  {
+    ignerr << "Sensor with id [" << id << "] was already added.\n";
+    return NO_SENSOR;
+  }
+
+  if (this->dataPtr->recording)
+    _sensor->SetMessageTap(this->dataPtr->recording.get());
+  this->dataPtr->sensors[id] = std::move(_sensor);
   return id;
 }
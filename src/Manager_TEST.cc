@@ -16,8 +16,36 @@
 */
 
 #include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
 #include <ignition/sensors/Manager.hh>
 
+/// \brief Sensor whose data is always consumed and whose update takes a
+/// known wall time.
+class CostSensor : public ignition::sensors::Sensor
+{
+  public: bool Update(const ignition::common::Time &) override
+  {
+    std::this_thread::sleep_for(this->cost);
+    ++this->updates;
+    return true;
+  }
+
+  public: bool HasSubscribers() const override
+  {
+    return true;
+  }
+
+  /// \brief Wall time of an update.
+  public: std::chrono::milliseconds cost{2};
+
+  /// \brief Number of updates.
+  public: unsigned int updates = 0u;
+};
+
 
 //////////////////////////////////////////////////
 TEST(Manager, construct)
@@ -46,6 +74,178 @@ TEST(Manager, removeSensor)
   // \todo(nkoenig) Add a sensor, then remove it
 }
 
+//////////////////////////////////////////////////
+TEST(Manager, bundles)
+{
+  ignition::sensors::Manager mgr;
+  EXPECT_TRUE(mgr.Init());
+  EXPECT_TRUE(mgr.Bundles().empty());
+
+  EXPECT_FALSE(mgr.AddBundle("", {}));
+  EXPECT_FALSE(mgr.AddBundle("/test/bundle", {12345u}));
+  EXPECT_TRUE(mgr.Bundles().empty());
+
+  EXPECT_TRUE(mgr.AddBundle("/test/bundle", {}));
+  EXPECT_FALSE(mgr.AddBundle("/test/bundle", {}));
+  ASSERT_EQ(1u, mgr.Bundles().size());
+  EXPECT_EQ("/test/bundle", mgr.Bundles()[0]);
+
+  // Nothing to publish
+  mgr.RunOnce(ignition::common::Time(1, 0));
+
+  EXPECT_TRUE(mgr.RemoveBundle("/test/bundle"));
+  EXPECT_FALSE(mgr.RemoveBundle("/test/bundle"));
+  EXPECT_TRUE(mgr.Bundles().empty());
+
+  // FNV-1a
+  EXPECT_EQ(14695981039346656037ULL,
+      ignition::sensors::Manager::BundleComponentType(""));
+  EXPECT_EQ(0xaf63dc4c8601ec8cULL,
+      ignition::sensors::Manager::BundleComponentType("a"));
+  EXPECT_NE(
+      ignition::sensors::Manager::BundleComponentType("ignition.msgs.IMU"),
+      ignition::sensors::Manager::BundleComponentType("ignition.msgs.Image"));
+}
+
+//////////////////////////////////////////////////
+TEST(Manager, rateGovernor)
+{
+  ignition::sensors::Manager mgr;
+  EXPECT_TRUE(mgr.Init());
+
+  EXPECT_FALSE(mgr.RateGovernorEnabled());
+  mgr.SetRateGovernorEnabled(true);
+  EXPECT_TRUE(mgr.RateGovernorEnabled());
+
+  EXPECT_DOUBLE_EQ(0.0, mgr.StepBudget());
+  mgr.SetStepBudget(0.01);
+  EXPECT_DOUBLE_EQ(0.01, mgr.StepBudget());
+  mgr.SetStepBudget(-1);
+  EXPECT_DOUBLE_EQ(0.0, mgr.StepBudget());
+
+  EXPECT_DOUBLE_EQ(1.0, mgr.RateFloor());
+  mgr.SetRateFloor(0.5);
+  EXPECT_DOUBLE_EQ(0.5, mgr.RateFloor());
+  mgr.SetRateFloor(0.0);
+  EXPECT_DOUBLE_EQ(0.5, mgr.RateFloor());
+
+  EXPECT_DOUBLE_EQ(0.0, mgr.EffectiveUpdateRate(12345u));
+  EXPECT_DOUBLE_EQ(0.0, mgr.NominalUpdateRate(12345u));
+
+  mgr.RunOnce(ignition::common::Time(1, 0));
+  ignition::sensors::RateGovernorStatistics stats = mgr.RateGovernorStats();
+  EXPECT_DOUBLE_EQ(1.0, stats.loadScale);
+  EXPECT_EQ(0u, stats.idleSensors);
+  EXPECT_EQ(0u, stats.throttledSensors);
+  EXPECT_TRUE(stats.effectiveRates.empty());
+
+  mgr.SetRateGovernorEnabled(false);
+  EXPECT_FALSE(mgr.RateGovernorEnabled());
+}
+
+//////////////////////////////////////////////////
+TEST(Manager, rateGovernorLoad)
+{
+  ignition::sensors::Manager mgr;
+  EXPECT_TRUE(mgr.Init());
+
+  EXPECT_EQ(ignition::sensors::NO_SENSOR, mgr.AddSensor(nullptr));
+  std::unique_ptr<CostSensor> owned(new CostSensor);
+  CostSensor *sensor = owned.get();
+  sensor->SetUpdateRate(100);
+  ignition::sensors::SensorId id = mgr.AddSensor(std::move(owned));
+  ASSERT_NE(ignition::sensors::NO_SENSOR, id);
+  EXPECT_EQ(sensor, mgr.Sensor(id));
+
+  // Each update takes twice the budget, so the rate is cut after the first
+  // step.
+  mgr.SetRateGovernorEnabled(true);
+  mgr.SetStepBudget(0.001);
+  int64_t step = 0;
+  auto run = [&](int _steps)
+  {
+    for (int i = 0; i < _steps; ++i, ++step)
+      mgr.RunOnce(ignition::common::Time(0, step * 10000000));
+  };
+  run(2);
+  EXPECT_EQ(2u, sensor->updates);
+  EXPECT_DOUBLE_EQ(100.0, mgr.NominalUpdateRate(id));
+  EXPECT_LT(mgr.EffectiveUpdateRate(id), 100.0);
+  EXPECT_DOUBLE_EQ(mgr.EffectiveUpdateRate(id), sensor->UpdateRate());
+  ignition::sensors::RateGovernorStatistics stats = mgr.RateGovernorStats();
+  EXPECT_LT(stats.loadScale, 1.0);
+  EXPECT_GT(stats.stepTime, 0.001);
+  EXPECT_EQ(1u, stats.throttledSensors);
+  EXPECT_EQ(0u, stats.idleSensors);
+
+  // Steps are 10 ms apart, so the throttled sensor skips some of them
+  run(40);
+  EXPECT_LT(sensor->updates, 42u);
+
+  // With room in the budget the nominal rate comes back
+  mgr.SetStepBudget(1.0);
+  run(30);
+  EXPECT_DOUBLE_EQ(100.0, mgr.EffectiveUpdateRate(id));
+  EXPECT_DOUBLE_EQ(100.0, sensor->UpdateRate());
+  stats = mgr.RateGovernorStats();
+  EXPECT_DOUBLE_EQ(1.0, stats.loadScale);
+  EXPECT_EQ(0u, stats.throttledSensors);
+  unsigned int updates = sensor->updates;
+  run(10);
+  EXPECT_EQ(updates + 10u, sensor->updates);
+}
+
+//////////////////////////////////////////////////
+TEST(Manager, sensorThread)
+{
+  ignition::sensors::Manager mgr;
+  EXPECT_TRUE(mgr.Init());
+
+  EXPECT_FALSE(mgr.SensorThreadRunning());
+  EXPECT_EQ(0u, mgr.MaxLag());
+  EXPECT_EQ(0u, mgr.CompletedFence());
+
+  // Steps can't be submitted without the thread
+  ignition::sensors::SensorStep step;
+  EXPECT_EQ(0u, mgr.SubmitStep(step));
+  EXPECT_FALSE(mgr.WaitForFence(1u));
+
+  EXPECT_TRUE(mgr.StartSensorThread(2u));
+  EXPECT_FALSE(mgr.StartSensorThread());
+  EXPECT_TRUE(mgr.SensorThreadRunning());
+  EXPECT_EQ(2u, mgr.MaxLag());
+
+  // Fences count the steps
+  int states = 0;
+  for (int i = 1; i <= 10; ++i)
+  {
+    step.time = ignition::common::Time(i, 0);
+    step.states.emplace_back(12345u,
+        [&states](ignition::sensors::Sensor &) { ++states; });
+    EXPECT_EQ(static_cast<uint64_t>(i), mgr.SubmitStep(step));
+    EXPECT_LE(static_cast<uint64_t>(i) - mgr.CompletedFence(), 2u);
+  }
+  EXPECT_TRUE(mgr.WaitForFence(10u, ignition::common::Time(5, 0)));
+  EXPECT_EQ(10u, mgr.CompletedFence());
+  EXPECT_FALSE(mgr.WaitForFence(11u));
+
+  // Updates of unknown sensors are skipped
+  EXPECT_EQ(0, states);
+
+  // RunOnce submits a step and waits for it
+  mgr.RunOnce(ignition::common::Time(11, 0));
+  EXPECT_EQ(11u, mgr.CompletedFence());
+
+  mgr.Flush();
+  mgr.StopSensorThread();
+  EXPECT_FALSE(mgr.SensorThreadRunning());
+  EXPECT_EQ(0u, mgr.MaxLag());
+
+  // Runs on the calling thread again
+  mgr.RunOnce(ignition::common::Time(12, 0));
+  EXPECT_EQ(11u, mgr.CompletedFence());
+}
+
 //////////////////////////////////////////////////
 int main(int argc, char **argv)
 {
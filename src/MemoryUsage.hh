@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef IGNITION_SENSORS_MEMORYUSAGE_HH_
+#define IGNITION_SENSORS_MEMORYUSAGE_HH_
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <google/protobuf/message.h>
+#include <sdf/Element.hh>
+
+#include "ignition/sensors/config.hh"
+
+namespace ignition
+{
+  namespace sensors
+  {
+    // Inline bracket to help doxygen filtering.
+    inline namespace IGNITION_SENSORS_VERSION_NAMESPACE {
+    //
+    /// \brief Helpers to estimate the heap memory held by the members of
+    /// sensors, see Sensor::MemoryUsage().
+    namespace memory
+    {
+      /// \brief Get the memory held by a vector.
+      /// \param[in] _vector The vector.
+      /// \return Bytes reserved by the vector.
+      template<typename T>
+      std::size_t Bytes(const std::vector<T> &_vector)
+      {
+        return _vector.capacity() * sizeof(T);
+      }
+
+      /// \brief Get the memory held by a vector of vectors.
+      /// \param[in] _vectors The vectors.
+      /// \return Bytes reserved by the outer and inner vectors.
+      template<typename T>
+      std::size_t Bytes(const std::vector<std::vector<T>> &_vectors)
+      {
+        std::size_t bytes = _vectors.capacity() * sizeof(std::vector<T>);
+        for (const auto &vector : _vectors)
+          bytes += Bytes(vector);
+        return bytes;
+      }
+
+      /// \brief Get the memory a string allocated.
+      /// \param[in] _string The string.
+      /// \return Bytes allocated, zero if the characters fit in the string
+      /// object.
+      inline std::size_t Bytes(const std::string &_string)
+      {
+        const char *object = reinterpret_cast<const char *>(&_string);
+        const char *data = _string.data();
+        if (data >= object && data < object + sizeof(std::string))
+          return 0u;
+        return _string.capacity() + 1u;
+      }
+
+      /// \brief Get the memory held by a message.
+      /// \param[in] _msg The message.
+      /// \return Bytes used by the message object and its fields.
+      inline std::size_t Bytes(const google::protobuf::Message &_msg)
+      {
+#if GOOGLE_PROTOBUF_VERSION >= 3004000
+        return static_cast<std::size_t>(_msg.SpaceUsedLong());
+#else
+        return static_cast<std::size_t>(_msg.SpaceUsed());
+#endif
+      }
+
+      /// \brief Estimate the memory held by an SDF element from the size
+      /// of its text.
+      /// \param[in] _sdf The element, may be null.
+      /// \return Estimated bytes.
+      inline std::size_t Bytes(const sdf::ElementPtr &_sdf)
+      {
+        return _sdf ? _sdf->ToString("").size() : 0u;
+      }
+
+      /// \brief Get the memory held by a map with string keys, excluding
+      /// the memory held by the values.
+      /// \param[in] _map The map.
+      /// \return Bytes of the nodes and keys.
+      template<typename T>
+      std::size_t Bytes(const std::map<std::string, T> &_map)
+      {
+        // A tree node holds the value, three links and a color
+        std::size_t bytes = _map.size() *
+            (sizeof(typename std::map<std::string, T>::value_type) +
+             4u * sizeof(void *));
+        for (const auto &entry : _map)
+          bytes += Bytes(entry.first);
+        return bytes;
+      }
+    }
+    }
+  }
+}
+
+#endif
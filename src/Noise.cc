@@ -168,3 +168,15 @@ void Noise::Print(std::ostream &_out) const
     << "does not have an overloaded Print function. "
     << "No more information is available.";
 }
+
+//////////////////////////////////////////////////
+bool Noise::SaveState(std::ostream &/*_out*/) const
+{
+  return true;
+}
+
+//////////////////////////////////////////////////
+bool Noise::LoadState(std::istream &/*_in*/)
+{
+  return true;
+}
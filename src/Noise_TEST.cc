@@ -18,6 +18,7 @@
 #include <gtest/gtest.h>
 
 #include <numeric>
+#include <sstream>
 
 #include <ignition/math/Rand.hh>
 
@@ -403,6 +404,50 @@ TEST(NoiseTest, OnApplyNoise)
   }
 }
 
+//////////////////////////////////////////////////
+TEST(NoiseTest, SaveLoadState)
+{
+  ignition::math::Rand::Seed(42);
+  sensors::NoisePtr noise = sensors::NoiseFactory::NewNoiseModel(
+      NoiseSdf("gaussian", 0.5, 2.0, 1.0, 3.0, 0));
+  for (unsigned int i = 0; i < g_applyCount; ++i)
+    noise->Apply(1.0, 0.01);
+
+  std::stringstream stream;
+  ASSERT_TRUE(noise->SaveState(stream));
+
+  std::vector<double> expected;
+  for (unsigned int i = 0; i < g_applyCount; ++i)
+    expected.push_back(noise->Apply(1.0, 0.01));
+
+  // A model loaded from the same SDF continues the same samples, whatever
+  // was drawn from the global generator in between
+  sensors::NoisePtr restored = sensors::NoiseFactory::NewNoiseModel(
+      NoiseSdf("gaussian", 0.5, 2.0, 1.0, 3.0, 0));
+  ignition::math::Rand::DblNormal(0, 1);
+  ASSERT_TRUE(restored->LoadState(stream));
+  EXPECT_DOUBLE_EQ(
+      std::dynamic_pointer_cast<sensors::GaussianNoiseModel>(noise)->Bias(),
+      std::dynamic_pointer_cast<sensors::GaussianNoiseModel>(
+      restored)->Bias());
+  for (unsigned int i = 0; i < g_applyCount; ++i)
+    EXPECT_DOUBLE_EQ(expected[i], restored->Apply(1.0, 0.01));
+
+  // A truncated state is rejected
+  std::stringstream truncated;
+  noise->SaveState(truncated);
+  std::string data = truncated.str();
+  std::stringstream shortStream(data.substr(0, data.size() / 2));
+  EXPECT_FALSE(restored->LoadState(shortStream));
+
+  // Models without state accept any stream
+  sensors::NoisePtr none(new sensors::Noise(sensors::NoiseType::NONE));
+  std::stringstream empty;
+  EXPECT_TRUE(none->SaveState(empty));
+  EXPECT_TRUE(empty.str().empty());
+  EXPECT_TRUE(none->LoadState(empty));
+}
+
 /////////////////////////////////////////////////
 int main(int argc, char **argv)
 {
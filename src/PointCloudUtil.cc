@@ -15,6 +15,11 @@
  *
 */
 
+#include <cmath>
+#include <cstring>
+
+#include <ignition/math/Matrix3.hh>
+
 #include "PointCloudUtil.hh"
 
 using namespace ignition;
@@ -35,56 +40,64 @@ void PointCloudUtil::FillMsg(msgs::PointCloudPacked &_msg,
   msgBuffer->resize(_msg.row_step() * _msg.height());
   char *msgBufferIndex = msgBuffer->data();
 
+  // The layout of the points doesn't change within the cloud
+  const uint32_t pointStep = _msg.point_step();
+  const uint32_t xOffset = _msg.field(0).offset();
+  const uint32_t yOffset = _msg.field(1).offset();
+  const uint32_t zOffset = _msg.field(2).offset();
+  const uint32_t rgbOffset = _msg.field(3).offset();
+  const bool bigEndian = _msg.is_bigendian();
+
   // For depth calculation from image
   double fl = width / (2.0 * std::tan(_hfov.Radian() / 2.0));
 
-  // Iterate over scan and populate point cloud
-  for (uint32_t j = 0; j < height; ++j)
+  this->WithTransform([&](const auto &_transform)
   {
-    float pAngle = 0.0;
-    if (fl > 0 && height > 1)
-      pAngle = std::atan2((height-j-1) - 0.5 * (height - 1), fl);
-
-    for (uint32_t i = 0; i < width; ++i)
+    // Iterate over scan and populate point cloud
+    for (uint32_t j = 0; j < height; ++j)
     {
-      int fieldIndex = 0;
-
-      // Current point depth
-      float depth = _depthData[j * width + i];
-
-      float yAngle = 0.0;
-      if (fl > 0 && width > 1)
-        yAngle = std::atan2(0.5 * (width - 1) - i, fl);
-
-      *reinterpret_cast<float*>(msgBufferIndex +
-          _msg.field(fieldIndex++).offset()) = depth;
-      *reinterpret_cast<float*>(msgBufferIndex +
-          _msg.field(fieldIndex++).offset()) =
-        depth * std::tan(yAngle);
-      *reinterpret_cast<float*>(msgBufferIndex +
-          _msg.field(fieldIndex++).offset()) =
-        depth * std::tan(pAngle);
-
-      int imgIndex = i * 3 + j * width * 3;
-      int fieldOffset = _msg.field(fieldIndex).offset();
-      // Put image color data for each point, check endianess first.
-      if (_msg.is_bigendian())
-      {
-        *(msgBufferIndex + fieldOffset + 0) = _imageData[imgIndex + 0];
-        *(msgBufferIndex + fieldOffset + 1) = _imageData[imgIndex + 1];
-        *(msgBufferIndex + fieldOffset + 2) = _imageData[imgIndex + 2];
-      }
-      else
+      float pAngle = 0.0;
+      if (fl > 0 && height > 1)
+        pAngle = std::atan2((height-j-1) - 0.5 * (height - 1), fl);
+
+      for (uint32_t i = 0; i < width; ++i)
       {
-        *(msgBufferIndex + fieldOffset + 0) = _imageData[imgIndex + 2];
-        *(msgBufferIndex + fieldOffset + 1) = _imageData[imgIndex + 1];
-        *(msgBufferIndex + fieldOffset + 2) = _imageData[imgIndex + 0];
+        // Current point depth
+        float depth = _depthData[j * width + i];
+
+        float yAngle = 0.0;
+        if (fl > 0 && width > 1)
+          yAngle = std::atan2(0.5 * (width - 1) - i, fl);
+
+        float x = depth;
+        float y = depth * std::tan(yAngle);
+        float z = depth * std::tan(pAngle);
+        _transform(x, y, z);
+
+        *reinterpret_cast<float*>(msgBufferIndex + xOffset) = x;
+        *reinterpret_cast<float*>(msgBufferIndex + yOffset) = y;
+        *reinterpret_cast<float*>(msgBufferIndex + zOffset) = z;
+
+        int imgIndex = i * 3 + j * width * 3;
+        // Put image color data for each point, check endianess first.
+        if (bigEndian)
+        {
+          *(msgBufferIndex + rgbOffset + 0) = _imageData[imgIndex + 0];
+          *(msgBufferIndex + rgbOffset + 1) = _imageData[imgIndex + 1];
+          *(msgBufferIndex + rgbOffset + 2) = _imageData[imgIndex + 2];
+        }
+        else
+        {
+          *(msgBufferIndex + rgbOffset + 0) = _imageData[imgIndex + 2];
+          *(msgBufferIndex + rgbOffset + 1) = _imageData[imgIndex + 1];
+          *(msgBufferIndex + rgbOffset + 2) = _imageData[imgIndex + 0];
+        }
+
+        // Add any padding
+        msgBufferIndex += pointStep;
       }
-
-      // Add any padding
-      msgBufferIndex += _msg.point_step();
     }
-  }
+  });
 }
 
 //////////////////////////////////////////////////
@@ -98,48 +111,55 @@ void PointCloudUtil::FillMsg(msgs::PointCloudPacked &_msg,
   msgBuffer->resize(_msg.row_step() * _msg.height());
   char *msgBufferIndex = msgBuffer->data();
 
-  // Iterate over scan and populate point cloud
-  for (uint32_t j = 0; j < height; ++j)
+  // The layout of the points doesn't change within the cloud
+  const uint32_t pointStep = _msg.point_step();
+  const uint32_t xOffset = _msg.field(0).offset();
+  const uint32_t yOffset = _msg.field(1).offset();
+  const uint32_t zOffset = _msg.field(2).offset();
+  const uint32_t rgbOffset = _msg.field(3).offset();
+  const bool bigEndian = _msg.is_bigendian();
+
+  this->WithTransform([&](const auto &_transform)
   {
-    int step = j*width*3;
-    for (uint32_t i = 0; i < width; ++i)
+    // Iterate over scan and populate point cloud
+    for (uint32_t j = 0; j < height; ++j)
     {
-      int index = step + i*3;
-      float x = _xyzData[index];
-      float y = _xyzData[index + 1];
-      float z = _xyzData[index + 2];
-
-      int fieldIndex = 0;
-      *reinterpret_cast<float*>(msgBufferIndex +
-          _msg.field(fieldIndex++).offset()) = x;
-      *reinterpret_cast<float*>(msgBufferIndex +
-          _msg.field(fieldIndex++).offset()) = y;
-      *reinterpret_cast<float*>(msgBufferIndex +
-          _msg.field(fieldIndex++).offset()) = z;
-
-      uint8_t r = static_cast<uint8_t>(_imageData[index]);
-      uint8_t g = static_cast<uint8_t>(_imageData[index + 1]);
-      uint8_t b = static_cast<uint8_t>(_imageData[index + 2]);
-
-      int fieldOffset = _msg.field(fieldIndex).offset();
-      // Put image color data for each point, check endianess first.
-      if (_msg.is_bigendian())
+      int step = j*width*3;
+      for (uint32_t i = 0; i < width; ++i)
       {
-        *(msgBufferIndex + fieldOffset + 0) = r;
-        *(msgBufferIndex + fieldOffset + 1) = g;
-        *(msgBufferIndex + fieldOffset + 2) = b;
+        int index = step + i*3;
+        float x = _xyzData[index];
+        float y = _xyzData[index + 1];
+        float z = _xyzData[index + 2];
+        _transform(x, y, z);
+
+        *reinterpret_cast<float*>(msgBufferIndex + xOffset) = x;
+        *reinterpret_cast<float*>(msgBufferIndex + yOffset) = y;
+        *reinterpret_cast<float*>(msgBufferIndex + zOffset) = z;
+
+        uint8_t r = static_cast<uint8_t>(_imageData[index]);
+        uint8_t g = static_cast<uint8_t>(_imageData[index + 1]);
+        uint8_t b = static_cast<uint8_t>(_imageData[index + 2]);
+
+        // Put image color data for each point, check endianess first.
+        if (bigEndian)
+        {
+          *(msgBufferIndex + rgbOffset + 0) = r;
+          *(msgBufferIndex + rgbOffset + 1) = g;
+          *(msgBufferIndex + rgbOffset + 2) = b;
+        }
+        else
+        {
+          *(msgBufferIndex + rgbOffset + 0) = b;
+          *(msgBufferIndex + rgbOffset + 1) = g;
+          *(msgBufferIndex + rgbOffset + 2) = r;
+        }
+
+        // Add any padding
+        msgBufferIndex += pointStep;
       }
-      else
-      {
-        *(msgBufferIndex + fieldOffset + 0) = b;
-        *(msgBufferIndex + fieldOffset + 1) = g;
-        *(msgBufferIndex + fieldOffset + 2) = r;
-      }
-
-      // Add any padding
-      msgBufferIndex += _msg.point_step();
     }
-  }
+  });
 }
 
 //////////////////////////////////////////////////
@@ -155,67 +175,79 @@ void PointCloudUtil::FillMsg(msgs::PointCloudPacked &_msg,
   msgBuffer->resize(_msg.row_step() * _msg.height());
   char *msgBufferIndex = msgBuffer->data();
 
-  // Iterate over scan and populate point cloud
-  for (uint32_t j = 0; j < height; ++j)
+  // The layout of the points doesn't change within the cloud
+  const uint32_t pointStep = _msg.point_step();
+  const uint32_t xOffset = _msg.field(0).offset();
+  const uint32_t yOffset = _msg.field(1).offset();
+  const uint32_t zOffset = _msg.field(2).offset();
+  const uint32_t rgbOffset = _msg.field(3).offset();
+  const bool bigEndian = _msg.is_bigendian();
+
+  this->WithTransform([&](const auto &_transform)
   {
-    int pcStep = j*width*4;
-    int imgStep = j*width*3;
-    for (uint32_t i = 0; i < width; ++i)
+    // Iterate over scan and populate point cloud
+    for (uint32_t j = 0; j < height; ++j)
     {
-      int pcIndex = pcStep + i*4;
-      float x = _pointCloudData[pcIndex];
-      float y = _pointCloudData[pcIndex + 1];
-      float z = _pointCloudData[pcIndex + 2];
-      float rgba = _pointCloudData[pcIndex + 3];
-
-      int fieldIndex = 0;
-      *reinterpret_cast<float*>(msgBufferIndex +
-          _msg.field(fieldIndex++).offset()) = x;
-      *reinterpret_cast<float*>(msgBufferIndex +
-          _msg.field(fieldIndex++).offset()) = y;
-      *reinterpret_cast<float*>(msgBufferIndex +
-          _msg.field(fieldIndex++).offset()) = z;
-
-      uint8_t r = 0u;
-      uint8_t g = 0u;
-      uint8_t b = 0u;
-      uint8_t a = 255u;
-      this->DecodeRGBAFromFloat(rgba, r, g, b, a);
-
-      int fieldOffset = _msg.field(fieldIndex).offset();
-      // Put image color data for each point, check endianess first.
-      if (_msg.is_bigendian())
-      {
-        *(msgBufferIndex + fieldOffset + 0) = r;
-        *(msgBufferIndex + fieldOffset + 1) = g;
-        *(msgBufferIndex + fieldOffset + 2) = b;
-      }
-      else
-      {
-        *(msgBufferIndex + fieldOffset + 0) = b;
-        *(msgBufferIndex + fieldOffset + 1) = g;
-        *(msgBufferIndex + fieldOffset + 2) = r;
-      }
-
-      // Add any padding
-      msgBufferIndex += _msg.point_step();
-
-      // Fill buffers
-      int imgIndex = imgStep + i * 3;
-      if (_writeToBuffers && _xyzData)
-      {
-        _xyzData[imgIndex + 0] = x;
-        _xyzData[imgIndex + 1] = y;
-        _xyzData[imgIndex + 2] = z;
-      }
-      if (_writeToBuffers && _imageData)
+      int pcStep = j*width*4;
+      int imgStep = j*width*3;
+      for (uint32_t i = 0; i < width; ++i)
       {
-        _imageData[imgIndex + 0] = static_cast<unsigned char>(r);
-        _imageData[imgIndex + 1] = static_cast<unsigned char>(g);
-        _imageData[imgIndex + 2] = static_cast<unsigned char>(b);
+        int pcIndex = pcStep + i*4;
+        float x = _pointCloudData[pcIndex];
+        float y = _pointCloudData[pcIndex + 1];
+        float z = _pointCloudData[pcIndex + 2];
+        float rgba = _pointCloudData[pcIndex + 3];
+
+        // The buffers keep the points in the sensor frame
+        float tx = x;
+        float ty = y;
+        float tz = z;
+        _transform(tx, ty, tz);
+
+        *reinterpret_cast<float*>(msgBufferIndex + xOffset) = tx;
+        *reinterpret_cast<float*>(msgBufferIndex + yOffset) = ty;
+        *reinterpret_cast<float*>(msgBufferIndex + zOffset) = tz;
+
+        uint8_t r = 0u;
+        uint8_t g = 0u;
+        uint8_t b = 0u;
+        uint8_t a = 255u;
+        this->DecodeRGBAFromFloat(rgba, r, g, b, a);
+
+        // Put image color data for each point, check endianess first.
+        if (bigEndian)
+        {
+          *(msgBufferIndex + rgbOffset + 0) = r;
+          *(msgBufferIndex + rgbOffset + 1) = g;
+          *(msgBufferIndex + rgbOffset + 2) = b;
+        }
+        else
+        {
+          *(msgBufferIndex + rgbOffset + 0) = b;
+          *(msgBufferIndex + rgbOffset + 1) = g;
+          *(msgBufferIndex + rgbOffset + 2) = r;
+        }
+
+        // Add any padding
+        msgBufferIndex += pointStep;
+
+        // Fill buffers
+        int imgIndex = imgStep + i * 3;
+        if (_writeToBuffers && _xyzData)
+        {
+          _xyzData[imgIndex + 0] = x;
+          _xyzData[imgIndex + 1] = y;
+          _xyzData[imgIndex + 2] = z;
+        }
+        if (_writeToBuffers && _imageData)
+        {
+          _imageData[imgIndex + 0] = static_cast<unsigned char>(r);
+          _imageData[imgIndex + 1] = static_cast<unsigned char>(g);
+          _imageData[imgIndex + 2] = static_cast<unsigned char>(b);
+        }
       }
     }
-  }
+  });
 }
 
 
@@ -277,3 +309,144 @@ void PointCloudUtil::DecodeRGBAFromFloat(float _rgba,
   _b = static_cast<uint8_t>(*rgba >> 8 & 0xFF);
   _a = static_cast<uint8_t>(*rgba >> 0 & 0xFF);
 }
+
+//////////////////////////////////////////////////
+void PointCloudUtil::SetTransform(const math::Pose3d &_pose)
+{
+  const math::Matrix3d rot(_pose.Rot());
+  for (unsigned int r = 0u; r < 3u; ++r)
+  {
+    for (unsigned int c = 0u; c < 3u; ++c)
+      this->transform.m[r * 4u + c] = static_cast<float>(rot(r, c));
+    this->transform.m[r * 4u + 3u] = static_cast<float>(_pose.Pos()[r]);
+  }
+  this->hasTransform = true;
+}
+
+//////////////////////////////////////////////////
+void PointCloudUtil::ClearTransform()
+{
+  this->hasTransform = false;
+}
+
+//////////////////////////////////////////////////
+bool PointCloudUtil::HasTransform() const
+{
+  return this->hasTransform;
+}
+
+//////////////////////////////////////////////////
+void PointCloudUtil::SetFrameId(msgs::PointCloudPacked &_msg,
+    const std::string &_frameId) const
+{
+  auto header = _msg.mutable_header();
+  for (int i = 0; i < header->data_size(); ++i)
+  {
+    if (header->data(i).key() == "frame_id")
+    {
+      if (header->data(i).value_size() == 0)
+        header->mutable_data(i)->add_value(_frameId);
+      else
+        header->mutable_data(i)->set_value(0, _frameId);
+      return;
+    }
+  }
+  auto frame = header->add_data();
+  frame->set_key("frame_id");
+  frame->add_value(_frameId);
+}
+
+//////////////////////////////////////////////////
+void PointCloudUtil::SetTargetFrame(msgs::PointCloudPacked &_msg,
+    const std::string &_sensorFrameId, const std::string &_targetFrameId,
+    const math::Pose3d &_sensorPose, const math::Pose3d &_targetPose)
+{
+  if (_targetFrameId.empty())
+  {
+    this->ClearTransform();
+    this->SetFrameId(_msg, _sensorFrameId);
+  }
+  else
+  {
+    // Pose of the sensor expressed in the target frame
+    this->SetTransform(_sensorPose * _targetPose.Inverse());
+    this->SetFrameId(_msg, _targetFrameId);
+  }
+}
+
+//////////////////////////////////////////////////
+uint32_t PointCloudUtil::Compact(const msgs::PointCloudPacked &_msg,
+    bool _index, msgs::PointCloudPacked &_dense) const
+{
+  const uint32_t width = _msg.width();
+  const uint32_t height = _msg.height();
+  const uint32_t pointStep = _msg.point_step();
+  const uint32_t denseStep = _index ? pointStep + 2u * sizeof(uint16_t) :
+      pointStep;
+
+  *_dense.mutable_header() = _msg.header();
+  _dense.mutable_field()->CopyFrom(_msg.field());
+  if (_index)
+  {
+    const char *names[] = {"row", "column"};
+    for (unsigned int f = 0u; f < 2u; ++f)
+    {
+      auto field = _dense.add_field();
+      field->set_name(names[f]);
+      field->set_offset(pointStep + f * sizeof(uint16_t));
+      field->set_datatype(msgs::PointCloudPacked::Field::UINT16);
+      field->set_count(1);
+    }
+  }
+  _dense.set_is_bigendian(_msg.is_bigendian());
+  _dense.set_point_step(denseStep);
+
+  std::string *data = _dense.mutable_data();
+  data->resize(static_cast<std::size_t>(width) * height * denseStep);
+  if (_msg.field_size() < 3 ||
+      _msg.data().size() < static_cast<std::size_t>(_msg.row_step()) * height)
+  {
+    data->clear();
+  }
+
+  uint32_t count = 0u;
+  if (!data->empty())
+  {
+    const uint32_t xOffset = _msg.field(0).offset();
+    const uint32_t yOffset = _msg.field(1).offset();
+    const uint32_t zOffset = _msg.field(2).offset();
+    char *dense = &(*data)[0];
+    for (uint32_t j = 0u; j < height; ++j)
+    {
+      const char *point = _msg.data().data() + j * _msg.row_step();
+      for (uint32_t i = 0u; i < width; ++i, point += pointStep)
+      {
+        float x, y, z;
+        std::memcpy(&x, point + xOffset, sizeof(float));
+        std::memcpy(&y, point + yOffset, sizeof(float));
+        std::memcpy(&z, point + zOffset, sizeof(float));
+
+        // Every point is written, and only valid points are kept by
+        // moving past them. A kept point never overruns the buffer.
+        std::memcpy(dense, point, pointStep);
+        if (_index)
+        {
+          const uint16_t position[] = {static_cast<uint16_t>(j),
+              static_cast<uint16_t>(i)};
+          std::memcpy(dense + pointStep, position, sizeof(position));
+        }
+        const bool valid = std::isfinite(x) & std::isfinite(y) &
+            std::isfinite(z);
+        dense += valid ? denseStep : 0u;
+        count += valid ? 1u : 0u;
+      }
+    }
+  }
+
+  data->resize(static_cast<std::size_t>(count) * denseStep);
+  _dense.set_width(count);
+  _dense.set_height(1u);
+  _dense.set_row_step(count * denseStep);
+  _dense.set_is_dense(true);
+  return count;
+}
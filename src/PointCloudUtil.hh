@@ -19,7 +19,11 @@
 #define IGNITION_SENSORS_POINTCLOUDUTIL_HH_
 
 #include <ignition/msgs/pointcloud_packed.pb.h>
+
+#include <string>
+
 #include <ignition/math/Angle.hh>
+#include <ignition/math/Pose3.hh>
 
 #include "ignition/sensors/config.hh"
 #include "ignition/sensors/Export.hh"
@@ -41,6 +45,37 @@ namespace ignition
     // Inline bracket to help doxygen filtering.
     inline namespace IGNITION_SENSORS_VERSION_NAMESPACE {
     //
+    /// \brief Rigid transform that fill loops apply to each point, as a
+    /// 3x4 matrix product.
+    struct PointTransform
+    {
+      /// \brief Transform a point.
+      /// \param[in,out] _x X coordinate.
+      /// \param[in,out] _y Y coordinate.
+      /// \param[in,out] _z Z coordinate.
+      void operator()(float &_x, float &_y, float &_z) const
+      {
+        const float x = m[0] * _x + m[1] * _y + m[2] * _z + m[3];
+        const float y = m[4] * _x + m[5] * _y + m[6] * _z + m[7];
+        const float z = m[8] * _x + m[9] * _y + m[10] * _z + m[11];
+        _x = x;
+        _y = y;
+        _z = z;
+      }
+
+      /// \brief Rows of the matrix.
+      float m[12];
+    };
+
+    /// \brief Transform of fill loops that keep points in the sensor frame.
+    struct NoTransform
+    {
+      /// \brief Leave a point unchanged.
+      void operator()(float &, float &, float &) const
+      {
+      }
+    };
+
     /// \brief Helper class that fills a msgs::PointCloudPacked message using
     /// image and depth data. The RgbdCameraSensor and DepthCameraSensor
     /// class use this.
@@ -82,6 +117,69 @@ namespace ignition
           const float *_pointCloudData, bool _writeToBuffers = false,
           unsigned char *_imageData = 0, float *_xyzData = 0) const;
 
+      /// \brief Set a rigid transform that the FillMsg functions apply to
+      /// the points they write to the message, such as the pose of the
+      /// sensor in the world, so that consumers don't need another pass
+      /// over the cloud. Buffers written by FillMsg keep the points in
+      /// the sensor frame. Infinite points may become NaN.
+      /// \param[in] _pose Pose of the sensor frame in the target frame.
+      public: void SetTransform(const math::Pose3d &_pose);
+
+      /// \brief Stop transforming points, they are written in the sensor
+      /// frame.
+      public: void ClearTransform();
+
+      /// \brief Get whether points are transformed.
+      /// \return True if a transform is set.
+      public: bool HasTransform() const;
+
+      /// \brief Run a fill loop with the transform to apply to its points,
+      /// a PointTransform if one is set and a NoTransform otherwise. The
+      /// loop is compiled for each, so it doesn't check for a transform at
+      /// every point.
+      /// \param[in] _fill Function taking the transform.
+      public: template<typename Fill>
+              void WithTransform(Fill &&_fill) const
+      {
+        if (this->hasTransform)
+          _fill(this->transform);
+        else
+          _fill(NoTransform());
+      }
+
+      /// \brief Set the frame id in the header of a point cloud.
+      /// \param[in,out] _msg Point cloud message.
+      /// \param[in] _frameId Frame id.
+      public: void SetFrameId(msgs::PointCloudPacked &_msg,
+          const std::string &_frameId) const;
+
+      /// \brief Set the frame the next filled point cloud is in, setting
+      /// the transform and the frame id of the message.
+      /// \param[in,out] _msg Point cloud message.
+      /// \param[in] _sensorFrameId Frame id of the sensor.
+      /// \param[in] _targetFrameId Frame id to transform points to, empty
+      /// to keep them in the sensor frame.
+      /// \param[in] _sensorPose Pose of the sensor in the world.
+      /// \param[in] _targetPose Pose of the target frame in the world.
+      public: void SetTargetFrame(msgs::PointCloudPacked &_msg,
+          const std::string &_sensorFrameId,
+          const std::string &_targetFrameId, const math::Pose3d &_sensorPose,
+          const math::Pose3d &_targetPose);
+
+      /// \brief Copy the points of an organized point cloud that have a
+      /// finite position into an unorganized, dense point cloud. Points
+      /// are copied whole, without branching on their validity, so that
+      /// the loop stays fast when most points are invalid.
+      /// \param[in] _msg Organized point cloud whose first three fields are
+      /// x, y and z.
+      /// \param[in] _index True to add UINT16 "row" and "column" fields
+      /// holding the position of each point in _msg.
+      /// \param[out] _dense Dense point cloud, with the header and fields
+      /// of _msg.
+      /// \return Number of points kept.
+      public: uint32_t Compact(const msgs::PointCloudPacked &_msg,
+          bool _index, msgs::PointCloudPacked &_dense) const;
+
       /// \brief Extract RGB data from point cloud data
       /// \param[out] _imageData RGB Image buffer to be filled.
       /// \param[in] _pointCloudData Point cloud XYZ data.
@@ -111,6 +209,12 @@ namespace ignition
       /// \param[out] _a Alpha [0-255]
       public: void DecodeRGBAFromFloat(float _rgba, uint8_t &_r, uint8_t &_g,
           uint8_t &_b, uint8_t &_a) const;
+
+      /// \brief Transform of the points.
+      private: PointTransform transform{{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0}};
+
+      /// \brief Whether points are transformed.
+      private: bool hasTransform = false;
     };
     }
   }
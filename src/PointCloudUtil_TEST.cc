@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstring>
+#include <string>
+
+#include <ignition/math/Helpers.hh>
+#include <ignition/math/Pose3.hh>
+#include <ignition/msgs/Utility.hh>
+
+#include "PointCloudUtil.hh"
+
+using namespace ignition;
+using namespace sensors;
+
+//////////////////////////////////////////////////
+TEST(PointCloudUtil_TEST, Compact)
+{
+  // Organized 3x2 cloud, where three points have no return
+  msgs::PointCloudPacked msg;
+  msgs::InitPointCloudPacked(msg, "frame", true,
+      {{"xyz", msgs::PointCloudPacked::Field::FLOAT32},
+      {"intensity", msgs::PointCloudPacked::Field::FLOAT32}});
+  msg.set_width(3u);
+  msg.set_height(2u);
+  msg.set_row_step(msg.point_step() * msg.width());
+  msg.set_is_dense(false);
+  msg.mutable_header()->mutable_stamp()->set_sec(4);
+
+  const float inf = math::INF_F;
+  const float nan = math::NAN_F;
+  const float points[][4] = {
+      {1, 2, 3, 10}, {inf, inf, inf, 0}, {4, 5, 6, 20},
+      {nan, 0, 0, 0}, {0, -inf, 0, 0}, {7, 8, 9, 30}};
+  msg.mutable_data()->resize(msg.row_step() * msg.height());
+  for (unsigned int k = 0u; k < 6u; ++k)
+  {
+    char *point = &(*msg.mutable_data())[k * msg.point_step()];
+    for (int f = 0; f < 4; ++f)
+    {
+      std::memcpy(point + msg.field(f).offset(), &points[k][f],
+          sizeof(float));
+    }
+  }
+
+  auto value = [](const msgs::PointCloudPacked &_cloud, unsigned int _point,
+      int _field)
+  {
+    float result;
+    std::memcpy(&result, _cloud.data().data() + _point * _cloud.point_step() +
+        _cloud.field(_field).offset(), sizeof(float));
+    return result;
+  };
+
+  PointCloudUtil util;
+  msgs::PointCloudPacked dense;
+  EXPECT_EQ(3u, util.Compact(msg, false, dense));
+  EXPECT_EQ(3u, dense.width());
+  EXPECT_EQ(1u, dense.height());
+  EXPECT_TRUE(dense.is_dense());
+  EXPECT_EQ(4, dense.header().stamp().sec());
+  EXPECT_EQ(msg.field_size(), dense.field_size());
+  EXPECT_EQ(msg.point_step(), dense.point_step());
+  EXPECT_EQ(dense.point_step() * 3u, dense.row_step());
+  ASSERT_EQ(dense.row_step(), dense.data().size());
+  const unsigned int kept[] = {0u, 2u, 5u};
+  for (unsigned int p = 0u; p < 3u; ++p)
+  {
+    for (int f = 0; f < 4; ++f)
+      EXPECT_FLOAT_EQ(points[kept[p]][f], value(dense, p, f));
+  }
+
+  // The position of each point can be kept
+  EXPECT_EQ(3u, util.Compact(msg, true, dense));
+  ASSERT_EQ(msg.field_size() + 2, dense.field_size());
+  EXPECT_EQ("row", dense.field(4).name());
+  EXPECT_EQ("column", dense.field(5).name());
+  EXPECT_EQ(msg.point_step() + 4u, dense.point_step());
+  ASSERT_EQ(dense.point_step() * 3u, dense.data().size());
+  for (unsigned int p = 0u; p < 3u; ++p)
+  {
+    EXPECT_FLOAT_EQ(points[kept[p]][3], value(dense, p, 3));
+    uint16_t row, column;
+    const char *point = dense.data().data() + p * dense.point_step();
+    std::memcpy(&row, point + dense.field(4).offset(), sizeof(row));
+    std::memcpy(&column, point + dense.field(5).offset(), sizeof(column));
+    EXPECT_EQ(kept[p] / 3u, row);
+    EXPECT_EQ(kept[p] % 3u, column);
+  }
+
+  // A cloud without valid points is empty
+  msg.set_height(1u);
+  msg.mutable_data()->resize(msg.row_step());
+  std::memcpy(&(*msg.mutable_data())[0], &nan, sizeof(float));
+  std::memcpy(&(*msg.mutable_data())[2 * msg.point_step()], &nan,
+      sizeof(float));
+  EXPECT_EQ(0u, util.Compact(msg, false, dense));
+  EXPECT_EQ(0u, dense.width());
+  EXPECT_TRUE(dense.data().empty());
+}
+
+//////////////////////////////////////////////////
+TEST(PointCloudUtil_TEST, TargetFrame)
+{
+  msgs::PointCloudPacked msg;
+  msgs::InitPointCloudPacked(msg, "sensor", true,
+      {{"xyz", msgs::PointCloudPacked::Field::FLOAT32},
+      {"rgb", msgs::PointCloudPacked::Field::FLOAT32}});
+  msg.set_width(2u);
+  msg.set_height(1u);
+  msg.set_row_step(msg.point_step() * msg.width());
+
+  const float xyz[] = {1, 0, 0, 0, 2, -1};
+  const unsigned char rgb[] = {10, 20, 30, 40, 50, 60};
+  auto point = [&msg](unsigned int _point)
+  {
+    float values[3];
+    for (int f = 0; f < 3; ++f)
+    {
+      std::memcpy(&values[f], msg.data().data() + _point * msg.point_step() +
+          msg.field(f).offset(), sizeof(float));
+    }
+    return math::Vector3d(values[0], values[1], values[2]);
+  };
+  auto frameId = [&msg]()
+  {
+    for (const auto &data : msg.header().data())
+    {
+      if (data.key() == "frame_id")
+        return data.value(0);
+    }
+    return std::string();
+  };
+
+  // Points are transformed by the pose of the sensor in the target frame
+  PointCloudUtil util;
+  EXPECT_FALSE(util.HasTransform());
+  const math::Pose3d pose(1, 2, 3, 0, 0, IGN_PI_2);
+  util.SetTargetFrame(msg, "sensor", "world", pose, math::Pose3d::Zero);
+  EXPECT_TRUE(util.HasTransform());
+  EXPECT_EQ("world", frameId());
+  util.FillMsg(msg, xyz, rgb);
+  EXPECT_EQ(math::Vector3d(1, 3, 3), point(0u));
+  EXPECT_EQ(math::Vector3d(-1, 2, 2), point(1u));
+
+  // The target frame may be anywhere in the world
+  const math::Pose3d basePose(1, 0, 0, 0, 0, IGN_PI_2);
+  util.SetTargetFrame(msg, "sensor", "base", pose, basePose);
+  EXPECT_EQ("base", frameId());
+  util.FillMsg(msg, xyz, rgb);
+  EXPECT_EQ(math::Vector3d(3, 0, 3), point(0u));
+  EXPECT_EQ(math::Vector3d(2, 2, 2), point(1u));
+
+  // Buffers written while filling keep the points in the sensor frame
+  const float xyzrgba[] = {1, 0, 0, 0, 0, 2, -1, 0};
+  float xyzOut[6];
+  unsigned char rgbOut[6];
+  util.FillMsg(msg, xyzrgba, true, rgbOut, xyzOut);
+  EXPECT_EQ(math::Vector3d(3, 0, 3), point(0u));
+  EXPECT_EQ(math::Vector3d(2, 2, 2), point(1u));
+  for (int k = 0; k < 6; ++k)
+    EXPECT_FLOAT_EQ(xyz[k], xyzOut[k]);
+
+  // Without a target frame, points stay in the sensor frame
+  util.SetTargetFrame(msg, "sensor", "", pose, basePose);
+  EXPECT_FALSE(util.HasTransform());
+  EXPECT_EQ("sensor", frameId());
+  util.FillMsg(msg, xyz, rgb);
+  EXPECT_EQ(math::Vector3d(1, 0, 0), point(0u));
+  EXPECT_EQ(math::Vector3d(0, 2, -1), point(1u));
+}
+
+//////////////////////////////////////////////////
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,1149 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <ignition/common/Console.hh>
+#include <ignition/common/SubMesh.hh>
+#include <ignition/common/WorkerPool.hh>
+
+#include "ignition/sensors/RayScene.hh"
+#include "ignition/sensors/Tracing.hh"
+
+using namespace ignition;
+using namespace sensors;
+
+namespace
+{
+  /// \brief Number of rays traced together.
+  const unsigned int kPacketSize = 8u;
+
+  /// \brief Number of packets a thread takes at a time.
+  const std::size_t kPacketsPerBatch = 32u;
+
+  /// \brief Largest number of items in a hierarchy leaf.
+  const uint32_t kLeafSize = 4u;
+
+  /// \brief Deepest hierarchy level. Deeper nodes become leaves, which
+  /// bounds the traversal stack.
+  const unsigned int kMaxDepth = 48u;
+
+  /// \brief Size of the traversal stack.
+  const unsigned int kStackSize = kMaxDepth + 2u;
+
+  /// \brief Marks a ray that didn't hit anything.
+  const uint32_t kNoHit = std::numeric_limits<uint32_t>::max();
+
+  const float kInf = std::numeric_limits<float>::infinity();
+
+  /// \brief Axis aligned bounding box.
+  struct Aabb
+  {
+    /// \brief Grow the box to contain a point.
+    /// \param[in] _p Point coordinates.
+    void Grow(const float *_p)
+    {
+      for (int i = 0; i < 3; ++i)
+      {
+        this->lo[i] = std::min(this->lo[i], _p[i]);
+        this->hi[i] = std::max(this->hi[i], _p[i]);
+      }
+    }
+
+    /// \brief Grow the box to contain another box.
+    /// \param[in] _box Box to contain.
+    void Grow(const Aabb &_box)
+    {
+      for (int i = 0; i < 3; ++i)
+      {
+        this->lo[i] = std::min(this->lo[i], _box.lo[i]);
+        this->hi[i] = std::max(this->hi[i], _box.hi[i]);
+      }
+    }
+
+    /// \brief Center of the box along an axis.
+    /// \param[in] _axis Axis index.
+    /// \return Center coordinate.
+    float Center(int _axis) const
+    {
+      return 0.5f * (this->lo[_axis] + this->hi[_axis]);
+    }
+
+    /// \brief Minimum corner.
+    float lo[3] = {kInf, kInf, kInf};
+
+    /// \brief Maximum corner.
+    float hi[3] = {-kInf, -kInf, -kInf};
+  };
+
+  /// \brief Node of a bounding volume hierarchy. Interior nodes have a
+  /// count of zero and store the index of their first child, the second
+  /// child follows it. Leaves store a range of items.
+  struct BvhNode
+  {
+    /// \brief Bounds of everything below the node.
+    Aabb box;
+
+    /// \brief First child or first item.
+    uint32_t first = 0u;
+
+    /// \brief Number of items in a leaf, zero for interior nodes.
+    uint32_t count = 0u;
+  };
+
+  /// \brief Bounding volume hierarchy over a set of boxes. Children are
+  /// always stored after their parent, so a reverse pass over the nodes
+  /// refits the hierarchy bottom up.
+  class Bvh
+  {
+    /// \brief Build the hierarchy.
+    /// \param[in] _boxes Bounds of each item.
+    public: void Build(const std::vector<Aabb> &_boxes)
+    {
+      this->nodes.clear();
+      this->items.resize(_boxes.size());
+      std::iota(this->items.begin(), this->items.end(), 0u);
+      if (_boxes.empty())
+        return;
+
+      this->nodes.reserve(2u * _boxes.size());
+      BvhNode root;
+      root.count = static_cast<uint32_t>(_boxes.size());
+      this->nodes.push_back(root);
+      this->Subdivide(0u, 0u, _boxes);
+    }
+
+    /// \brief Update node bounds without changing the structure.
+    /// \param[in] _boxes New bounds of each item.
+    public: void Refit(const std::vector<Aabb> &_boxes)
+    {
+      for (std::size_t i = this->nodes.size(); i-- > 0u;)
+      {
+        BvhNode &node = this->nodes[i];
+        node.box = Aabb();
+        if (node.count > 0u)
+        {
+          for (uint32_t j = node.first; j < node.first + node.count; ++j)
+            node.box.Grow(_boxes[this->items[j]]);
+        }
+        else
+        {
+          node.box.Grow(this->nodes[node.first].box);
+          node.box.Grow(this->nodes[node.first + 1u].box);
+        }
+      }
+    }
+
+    /// \brief Split a node until its leaves are small enough. Splits at
+    /// the middle of the largest centroid extent, falling back to the
+    /// median when all items fall on one side.
+    /// \param[in] _index Node index.
+    /// \param[in] _depth Depth of the node.
+    /// \param[in] _boxes Bounds of each item.
+    private: void Subdivide(uint32_t _index, unsigned int _depth,
+                 const std::vector<Aabb> &_boxes)
+    {
+      const uint32_t first = this->nodes[_index].first;
+      const uint32_t count = this->nodes[_index].count;
+
+      Aabb box;
+      Aabb centers;
+      for (uint32_t i = first; i < first + count; ++i)
+      {
+        const Aabb &b = _boxes[this->items[i]];
+        box.Grow(b);
+        const float c[3] = {b.Center(0), b.Center(1), b.Center(2)};
+        centers.Grow(c);
+      }
+      this->nodes[_index].box = box;
+
+      if (count <= kLeafSize || _depth >= kMaxDepth)
+        return;
+
+      int axis = 0;
+      for (int i = 1; i < 3; ++i)
+      {
+        if (centers.hi[i] - centers.lo[i] > centers.hi[axis] - centers.lo[axis])
+          axis = i;
+      }
+      if (!(centers.hi[axis] > centers.lo[axis]))
+        return;
+
+      auto begin = this->items.begin() + first;
+      auto end = begin + count;
+      const float split = centers.Center(axis);
+      auto middle = std::partition(begin, end, [&](uint32_t _item)
+      {
+        return _boxes[_item].Center(axis) < split;
+      });
+      if (middle == begin || middle == end)
+      {
+        middle = begin + count / 2u;
+        std::nth_element(begin, middle, end, [&](uint32_t _a, uint32_t _b)
+        {
+          return _boxes[_a].Center(axis) < _boxes[_b].Center(axis);
+        });
+      }
+
+      const uint32_t leftCount = static_cast<uint32_t>(middle - begin);
+      const uint32_t left = static_cast<uint32_t>(this->nodes.size());
+      BvhNode child;
+      child.first = first;
+      child.count = leftCount;
+      this->nodes.push_back(child);
+      child.first = first + leftCount;
+      child.count = count - leftCount;
+      this->nodes.push_back(child);
+
+      this->nodes[_index].first = left;
+      this->nodes[_index].count = 0u;
+      this->Subdivide(left, _depth + 1u, _boxes);
+      this->Subdivide(left + 1u, _depth + 1u, _boxes);
+    }
+
+    /// \brief Nodes, the root is first.
+    public: std::vector<BvhNode> nodes;
+
+    /// \brief Item indices referenced by the leaves.
+    public: std::vector<uint32_t> items;
+  };
+
+  /// \brief A packet of rays stored as a structure of arrays, so that
+  /// loops over the rays can be vectorized.
+  struct Packet
+  {
+    /// \brief Compute the inverse directions used by box tests.
+    void UpdateInverse()
+    {
+      for (unsigned int k = 0; k < kPacketSize; ++k)
+      {
+        // Avoid 0 * inf in the slab test when a ray is parallel to an axis
+        this->ix[k] = 1.0f / (std::fabs(this->dx[k]) > 1e-20f ?
+            this->dx[k] : 1e-20f);
+        this->iy[k] = 1.0f / (std::fabs(this->dy[k]) > 1e-20f ?
+            this->dy[k] : 1e-20f);
+        this->iz[k] = 1.0f / (std::fabs(this->dz[k]) > 1e-20f ?
+            this->dz[k] : 1e-20f);
+      }
+    }
+
+    /// \brief Ray origins.
+    float ox[kPacketSize], oy[kPacketSize], oz[kPacketSize];
+
+    /// \brief Ray directions.
+    float dx[kPacketSize], dy[kPacketSize], dz[kPacketSize];
+
+    /// \brief Inverse ray directions.
+    float ix[kPacketSize], iy[kPacketSize], iz[kPacketSize];
+
+    /// \brief Start of each ray interval.
+    float tmin[kPacketSize];
+
+    /// \brief End of each ray interval, shortened to the closest hit.
+    /// Unused rays have an empty interval.
+    float tmax[kPacketSize];
+
+    /// \brief Index of the object each ray hit, kNoHit if none.
+    uint32_t hit[kPacketSize];
+  };
+
+  /// \brief Test a packet against a box.
+  /// \param[in] _box Box to test.
+  /// \param[in] _p Ray packet.
+  /// \return Bit mask of the rays that overlap the box within their
+  /// interval.
+  unsigned int HitMask(const Aabb &_box, const Packet &_p)
+  {
+    unsigned int mask = 0u;
+    for (unsigned int k = 0; k < kPacketSize; ++k)
+    {
+      const float tx1 = (_box.lo[0] - _p.ox[k]) * _p.ix[k];
+      const float tx2 = (_box.hi[0] - _p.ox[k]) * _p.ix[k];
+      const float ty1 = (_box.lo[1] - _p.oy[k]) * _p.iy[k];
+      const float ty2 = (_box.hi[1] - _p.oy[k]) * _p.iy[k];
+      const float tz1 = (_box.lo[2] - _p.oz[k]) * _p.iz[k];
+      const float tz2 = (_box.hi[2] - _p.oz[k]) * _p.iz[k];
+      const float t0 = std::max(
+          std::max(std::min(tx1, tx2), std::min(ty1, ty2)),
+          std::max(std::min(tz1, tz2), _p.tmin[k]));
+      const float t1 = std::min(
+          std::min(std::max(tx1, tx2), std::max(ty1, ty2)),
+          std::min(std::max(tz1, tz2), _p.tmax[k]));
+      mask |= static_cast<unsigned int>(t0 <= t1) << k;
+    }
+    return mask;
+  }
+
+  /// \brief Visit the leaves of a hierarchy that a packet overlaps,
+  /// nearest child first.
+  /// \param[in] _bvh Hierarchy to traverse.
+  /// \param[in] _p Ray packet. Leaf callbacks may shorten the intervals.
+  /// \param[in] _leaf Called with the item range of each leaf.
+  template<typename LeafFn>
+  void Traverse(const Bvh &_bvh, const Packet &_p, LeafFn _leaf)
+  {
+    if (_bvh.nodes.empty())
+      return;
+
+    uint32_t stack[kStackSize];
+    unsigned int size = 0u;
+    stack[size++] = 0u;
+    while (size > 0u)
+    {
+      const BvhNode &node = _bvh.nodes[stack[--size]];
+      if (!HitMask(node.box, _p))
+        continue;
+
+      if (node.count > 0u)
+      {
+        _leaf(node.first, node.count);
+        continue;
+      }
+
+      // Order the children along the direction of the first ray
+      const Aabb &left = _bvh.nodes[node.first].box;
+      const Aabb &right = _bvh.nodes[node.first + 1u].box;
+      const float along =
+          (left.Center(0) - right.Center(0)) * _p.dx[0] +
+          (left.Center(1) - right.Center(1)) * _p.dy[0] +
+          (left.Center(2) - right.Center(2)) * _p.dz[0];
+      if (along > 0.0f)
+      {
+        stack[size++] = node.first;
+        stack[size++] = node.first + 1u;
+      }
+      else
+      {
+        stack[size++] = node.first + 1u;
+        stack[size++] = node.first;
+      }
+    }
+  }
+
+  /// \brief Shape of an object. Every shape is unit sized in its own
+  /// frame and scaled to its real size.
+  enum class Shape
+  {
+    /// \brief Box from -0.5 to 0.5 along each axis.
+    BOX,
+
+    /// \brief Sphere of radius 1.
+    SPHERE,
+
+    /// \brief Cylinder of radius 1 and length 1 along z.
+    CYLINDER,
+
+    /// \brief Triangle mesh.
+    MESH
+  };
+
+  /// \brief Triangles of a mesh with their hierarchy.
+  struct MeshData
+  {
+    /// \brief Hierarchy over the triangles.
+    Bvh bvh;
+
+    /// \brief Nine floats per triangle, a vertex and two edges, stored in
+    /// hierarchy leaf order.
+    std::vector<float> triangles;
+
+    /// \brief Bounds of the mesh.
+    Aabb bounds;
+  };
+
+  /// \brief An object in the scene.
+  struct Object
+  {
+    /// \brief Id of the object.
+    RayObjectId id = NO_RAY_OBJECT;
+
+    /// \brief Shape of the object.
+    Shape shape = Shape::BOX;
+
+    /// \brief World pose.
+    math::Pose3d pose;
+
+    /// \brief Size of the shape, or mesh scale.
+    math::Vector3d scale = math::Vector3d::One;
+
+    /// \brief Retro-reflectance reported for hits.
+    float retro = 0.0f;
+
+    /// \brief Triangles, for meshes only.
+    std::shared_ptr<MeshData> mesh;
+
+    /// \brief Rows of the world to local transform, which includes the
+    /// inverse scale.
+    float rotation[9];
+
+    /// \brief Translation of the world to local transform.
+    float translation[3];
+
+    /// \brief World bounds.
+    Aabb worldBox;
+  };
+
+  /// \brief Get the bounds of a shape in its own unit sized frame.
+  /// \param[in] _object Object to get the bounds of.
+  /// \return Local bounds.
+  Aabb LocalBounds(const Object &_object)
+  {
+    Aabb box;
+    switch (_object.shape)
+    {
+      case Shape::BOX:
+        box.lo[0] = box.lo[1] = box.lo[2] = -0.5f;
+        box.hi[0] = box.hi[1] = box.hi[2] = 0.5f;
+        break;
+      case Shape::SPHERE:
+        box.lo[0] = box.lo[1] = box.lo[2] = -1.0f;
+        box.hi[0] = box.hi[1] = box.hi[2] = 1.0f;
+        break;
+      case Shape::CYLINDER:
+        box.lo[0] = box.lo[1] = -1.0f;
+        box.hi[0] = box.hi[1] = 1.0f;
+        box.lo[2] = -0.5f;
+        box.hi[2] = 0.5f;
+        break;
+      case Shape::MESH:
+        box = _object.mesh->bounds;
+        break;
+    }
+    return box;
+  }
+
+  /// \brief Update the cached transform and world bounds of an object.
+  /// \param[in,out] _object Object to update.
+  void UpdateTransform(Object &_object)
+  {
+    const math::Quaterniond &rot = _object.pose.Rot();
+    const math::Vector3d axes[3] = {
+      rot.RotateVector(math::Vector3d::UnitX),
+      rot.RotateVector(math::Vector3d::UnitY),
+      rot.RotateVector(math::Vector3d::UnitZ)};
+
+    // Local = S^-1 * R^T * (world - p)
+    for (int r = 0; r < 3; ++r)
+    {
+      const double inv = 1.0 / _object.scale[r];
+      for (int c = 0; c < 3; ++c)
+        _object.rotation[r * 3 + c] = static_cast<float>(axes[r][c] * inv);
+      _object.translation[r] = static_cast<float>(
+          -axes[r].Dot(_object.pose.Pos()) * inv);
+    }
+
+    const Aabb local = LocalBounds(_object);
+    _object.worldBox = Aabb();
+    for (int i = 0; i < 8; ++i)
+    {
+      const math::Vector3d corner(
+          (i & 1) ? local.hi[0] : local.lo[0],
+          (i & 2) ? local.hi[1] : local.lo[1],
+          (i & 4) ? local.hi[2] : local.lo[2]);
+      const math::Vector3d world = _object.pose.Pos() +
+          rot.RotateVector(corner * _object.scale);
+      const float p[3] = {static_cast<float>(world.X()),
+          static_cast<float>(world.Y()), static_cast<float>(world.Z())};
+      _object.worldBox.Grow(p);
+    }
+  }
+
+  /// \brief Intersect a packet with a unit box.
+  /// \param[in,out] _p Packet in the box frame.
+  /// \return Bit mask of the rays whose closest hit changed.
+  unsigned int IntersectBox(Packet &_p)
+  {
+    unsigned int mask = 0u;
+    for (unsigned int k = 0; k < kPacketSize; ++k)
+    {
+      const float tx1 = (-0.5f - _p.ox[k]) * _p.ix[k];
+      const float tx2 = (0.5f - _p.ox[k]) * _p.ix[k];
+      const float ty1 = (-0.5f - _p.oy[k]) * _p.iy[k];
+      const float ty2 = (0.5f - _p.oy[k]) * _p.iy[k];
+      const float tz1 = (-0.5f - _p.oz[k]) * _p.iz[k];
+      const float tz2 = (0.5f - _p.oz[k]) * _p.iz[k];
+      const float t0 = std::max(std::max(std::min(tx1, tx2),
+          std::min(ty1, ty2)), std::min(tz1, tz2));
+      const float t1 = std::min(std::min(std::max(tx1, tx2),
+          std::max(ty1, ty2)), std::max(tz1, tz2));
+
+      // Rays starting inside the box hit its far side
+      const float t = t0 >= _p.tmin[k] ? t0 : t1;
+      if (t0 <= t1 && t >= _p.tmin[k] && t < _p.tmax[k])
+      {
+        _p.tmax[k] = t;
+        mask |= 1u << k;
+      }
+    }
+    return mask;
+  }
+
+  /// \brief Intersect a packet with a unit sphere.
+  /// \param[in,out] _p Packet in the sphere frame.
+  /// \return Bit mask of the rays whose closest hit changed.
+  unsigned int IntersectSphere(Packet &_p)
+  {
+    unsigned int mask = 0u;
+    for (unsigned int k = 0; k < kPacketSize; ++k)
+    {
+      const float a = _p.dx[k] * _p.dx[k] + _p.dy[k] * _p.dy[k] +
+          _p.dz[k] * _p.dz[k];
+      const float b = _p.ox[k] * _p.dx[k] + _p.oy[k] * _p.dy[k] +
+          _p.oz[k] * _p.dz[k];
+      const float c = _p.ox[k] * _p.ox[k] + _p.oy[k] * _p.oy[k] +
+          _p.oz[k] * _p.oz[k] - 1.0f;
+      const float disc = b * b - a * c;
+      const float root = std::sqrt(std::max(disc, 0.0f));
+      const float t0 = (-b - root) / a;
+      const float t1 = (-b + root) / a;
+      const float t = t0 >= _p.tmin[k] ? t0 : t1;
+      if (disc >= 0.0f && t >= _p.tmin[k] && t < _p.tmax[k])
+      {
+        _p.tmax[k] = t;
+        mask |= 1u << k;
+      }
+    }
+    return mask;
+  }
+
+  /// \brief Intersect a packet with a unit cylinder.
+  /// \param[in,out] _p Packet in the cylinder frame.
+  /// \return Bit mask of the rays whose closest hit changed.
+  unsigned int IntersectCylinder(Packet &_p)
+  {
+    unsigned int mask = 0u;
+    for (unsigned int k = 0; k < kPacketSize; ++k)
+    {
+      float best = _p.tmax[k];
+
+      // Side
+      const float a = _p.dx[k] * _p.dx[k] + _p.dy[k] * _p.dy[k];
+      const float b = _p.ox[k] * _p.dx[k] + _p.oy[k] * _p.dy[k];
+      const float c = _p.ox[k] * _p.ox[k] + _p.oy[k] * _p.oy[k] - 1.0f;
+      const float disc = b * b - a * c;
+      if (a > 0.0f && disc >= 0.0f)
+      {
+        const float root = std::sqrt(disc);
+        for (const float t : {(-b - root) / a, (-b + root) / a})
+        {
+          const float z = _p.oz[k] + t * _p.dz[k];
+          if (t >= _p.tmin[k] && t < best && std::fabs(z) <= 0.5f)
+            best = t;
+        }
+      }
+
+      // Caps
+      if (_p.dz[k] != 0.0f)
+      {
+        for (const float cap : {-0.5f, 0.5f})
+        {
+          const float t = (cap - _p.oz[k]) / _p.dz[k];
+          const float x = _p.ox[k] + t * _p.dx[k];
+          const float y = _p.oy[k] + t * _p.dy[k];
+          if (t >= _p.tmin[k] && t < best && x * x + y * y <= 1.0f)
+            best = t;
+        }
+      }
+
+      if (best < _p.tmax[k])
+      {
+        _p.tmax[k] = best;
+        mask |= 1u << k;
+      }
+    }
+    return mask;
+  }
+
+  /// \brief Intersect a packet with a triangle mesh.
+  /// \param[in] _mesh Mesh to intersect.
+  /// \param[in,out] _p Packet in the mesh frame.
+  /// \return Bit mask of the rays whose closest hit changed.
+  unsigned int IntersectMesh(const MeshData &_mesh, Packet &_p)
+  {
+    unsigned int mask = 0u;
+    Traverse(_mesh.bvh, _p, [&](uint32_t _first, uint32_t _count)
+    {
+      for (uint32_t i = _first; i < _first + _count; ++i)
+      {
+        // Moller-Trumbore
+        const float *tri = &_mesh.triangles[i * 9u];
+        for (unsigned int k = 0; k < kPacketSize; ++k)
+        {
+          const float px = _p.dy[k] * tri[8] - _p.dz[k] * tri[7];
+          const float py = _p.dz[k] * tri[6] - _p.dx[k] * tri[8];
+          const float pz = _p.dx[k] * tri[7] - _p.dy[k] * tri[6];
+          const float det = tri[3] * px + tri[4] * py + tri[5] * pz;
+          const float inv = 1.0f / det;
+          const float sx = _p.ox[k] - tri[0];
+          const float sy = _p.oy[k] - tri[1];
+          const float sz = _p.oz[k] - tri[2];
+          const float u = (sx * px + sy * py + sz * pz) * inv;
+          const float qx = sy * tri[5] - sz * tri[4];
+          const float qy = sz * tri[3] - sx * tri[5];
+          const float qz = sx * tri[4] - sy * tri[3];
+          const float v = (_p.dx[k] * qx + _p.dy[k] * qy + _p.dz[k] * qz) *
+              inv;
+          const float t = (tri[6] * qx + tri[7] * qy + tri[8] * qz) * inv;
+          const bool hit = std::fabs(det) > 1e-12f && u >= 0.0f &&
+              v >= 0.0f && u + v <= 1.0f && t >= _p.tmin[k] &&
+              t < _p.tmax[k];
+          _p.tmax[k] = hit ? t : _p.tmax[k];
+          mask |= static_cast<unsigned int>(hit) << k;
+        }
+      }
+    });
+    return mask;
+  }
+}
+
+/// \brief Private data for RayScene
+class ignition::sensors::RayScenePrivate
+{
+  /// \brief Add an object and mark the hierarchy for rebuild.
+  /// \param[in] _object Object to add, its id is assigned here.
+  /// \return Id of the object.
+  public: RayObjectId Add(Object &&_object);
+
+  /// \brief Get an object by id.
+  /// \param[in] _id Id of the object.
+  /// \return The object, or null if it doesn't exist.
+  public: Object *Find(RayObjectId _id);
+
+  /// \brief Rebuild or refit the scene hierarchy if objects changed.
+  public: void UpdateHierarchy();
+
+  /// \brief Trace a packet through the scene.
+  /// \param[in,out] _p Packet in world frame.
+  public: void Trace(Packet &_p) const;
+
+  /// \brief Intersect a packet with one object.
+  /// \param[in] _index Index of the object.
+  /// \param[in,out] _p Packet in world frame.
+  public: void Intersect(uint32_t _index, Packet &_p) const;
+
+  /// \brief Objects in the scene.
+  public: std::vector<Object> objects;
+
+  /// \brief Index in objects of each object id.
+  public: std::unordered_map<RayObjectId, std::size_t> indices;
+
+  /// \brief Hierarchy over the world bounds of the objects.
+  public: Bvh bvh;
+
+  /// \brief True when objects were added or removed since the last build.
+  public: bool rebuild = false;
+
+  /// \brief True when objects moved since the last refit.
+  public: bool refit = false;
+
+  /// \brief Id of the next object.
+  public: RayObjectId nextId = NO_RAY_OBJECT + 1;
+
+  /// \brief Scene revision.
+  public: uint64_t revision = 0u;
+
+  /// \brief Number of threads used to cast rays.
+  public: unsigned int threadCount =
+              std::max(1u, std::thread::hardware_concurrency());
+
+  /// \brief Threads that cast rays, created on first use.
+  public: std::unique_ptr<common::WorkerPool> pool;
+
+  /// \brief Protects the scene. Held for the duration of a cast.
+  public: mutable std::mutex mutex;
+};
+
+//////////////////////////////////////////////////
+RayObjectId RayScenePrivate::Add(Object &&_object)
+{
+  _object.id = this->nextId++;
+  UpdateTransform(_object);
+  this->indices[_object.id] = this->objects.size();
+  this->objects.push_back(std::move(_object));
+  this->rebuild = true;
+  ++this->revision;
+  return this->objects.back().id;
+}
+
+//////////////////////////////////////////////////
+Object *RayScenePrivate::Find(RayObjectId _id)
+{
+  auto it = this->indices.find(_id);
+  return it == this->indices.end() ? nullptr : &this->objects[it->second];
+}
+
+//////////////////////////////////////////////////
+void RayScenePrivate::UpdateHierarchy()
+{
+  if (!this->rebuild && !this->refit)
+    return;
+
+  std::vector<Aabb> boxes(this->objects.size());
+  for (std::size_t i = 0; i < this->objects.size(); ++i)
+    boxes[i] = this->objects[i].worldBox;
+
+  if (this->rebuild)
+  {
+    IGN_SENSORS_PROFILE("RayScene::Build");
+    this->bvh.Build(boxes);
+  }
+  else
+  {
+    IGN_SENSORS_PROFILE("RayScene::Refit");
+    this->bvh.Refit(boxes);
+  }
+  this->rebuild = false;
+  this->refit = false;
+}
+
+//////////////////////////////////////////////////
+void RayScenePrivate::Trace(Packet &_p) const
+{
+  Traverse(this->bvh, _p, [&](uint32_t _first, uint32_t _count)
+  {
+    for (uint32_t i = _first; i < _first + _count; ++i)
+      this->Intersect(this->bvh.items[i], _p);
+  });
+}
+
+//////////////////////////////////////////////////
+void RayScenePrivate::Intersect(uint32_t _index, Packet &_p) const
+{
+  const Object &object = this->objects[_index];
+  const float *m = object.rotation;
+  const float *t = object.translation;
+
+  Packet local;
+  for (unsigned int k = 0; k < kPacketSize; ++k)
+  {
+    local.ox[k] = m[0] * _p.ox[k] + m[1] * _p.oy[k] + m[2] * _p.oz[k] + t[0];
+    local.oy[k] = m[3] * _p.ox[k] + m[4] * _p.oy[k] + m[5] * _p.oz[k] + t[1];
+    local.oz[k] = m[6] * _p.ox[k] + m[7] * _p.oy[k] + m[8] * _p.oz[k] + t[2];
+    local.dx[k] = m[0] * _p.dx[k] + m[1] * _p.dy[k] + m[2] * _p.dz[k];
+    local.dy[k] = m[3] * _p.dx[k] + m[4] * _p.dy[k] + m[5] * _p.dz[k];
+    local.dz[k] = m[6] * _p.dx[k] + m[7] * _p.dy[k] + m[8] * _p.dz[k];
+    // The directions aren't normalized, so distances carry over unchanged
+    local.tmin[k] = _p.tmin[k];
+    local.tmax[k] = _p.tmax[k];
+  }
+  local.UpdateInverse();
+
+  unsigned int mask = 0u;
+  switch (object.shape)
+  {
+    case Shape::BOX:
+      mask = IntersectBox(local);
+      break;
+    case Shape::SPHERE:
+      mask = IntersectSphere(local);
+      break;
+    case Shape::CYLINDER:
+      mask = IntersectCylinder(local);
+      break;
+    case Shape::MESH:
+      mask = IntersectMesh(*object.mesh, local);
+      break;
+  }
+
+  for (unsigned int k = 0; k < kPacketSize; ++k)
+  {
+    if (mask & (1u << k))
+    {
+      _p.tmax[k] = local.tmax[k];
+      _p.hit[k] = _index;
+    }
+  }
+}
+
+//////////////////////////////////////////////////
+RayScene::RayScene()
+  : dataPtr(new RayScenePrivate)
+{
+}
+
+//////////////////////////////////////////////////
+RayScene::~RayScene()
+{
+}
+
+//////////////////////////////////////////////////
+RayObjectId RayScene::AddBox(const math::Vector3d &_size,
+    const math::Pose3d &_pose)
+{
+  if (_size.Min() <= 0.0)
+  {
+    ignerr << "Unable to add box with size [" << _size << "].\n";
+    return NO_RAY_OBJECT;
+  }
+
+  Object object;
+  object.shape = Shape::BOX;
+  object.pose = _pose;
+  object.scale = _size;
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->Add(std::move(object));
+}
+
+//////////////////////////////////////////////////
+RayObjectId RayScene::AddSphere(double _radius, const math::Pose3d &_pose)
+{
+  if (_radius <= 0.0)
+  {
+    ignerr << "Unable to add sphere with radius [" << _radius << "].\n";
+    return NO_RAY_OBJECT;
+  }
+
+  Object object;
+  object.shape = Shape::SPHERE;
+  object.pose = _pose;
+  object.scale.Set(_radius, _radius, _radius);
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->Add(std::move(object));
+}
+
+//////////////////////////////////////////////////
+RayObjectId RayScene::AddCylinder(double _radius, double _length,
+    const math::Pose3d &_pose)
+{
+  if (_radius <= 0.0 || _length <= 0.0)
+  {
+    ignerr << "Unable to add cylinder with radius [" << _radius
+           << "] and length [" << _length << "].\n";
+    return NO_RAY_OBJECT;
+  }
+
+  Object object;
+  object.shape = Shape::CYLINDER;
+  object.pose = _pose;
+  object.scale.Set(_radius, _radius, _length);
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->Add(std::move(object));
+}
+
+//////////////////////////////////////////////////
+RayObjectId RayScene::AddMesh(const common::Mesh &_mesh,
+    const math::Pose3d &_pose, const math::Vector3d &_scale)
+{
+  std::vector<math::Vector3d> vertices;
+  std::vector<unsigned int> indices;
+  for (unsigned int i = 0; i < _mesh.SubMeshCount(); ++i)
+  {
+    auto subMesh = _mesh.SubMeshByIndex(i).lock();
+    if (!subMesh ||
+        subMesh->SubMeshPrimitiveType() != common::SubMesh::TRIANGLES)
+    {
+      continue;
+    }
+
+    const unsigned int offset = static_cast<unsigned int>(vertices.size());
+    for (unsigned int v = 0; v < subMesh->VertexCount(); ++v)
+      vertices.push_back(subMesh->Vertex(v));
+    for (unsigned int j = 0; j < subMesh->IndexCount(); ++j)
+      indices.push_back(offset + static_cast<unsigned int>(subMesh->Index(j)));
+  }
+
+  return this->AddMesh(vertices, indices, _pose, _scale);
+}
+
+//////////////////////////////////////////////////
+RayObjectId RayScene::AddMesh(const std::vector<math::Vector3d> &_vertices,
+    const std::vector<unsigned int> &_indices, const math::Pose3d &_pose,
+    const math::Vector3d &_scale)
+{
+  IGN_SENSORS_PROFILE("RayScene::AddMesh");
+  if (_scale.Min() <= 0.0)
+  {
+    ignerr << "Unable to add mesh with scale [" << _scale << "].\n";
+    return NO_RAY_OBJECT;
+  }
+
+  auto mesh = std::make_shared<MeshData>();
+  std::vector<float> triangles;
+  std::vector<Aabb> boxes;
+  for (std::size_t i = 0; i + 2u < _indices.size(); i += 3u)
+  {
+    if (_indices[i] >= _vertices.size() ||
+        _indices[i + 1u] >= _vertices.size() ||
+        _indices[i + 2u] >= _vertices.size())
+    {
+      continue;
+    }
+
+    const math::Vector3d &a = _vertices[_indices[i]];
+    const math::Vector3d &b = _vertices[_indices[i + 1u]];
+    const math::Vector3d &c = _vertices[_indices[i + 2u]];
+    const math::Vector3d e1 = b - a;
+    const math::Vector3d e2 = c - a;
+    if (e1.Cross(e2).SquaredLength() <= 0.0)
+      continue;
+
+    const float tri[9] = {
+      static_cast<float>(a.X()), static_cast<float>(a.Y()),
+      static_cast<float>(a.Z()), static_cast<float>(e1.X()),
+      static_cast<float>(e1.Y()), static_cast<float>(e1.Z()),
+      static_cast<float>(e2.X()), static_cast<float>(e2.Y()),
+      static_cast<float>(e2.Z())};
+    triangles.insert(triangles.end(), tri, tri + 9);
+
+    Aabb box;
+    for (const math::Vector3d *v : {&a, &b, &c})
+    {
+      const float p[3] = {static_cast<float>(v->X()),
+          static_cast<float>(v->Y()), static_cast<float>(v->Z())};
+      box.Grow(p);
+    }
+    mesh->bounds.Grow(box);
+    boxes.push_back(box);
+  }
+
+  if (boxes.empty())
+  {
+    ignwarn << "Mesh has no triangles, it will not be added.\n";
+    return NO_RAY_OBJECT;
+  }
+
+  // Store the triangles in leaf order so that leaves are contiguous
+  mesh->bvh.Build(boxes);
+  mesh->triangles.resize(triangles.size());
+  for (std::size_t i = 0; i < mesh->bvh.items.size(); ++i)
+  {
+    std::copy_n(triangles.begin() + mesh->bvh.items[i] * 9u, 9u,
+        mesh->triangles.begin() + i * 9u);
+  }
+
+  Object object;
+  object.shape = Shape::MESH;
+  object.pose = _pose;
+  object.scale = _scale;
+  object.mesh = mesh;
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->Add(std::move(object));
+}
+
+//////////////////////////////////////////////////
+bool RayScene::RemoveObject(RayObjectId _id)
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  auto it = this->dataPtr->indices.find(_id);
+  if (it == this->dataPtr->indices.end())
+    return false;
+
+  const std::size_t index = it->second;
+  this->dataPtr->indices.erase(it);
+  if (index + 1u != this->dataPtr->objects.size())
+  {
+    this->dataPtr->objects[index] = std::move(this->dataPtr->objects.back());
+    this->dataPtr->indices[this->dataPtr->objects[index].id] = index;
+  }
+  this->dataPtr->objects.pop_back();
+  this->dataPtr->rebuild = true;
+  ++this->dataPtr->revision;
+  return true;
+}
+
+//////////////////////////////////////////////////
+bool RayScene::SetObjectPose(RayObjectId _id, const math::Pose3d &_pose)
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  Object *object = this->dataPtr->Find(_id);
+  if (!object)
+    return false;
+
+  if (object->pose == _pose)
+    return true;
+
+  object->pose = _pose;
+  UpdateTransform(*object);
+  this->dataPtr->refit = true;
+  ++this->dataPtr->revision;
+  return true;
+}
+
+//////////////////////////////////////////////////
+math::Pose3d RayScene::ObjectPose(RayObjectId _id) const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  const Object *object = this->dataPtr->Find(_id);
+  return object ? object->pose : math::Pose3d::Zero;
+}
+
+//////////////////////////////////////////////////
+math::AxisAlignedBox RayScene::ObjectBoundingBox(RayObjectId _id) const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  const Object *object = this->dataPtr->Find(_id);
+  if (!object)
+    return math::AxisAlignedBox();
+
+  const Aabb &box = object->worldBox;
+  return math::AxisAlignedBox(
+      math::Vector3d(box.lo[0], box.lo[1], box.lo[2]),
+      math::Vector3d(box.hi[0], box.hi[1], box.hi[2]));
+}
+
+//////////////////////////////////////////////////
+bool RayScene::SetObjectRetro(RayObjectId _id, double _retro)
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  Object *object = this->dataPtr->Find(_id);
+  if (!object)
+    return false;
+
+  object->retro = static_cast<float>(_retro);
+  ++this->dataPtr->revision;
+  return true;
+}
+
+//////////////////////////////////////////////////
+std::size_t RayScene::ObjectCount() const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->objects.size();
+}
+
+//////////////////////////////////////////////////
+uint64_t RayScene::Revision() const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->revision;
+}
+
+//////////////////////////////////////////////////
+void RayScene::SetThreadCount(unsigned int _count)
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  const unsigned int count = std::max(1u, _count);
+  if (count == this->dataPtr->threadCount)
+    return;
+
+  // The pool is sized on first use, so recreate it with the new count
+  this->dataPtr->threadCount = count;
+  this->dataPtr->pool.reset();
+}
+
+//////////////////////////////////////////////////
+unsigned int RayScene::ThreadCount() const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->threadCount;
+}
+
+//////////////////////////////////////////////////
+void RayScene::CastRays(const math::Pose3d &_origin,
+    const std::vector<math::Vector3d> &_directions, double _minRange,
+    double _maxRange, std::vector<RayHit> &_hits)
+{
+  IGN_SENSORS_PROFILE("RayScene::CastRays");
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  this->dataPtr->UpdateHierarchy();
+
+  const std::size_t rayCount = _directions.size();
+  _hits.resize(rayCount);
+
+  const float origin[3] = {static_cast<float>(_origin.Pos().X()),
+      static_cast<float>(_origin.Pos().Y()),
+      static_cast<float>(_origin.Pos().Z())};
+  const float tmin = static_cast<float>(_minRange);
+  const float tmax = static_cast<float>(_maxRange);
+
+  auto castBatch = [&](std::size_t _batch)
+  {
+    const std::size_t begin = _batch * kPacketsPerBatch * kPacketSize;
+    const std::size_t end =
+        std::min(rayCount, begin + kPacketsPerBatch * kPacketSize);
+    Packet packet;
+    for (std::size_t first = begin; first < end; first += kPacketSize)
+    {
+      for (unsigned int k = 0; k < kPacketSize; ++k)
+      {
+        // Unused rays repeat the last direction with an empty interval
+        const std::size_t i = std::min(first + k, end - 1u);
+        const math::Vector3d dir =
+            _origin.Rot().RotateVector(_directions[i]);
+        packet.ox[k] = origin[0];
+        packet.oy[k] = origin[1];
+        packet.oz[k] = origin[2];
+        packet.dx[k] = static_cast<float>(dir.X());
+        packet.dy[k] = static_cast<float>(dir.Y());
+        packet.dz[k] = static_cast<float>(dir.Z());
+        packet.tmin[k] = tmin;
+        packet.tmax[k] = first + k < end ? tmax : -1.0f;
+        packet.hit[k] = kNoHit;
+      }
+      packet.UpdateInverse();
+
+      this->dataPtr->Trace(packet);
+
+      for (unsigned int k = 0; k < kPacketSize && first + k < end; ++k)
+      {
+        RayHit &hit = _hits[first + k];
+        if (packet.hit[k] == kNoHit)
+        {
+          hit.range = kInf;
+          hit.retro = 0.0f;
+          hit.object = NO_RAY_OBJECT;
+        }
+        else
+        {
+          const Object &object = this->dataPtr->objects[packet.hit[k]];
+          hit.range = packet.tmax[k];
+          hit.retro = object.retro;
+          hit.object = object.id;
+        }
+      }
+    }
+  };
+
+  const std::size_t batchCount =
+      (rayCount + kPacketsPerBatch * kPacketSize - 1u) /
+      (kPacketsPerBatch * kPacketSize);
+  const unsigned int threads = static_cast<unsigned int>(
+      std::min<std::size_t>(this->dataPtr->threadCount, batchCount));
+  if (threads <= 1u)
+  {
+    for (std::size_t b = 0; b < batchCount; ++b)
+      castBatch(b);
+    return;
+  }
+
+  if (!this->dataPtr->pool)
+  {
+    this->dataPtr->pool.reset(
+        new common::WorkerPool(this->dataPtr->threadCount));
+  }
+
+  // Threads take batches until none are left, which balances the load
+  // when some parts of the scene are more expensive than others.
+  std::atomic<std::size_t> next(0u);
+  auto work = [&]()
+  {
+    for (std::size_t b = next++; b < batchCount; b = next++)
+      castBatch(b);
+  };
+  for (unsigned int t = 1u; t < threads; ++t)
+    this->dataPtr->pool->AddWork(work);
+  work();
+  this->dataPtr->pool->WaitForResults();
+}
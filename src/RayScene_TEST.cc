@@ -0,0 +1,370 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include <ignition/common/Mesh.hh>
+#include <ignition/common/SubMesh.hh>
+#include <ignition/math/Helpers.hh>
+
+#include <ignition/sensors/RayScene.hh>
+
+using namespace ignition;
+using namespace sensors;
+
+/// \brief Cast a single ray.
+/// \param[in] _scene Scene to cast into.
+/// \param[in] _origin Ray origin.
+/// \param[in] _dir Ray direction.
+/// \return Result of the cast.
+RayHit CastOne(RayScene &_scene, const math::Pose3d &_origin,
+    const math::Vector3d &_dir, double _min = 0.0, double _max = 100.0)
+{
+  std::vector<RayHit> hits;
+  _scene.CastRays(_origin, {_dir}, _min, _max, hits);
+  EXPECT_EQ(1u, hits.size());
+  return hits[0];
+}
+
+/// \brief Directions of a scan with the given number of columns and rows.
+std::vector<math::Vector3d> ScanDirections(unsigned int _width,
+    unsigned int _height)
+{
+  std::vector<math::Vector3d> dirs;
+  for (unsigned int j = 0; j < _height; ++j)
+  {
+    double v = -0.5 + j * 1.0 / _height;
+    for (unsigned int i = 0; i < _width; ++i)
+    {
+      double h = -IGN_PI + i * 2 * IGN_PI / _width;
+      dirs.emplace_back(std::cos(v) * std::cos(h), std::cos(v) * std::sin(h),
+          std::sin(v));
+    }
+  }
+  return dirs;
+}
+
+//////////////////////////////////////////////////
+TEST(RayScene_TEST, Empty)
+{
+  RayScene scene;
+  EXPECT_EQ(0u, scene.ObjectCount());
+
+  RayHit hit = CastOne(scene, math::Pose3d::Zero, math::Vector3d::UnitX);
+  EXPECT_TRUE(std::isinf(hit.range));
+  EXPECT_FLOAT_EQ(0.0f, hit.retro);
+  EXPECT_EQ(NO_RAY_OBJECT, hit.object);
+}
+
+//////////////////////////////////////////////////
+TEST(RayScene_TEST, Primitives)
+{
+  RayScene scene;
+  RayObjectId box = scene.AddBox(math::Vector3d(1, 2, 2),
+      math::Pose3d(5, 0, 0, 0, 0, 0));
+  RayObjectId sphere = scene.AddSphere(1.0, math::Pose3d(0, 5, 0, 0, 0, 0));
+  RayObjectId cylinder = scene.AddCylinder(0.5, 2.0,
+      math::Pose3d(0, 0, 5, 0, 0, 0));
+  EXPECT_NE(NO_RAY_OBJECT, box);
+  EXPECT_NE(NO_RAY_OBJECT, sphere);
+  EXPECT_NE(NO_RAY_OBJECT, cylinder);
+  EXPECT_EQ(3u, scene.ObjectCount());
+  EXPECT_TRUE(scene.SetObjectRetro(box, 0.7));
+
+  RayHit hit = CastOne(scene, math::Pose3d::Zero, math::Vector3d::UnitX);
+  EXPECT_NEAR(4.5, hit.range, 1e-4);
+  EXPECT_NEAR(0.7, hit.retro, 1e-6);
+  EXPECT_EQ(box, hit.object);
+
+  hit = CastOne(scene, math::Pose3d::Zero, math::Vector3d::UnitY);
+  EXPECT_NEAR(4.0, hit.range, 1e-4);
+  EXPECT_EQ(sphere, hit.object);
+
+  // Cap of the cylinder
+  hit = CastOne(scene, math::Pose3d::Zero, math::Vector3d::UnitZ);
+  EXPECT_NEAR(4.0, hit.range, 1e-4);
+  EXPECT_EQ(cylinder, hit.object);
+
+  // Side of the cylinder
+  hit = CastOne(scene, math::Pose3d(-3, 0, 5, 0, 0, 0),
+      math::Vector3d::UnitX);
+  EXPECT_NEAR(2.5, hit.range, 1e-4);
+  EXPECT_EQ(cylinder, hit.object);
+
+  // Miss
+  hit = CastOne(scene, math::Pose3d::Zero, -math::Vector3d::UnitX);
+  EXPECT_TRUE(std::isinf(hit.range));
+
+  // Out of range
+  hit = CastOne(scene, math::Pose3d::Zero, math::Vector3d::UnitX, 0.0, 4.0);
+  EXPECT_TRUE(std::isinf(hit.range));
+
+  // Rays start at the minimum range, so they hit the inside of the box
+  hit = CastOne(scene, math::Pose3d::Zero, math::Vector3d::UnitX, 5.0);
+  EXPECT_NEAR(5.5, hit.range, 1e-4);
+
+  // Invalid sizes
+  EXPECT_EQ(NO_RAY_OBJECT, scene.AddBox(math::Vector3d(0, 1, 1),
+      math::Pose3d::Zero));
+  EXPECT_EQ(NO_RAY_OBJECT, scene.AddSphere(-1.0, math::Pose3d::Zero));
+  EXPECT_EQ(3u, scene.ObjectCount());
+}
+
+//////////////////////////////////////////////////
+TEST(RayScene_TEST, OriginPose)
+{
+  RayScene scene;
+  RayObjectId box = scene.AddBox(math::Vector3d::One,
+      math::Pose3d(0, 3, 0, 0, 0, 0));
+
+  // Rotating the origin by 90 degrees points its x axis at the box
+  math::Pose3d origin(0, 1, 0, 0, 0, IGN_PI_2);
+  RayHit hit = CastOne(scene, origin, math::Vector3d::UnitX);
+  EXPECT_NEAR(1.5, hit.range, 1e-4);
+  EXPECT_EQ(box, hit.object);
+
+  // Rotated box, its diagonal faces the ray
+  scene.SetObjectPose(box, math::Pose3d(0, 3, 0, 0, 0, IGN_PI / 4));
+  hit = CastOne(scene, origin, math::Vector3d::UnitX);
+  EXPECT_NEAR(2.0 - std::sqrt(0.5), hit.range, 1e-4);
+}
+
+//////////////////////////////////////////////////
+TEST(RayScene_TEST, Mesh)
+{
+  RayScene scene;
+
+  // Unit square in the yz plane, facing x
+  std::vector<math::Vector3d> vertices = {
+    {0, -0.5, -0.5}, {0, 0.5, -0.5}, {0, 0.5, 0.5}, {0, -0.5, 0.5}};
+  std::vector<unsigned int> indices = {0, 1, 2, 0, 2, 3};
+  RayObjectId quad = scene.AddMesh(vertices, indices,
+      math::Pose3d(3, 0, 0, 0, 0, 0), math::Vector3d(1, 4, 4));
+  EXPECT_NE(NO_RAY_OBJECT, quad);
+
+  RayHit hit = CastOne(scene, math::Pose3d::Zero, math::Vector3d::UnitX);
+  EXPECT_NEAR(3.0, hit.range, 1e-4);
+  EXPECT_EQ(quad, hit.object);
+
+  // The scale makes the quad 4m wide
+  hit = CastOne(scene, math::Pose3d(0, 1.5, 0, 0, 0, 0),
+      math::Vector3d::UnitX);
+  EXPECT_NEAR(3.0, hit.range, 1e-4);
+  hit = CastOne(scene, math::Pose3d(0, 2.5, 0, 0, 0, 0),
+      math::Vector3d::UnitX);
+  EXPECT_TRUE(std::isinf(hit.range));
+
+  // The same quad from a common::Mesh, closer to the origin
+  common::SubMesh subMesh;
+  subMesh.SetPrimitiveType(common::SubMesh::TRIANGLES);
+  for (const auto &v : vertices)
+    subMesh.AddVertex(v);
+  for (unsigned int i : indices)
+    subMesh.AddIndex(i);
+  common::Mesh mesh;
+  mesh.AddSubMesh(subMesh);
+  RayObjectId near = scene.AddMesh(mesh, math::Pose3d(2, 0, 0, 0, 0, 0));
+  EXPECT_NE(NO_RAY_OBJECT, near);
+
+  hit = CastOne(scene, math::Pose3d::Zero, math::Vector3d::UnitX);
+  EXPECT_NEAR(2.0, hit.range, 1e-4);
+  EXPECT_EQ(near, hit.object);
+
+  // Degenerate and out of bounds triangles are ignored
+  EXPECT_EQ(NO_RAY_OBJECT, scene.AddMesh(vertices, {0, 0, 1, 0, 1, 9},
+      math::Pose3d::Zero));
+}
+
+//////////////////////////////////////////////////
+TEST(RayScene_TEST, LargeMesh)
+{
+  // A grid of triangles large enough to need several hierarchy levels
+  const int n = 64;
+  std::vector<math::Vector3d> vertices;
+  std::vector<unsigned int> indices;
+  for (int j = 0; j <= n; ++j)
+  {
+    for (int i = 0; i <= n; ++i)
+    {
+      double x = -1.0 + 2.0 * i / n;
+      double y = -1.0 + 2.0 * j / n;
+      // Bumpy floor
+      vertices.emplace_back(x, y, 0.05 * std::sin(5 * x) * std::cos(5 * y));
+    }
+  }
+  for (int j = 0; j < n; ++j)
+  {
+    for (int i = 0; i < n; ++i)
+    {
+      unsigned int a = j * (n + 1) + i;
+      indices.insert(indices.end(), {a, a + 1, a + n + 2, a, a + n + 2,
+          a + n + 1});
+    }
+  }
+
+  RayScene scene;
+  scene.AddMesh(vertices, indices, math::Pose3d::Zero);
+
+  // Vertical rays hit the floor at a vertex height
+  for (int j = 1; j < n; j += 7)
+  {
+    for (int i = 1; i < n; i += 5)
+    {
+      const math::Vector3d &v = vertices[j * (n + 1) + i];
+      RayHit hit = CastOne(scene, math::Pose3d(v.X(), v.Y(), 1, 0, 0, 0),
+          -math::Vector3d::UnitZ);
+      EXPECT_NEAR(1.0 - v.Z(), hit.range, 1e-4);
+    }
+  }
+}
+
+//////////////////////////////////////////////////
+TEST(RayScene_TEST, Occlusion)
+{
+  RayScene scene;
+  RayObjectId far = scene.AddBox(math::Vector3d::One,
+      math::Pose3d(10, 0, 0, 0, 0, 0));
+  RayObjectId near = scene.AddSphere(0.5, math::Pose3d(4, 0, 0, 0, 0, 0));
+
+  RayHit hit = CastOne(scene, math::Pose3d::Zero, math::Vector3d::UnitX);
+  EXPECT_NEAR(3.5, hit.range, 1e-4);
+  EXPECT_EQ(near, hit.object);
+
+  EXPECT_TRUE(scene.RemoveObject(near));
+  EXPECT_FALSE(scene.RemoveObject(near));
+  EXPECT_EQ(1u, scene.ObjectCount());
+
+  hit = CastOne(scene, math::Pose3d::Zero, math::Vector3d::UnitX);
+  EXPECT_NEAR(9.5, hit.range, 1e-4);
+  EXPECT_EQ(far, hit.object);
+}
+
+//////////////////////////////////////////////////
+TEST(RayScene_TEST, MoveObjects)
+{
+  RayScene scene;
+  std::vector<RayObjectId> boxes;
+  for (int i = 0; i < 20; ++i)
+  {
+    boxes.push_back(scene.AddBox(math::Vector3d::One,
+        math::Pose3d(0, 0, 100 + i * 2, 0, 0, 0)));
+  }
+
+  uint64_t revision = scene.Revision();
+  RayHit hit = CastOne(scene, math::Pose3d::Zero, math::Vector3d::UnitX);
+  EXPECT_TRUE(std::isinf(hit.range));
+
+  // Moving objects refits the hierarchy
+  EXPECT_TRUE(scene.SetObjectPose(boxes[7], math::Pose3d(6, 0, 0, 0, 0, 0)));
+  EXPECT_GT(scene.Revision(), revision);
+  EXPECT_EQ(math::Pose3d(6, 0, 0, 0, 0, 0), scene.ObjectPose(boxes[7]));
+  math::AxisAlignedBox box = scene.ObjectBoundingBox(boxes[7]);
+  EXPECT_EQ(math::Vector3d(5.5, -0.5, -0.5), box.Min());
+  EXPECT_EQ(math::Vector3d(6.5, 0.5, 0.5), box.Max());
+  hit = CastOne(scene, math::Pose3d::Zero, math::Vector3d::UnitX);
+  EXPECT_NEAR(5.5, hit.range, 1e-4);
+  EXPECT_EQ(boxes[7], hit.object);
+
+  EXPECT_TRUE(scene.SetObjectPose(boxes[3], math::Pose3d(3, 0, 0, 0, 0, 0)));
+  EXPECT_TRUE(scene.SetObjectPose(boxes[7],
+      math::Pose3d(0, 0, 50, 0, 0, 0)));
+  hit = CastOne(scene, math::Pose3d::Zero, math::Vector3d::UnitX);
+  EXPECT_NEAR(2.5, hit.range, 1e-4);
+  EXPECT_EQ(boxes[3], hit.object);
+
+  // Unchanged pose doesn't change the revision
+  revision = scene.Revision();
+  EXPECT_TRUE(scene.SetObjectPose(boxes[3], math::Pose3d(3, 0, 0, 0, 0, 0)));
+  EXPECT_EQ(revision, scene.Revision());
+
+  EXPECT_FALSE(scene.SetObjectPose(NO_RAY_OBJECT, math::Pose3d::Zero));
+  box = scene.ObjectBoundingBox(NO_RAY_OBJECT);
+  EXPECT_GT(box.Min().X(), box.Max().X());
+}
+
+//////////////////////////////////////////////////
+TEST(RayScene_TEST, Threads)
+{
+  RayScene scene;
+  for (int i = 0; i < 50; ++i)
+  {
+    double angle = i * 2 * IGN_PI / 50;
+    math::Pose3d pose(5 * std::cos(angle), 5 * std::sin(angle),
+        std::sin(i * 1.3), 0, 0, angle);
+    if (i % 3 == 0)
+      scene.AddBox(math::Vector3d(0.5, 1, 2), pose);
+    else if (i % 3 == 1)
+      scene.AddSphere(0.4, pose);
+    else
+      scene.AddCylinder(0.3, 1.5, pose);
+  }
+
+  // Ray count isn't a multiple of the packet size
+  std::vector<math::Vector3d> dirs = ScanDirections(1001, 17);
+  math::Pose3d origin(0.1, -0.2, 0.3, 0, 0, 0.4);
+
+  scene.SetThreadCount(1u);
+  EXPECT_EQ(1u, scene.ThreadCount());
+  std::vector<RayHit> single;
+  scene.CastRays(origin, dirs, 0.1, 20.0, single);
+
+  scene.SetThreadCount(4u);
+  EXPECT_EQ(4u, scene.ThreadCount());
+  std::vector<RayHit> multi;
+  scene.CastRays(origin, dirs, 0.1, 20.0, multi);
+
+  // The pool is resized after it was used
+  scene.SetThreadCount(2u);
+  EXPECT_EQ(2u, scene.ThreadCount());
+  std::vector<RayHit> resized;
+  scene.CastRays(origin, dirs, 0.1, 20.0, resized);
+  ASSERT_EQ(dirs.size(), resized.size());
+  for (std::size_t i = 0; i < dirs.size(); ++i)
+    EXPECT_EQ(multi[i].object, resized[i].object);
+
+  ASSERT_EQ(dirs.size(), single.size());
+  ASSERT_EQ(dirs.size(), multi.size());
+  unsigned int hits = 0u;
+  for (std::size_t i = 0; i < dirs.size(); ++i)
+  {
+    EXPECT_EQ(single[i].object, multi[i].object);
+    if (!std::isinf(single[i].range))
+    {
+      EXPECT_FLOAT_EQ(single[i].range, multi[i].range);
+      ++hits;
+    }
+
+    // Rays traced in packets match rays traced alone
+    if (i % 97 == 0)
+    {
+      RayHit hit = CastOne(scene, origin, dirs[i], 0.1, 20.0);
+      EXPECT_EQ(hit.object, multi[i].object);
+    }
+  }
+  EXPECT_GT(hits, 0u);
+  EXPECT_LT(hits, dirs.size());
+}
+
+//////////////////////////////////////////////////
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
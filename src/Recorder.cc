@@ -0,0 +1,489 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef _WIN32
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include <ignition/msgs/header.pb.h>
+#include <ignition/common/Console.hh>
+
+#include "ignition/sensors/Recorder.hh"
+#include "ignition/sensors/Tracing.hh"
+
+#include "RecordingFormat.hh"
+#include "StateStream.hh"
+
+using namespace ignition;
+using namespace sensors;
+
+namespace
+{
+  /// \brief Convert a time to nanoseconds.
+  /// \param[in] _time Time.
+  /// \return Nanoseconds.
+  int64_t Nanoseconds(const common::Time &_time)
+  {
+    return static_cast<int64_t>(_time.sec) * 1000000000 + _time.nsec;
+  }
+
+  /// \brief Get the stamp of the header of a message.
+  /// \param[in] _msg The message.
+  /// \return Stamp, zero if the message has no header.
+  common::Time HeaderStamp(const google::protobuf::Message &_msg)
+  {
+    const google::protobuf::FieldDescriptor *field =
+        _msg.GetDescriptor()->FindFieldByName("header");
+    if (!field || field->is_repeated() ||
+        field->type() != google::protobuf::FieldDescriptor::TYPE_MESSAGE)
+    {
+      return common::Time::Zero;
+    }
+
+    const msgs::Header *header = dynamic_cast<const msgs::Header *>(
+        &_msg.GetReflection()->GetMessage(_msg, field));
+    if (!header)
+      return common::Time::Zero;
+    return common::Time(header->stamp().sec(), header->stamp().nsec());
+  }
+}
+
+/// \brief Private data for Recorder
+class ignition::sensors::RecorderPrivate
+{
+  /// \brief Write to the file.
+  /// \param[in] _offset Offset to write at.
+  /// \param[in] _data Bytes to write.
+  /// \param[in] _size Number of bytes.
+  /// \return False if the write failed.
+  public: bool WriteAt(uint64_t _offset, const void *_data, std::size_t _size);
+
+  /// \brief Start a new chunk at the end of the file.
+  /// \param[in] _minSize Bytes the chunk must hold.
+  /// \return False if the file couldn't grow.
+  public: bool StartChunk(std::size_t _minSize);
+
+  /// \brief Finish the current chunk.
+  /// \param[in] _last Whether it's the last chunk, which is shrunk to its
+  /// records.
+  /// \return False if the chunk couldn't be written.
+  public: bool FinishChunk(bool _last);
+
+  /// \brief Reserve a record in the current chunk, starting a new chunk if
+  /// it's full, and write the record header.
+  /// \param[in] _stamp Stamp of the record.
+  /// \param[in] _channel Channel of the record.
+  /// \param[in] _size Size of the record data.
+  /// \return Where to write the record data, nullptr on error.
+  public: char *Reserve(int64_t _stamp, uint32_t _channel, uint32_t _size);
+
+  /// \brief Get the channel of a message, defining it if it's new.
+  /// \param[in] _sensor Name of the sensor.
+  /// \param[in] _topic Topic of the sensor.
+  /// \param[in] _type Type name of the message.
+  /// \param[in] _stamp Stamp of the message.
+  /// \param[out] _channel Channel.
+  /// \return False if the definition couldn't be written.
+  public: bool Channel(const std::string &_sensor, const std::string &_topic,
+              const std::string &_type, int64_t _stamp, uint32_t &_channel);
+
+  /// \brief Release the file.
+  public: void Release();
+
+  /// \brief Protects everything below.
+  public: mutable std::mutex mutex;
+
+  /// \brief Whether a recording is open.
+  public: bool open = false;
+
+#ifndef _WIN32
+  /// \brief File descriptor of the recording.
+  public: int fd = -1;
+#else
+  /// \brief The recording.
+  public: std::fstream file;
+
+  /// \brief Memory holding the current chunk.
+  public: std::vector<char> buffer;
+#endif
+
+  /// \brief Page size, the alignment of the chunks.
+  public: std::size_t pageSize = 4096u;
+
+  /// \brief Size of the chunks.
+  public: std::size_t chunkSize = 0u;
+
+  /// \brief End of the file.
+  public: uint64_t fileEnd = 0u;
+
+  /// \brief Offset of the current chunk.
+  public: uint64_t chunkOffset = 0u;
+
+  /// \brief Current chunk, nullptr before the first message.
+  public: char *chunk = nullptr;
+
+  /// \brief Size of the current chunk in memory.
+  public: std::size_t chunkCapacity = 0u;
+
+  /// \brief Header of the current chunk.
+  public: recording::ChunkHeader chunkHeader;
+
+  /// \brief Channels by sensor name, topic and type.
+  public: std::map<std::string, uint32_t> channels;
+
+  /// \brief Encoded channel definitions, in channel order.
+  public: std::vector<std::string> definitions;
+
+  /// \brief Index of the messages.
+  public: std::vector<recording::IndexEntry> entries;
+};
+
+//////////////////////////////////////////////////
+bool RecorderPrivate::WriteAt(uint64_t _offset, const void *_data,
+    std::size_t _size)
+{
+  const char *data = static_cast<const char *>(_data);
+#ifndef _WIN32
+  while (_size > 0u)
+  {
+    ssize_t written = pwrite(this->fd, data, _size, _offset);
+    if (written <= 0)
+      return false;
+    data += written;
+    _size -= written;
+    _offset += written;
+  }
+  return true;
+#else
+  this->file.seekp(_offset);
+  this->file.write(data, _size);
+  return static_cast<bool>(this->file);
+#endif
+}
+
+//////////////////////////////////////////////////
+bool RecorderPrivate::StartChunk(std::size_t _minSize)
+{
+  std::size_t capacity = std::max(this->chunkSize, _minSize);
+  capacity = (capacity + this->pageSize - 1u) / this->pageSize *
+      this->pageSize;
+
+#ifndef _WIN32
+  if (ftruncate(this->fd, this->fileEnd + capacity) != 0)
+    return false;
+  void *map = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED,
+      this->fd, this->fileEnd);
+  if (map == MAP_FAILED)
+    return false;
+  this->chunk = static_cast<char *>(map);
+#else
+  this->buffer.assign(capacity, 0);
+  this->chunk = this->buffer.data();
+#endif
+
+  this->chunkOffset = this->fileEnd;
+  this->chunkCapacity = capacity;
+  this->fileEnd += capacity;
+  this->chunkHeader.magic = recording::kChunkMagic;
+  this->chunkHeader.records = 0u;
+  this->chunkHeader.capacity = capacity;
+  this->chunkHeader.used = sizeof(recording::ChunkHeader);
+  std::memcpy(this->chunk, &this->chunkHeader, sizeof(this->chunkHeader));
+  return true;
+}
+
+//////////////////////////////////////////////////
+bool RecorderPrivate::FinishChunk(bool _last)
+{
+  if (!this->chunk)
+    return true;
+
+  if (_last)
+  {
+    this->chunkHeader.capacity = this->chunkHeader.used;
+    std::memcpy(this->chunk, &this->chunkHeader, sizeof(this->chunkHeader));
+    this->fileEnd = this->chunkOffset + this->chunkHeader.used;
+  }
+
+  bool result = true;
+#ifndef _WIN32
+  munmap(this->chunk, this->chunkCapacity);
+  if (_last)
+    result = ftruncate(this->fd, this->fileEnd) == 0;
+#else
+  result = this->WriteAt(this->chunkOffset, this->chunk,
+      this->fileEnd - this->chunkOffset);
+#endif
+  this->chunk = nullptr;
+  return result;
+}
+
+//////////////////////////////////////////////////
+char *RecorderPrivate::Reserve(int64_t _stamp, uint32_t _channel,
+    uint32_t _size)
+{
+  const std::size_t recordSize = sizeof(recording::RecordHeader) + _size;
+  if (!this->chunk ||
+      this->chunkHeader.capacity - this->chunkHeader.used < recordSize)
+  {
+    if (!this->FinishChunk(false) ||
+        !this->StartChunk(sizeof(recording::ChunkHeader) + recordSize))
+    {
+      ignerr << "Unable to grow the recording.\n";
+      return nullptr;
+    }
+  }
+
+  char *record = this->chunk + this->chunkHeader.used;
+  recording::RecordHeader header;
+  header.stamp = _stamp;
+  header.channel = _channel;
+  header.size = _size;
+  std::memcpy(record, &header, sizeof(header));
+
+  if (_channel != recording::kChannelDefinition)
+  {
+    this->entries.push_back(
+        {_stamp, this->chunkOffset + this->chunkHeader.used});
+  }
+
+  // Keep the chunk header current, so that the chunk can be read even if
+  // the recording isn't closed
+  this->chunkHeader.used += recordSize;
+  ++this->chunkHeader.records;
+  std::memcpy(this->chunk, &this->chunkHeader, sizeof(this->chunkHeader));
+  return record + sizeof(header);
+}
+
+//////////////////////////////////////////////////
+bool RecorderPrivate::Channel(const std::string &_sensor,
+    const std::string &_topic, const std::string &_type, int64_t _stamp,
+    uint32_t &_channel)
+{
+  std::string key = _sensor;
+  key.append(1, '\0').append(_topic).append(1, '\0').append(_type);
+  auto it = this->channels.find(key);
+  if (it != this->channels.end())
+  {
+    _channel = it->second;
+    return true;
+  }
+
+  _channel = static_cast<uint32_t>(this->definitions.size());
+  std::ostringstream definition;
+  state::Write(definition, _channel);
+  state::WriteString(definition, _sensor);
+  state::WriteString(definition, _topic);
+  state::WriteString(definition, _type);
+  const std::string data = definition.str();
+
+  char *record = this->Reserve(_stamp, recording::kChannelDefinition,
+      static_cast<uint32_t>(data.size()));
+  if (!record)
+    return false;
+  std::memcpy(record, data.data(), data.size());
+
+  this->channels[key] = _channel;
+  this->definitions.push_back(data);
+  return true;
+}
+
+//////////////////////////////////////////////////
+void RecorderPrivate::Release()
+{
+#ifndef _WIN32
+  if (this->chunk)
+    munmap(this->chunk, this->chunkCapacity);
+  if (this->fd >= 0)
+    close(this->fd);
+  this->fd = -1;
+#else
+  this->file.close();
+  this->buffer.clear();
+#endif
+  this->chunk = nullptr;
+  this->open = false;
+  this->channels.clear();
+  this->definitions.clear();
+  this->entries.clear();
+}
+
+//////////////////////////////////////////////////
+Recorder::Recorder()
+  : dataPtr(new RecorderPrivate)
+{
+#ifndef _WIN32
+  this->dataPtr->pageSize = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+//////////////////////////////////////////////////
+Recorder::~Recorder()
+{
+  if (this->IsOpen())
+    this->Close();
+}
+
+//////////////////////////////////////////////////
+bool Recorder::Open(const std::string &_path, std::size_t _chunkSize)
+{
+  if (this->IsOpen())
+    this->Close();
+
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+#ifndef _WIN32
+  this->dataPtr->fd = open(_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  bool opened = this->dataPtr->fd >= 0;
+#else
+  this->dataPtr->file.open(_path, std::ios::in | std::ios::out |
+      std::ios::binary | std::ios::trunc);
+  bool opened = static_cast<bool>(this->dataPtr->file);
+#endif
+
+  recording::FileHeader header;
+  std::memcpy(header.magic, recording::kFileMagic, sizeof(header.magic));
+  header.version = recording::kVersion;
+  header.headerSize = static_cast<uint32_t>(this->dataPtr->pageSize);
+  header.indexOffset = 0u;
+
+  // Pad the header to a page, so that the chunks can be mapped
+  std::vector<char> page(this->dataPtr->pageSize, 0);
+  std::memcpy(page.data(), &header, sizeof(header));
+  if (!opened || !this->dataPtr->WriteAt(0u, page.data(), page.size()))
+  {
+    ignerr << "Unable to create recording [" << _path << "].\n";
+    this->dataPtr->Release();
+    return false;
+  }
+
+  this->dataPtr->chunkSize = std::max<std::size_t>(_chunkSize,
+      sizeof(recording::ChunkHeader));
+  this->dataPtr->fileEnd = this->dataPtr->pageSize;
+  this->dataPtr->open = true;
+  return true;
+}
+
+//////////////////////////////////////////////////
+bool Recorder::IsOpen() const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->open;
+}
+
+//////////////////////////////////////////////////
+bool Recorder::Add(const std::string &_sensor, const std::string &_topic,
+    const google::protobuf::Message &_msg, const common::Time &_stamp)
+{
+  IGN_SENSORS_PROFILE("Recorder::Add");
+  const std::size_t size = _msg.ByteSizeLong();
+  if (size > std::numeric_limits<uint32_t>::max())
+  {
+    ignerr << "Message of sensor [" << _sensor << "] is too large to be "
+           << "recorded.\n";
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  if (!this->dataPtr->open)
+    return false;
+
+  const int64_t stamp = Nanoseconds(_stamp);
+  uint32_t channel = 0u;
+  if (!this->dataPtr->Channel(_sensor, _topic, _msg.GetTypeName(), stamp,
+      channel))
+  {
+    return false;
+  }
+
+  // Serialize straight into the mapped chunk
+  char *data = this->dataPtr->Reserve(stamp, channel,
+      static_cast<uint32_t>(size));
+  if (!data)
+    return false;
+  _msg.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t *>(data));
+  return true;
+}
+
+//////////////////////////////////////////////////
+bool Recorder::Add(const std::string &_sensor, const std::string &_topic,
+    const google::protobuf::Message &_msg)
+{
+  return this->Add(_sensor, _topic, _msg, HeaderStamp(_msg));
+}
+
+//////////////////////////////////////////////////
+uint64_t Recorder::MessageCount() const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  return this->dataPtr->entries.size();
+}
+
+//////////////////////////////////////////////////
+bool Recorder::Close()
+{
+  IGN_SENSORS_PROFILE("Recorder::Close");
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  if (!this->dataPtr->open)
+    return false;
+
+  bool result = this->dataPtr->FinishChunk(true);
+
+  // Sensors may produce messages out of order, for example from their
+  // rendering pipeline thread
+  std::stable_sort(this->dataPtr->entries.begin(),
+      this->dataPtr->entries.end(),
+      [](const recording::IndexEntry &_a, const recording::IndexEntry &_b)
+      {
+        return _a.stamp < _b.stamp;
+      });
+
+  std::ostringstream index;
+  recording::IndexHeader indexHeader;
+  indexHeader.channels = static_cast<uint32_t>(
+      this->dataPtr->definitions.size());
+  indexHeader.reserved = 0u;
+  indexHeader.entries = this->dataPtr->entries.size();
+  state::Write(index, indexHeader);
+  for (const std::string &definition : this->dataPtr->definitions)
+    state::WriteString(index, definition);
+  const std::string data = index.str();
+
+  const uint64_t indexOffset = this->dataPtr->fileEnd;
+  result = result &&
+      this->dataPtr->WriteAt(indexOffset, data.data(), data.size()) &&
+      this->dataPtr->WriteAt(indexOffset + data.size(),
+          this->dataPtr->entries.data(),
+          this->dataPtr->entries.size() * sizeof(recording::IndexEntry)) &&
+      this->dataPtr->WriteAt(offsetof(recording::FileHeader, indexOffset),
+          &indexOffset, sizeof(indexOffset));
+  if (!result)
+    ignerr << "Unable to write the index of the recording.\n";
+
+  this->dataPtr->Release();
+  return result;
+}
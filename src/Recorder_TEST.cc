@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include <ignition/msgs/image.pb.h>
+#include <ignition/msgs/imu.pb.h>
+
+#include "ignition/sensors/Recorder.hh"
+#include "ignition/sensors/Replay.hh"
+
+#include "test_config.h"  // NOLINT(build/include)
+
+using namespace ignition;
+using namespace sensors;
+
+/// \brief Path of the recording written by the tests.
+const std::string kRecordingPath =
+    std::string(PROJECT_BUILD_PATH) + "/Recorder_TEST.rec";
+
+/// \brief Create a stamped IMU message.
+/// \param[in] _ms Stamp in milliseconds.
+/// \return IMU message.
+msgs::IMU ImuMsg(int _ms)
+{
+  msgs::IMU msg;
+  msg.mutable_header()->mutable_stamp()->set_sec(_ms / 1000);
+  msg.mutable_header()->mutable_stamp()->set_nsec((_ms % 1000) * 1000000);
+  msg.set_entity_name("imu");
+  msg.mutable_linear_acceleration()->set_x(_ms);
+  return msg;
+}
+
+//////////////////////////////////////////////////
+TEST(Recorder_TEST, RecordReplay)
+{
+  Recorder recorder;
+  EXPECT_FALSE(recorder.IsOpen());
+  EXPECT_FALSE(recorder.Add("imu", "/imu", ImuMsg(0)));
+
+  // Small chunks, so that the messages span several of them
+  ASSERT_TRUE(recorder.Open(kRecordingPath, 1024u));
+  EXPECT_TRUE(recorder.IsOpen());
+  for (int i = 0; i < 100; ++i)
+    EXPECT_TRUE(recorder.Add("imu", "/imu", ImuMsg(i * 10)));
+
+  // Larger than a chunk, and out of order
+  msgs::Image image;
+  image.set_width(100);
+  image.set_height(100);
+  image.set_data(std::string(100000, 'x'));
+  EXPECT_TRUE(recorder.Add("camera", "/camera", image,
+      common::Time(0, 455000000)));
+  EXPECT_EQ(101u, recorder.MessageCount());
+  EXPECT_TRUE(recorder.Close());
+  EXPECT_FALSE(recorder.IsOpen());
+  EXPECT_FALSE(recorder.Close());
+
+  Replay replay;
+  ASSERT_TRUE(replay.Open(kRecordingPath));
+  EXPECT_EQ(101u, replay.MessageCount());
+  EXPECT_EQ(common::Time::Zero, replay.StartTime());
+  EXPECT_EQ(common::Time(0, 990000000), replay.EndTime());
+
+  // Messages come back in stamp order
+  ReplayMessage msg;
+  common::Time last;
+  int imuCount = 0;
+  while (replay.Next(msg))
+  {
+    EXPECT_LE(last, msg.stamp);
+    last = msg.stamp;
+    if (msg.sensor == "imu")
+    {
+      EXPECT_EQ("/imu", msg.topic);
+      EXPECT_EQ("ignition.msgs.IMU", msg.type);
+      msgs::IMU imu;
+      ASSERT_TRUE(msg.Parse(imu));
+      EXPECT_EQ(ImuMsg(imuCount * 10).DebugString(), imu.DebugString());
+      EXPECT_FALSE(msg.Parse(image));
+      ++imuCount;
+    }
+    else
+    {
+      EXPECT_EQ("camera", msg.sensor);
+      EXPECT_EQ(common::Time(0, 455000000), msg.stamp);
+      msgs::Image parsed;
+      ASSERT_TRUE(msg.Parse(parsed));
+      EXPECT_EQ(image.data(), parsed.data());
+    }
+  }
+  EXPECT_EQ(100, imuCount);
+
+  // Seek
+  EXPECT_TRUE(replay.Seek(common::Time(0, 455000000)));
+  ASSERT_TRUE(replay.Next(msg));
+  EXPECT_EQ("camera", msg.sensor);
+  EXPECT_TRUE(replay.Seek(common::Time(0, 451000000)));
+  ASSERT_TRUE(replay.Next(msg));
+  EXPECT_EQ("camera", msg.sensor);
+  ASSERT_TRUE(replay.Next(msg));
+  EXPECT_EQ(common::Time(0, 460000000), msg.stamp);
+  EXPECT_TRUE(replay.Seek(common::Time(-1, 0)));
+  ASSERT_TRUE(replay.Next(msg));
+  EXPECT_EQ(common::Time::Zero, msg.stamp);
+  EXPECT_FALSE(replay.Seek(common::Time(1, 0)));
+  EXPECT_FALSE(replay.Next(msg));
+
+  // Play as fast as possible, then at 10x for the last 100 ms
+  EXPECT_TRUE(replay.Seek(common::Time::Zero));
+  uint64_t played = 0u;
+  EXPECT_EQ(101u, replay.Play(0.0, [&](const ReplayMessage &)
+      {
+        ++played;
+      }));
+  EXPECT_EQ(101u, played);
+
+  EXPECT_TRUE(replay.Seek(common::Time(0, 890000000)));
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_EQ(11u, replay.Play(10.0, [](const ReplayMessage &) {}));
+  EXPECT_GE(std::chrono::steady_clock::now() - start,
+      std::chrono::milliseconds(10));
+
+  // Stop from the callback
+  EXPECT_TRUE(replay.Seek(common::Time::Zero));
+  EXPECT_EQ(5u, replay.Play(0.0, [&](const ReplayMessage &_msg)
+      {
+        if (_msg.stamp == common::Time(0, 40000000))
+          replay.Stop();
+      }));
+  ASSERT_TRUE(replay.Next(msg));
+  EXPECT_EQ(common::Time(0, 50000000), msg.stamp);
+
+  replay.Close();
+  EXPECT_EQ(0u, replay.MessageCount());
+}
+
+//////////////////////////////////////////////////
+TEST(Recorder_TEST, NotClosed)
+{
+  Recorder recorder;
+  ASSERT_TRUE(recorder.Open(kRecordingPath, 1024u));
+  for (int i = 0; i < 50; ++i)
+    EXPECT_TRUE(recorder.Add("imu", "/imu", ImuMsg(i)));
+
+  // Copy the recording while it's open, as if the recorder crashed
+  std::string contents;
+  {
+    std::ifstream file(kRecordingPath, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(file),
+        std::istreambuf_iterator<char>());
+  }
+  const std::string copyPath = kRecordingPath + ".copy";
+  {
+    std::ofstream file(copyPath, std::ios::binary | std::ios::trunc);
+    file.write(contents.data(), contents.size());
+  }
+  EXPECT_TRUE(recorder.Close());
+
+  Replay replay;
+  ASSERT_TRUE(replay.Open(copyPath));
+  EXPECT_EQ(50u, replay.MessageCount());
+  EXPECT_EQ(common::Time(0, 49000000), replay.EndTime());
+
+  ReplayMessage msg;
+  EXPECT_TRUE(replay.Seek(common::Time(0, 20000000)));
+  ASSERT_TRUE(replay.Next(msg));
+  msgs::IMU imu;
+  ASSERT_TRUE(msg.Parse(imu));
+  EXPECT_DOUBLE_EQ(20.0, imu.linear_acceleration().x());
+}
+
+//////////////////////////////////////////////////
+TEST(Recorder_TEST, Invalid)
+{
+  Replay replay;
+  EXPECT_FALSE(replay.Open(kRecordingPath + ".missing"));
+
+  {
+    std::ofstream file(kRecordingPath, std::ios::binary | std::ios::trunc);
+    file << "not a recording, but long enough for a header";
+  }
+  EXPECT_FALSE(replay.Open(kRecordingPath));
+  EXPECT_EQ(0u, replay.MessageCount());
+
+  // Empty recording
+  Recorder recorder;
+  ASSERT_TRUE(recorder.Open(kRecordingPath));
+  EXPECT_TRUE(recorder.Close());
+  ASSERT_TRUE(replay.Open(kRecordingPath));
+  EXPECT_EQ(0u, replay.MessageCount());
+  EXPECT_FALSE(replay.Seek(common::Time::Zero));
+  ReplayMessage msg;
+  EXPECT_FALSE(replay.Next(msg));
+}
+
+//////////////////////////////////////////////////
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef IGNITION_SENSORS_RECORDINGFORMAT_HH_
+#define IGNITION_SENSORS_RECORDINGFORMAT_HH_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "ignition/sensors/config.hh"
+
+namespace ignition
+{
+  namespace sensors
+  {
+    // Inline bracket to help doxygen filtering.
+    inline namespace IGNITION_SENSORS_VERSION_NAMESPACE {
+    //
+    /// \brief Layout of the recordings written by Recorder and read by
+    /// Replay. Values are stored in host byte order.
+    ///
+    /// The file starts with a FileHeader, padded to a page. Chunks follow,
+    /// each starting with a ChunkHeader and holding records. A record is a
+    /// RecordHeader followed by the serialized message, or by a channel
+    /// definition when its channel is kChannelDefinition. Channel
+    /// definitions precede the first message of their channel, so a
+    /// recording that wasn't closed can still be read by scanning the
+    /// chunks. Closing the recording appends the index: an IndexHeader,
+    /// the channel definitions, and an IndexEntry per message, sorted by
+    /// stamp.
+    namespace recording
+    {
+      /// \brief First bytes of a recording.
+      const char kFileMagic[8] = {'I', 'G', 'N', 'S', 'R', 'E', 'C', '\0'};
+
+      /// \brief Version of the format.
+      const uint32_t kVersion = 1u;
+
+      /// \brief First bytes of a chunk, "CHNK" in ASCII.
+      const uint32_t kChunkMagic = 0x4b4e4843u;
+
+      /// \brief Channel of the records defining a channel.
+      const uint32_t kChannelDefinition = 0xffffffffu;
+
+      /// \brief Header of a recording.
+      struct FileHeader
+      {
+        /// \brief kFileMagic.
+        char magic[8];
+
+        /// \brief Format version.
+        uint32_t version;
+
+        /// \brief Size of the file header, where the first chunk starts.
+        uint32_t headerSize;
+
+        /// \brief Offset of the index, zero if the recording wasn't
+        /// closed.
+        uint64_t indexOffset;
+      };
+
+      /// \brief Header of a chunk.
+      struct ChunkHeader
+      {
+        /// \brief kChunkMagic.
+        uint32_t magic;
+
+        /// \brief Number of records.
+        uint32_t records;
+
+        /// \brief Size of the chunk in the file, including this header.
+        uint64_t capacity;
+
+        /// \brief Bytes used by this header and the records.
+        uint64_t used;
+      };
+
+      /// \brief Header of a record.
+      struct RecordHeader
+      {
+        /// \brief Stamp of the message, in nanoseconds.
+        int64_t stamp;
+
+        /// \brief Channel of the message.
+        uint32_t channel;
+
+        /// \brief Size of the data following the header.
+        uint32_t size;
+      };
+
+      /// \brief Header of the index.
+      struct IndexHeader
+      {
+        /// \brief Number of channel definitions following the header.
+        uint32_t channels;
+
+        /// \brief Unused.
+        uint32_t reserved;
+
+        /// \brief Number of entries following the channel definitions.
+        uint64_t entries;
+      };
+
+      /// \brief Index entry of a message.
+      struct IndexEntry
+      {
+        /// \brief Stamp of the message, in nanoseconds.
+        int64_t stamp;
+
+        /// \brief Offset of the RecordHeader of the message.
+        uint64_t offset;
+      };
+
+      /// \brief Reads values from memory, checking bounds.
+      class MemoryReader
+      {
+        /// \brief Constructor
+        /// \param[in] _data First byte to read.
+        /// \param[in] _size Number of bytes that can be read.
+        public: MemoryReader(const char *_data, std::size_t _size)
+          : pos(_data), end(_data + _size)
+        {
+        }
+
+        /// \brief Read a value.
+        /// \param[out] _value Value, trivially copyable.
+        /// \return False if the memory ended.
+        public: template<typename T>
+        bool Read(T &_value)
+        {
+          if (this->Remaining() < sizeof(T))
+            return false;
+          std::memcpy(&_value, this->pos, sizeof(T));
+          this->pos += sizeof(T);
+          return true;
+        }
+
+        /// \brief Read a string, prefixed with its uint32_t length.
+        /// \param[out] _value String.
+        /// \return False if the memory ended.
+        public: bool ReadString(std::string &_value)
+        {
+          uint32_t size = 0u;
+          if (!this->Read(size) || this->Remaining() < size)
+            return false;
+          _value.assign(this->pos, size);
+          this->pos += size;
+          return true;
+        }
+
+        /// \brief Skip bytes.
+        /// \param[in] _size Number of bytes, at most Remaining().
+        public: void Skip(std::size_t _size)
+        {
+          this->pos += std::min(_size, this->Remaining());
+        }
+
+        /// \brief Get the number of bytes left to read.
+        /// \return Remaining bytes.
+        public: std::size_t Remaining() const
+        {
+          return static_cast<std::size_t>(this->end - this->pos);
+        }
+
+        /// \brief Next byte to read.
+        private: const char *pos;
+
+        /// \brief End of the memory.
+        private: const char *end;
+      };
+    }
+    }
+  }
+}
+
+#endif
@@ -15,11 +15,20 @@
  *
 */
 
-#include <ignition/common/Profiler.hh>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <ignition/common/Console.hh>
 
 #include <ignition/rendering/Camera.hh>
 
 #include "ignition/sensors/RenderingSensor.hh"
+#include "ignition/sensors/Tracing.hh"
 
 /// \brief Private data class for RenderingSensor
 class ignition::sensors::RenderingSensorPrivate
@@ -27,12 +36,87 @@ class ignition::sensors::RenderingSensorPrivate
   /// \brief Pointer to the scene
   public: ignition::rendering::ScenePtr scene;
 
+  /// \brief Scene to cast rays against on the CPU
+  public: RayScenePtr cpuScene;
+
   /// \brief Manually update the rendering scene graph
   public: bool manualSceneUpdate = false;
 
   /// \brief Pointer to the internal rendering sensors used for generating
   /// sensor data
   public: std::vector<rendering::SensorPtr::weak_type> sensors;
+
+  /// \brief Pipeline thread loop, runs queued post-processing work in
+  /// order until stopped.
+  /// \param[in] _id Id of the sensor, to tag its trace zones.
+  public: void PipelineLoop(SensorId _id);
+
+  /// \brief Start the pipeline thread if it isn't running.
+  /// \param[in] _id Id of the sensor, to tag its trace zones.
+  public: void StartPipeline(SensorId _id);
+
+  /// \brief Finish queued work and join the pipeline thread.
+  public: void StopPipeline();
+
+  /// \brief Block until the queued work satisfies a condition. Must be
+  /// called with pipelineMutex locked.
+  /// \param[in] _lock Lock on pipelineMutex.
+  /// \param[in] _done Condition to wait for.
+  public: void WaitPipeline(std::unique_lock<std::mutex> &_lock,
+              const std::function<bool()> &_done);
+
+  /// \brief Maximum number of frames waiting to be post-processed.
+  public: unsigned int pipelineDepth = 0u;
+
+  /// \brief Maximum time a frame may wait in the pipeline.
+  public: common::Time pipelineLatency;
+
+  /// \brief Counter used to cycle through per-frame buffer slots.
+  public: unsigned int pipelineSlot = 0u;
+
+  /// \brief Queued post-processing work with the stamp of its frame.
+  /// The front entry stays in the queue while it is being processed.
+  public: std::deque<std::pair<common::Time, std::function<void()>>>
+          pipelineQueue;
+
+  /// \brief Protects the pipeline queue and stop flag.
+  public: std::mutex pipelineMutex;
+
+  /// \brief Signaled when work is queued or the pipeline stops.
+  public: std::condition_variable pipelineWork;
+
+  /// \brief Signaled when queued work completes.
+  public: std::condition_variable pipelineDone;
+
+  /// \brief True to stop the pipeline thread.
+  public: bool pipelineStop = false;
+
+  /// \brief Thread that runs post-processing work.
+  public: std::thread pipelineThread;
+
+  /// \brief What to do when nothing changed since the last frame.
+  public: FrameReusePolicy frameReuse = FrameReusePolicy::NEVER;
+
+  /// \brief Revision of the rendering scene set by the host.
+  public: uint64_t sceneRevision = 0u;
+
+  /// \brief True once the host has set a scene revision.
+  public: bool hasSceneRevision = false;
+
+  /// \brief True if there is a frame that can be reused.
+  public: bool hasFrame = false;
+
+  /// \brief Sensor pose of the last rendered frame.
+  public: math::Pose3d framePose;
+
+  /// \brief Host scene revision of the last rendered frame.
+  public: uint64_t frameSceneRevision = 0u;
+
+  /// \brief CPU scene revision of the last rendered frame.
+  public: uint64_t frameCpuRevision = 0u;
+
+  /// \brief Number of reused frames.
+  public: uint64_t reusedFrames = 0u;
 };
 
 using namespace ignition;
@@ -47,12 +131,14 @@ RenderingSensor::RenderingSensor() :
 //////////////////////////////////////////////////
 RenderingSensor::~RenderingSensor()
 {
+  this->dataPtr->StopPipeline();
 }
 
 /////////////////////////////////////////////////
 void RenderingSensor::SetScene(rendering::ScenePtr _scene)
 {
   this->dataPtr->scene = _scene;
+  this->dataPtr->hasFrame = false;
 }
 
 /////////////////////////////////////////////////
@@ -61,6 +147,19 @@ rendering::ScenePtr RenderingSensor::Scene() const
   return this->dataPtr->scene;
 }
 
+/////////////////////////////////////////////////
+void RenderingSensor::SetCpuScene(RayScenePtr _scene)
+{
+  this->dataPtr->cpuScene = _scene;
+  this->dataPtr->hasFrame = false;
+}
+
+/////////////////////////////////////////////////
+RayScenePtr RenderingSensor::CpuScene() const
+{
+  return this->dataPtr->cpuScene;
+}
+
 /////////////////////////////////////////////////
 void RenderingSensor::AddSensor(rendering::SensorPtr _sensor)
 {
@@ -82,7 +181,7 @@ bool RenderingSensor::ManualSceneUpdate() const
 /////////////////////////////////////////////////
 void RenderingSensor::Render()
 {
-  IGN_PROFILE("RenderingSensor::Render");
+  IGN_SENSORS_PROFILE_SENSOR("RenderingSensor::Render", this->Id());
   // Skip scene update. The user indicated that they will do this manually.
   // Performance is improved when a global scene update occurs only once per
   // frame, which can be acheived using a manual scene update.
@@ -104,3 +203,227 @@ void RenderingSensor::Render()
   }
 }
 
+
+/////////////////////////////////////////////////
+void RenderingSensor::SetPipelineDepth(unsigned int _depth)
+{
+  if (_depth == this->dataPtr->pipelineDepth)
+    return;
+
+  this->FlushPipeline();
+  this->dataPtr->pipelineDepth = _depth;
+  this->dataPtr->pipelineSlot = 0u;
+
+  // Sensors reallocate their frame buffers when the depth changes
+  this->dataPtr->hasFrame = false;
+
+  if (_depth == 0u)
+    this->dataPtr->StopPipeline();
+}
+
+/////////////////////////////////////////////////
+unsigned int RenderingSensor::PipelineDepth() const
+{
+  return this->dataPtr->pipelineDepth;
+}
+
+/////////////////////////////////////////////////
+void RenderingSensor::SetPipelineLatency(const common::Time &_latency)
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->pipelineMutex);
+  this->dataPtr->pipelineLatency = _latency;
+}
+
+/////////////////////////////////////////////////
+common::Time RenderingSensor::PipelineLatency() const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->pipelineMutex);
+  return this->dataPtr->pipelineLatency;
+}
+
+/////////////////////////////////////////////////
+void RenderingSensor::FlushPipeline()
+{
+  IGN_SENSORS_PROFILE_SENSOR("RenderingSensor::FlushPipeline", this->Id());
+  std::unique_lock<std::mutex> lock(this->dataPtr->pipelineMutex);
+  this->dataPtr->WaitPipeline(lock, [this]
+  {
+    return this->dataPtr->pipelineQueue.empty();
+  });
+}
+
+/////////////////////////////////////////////////
+void RenderingSensor::SetFrameReuse(FrameReusePolicy _policy)
+{
+  this->dataPtr->frameReuse = _policy;
+}
+
+/////////////////////////////////////////////////
+FrameReusePolicy RenderingSensor::FrameReuse() const
+{
+  return this->dataPtr->frameReuse;
+}
+
+/////////////////////////////////////////////////
+void RenderingSensor::SetSceneRevision(uint64_t _revision)
+{
+  this->dataPtr->sceneRevision = _revision;
+  this->dataPtr->hasSceneRevision = true;
+}
+
+/////////////////////////////////////////////////
+uint64_t RenderingSensor::SceneRevision() const
+{
+  return this->dataPtr->sceneRevision;
+}
+
+/////////////////////////////////////////////////
+uint64_t RenderingSensor::ReusedFrameCount() const
+{
+  return this->dataPtr->reusedFrames;
+}
+
+/////////////////////////////////////////////////
+bool RenderingSensor::FrameDirty()
+{
+  if (this->dataPtr->frameReuse == FrameReusePolicy::NEVER)
+  {
+    this->dataPtr->hasFrame = false;
+    return true;
+  }
+
+  const math::Pose3d pose = this->Pose();
+  const uint64_t cpuRevision =
+      this->dataPtr->cpuScene ? this->dataPtr->cpuScene->Revision() : 0u;
+
+  // Without a revision there is no way to tell if the scene changed
+  const bool known = this->dataPtr->hasSceneRevision || this->dataPtr->cpuScene;
+  if (known && this->dataPtr->hasFrame && pose == this->dataPtr->framePose &&
+      this->dataPtr->sceneRevision == this->dataPtr->frameSceneRevision &&
+      cpuRevision == this->dataPtr->frameCpuRevision)
+  {
+    ++this->dataPtr->reusedFrames;
+    return false;
+  }
+
+  this->dataPtr->hasFrame = true;
+  this->dataPtr->framePose = pose;
+  this->dataPtr->frameSceneRevision = this->dataPtr->sceneRevision;
+  this->dataPtr->frameCpuRevision = cpuRevision;
+  return true;
+}
+
+/////////////////////////////////////////////////
+void RenderingSensor::InvalidateFrame()
+{
+  this->dataPtr->hasFrame = false;
+}
+
+/////////////////////////////////////////////////
+void RenderingSensor::PostProcess(const common::Time &_stamp,
+    std::function<void()> _work)
+{
+  if (this->dataPtr->pipelineDepth == 0u)
+  {
+    _work();
+    return;
+  }
+
+  this->dataPtr->StartPipeline(this->Id());
+
+  {
+    IGN_SENSORS_PROFILE_SENSOR("RenderingSensor::PostProcess Wait",
+        this->Id());
+    std::unique_lock<std::mutex> lock(this->dataPtr->pipelineMutex);
+    const common::Time latency = this->dataPtr->pipelineLatency;
+    this->dataPtr->WaitPipeline(lock, [&]
+    {
+      auto &queue = this->dataPtr->pipelineQueue;
+      if (queue.size() >= this->dataPtr->pipelineDepth)
+        return false;
+      return latency == common::Time::Zero || queue.empty() ||
+          queue.front().first + latency >= _stamp;
+    });
+    this->dataPtr->pipelineQueue.emplace_back(_stamp, std::move(_work));
+  }
+  this->dataPtr->pipelineWork.notify_one();
+}
+
+/////////////////////////////////////////////////
+unsigned int RenderingSensor::NextPipelineSlot()
+{
+  unsigned int slot = this->dataPtr->pipelineSlot;
+  this->dataPtr->pipelineSlot =
+      (slot + 1u) % (this->dataPtr->pipelineDepth + 1u);
+  return slot;
+}
+
+/////////////////////////////////////////////////
+void RenderingSensorPrivate::StartPipeline(SensorId _id)
+{
+  if (this->pipelineThread.joinable())
+    return;
+
+  this->pipelineStop = false;
+  this->pipelineThread = std::thread(&RenderingSensorPrivate::PipelineLoop,
+      this, _id);
+}
+
+/////////////////////////////////////////////////
+void RenderingSensorPrivate::StopPipeline()
+{
+  if (!this->pipelineThread.joinable())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(this->pipelineMutex);
+    this->pipelineStop = true;
+  }
+  this->pipelineWork.notify_all();
+  this->pipelineThread.join();
+}
+
+/////////////////////////////////////////////////
+void RenderingSensorPrivate::WaitPipeline(
+    std::unique_lock<std::mutex> &_lock, const std::function<bool()> &_done)
+{
+  // Nothing will drain the queue if the thread isn't running.
+  if (!this->pipelineThread.joinable())
+    return;
+  this->pipelineDone.wait(_lock, _done);
+}
+
+/////////////////////////////////////////////////
+void RenderingSensorPrivate::PipelineLoop(SensorId _id)
+{
+  IGN_SENSORS_PROFILE_THREAD_NAME("RenderingSensorPipeline");
+  std::unique_lock<std::mutex> lock(this->pipelineMutex);
+  while (true)
+  {
+    this->pipelineWork.wait(lock, [this]
+    {
+      return this->pipelineStop || !this->pipelineQueue.empty();
+    });
+
+    // Queued frames are always published, even when stopping.
+    if (this->pipelineQueue.empty())
+      break;
+
+    std::function<void()> work = std::move(this->pipelineQueue.front().second);
+    lock.unlock();
+    {
+      IGN_SENSORS_PROFILE_SENSOR("RenderingSensor::PostProcess", _id);
+      try
+      {
+        work();
+      }
+      catch(...)
+      {
+        ignerr << "Exception thrown while post-processing a frame.\n";
+      }
+    }
+    lock.lock();
+    this->pipelineQueue.pop_front();
+    this->pipelineDone.notify_all();
+  }
+}
@@ -0,0 +1,409 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ignition/sensors/RenderingSensor.hh>
+#include <ignition/sensors/Tracing.hh>
+
+using namespace ignition;
+using namespace sensors;
+
+/// \brief Stand-in for a rendering sensor. Instead of using a scene, each
+/// update "renders" by sleeping and writing the frame number into the
+/// buffer of its pipeline slot. Post-processing sleeps, then records the
+/// frame it received and the frame still held by its slot.
+class PipelineTestSensor : public RenderingSensor
+{
+  public: bool Update(const common::Time &_now) override
+  {
+    unsigned int frame = this->frameCount++;
+    unsigned int slot = this->NextPipelineSlot();
+    if (this->buffers.size() != this->PipelineDepth() + 1u)
+      this->buffers.resize(this->PipelineDepth() + 1u);
+
+    {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      this->rendersStarted = frame + 1u;
+      this->cv.notify_all();
+
+      // With the latch, this render can't finish before post-processing
+      // of the previous frame started.
+      if (frame > 0u && frame < this->latchFrames)
+      {
+        this->cv.wait_for(lock, std::chrono::seconds(5),
+            [&] {return this->postsStarted >= frame;});
+      }
+    }
+
+    // Stand-in render
+    std::this_thread::sleep_for(this->renderTime);
+    this->buffers[slot] = frame;
+
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->rendersFinished = frame + 1u;
+      this->maxPending = std::max(this->maxPending,
+          frame - static_cast<unsigned int>(this->published.size()));
+      this->stamps.push_back(_now);
+    }
+
+    this->PostProcess(_now, [this, frame, slot]
+    {
+      if (frame + 1u < this->latchFrames)
+      {
+        // Post-processing of this frame overlaps the next render if it
+        // starts before that render finished, and that render starts
+        // before it finished.
+        std::unique_lock<std::mutex> lock(this->mutex);
+        bool beforeEnd = this->rendersFinished <= frame + 1u;
+        this->postsStarted = frame + 1u;
+        this->cv.notify_all();
+        bool afterStart = this->cv.wait_for(lock, std::chrono::seconds(5),
+            [&] {return this->rendersStarted > frame + 1u;});
+        this->overlapped.push_back(beforeEnd && afterStart);
+      }
+
+      std::this_thread::sleep_for(this->postTime);
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->published.push_back(frame);
+      this->slotFrames.push_back(this->buffers[slot]);
+      this->threads.push_back(std::this_thread::get_id());
+    });
+
+    // Every frame older than the latency bound must have been published
+    // once this one is queued.
+    std::lock_guard<std::mutex> lock(this->mutex);
+    for (unsigned int i = static_cast<unsigned int>(this->published.size());
+        i < frame; ++i)
+    {
+      if (this->PipelineLatency() != common::Time::Zero &&
+          this->stamps[i] + this->PipelineLatency() < _now)
+      {
+        this->latencyExceeded = true;
+      }
+    }
+    return true;
+  }
+
+  /// \brief Time each stand-in render takes.
+  public: std::chrono::milliseconds renderTime{20};
+
+  /// \brief Time each post-process takes.
+  public: std::chrono::milliseconds postTime{20};
+
+  /// \brief Frame number held by each pipeline slot.
+  public: std::vector<unsigned int> buffers;
+
+  /// \brief Number of frames rendered.
+  public: unsigned int frameCount = 0u;
+
+  /// \brief Frames in the order they were published.
+  public: std::vector<unsigned int> published;
+
+  /// \brief Frame number found in the slot when each frame was published.
+  public: std::vector<unsigned int> slotFrames;
+
+  /// \brief Thread that published each frame.
+  public: std::vector<std::thread::id> threads;
+
+  /// \brief Stamp of each frame.
+  public: std::vector<common::Time> stamps;
+
+  /// \brief Largest number of unpublished frames seen before a render.
+  public: unsigned int maxPending = 0u;
+
+  /// \brief True if a frame waited longer than the latency bound.
+  public: bool latencyExceeded = false;
+
+  /// \brief Number of frames whose render and post-process are held
+  /// until the other started, so that post-processing of a frame and
+  /// rendering of the next are known to overlap when the pipeline works.
+  public: unsigned int latchFrames = 0u;
+
+  /// \brief Number of renders started.
+  public: unsigned int rendersStarted = 0u;
+
+  /// \brief Number of renders finished.
+  public: unsigned int rendersFinished = 0u;
+
+  /// \brief Number of post-processes started.
+  public: unsigned int postsStarted = 0u;
+
+  /// \brief Whether the post-process of each frame ran while the next
+  /// frame was rendering.
+  public: std::vector<bool> overlapped;
+
+  /// \brief Signals render and post-process progress for the latch.
+  public: std::condition_variable cv;
+
+  /// \brief Protects the recorded data.
+  public: std::mutex mutex;
+};
+
+/// \brief Run a number of updates and return the elapsed wall time in
+/// seconds, including the time to flush the pipeline.
+double RunFrames(PipelineTestSensor &_sensor, unsigned int _count,
+    double _period = 0.01)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned int i = 0; i < _count; ++i)
+    _sensor.Update(common::Time(i * _period));
+  _sensor.FlushPipeline();
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+//////////////////////////////////////////////////
+TEST(RenderingSensor_TEST, PipelineDisabled)
+{
+  PipelineTestSensor sensor;
+  EXPECT_EQ(0u, sensor.PipelineDepth());
+  EXPECT_EQ(common::Time::Zero, sensor.PipelineLatency());
+
+  sensor.Update(common::Time(0.1));
+
+  // Post-processing ran inside Update on this thread.
+  ASSERT_EQ(1u, sensor.published.size());
+  EXPECT_EQ(0u, sensor.published[0]);
+  EXPECT_EQ(std::this_thread::get_id(), sensor.threads[0]);
+}
+
+//////////////////////////////////////////////////
+TEST(RenderingSensor_TEST, PipelineOverlap)
+{
+  const unsigned int frames = 10u;
+
+  PipelineTestSensor pipelined;
+  pipelined.SetPipelineDepth(1u);
+  EXPECT_EQ(1u, pipelined.PipelineDepth());
+  pipelined.latchFrames = frames;
+  RunFrames(pipelined, frames);
+
+  // Post-processing of each frame ran while the next one was rendering.
+  ASSERT_EQ(frames - 1u, pipelined.overlapped.size());
+  for (unsigned int i = 0; i + 1u < frames; ++i)
+    EXPECT_TRUE(pipelined.overlapped[i]) << "frame " << i;
+
+  // Every frame is published in order, from the pipeline thread, with the
+  // data its slot held when it was rendered.
+  ASSERT_EQ(frames, pipelined.published.size());
+  for (unsigned int i = 0; i < frames; ++i)
+  {
+    EXPECT_EQ(i, pipelined.published[i]);
+    EXPECT_EQ(i, pipelined.slotFrames[i]);
+    EXPECT_NE(std::this_thread::get_id(), pipelined.threads[i]);
+  }
+}
+
+//////////////////////////////////////////////////
+TEST(RenderingSensor_TEST, PipelineDepth)
+{
+  const unsigned int frames = 12u;
+
+  for (unsigned int depth : {1u, 2u, 4u})
+  {
+    PipelineTestSensor sensor;
+    sensor.SetPipelineDepth(depth);
+
+    // Post-processing is the bottleneck, so the pipeline fills up.
+    sensor.renderTime = std::chrono::milliseconds(2);
+    sensor.postTime = std::chrono::milliseconds(15);
+    RunFrames(sensor, frames);
+
+    ASSERT_EQ(frames, sensor.published.size());
+    EXPECT_LE(sensor.maxPending, depth);
+    for (unsigned int i = 0; i < frames; ++i)
+    {
+      EXPECT_EQ(i, sensor.published[i]);
+      EXPECT_EQ(i, sensor.slotFrames[i]);
+    }
+  }
+}
+
+//////////////////////////////////////////////////
+TEST(RenderingSensor_TEST, PipelineLatency)
+{
+  PipelineTestSensor sensor;
+  sensor.SetPipelineDepth(4u);
+  sensor.SetPipelineLatency(common::Time(0.02));
+  EXPECT_EQ(common::Time(0.02), sensor.PipelineLatency());
+
+  sensor.renderTime = std::chrono::milliseconds(2);
+  sensor.postTime = std::chrono::milliseconds(15);
+  RunFrames(sensor, 10u, 0.01);
+
+  ASSERT_EQ(10u, sensor.published.size());
+  EXPECT_FALSE(sensor.latencyExceeded);
+
+  // Frames 10ms apart with a 20ms bound allow at most three queued frames,
+  // even though the depth allows four.
+  EXPECT_LE(sensor.maxPending, 3u);
+}
+
+//////////////////////////////////////////////////
+TEST(RenderingSensor_TEST, PipelineDepthChange)
+{
+  PipelineTestSensor sensor;
+  sensor.SetPipelineDepth(2u);
+  RunFrames(sensor, 3u);
+
+  // Changing the depth publishes queued frames, and disabling the pipeline
+  // returns to synchronous post-processing.
+  sensor.Update(common::Time(1.0));
+  sensor.SetPipelineDepth(0u);
+  ASSERT_EQ(4u, sensor.published.size());
+
+  sensor.Update(common::Time(2.0));
+  ASSERT_EQ(5u, sensor.published.size());
+  EXPECT_EQ(std::this_thread::get_id(), sensor.threads.back());
+}
+
+//////////////////////////////////////////////////
+TEST(RenderingSensor_TEST, PipelineTraceZones)
+{
+  PipelineTestSensor sensor;
+  sensor.SetPipelineDepth(1u);
+  sensor.renderTime = std::chrono::milliseconds(1);
+  sensor.postTime = std::chrono::milliseconds(1);
+
+  Tracing::Clear();
+  Tracing::Start();
+  Tracing::SetSensorName(sensor.Id(), "pipelined");
+  RunFrames(sensor, 3u);
+  Tracing::Stop();
+
+  std::ostringstream out;
+  EXPECT_TRUE(Tracing::Dump(out));
+  const std::string trace = out.str();
+  Tracing::Clear();
+
+  // Zones of the pipeline thread are tagged with the sensor
+  const std::string tag = "\"args\":{\"sensor\":\"pipelined\",\"id\":" +
+      std::to_string(sensor.Id()) + "}";
+  auto tagged = [&](const std::string &_zone)
+  {
+    unsigned int count = 0u;
+    const std::string name = "{\"name\":\"" + _zone + "\"";
+    for (std::size_t pos = trace.find(name); pos != std::string::npos;
+         pos = trace.find(name, pos + 1u))
+    {
+      std::size_t end = trace.find("{\"name\":", pos + 1u);
+      if (trace.substr(pos, end - pos).find(tag) == std::string::npos)
+        return 0u;
+      ++count;
+    }
+    return count;
+  };
+  EXPECT_EQ(3u, tagged("RenderingSensor::PostProcess"));
+  EXPECT_EQ(3u, tagged("RenderingSensor::PostProcess Wait"));
+  EXPECT_EQ(1u, tagged("RenderingSensor::FlushPipeline"));
+}
+
+//////////////////////////////////////////////////
+/// \brief Rendering sensor that only exposes frame reuse checks.
+class ReuseTestSensor : public RenderingSensor
+{
+  public: bool Update(const common::Time &) override
+  {
+    return this->FrameDirty();
+  }
+};
+
+//////////////////////////////////////////////////
+TEST(RenderingSensor_TEST, FrameReuse)
+{
+  ReuseTestSensor sensor;
+  EXPECT_EQ(FrameReusePolicy::NEVER, sensor.FrameReuse());
+  EXPECT_TRUE(sensor.Update(common::Time::Zero));
+  EXPECT_TRUE(sensor.Update(common::Time::Zero));
+
+  // Without a scene revision changes can't be detected
+  sensor.SetFrameReuse(FrameReusePolicy::REPUBLISH);
+  EXPECT_EQ(FrameReusePolicy::REPUBLISH, sensor.FrameReuse());
+  EXPECT_TRUE(sensor.Update(common::Time::Zero));
+  EXPECT_TRUE(sensor.Update(common::Time::Zero));
+  EXPECT_EQ(0u, sensor.ReusedFrameCount());
+
+  sensor.SetSceneRevision(3u);
+  EXPECT_EQ(3u, sensor.SceneRevision());
+  EXPECT_TRUE(sensor.Update(common::Time::Zero));
+  EXPECT_FALSE(sensor.Update(common::Time::Zero));
+  EXPECT_FALSE(sensor.Update(common::Time::Zero));
+  EXPECT_EQ(2u, sensor.ReusedFrameCount());
+
+  // The scene changed
+  sensor.SetSceneRevision(4u);
+  EXPECT_TRUE(sensor.Update(common::Time::Zero));
+  EXPECT_FALSE(sensor.Update(common::Time::Zero));
+
+  // The sensor moved
+  sensor.SetPose(math::Pose3d(1, 0, 0, 0, 0, 0));
+  EXPECT_TRUE(sensor.Update(common::Time::Zero));
+  EXPECT_FALSE(sensor.Update(common::Time::Zero));
+
+  // Frame buffers are reallocated
+  sensor.SetPipelineDepth(1u);
+  EXPECT_TRUE(sensor.Update(common::Time::Zero));
+  EXPECT_FALSE(sensor.Update(common::Time::Zero));
+
+  // Frames rendered without reuse are never reused later
+  sensor.SetFrameReuse(FrameReusePolicy::NEVER);
+  EXPECT_TRUE(sensor.Update(common::Time::Zero));
+  sensor.SetFrameReuse(FrameReusePolicy::SKIP);
+  EXPECT_TRUE(sensor.Update(common::Time::Zero));
+  EXPECT_FALSE(sensor.Update(common::Time::Zero));
+  EXPECT_EQ(6u, sensor.ReusedFrameCount());
+}
+
+//////////////////////////////////////////////////
+TEST(RenderingSensor_TEST, FrameReuseCpuScene)
+{
+  ReuseTestSensor sensor;
+  sensor.SetFrameReuse(FrameReusePolicy::REPUBLISH);
+
+  // The CPU scene revision is used without a host revision
+  auto scene = std::make_shared<RayScene>();
+  sensor.SetCpuScene(scene);
+  EXPECT_TRUE(sensor.Update(common::Time::Zero));
+  EXPECT_FALSE(sensor.Update(common::Time::Zero));
+
+  RayObjectId box = scene->AddBox(math::Vector3d::One,
+      math::Pose3d(2, 0, 0, 0, 0, 0));
+  EXPECT_TRUE(sensor.Update(common::Time::Zero));
+  EXPECT_FALSE(sensor.Update(common::Time::Zero));
+
+  scene->SetObjectPose(box, math::Pose3d(3, 0, 0, 0, 0, 0));
+  EXPECT_TRUE(sensor.Update(common::Time::Zero));
+  EXPECT_FALSE(sensor.Update(common::Time::Zero));
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,589 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef _WIN32
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <ignition/common/Console.hh>
+#include <ignition/transport/Node.hh>
+
+#include "ignition/sensors/Replay.hh"
+#include "ignition/sensors/Tracing.hh"
+
+#include "RecordingFormat.hh"
+
+using namespace ignition;
+using namespace sensors;
+
+namespace
+{
+  /// \brief Longest sleep of Play() between checks for Stop().
+  const std::chrono::milliseconds kMaxSleep(10);
+
+  /// \brief Convert nanoseconds to a time.
+  /// \param[in] _ns Nanoseconds.
+  /// \return Time.
+  common::Time ToTime(int64_t _ns)
+  {
+    return common::Time(static_cast<int32_t>(_ns / 1000000000),
+        static_cast<int32_t>(_ns % 1000000000));
+  }
+
+  /// \brief Convert a time to nanoseconds.
+  /// \param[in] _time Time.
+  /// \return Nanoseconds.
+  int64_t Nanoseconds(const common::Time &_time)
+  {
+    return static_cast<int64_t>(_time.sec) * 1000000000 + _time.nsec;
+  }
+
+  /// \brief Channel of a recording.
+  struct ReplayChannel
+  {
+    /// \brief Name of the sensor.
+    std::string sensor;
+
+    /// \brief Topic of the sensor.
+    std::string topic;
+
+    /// \brief Type name of the messages.
+    std::string type;
+
+    /// \brief Publisher of the messages, created by Play().
+    transport::Node::Publisher *pub = nullptr;
+  };
+}
+
+/// \brief Private data for Replay
+class ignition::sensors::ReplayPrivate
+{
+  /// \brief Parse a channel definition.
+  /// \param[in] _data Definition.
+  /// \param[in] _size Size of the definition.
+  /// \return False if it's invalid or out of order.
+  public: bool AddChannel(const char *_data, std::size_t _size);
+
+  /// \brief Read the index written when the recording was closed.
+  /// \param[in] _offset Offset of the index.
+  /// \return False if the index is invalid.
+  public: bool ReadIndex(uint64_t _offset);
+
+  /// \brief Index the messages by scanning the chunks.
+  /// \param[in] _offset Offset of the first chunk.
+  /// \return False if a chunk is invalid.
+  public: bool Scan(uint64_t _offset);
+
+  /// \brief Build the time table used by Seek().
+  public: void BuildTimeTable();
+
+  /// \brief Get the publisher of a channel, advertising it if needed.
+  /// \param[in] _channel The channel.
+  /// \return The publisher, nullptr if it couldn't be advertised.
+  public: transport::Node::Publisher *Publisher(ReplayChannel &_channel);
+
+  /// \brief Unmap the recording and clear the index.
+  public: void Release();
+
+  /// \brief Mapped recording.
+  public: const char *data = nullptr;
+
+  /// \brief Size of the recording.
+  public: std::size_t size = 0u;
+
+#ifdef _WIN32
+  /// \brief Recording read in memory, where it can't be mapped.
+  public: std::string buffer;
+#endif
+
+  /// \brief Channels, by id.
+  public: std::vector<ReplayChannel> channels;
+
+  /// \brief Messages, sorted by stamp.
+  public: std::vector<recording::IndexEntry> entries;
+
+  /// \brief Index of the first message at or after the start of each time
+  /// slot.
+  public: std::vector<std::size_t> timeTable;
+
+  /// \brief Duration of the time slots, in nanoseconds.
+  public: int64_t slotDuration = 1;
+
+  /// \brief Index of the next message.
+  public: std::size_t position = 0u;
+
+  /// \brief Channel of the message last returned by Next().
+  public: uint32_t lastChannel = 0u;
+
+  /// \brief Tells Play() to stop.
+  public: std::atomic<bool> stopping{false};
+
+  /// \brief Node to republish messages.
+  public: transport::Node node;
+
+  /// \brief Publishers by topic.
+  public: std::map<std::string, transport::Node::Publisher> publishers;
+
+  /// \brief Type published on each topic.
+  public: std::map<std::string, std::string> topicTypes;
+};
+
+//////////////////////////////////////////////////
+bool ReplayPrivate::AddChannel(const char *_data, std::size_t _size)
+{
+  recording::MemoryReader reader(_data, _size);
+  uint32_t id = 0u;
+  ReplayChannel channel;
+  if (!reader.Read(id) || id != this->channels.size() ||
+      !reader.ReadString(channel.sensor) ||
+      !reader.ReadString(channel.topic) || !reader.ReadString(channel.type))
+  {
+    return false;
+  }
+  this->channels.push_back(channel);
+  return true;
+}
+
+//////////////////////////////////////////////////
+bool ReplayPrivate::ReadIndex(uint64_t _offset)
+{
+  if (_offset > this->size)
+    return false;
+
+  recording::MemoryReader reader(this->data + _offset, this->size - _offset);
+  recording::IndexHeader header;
+  if (!reader.Read(header))
+    return false;
+
+  std::string definition;
+  for (uint32_t i = 0u; i < header.channels; ++i)
+  {
+    if (!reader.ReadString(definition) ||
+        !this->AddChannel(definition.data(), definition.size()))
+    {
+      return false;
+    }
+  }
+
+  if (reader.Remaining() / sizeof(recording::IndexEntry) < header.entries)
+    return false;
+  this->entries.resize(header.entries);
+  for (recording::IndexEntry &entry : this->entries)
+    reader.Read(entry);
+  return true;
+}
+
+//////////////////////////////////////////////////
+bool ReplayPrivate::Scan(uint64_t _offset)
+{
+  while (this->size - _offset >= sizeof(recording::ChunkHeader))
+  {
+    recording::ChunkHeader chunk;
+    std::memcpy(&chunk, this->data + _offset, sizeof(chunk));
+
+    // A chunk that was being started when the recording stopped
+    if (chunk.magic != recording::kChunkMagic)
+      break;
+
+    if (chunk.used < sizeof(chunk) || chunk.capacity < chunk.used ||
+        chunk.capacity > this->size - _offset)
+    {
+      return false;
+    }
+
+    recording::MemoryReader reader(this->data + _offset + sizeof(chunk),
+        chunk.used - sizeof(chunk));
+    for (uint32_t i = 0u; i < chunk.records; ++i)
+    {
+      const uint64_t offset = _offset + chunk.used - reader.Remaining();
+      recording::RecordHeader record;
+      if (!reader.Read(record) || reader.Remaining() < record.size)
+        return false;
+
+      const char *recordData = this->data + offset + sizeof(record);
+      if (record.channel == recording::kChannelDefinition)
+      {
+        if (!this->AddChannel(recordData, record.size))
+          return false;
+      }
+      else
+      {
+        this->entries.push_back({record.stamp, offset});
+      }
+
+      reader.Skip(record.size);
+    }
+    _offset += chunk.capacity;
+  }
+
+  std::stable_sort(this->entries.begin(), this->entries.end(),
+      [](const recording::IndexEntry &_a, const recording::IndexEntry &_b)
+      {
+        return _a.stamp < _b.stamp;
+      });
+  return true;
+}
+
+//////////////////////////////////////////////////
+void ReplayPrivate::BuildTimeTable()
+{
+  this->timeTable.clear();
+  if (this->entries.empty())
+    return;
+
+  // About one message per slot, so that Seek() only steps over a few
+  // messages after the lookup
+  const int64_t start = this->entries.front().stamp;
+  const int64_t duration = this->entries.back().stamp - start;
+  const int64_t count = static_cast<int64_t>(this->entries.size());
+  this->slotDuration = duration / count + 1;
+
+  std::size_t index = 0u;
+  for (int64_t slot = 0; slot <= duration / this->slotDuration; ++slot)
+  {
+    const int64_t slotStart = start + slot * this->slotDuration;
+    while (index < this->entries.size() &&
+        this->entries[index].stamp < slotStart)
+    {
+      ++index;
+    }
+    this->timeTable.push_back(index);
+  }
+}
+
+//////////////////////////////////////////////////
+transport::Node::Publisher *ReplayPrivate::Publisher(ReplayChannel &_channel)
+{
+  if (_channel.pub)
+    return _channel.pub;
+
+  std::string topic = _channel.topic.empty() ?
+      "/" + _channel.sensor : _channel.topic;
+  auto type = this->topicTypes.find(topic);
+  if (type != this->topicTypes.end() && type->second != _channel.type)
+  {
+    std::string suffix = _channel.type.substr(_channel.type.rfind('.') + 1);
+    std::transform(suffix.begin(), suffix.end(), suffix.begin(),
+        [](unsigned char _c) {return std::tolower(_c);});
+    topic += "/" + suffix;
+  }
+
+  auto pub = this->publishers.find(topic);
+  if (pub == this->publishers.end())
+  {
+    transport::Node::Publisher advertised =
+        this->node.Advertise(topic, _channel.type);
+    if (!advertised)
+    {
+      ignerr << "Unable to create publisher on topic[" << topic << "].\n";
+      return nullptr;
+    }
+    pub = this->publishers.emplace(topic, advertised).first;
+    this->topicTypes[topic] = _channel.type;
+  }
+  _channel.pub = &pub->second;
+  return _channel.pub;
+}
+
+//////////////////////////////////////////////////
+void ReplayPrivate::Release()
+{
+#ifndef _WIN32
+  if (this->data)
+    munmap(const_cast<char *>(this->data), this->size);
+#else
+  this->buffer.clear();
+#endif
+  this->data = nullptr;
+  this->size = 0u;
+  this->channels.clear();
+  this->entries.clear();
+  this->timeTable.clear();
+  this->position = 0u;
+}
+
+//////////////////////////////////////////////////
+bool ReplayMessage::Parse(google::protobuf::Message &_msg) const
+{
+  return _msg.GetTypeName() == this->type &&
+      _msg.ParseFromArray(this->data, static_cast<int>(this->size));
+}
+
+//////////////////////////////////////////////////
+Replay::Replay()
+  : dataPtr(new ReplayPrivate)
+{
+}
+
+//////////////////////////////////////////////////
+Replay::~Replay()
+{
+  this->dataPtr->Release();
+}
+
+//////////////////////////////////////////////////
+bool Replay::Open(const std::string &_path)
+{
+  IGN_SENSORS_PROFILE("Replay::Open");
+  this->Close();
+
+#ifndef _WIN32
+  int fd = open(_path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    ignerr << "Unable to open recording [" << _path << "].\n";
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) == 0 &&
+      static_cast<std::size_t>(info.st_size) >= sizeof(recording::FileHeader))
+  {
+    void *map = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED)
+    {
+      this->dataPtr->data = static_cast<const char *>(map);
+      this->dataPtr->size = static_cast<std::size_t>(info.st_size);
+    }
+  }
+  close(fd);
+#else
+  std::ifstream stream(_path, std::ios::binary);
+  if (!stream)
+  {
+    ignerr << "Unable to open recording [" << _path << "].\n";
+    return false;
+  }
+  std::ostringstream contents;
+  contents << stream.rdbuf();
+  this->dataPtr->buffer = contents.str();
+  if (this->dataPtr->buffer.size() >= sizeof(recording::FileHeader))
+  {
+    this->dataPtr->data = this->dataPtr->buffer.data();
+    this->dataPtr->size = this->dataPtr->buffer.size();
+  }
+#endif
+
+  if (!this->dataPtr->data)
+  {
+    ignerr << "Recording [" << _path << "] is too small or can't be "
+           << "mapped.\n";
+    this->Close();
+    return false;
+  }
+
+  recording::FileHeader header;
+  std::memcpy(&header, this->dataPtr->data, sizeof(header));
+  if (std::memcmp(header.magic, recording::kFileMagic,
+      sizeof(header.magic)) != 0 || header.version != recording::kVersion ||
+      header.headerSize < sizeof(header) ||
+      header.headerSize > this->dataPtr->size)
+  {
+    ignerr << "[" << _path << "] isn't a recording of version ["
+           << recording::kVersion << "].\n";
+    this->Close();
+    return false;
+  }
+
+  bool indexed = false;
+  if (header.indexOffset != 0u)
+  {
+    indexed = this->dataPtr->ReadIndex(header.indexOffset);
+  }
+  else
+  {
+    ignwarn << "Recording [" << _path << "] wasn't closed, scanning it.\n";
+    indexed = this->dataPtr->Scan(header.headerSize);
+  }
+
+  if (!indexed)
+  {
+    ignerr << "Recording [" << _path << "] is corrupt.\n";
+    this->Close();
+    return false;
+  }
+
+  this->dataPtr->BuildTimeTable();
+  return true;
+}
+
+//////////////////////////////////////////////////
+void Replay::Close()
+{
+  this->dataPtr->Release();
+}
+
+//////////////////////////////////////////////////
+uint64_t Replay::MessageCount() const
+{
+  return this->dataPtr->entries.size();
+}
+
+//////////////////////////////////////////////////
+common::Time Replay::StartTime() const
+{
+  if (this->dataPtr->entries.empty())
+    return common::Time::Zero;
+  return ToTime(this->dataPtr->entries.front().stamp);
+}
+
+//////////////////////////////////////////////////
+common::Time Replay::EndTime() const
+{
+  if (this->dataPtr->entries.empty())
+    return common::Time::Zero;
+  return ToTime(this->dataPtr->entries.back().stamp);
+}
+
+//////////////////////////////////////////////////
+bool Replay::Seek(const common::Time &_time)
+{
+  const auto &entries = this->dataPtr->entries;
+  const int64_t stamp = Nanoseconds(_time);
+  if (entries.empty() || stamp > entries.back().stamp)
+  {
+    this->dataPtr->position = entries.size();
+    return false;
+  }
+
+  const int64_t start = entries.front().stamp;
+  if (stamp <= start)
+  {
+    this->dataPtr->position = 0u;
+    return true;
+  }
+
+  std::size_t index = this->dataPtr->timeTable[
+      (stamp - start) / this->dataPtr->slotDuration];
+  while (entries[index].stamp < stamp)
+    ++index;
+  this->dataPtr->position = index;
+  return true;
+}
+
+//////////////////////////////////////////////////
+bool Replay::Next(ReplayMessage &_msg)
+{
+  while (this->dataPtr->position < this->dataPtr->entries.size())
+  {
+    const recording::IndexEntry &entry =
+        this->dataPtr->entries[this->dataPtr->position++];
+
+    // Entries are checked when read, so opening a recording doesn't touch
+    // all of it
+    recording::RecordHeader record;
+    if (entry.offset > this->dataPtr->size ||
+        this->dataPtr->size - entry.offset < sizeof(record))
+    {
+      ignerr << "Skipping invalid message of the recording.\n";
+      continue;
+    }
+    std::memcpy(&record, this->dataPtr->data + entry.offset, sizeof(record));
+    if (this->dataPtr->size - entry.offset - sizeof(record) < record.size ||
+        record.channel >= this->dataPtr->channels.size())
+    {
+      ignerr << "Skipping invalid message of the recording.\n";
+      continue;
+    }
+
+    this->dataPtr->lastChannel = record.channel;
+    const ReplayChannel &channel = this->dataPtr->channels[record.channel];
+    _msg.sensor = channel.sensor;
+    _msg.topic = channel.topic;
+    _msg.type = channel.type;
+    _msg.stamp = ToTime(record.stamp);
+    _msg.data = this->dataPtr->data + entry.offset + sizeof(record);
+    _msg.size = record.size;
+    return true;
+  }
+  return false;
+}
+
+//////////////////////////////////////////////////
+uint64_t Replay::Play(double _speed,
+    const std::function<void(const ReplayMessage &)> &_callback)
+{
+  IGN_SENSORS_PROFILE("Replay::Play");
+  this->dataPtr->stopping = false;
+
+  uint64_t played = 0u;
+  ReplayMessage msg;
+  std::string data;
+  const auto wallStart = std::chrono::steady_clock::now();
+  int64_t firstStamp = 0;
+  while (!this->dataPtr->stopping && this->Next(msg))
+  {
+    if (played == 0u)
+      firstStamp = Nanoseconds(msg.stamp);
+
+    if (_speed > 0.0)
+    {
+      const auto target = wallStart + std::chrono::nanoseconds(
+          static_cast<int64_t>((Nanoseconds(msg.stamp) - firstStamp) /
+          _speed));
+      auto now = std::chrono::steady_clock::now();
+      while (!this->dataPtr->stopping && now < target)
+      {
+        std::this_thread::sleep_for(std::min<std::chrono::nanoseconds>(
+            target - now, kMaxSleep));
+        now = std::chrono::steady_clock::now();
+      }
+      if (this->dataPtr->stopping)
+      {
+        // Play the message on the next call
+        --this->dataPtr->position;
+        break;
+      }
+    }
+
+    if (_callback)
+    {
+      _callback(msg);
+    }
+    else
+    {
+      transport::Node::Publisher *pub = this->dataPtr->Publisher(
+          this->dataPtr->channels[this->dataPtr->lastChannel]);
+      if (pub)
+      {
+        data.assign(msg.data, msg.size);
+        pub->PublishRaw(data, msg.type);
+      }
+    }
+    ++played;
+  }
+  return played;
+}
+
+//////////////////////////////////////////////////
+void Replay::Stop()
+{
+  this->dataPtr->stopping = true;
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include <ignition/common/Console.hh>
+#include <ignition/math/Helpers.hh>
+
+#include "ignition/sensors/ResolutionScaler.hh"
+
+using namespace ignition;
+using namespace sensors;
+
+namespace
+{
+  /// \brief Granularity of the scale.
+  const double kScaleStep = 0.05;
+
+  /// \brief Weight of the last render time in the smoothed time.
+  const double kSmoothing = 0.3;
+
+  /// \brief Number of frames to render at a new scale before changing it
+  /// again.
+  const unsigned int kSettleFrames = 3u;
+
+  /// \brief Fraction of the target time below which the scale is raised.
+  const double kHeadroom = 0.7;
+
+  /// \brief Fraction of the target time a raised scale aims for, so it
+  /// isn't lowered again right away.
+  const double kRaiseTarget = 0.9;
+
+  /// \brief Round a scale down to a multiple of the scale step.
+  /// \param[in] _scale Scale to round.
+  /// \return Rounded scale.
+  double Quantize(double _scale)
+  {
+    return std::floor(_scale / kScaleStep + 1e-6) * kScaleStep;
+  }
+}
+
+/// \brief Private data for ResolutionScaler
+class ignition::sensors::ResolutionScalerPrivate
+{
+  /// \brief Lower bound of the scale.
+  public: double minScale = 1.0;
+
+  /// \brief Upper bound of the scale.
+  public: double maxScale = 1.0;
+
+  /// \brief Render time to aim for, in seconds.
+  public: double targetTime = 0.0;
+
+  /// \brief Current scale.
+  public: double scale = 1.0;
+
+  /// \brief Smoothed render time at the current scale, in seconds.
+  public: double smoothedTime = 0.0;
+
+  /// \brief Number of frames rendered at the current scale.
+  public: unsigned int samples = 0u;
+};
+
+//////////////////////////////////////////////////
+ResolutionScaler::ResolutionScaler()
+  : dataPtr(new ResolutionScalerPrivate)
+{
+}
+
+//////////////////////////////////////////////////
+ResolutionScaler::~ResolutionScaler()
+{
+}
+
+//////////////////////////////////////////////////
+bool ResolutionScaler::SetBounds(double _min, double _max)
+{
+  if (_min <= 0.0 || _max < _min)
+  {
+    ignerr << "Invalid resolution scale bounds [" << _min << ", " << _max
+           << "].\n";
+    return false;
+  }
+
+  this->dataPtr->minScale = _min;
+  this->dataPtr->maxScale = _max;
+  this->Reset();
+  return true;
+}
+
+//////////////////////////////////////////////////
+double ResolutionScaler::MinScale() const
+{
+  return this->dataPtr->minScale;
+}
+
+//////////////////////////////////////////////////
+double ResolutionScaler::MaxScale() const
+{
+  return this->dataPtr->maxScale;
+}
+
+//////////////////////////////////////////////////
+void ResolutionScaler::SetTargetTime(double _seconds)
+{
+  this->dataPtr->targetTime = std::max(0.0, _seconds);
+  this->dataPtr->samples = 0u;
+}
+
+//////////////////////////////////////////////////
+double ResolutionScaler::TargetTime() const
+{
+  return this->dataPtr->targetTime;
+}
+
+//////////////////////////////////////////////////
+bool ResolutionScaler::Enabled() const
+{
+  return this->dataPtr->targetTime > 0.0 ||
+      !math::equal(this->dataPtr->maxScale, 1.0);
+}
+
+//////////////////////////////////////////////////
+double ResolutionScaler::Scale() const
+{
+  return this->dataPtr->scale;
+}
+
+//////////////////////////////////////////////////
+unsigned int ResolutionScaler::Scaled(unsigned int _size) const
+{
+  return std::max(1u, static_cast<unsigned int>(
+      std::lround(_size * this->dataPtr->scale)));
+}
+
+//////////////////////////////////////////////////
+bool ResolutionScaler::AddSample(double _seconds)
+{
+  ResolutionScalerPrivate &d = *this->dataPtr;
+  if (d.targetTime <= 0.0)
+  {
+    if (math::equal(d.scale, d.maxScale))
+      return false;
+    d.scale = d.maxScale;
+    return true;
+  }
+
+  if (d.samples == 0u)
+    d.smoothedTime = _seconds;
+  else
+    d.smoothedTime += kSmoothing * (_seconds - d.smoothedTime);
+  if (++d.samples < kSettleFrames)
+    return false;
+
+  // The render time grows with the number of pixels, the square of the
+  // scale
+  double scale = d.scale;
+  if (d.smoothedTime > d.targetTime)
+  {
+    scale = std::min(Quantize(d.scale *
+        std::sqrt(d.targetTime / d.smoothedTime)), d.scale - kScaleStep);
+  }
+  else if (d.smoothedTime < kHeadroom * d.targetTime)
+  {
+    double raised = d.smoothedTime > 0.0 ?
+        Quantize(d.scale *
+        std::sqrt(kRaiseTarget * d.targetTime / d.smoothedTime)) :
+        d.maxScale;
+    if (raised >= d.scale + kScaleStep - 1e-6)
+      scale = raised;
+  }
+  scale = math::clamp(scale, d.minScale, d.maxScale);
+
+  if (math::equal(scale, d.scale))
+    return false;
+
+  d.scale = scale;
+  d.samples = 0u;
+  return true;
+}
+
+//////////////////////////////////////////////////
+void ResolutionScaler::Reset()
+{
+  this->dataPtr->scale = this->dataPtr->maxScale;
+  this->dataPtr->smoothedTime = 0.0;
+  this->dataPtr->samples = 0u;
+}
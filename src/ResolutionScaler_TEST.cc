@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <gtest/gtest.h>
+
+#include "ignition/sensors/ResolutionScaler.hh"
+
+using namespace ignition;
+using namespace sensors;
+
+//////////////////////////////////////////////////
+TEST(ResolutionScaler_TEST, Defaults)
+{
+  ResolutionScaler scaler;
+  EXPECT_FALSE(scaler.Enabled());
+  EXPECT_DOUBLE_EQ(1.0, scaler.Scale());
+  EXPECT_DOUBLE_EQ(1.0, scaler.MinScale());
+  EXPECT_DOUBLE_EQ(1.0, scaler.MaxScale());
+  EXPECT_DOUBLE_EQ(0.0, scaler.TargetTime());
+  EXPECT_EQ(640u, scaler.Scaled(640u));
+
+  // Without a target the scale doesn't move
+  for (int i = 0; i < 10; ++i)
+    EXPECT_FALSE(scaler.AddSample(1.0));
+  EXPECT_DOUBLE_EQ(1.0, scaler.Scale());
+
+  EXPECT_FALSE(scaler.SetBounds(0.0, 1.0));
+  EXPECT_FALSE(scaler.SetBounds(0.5, 0.25));
+  EXPECT_TRUE(scaler.SetBounds(0.25, 0.5));
+  EXPECT_TRUE(scaler.Enabled());
+  EXPECT_DOUBLE_EQ(0.5, scaler.Scale());
+  EXPECT_EQ(320u, scaler.Scaled(640u));
+  EXPECT_EQ(1u, scaler.Scaled(1u));
+}
+
+//////////////////////////////////////////////////
+TEST(ResolutionScaler_TEST, FollowsRenderTime)
+{
+  ResolutionScaler scaler;
+  EXPECT_TRUE(scaler.SetBounds(0.25, 1.0));
+  scaler.SetTargetTime(0.01);
+  EXPECT_TRUE(scaler.Enabled());
+
+  // Simulated render time, proportional to the number of pixels
+  double fullTime = 0.04;
+  auto renderTime = [&]()
+  {
+    return fullTime * scaler.Scale() * scaler.Scale();
+  };
+
+  int changes = 0;
+  for (int i = 0; i < 100; ++i)
+  {
+    if (scaler.AddSample(renderTime()))
+      ++changes;
+  }
+  EXPECT_LE(renderTime(), 0.01);
+  EXPECT_GE(renderTime(), 0.01 * 0.7 * 0.7);
+  EXPECT_NEAR(0.5, scaler.Scale(), 0.1);
+
+  // The scale settles instead of oscillating
+  EXPECT_LT(changes, 5);
+  changes = 0;
+  for (int i = 0; i < 100; ++i)
+  {
+    if (scaler.AddSample(renderTime()))
+      ++changes;
+  }
+  EXPECT_EQ(0, changes);
+
+  // Rendering gets too slow even at the lower bound
+  fullTime = 1.0;
+  for (int i = 0; i < 100; ++i)
+    scaler.AddSample(renderTime());
+  EXPECT_DOUBLE_EQ(0.25, scaler.Scale());
+
+  // Rendering gets fast, the scale goes back up to the upper bound
+  fullTime = 0.001;
+  for (int i = 0; i < 100; ++i)
+    scaler.AddSample(renderTime());
+  EXPECT_DOUBLE_EQ(1.0, scaler.Scale());
+
+  // Removing the target restores the upper bound
+  fullTime = 1.0;
+  for (int i = 0; i < 100; ++i)
+    scaler.AddSample(renderTime());
+  EXPECT_DOUBLE_EQ(0.25, scaler.Scale());
+  scaler.SetTargetTime(0.0);
+  EXPECT_TRUE(scaler.AddSample(renderTime()));
+  EXPECT_DOUBLE_EQ(1.0, scaler.Scale());
+}
+
+//////////////////////////////////////////////////
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -19,7 +19,6 @@
 #include <ignition/msgs/pointcloud_packed.pb.h>
 
 #include <ignition/common/Image.hh>
-#include <ignition/common/Profiler.hh>
 #include <ignition/math/Helpers.hh>
 
 #include <ignition/rendering/Camera.hh>
@@ -31,7 +30,10 @@
 #include "ignition/sensors/RgbdCameraSensor.hh"
 #include "ignition/sensors/RenderingEvents.hh"
 #include "ignition/sensors/SensorFactory.hh"
+#include "ignition/sensors/Tracing.hh"
 
+#include "CpuDepthRenderer.hh"
+#include "MemoryUsage.hh"
 #include "PointCloudUtil.hh"
 
 /// \brief Private data for RgbdCameraSensor
@@ -59,6 +61,11 @@ class ignition::sensors::RgbdCameraSensorPrivate
                     unsigned int _channels,
                     const std::string &_format);
 
+  /// \brief Read the depth clip distances, which override the camera clip
+  /// distances.
+  /// \param[in] _cameraSdf Camera SDF.
+  public: void LoadDepthClip(const sdf::Camera *_cameraSdf);
+
   /// \brief node to create publisher
   public: transport::Node node;
 
@@ -77,6 +84,9 @@ class ignition::sensors::RgbdCameraSensorPrivate
   /// \brief Rendering camera
   public: ignition::rendering::DepthCameraPtr depthCamera;
 
+  /// \brief Renders depth on the CPU when there is no rendering camera.
+  public: CpuDepthRenderer cpuRenderer;
+
   /// \brief Depth data buffer.
   public: float *depthBuffer = nullptr;
 
@@ -123,6 +133,22 @@ class ignition::sensors::RgbdCameraSensorPrivate
   /// \brief Helper class that can fill a msgs::PointCloudPacked
   /// image and depth data.
   public: PointCloudUtil pointsUtil;
+
+  /// \brief Whether the point cloud is compacted into a dense cloud.
+  public: bool densePointCloud = false;
+
+  /// \brief Whether the dense point cloud has row and column fields.
+  public: bool densePointCloudIndex = false;
+
+  /// \brief The dense point cloud message, compacted from pointMsg.
+  public: msgs::PointCloudPacked denseMsg;
+
+  /// \brief Frame the point cloud is published in, empty for the sensor
+  /// frame.
+  public: std::string pointCloudFrame;
+
+  /// \brief Pose of the point cloud frame in the world.
+  public: math::Pose3d pointCloudFramePose;
 };
 
 using namespace ignition;
@@ -259,21 +285,7 @@ bool RgbdCameraSensor::CreateCameras()
   this->dataPtr->depthCamera->SetNearClipPlane(cameraSdf->NearClip());
   this->dataPtr->depthCamera->SetFarClipPlane(cameraSdf->FarClip());
 
-  // Depth camera clip params are new and only override the camera clip
-  // params if specified.
-  if (cameraSdf->HasDepthCamera())
-  {
-    if (cameraSdf->HasDepthFarClip())
-    {
-      this->dataPtr->hasDepthFarClip = true;
-      this->dataPtr->depthFarClip = cameraSdf->DepthFarClip();
-    }
-    if (cameraSdf->HasDepthNearClip())
-    {
-      this->dataPtr->hasDepthNearClip = true;
-      this->dataPtr->depthNearClip = cameraSdf->DepthNearClip();
-    }
-  }
+  this->dataPtr->LoadDepthClip(cameraSdf);
 
   this->dataPtr->depthCamera->SetVisibilityMask(cameraSdf->VisibilityMask());
 
@@ -326,6 +338,59 @@ bool RgbdCameraSensor::CreateCameras()
   return true;
 }
 
+//////////////////////////////////////////////////
+bool RgbdCameraSensor::CreateCpuCameras()
+{
+  const sdf::Camera *cameraSdf = this->dataPtr->sdfSensor.CameraSensor();
+
+  if (!cameraSdf)
+  {
+    ignerr << "Unable to access camera SDF element\n";
+    return false;
+  }
+
+  math::Angle angle = cameraSdf->HorizontalFov();
+  if (angle < 0.01 || angle > IGN_PI * 2)
+  {
+    ignerr << "Invalid horizontal field of view [" << angle << "]\n";
+    return false;
+  }
+
+  this->PopulateInfo(cameraSdf);
+  this->dataPtr->LoadDepthClip(cameraSdf);
+  this->dataPtr->cpuRenderer.SetCamera(cameraSdf->ImageWidth(),
+      cameraSdf->ImageHeight(), angle.Radian(), cameraSdf->NearClip(),
+      cameraSdf->FarClip());
+
+  // Set the values of the point message based on the camera information.
+  this->dataPtr->pointMsg.set_width(this->ImageWidth());
+  this->dataPtr->pointMsg.set_height(this->ImageHeight());
+  this->dataPtr->pointMsg.set_row_step(
+      this->dataPtr->pointMsg.point_step() * this->ImageWidth());
+
+  return true;
+}
+
+//////////////////////////////////////////////////
+void RgbdCameraSensorPrivate::LoadDepthClip(const sdf::Camera *_cameraSdf)
+{
+  // Depth camera clip params are new and only override the camera clip
+  // params if specified.
+  if (_cameraSdf->HasDepthCamera())
+  {
+    if (_cameraSdf->HasDepthFarClip())
+    {
+      this->hasDepthFarClip = true;
+      this->depthFarClip = _cameraSdf->DepthFarClip();
+    }
+    if (_cameraSdf->HasDepthNearClip())
+    {
+      this->hasDepthNearClip = true;
+      this->depthNearClip = _cameraSdf->DepthNearClip();
+    }
+  }
+}
+
 /////////////////////////////////////////////////
 void RgbdCameraSensor::SetScene(ignition::rendering::ScenePtr _scene)
 {
@@ -381,30 +446,56 @@ void RgbdCameraSensorPrivate::OnNewRgbPointCloud(const float *_scan,
 //////////////////////////////////////////////////
 bool RgbdCameraSensor::Update(const ignition::common::Time &_now)
 {
-  IGN_PROFILE("RgbdCameraSensor::Update");
+  IGN_SENSORS_PROFILE_SENSOR("RgbdCameraSensor::Update", this->Id());
   if (!this->dataPtr->initialized)
   {
     ignerr << "Not initialized, update ignored.\n";
     return false;
   }
 
-  if (!this->dataPtr->depthCamera)
+  RayScenePtr cpuScene = this->CpuScene();
+  if (!this->dataPtr->depthCamera && !cpuScene)
   {
     ignerr << "Depth or image cameras don't exist.\n";
     return false;
   }
 
-  unsigned int width = this->dataPtr->depthCamera->ImageWidth();
-  unsigned int height = this->dataPtr->depthCamera->ImageHeight();
+  if (!this->dataPtr->depthCamera && this->dataPtr->cpuRenderer.Width() == 0u &&
+      !this->CreateCpuCameras())
+  {
+    return false;
+  }
+
+  unsigned int width = this->ImageWidth();
+  unsigned int height = this->ImageHeight();
   unsigned int depthSamples = height * width;
 
-  // generate sensor data
-  this->Render();
+  // Reuse the last frame if nothing changed since it was rendered. The
+  // buffers still hold it.
+  if (!this->FrameDirty())
+  {
+    if (this->FrameReuse() == FrameReusePolicy::SKIP)
+      return true;
+  }
+  else if (this->dataPtr->depthCamera)
+  {
+    // generate sensor data
+    this->Render();
+  }
+  else
+  {
+    // Feed the CPU frame through the same callbacks as the rendering camera
+    this->dataPtr->cpuRenderer.Render(*cpuScene, this->Pose());
+    this->dataPtr->OnNewDepthFrame(this->dataPtr->cpuRenderer.Depth(), width,
+        height, 1, "FLOAT32");
+    this->dataPtr->OnNewRgbPointCloud(this->dataPtr->cpuRenderer.PointCloud(),
+        width, height, 4, "PF_FLOAT32_RGBA");
+  }
 
   // create and publish the depthmessage
-  if (this->dataPtr->depthPub.HasConnections())
+  if (this->HasConnections(this->dataPtr->depthPub))
   {
-    ignition::msgs::Image msg;
+    auto &msg = this->FrameMessage<msgs::Image>();
     msg.set_width(width);
     msg.set_height(height);
     msg.set_step(width * rendering::PixelUtil::BytesPerPixel(
@@ -438,15 +529,16 @@ bool RgbdCameraSensor::Update(const ignition::common::Time &_now)
         }
       }
     }
-    msg.set_data(this->dataPtr->depthBuffer,
+    msg.mutable_data()->assign(
+        reinterpret_cast<const char *>(this->dataPtr->depthBuffer),
         rendering::PixelUtil::MemorySize(rendering::PF_FLOAT32_R,
         width, height));
 
     // publish
     {
       this->AddSequence(msg.mutable_header(), "depthImage");
-      IGN_PROFILE("RgbdCameraSensor::Update Publish depth image");
-      this->dataPtr->depthPub.Publish(msg);
+      IGN_SENSORS_PROFILE("RgbdCameraSensor::Update Publish depth image");
+      this->Publish(this->dataPtr->depthPub, msg);
     }
   }
 
@@ -461,14 +553,15 @@ bool RgbdCameraSensor::Update(const ignition::common::Time &_now)
     }
 
     // publish point cloud msg
-    if (this->dataPtr->pointPub.HasConnections())
+    if (this->HasConnections(this->dataPtr->pointPub))
     {
       // Set the time stamp
       this->dataPtr->pointMsg.mutable_header()->mutable_stamp()->set_sec(
           _now.sec);
       this->dataPtr->pointMsg.mutable_header()->mutable_stamp()->set_nsec(
           _now.nsec);
-      this->dataPtr->pointMsg.set_is_dense(true);
+      // Pixels without a depth are kept, so the cloud isn't dense
+      this->dataPtr->pointMsg.set_is_dense(false);
 
       if ((this->dataPtr->hasDepthNearClip || this->dataPtr->hasDepthFarClip)
           && this->dataPtr->depthBuffer)
@@ -488,8 +581,11 @@ bool RgbdCameraSensor::Update(const ignition::common::Time &_now)
       }
 
       {
-        IGN_PROFILE("RgbdCameraSensor::Update Fill Point Cloud");
+        IGN_SENSORS_PROFILE("RgbdCameraSensor::Update Fill Point Cloud");
         // fill point cloud msg and image data
+        this->dataPtr->pointsUtil.SetTargetFrame(this->dataPtr->pointMsg,
+            this->Name(), this->dataPtr->pointCloudFrame, this->Pose(),
+            this->dataPtr->pointCloudFramePose);
         this->dataPtr->pointsUtil.FillMsg(this->dataPtr->pointMsg,
             this->dataPtr->pointCloudBuffer, true,
             this->dataPtr->image.Data<unsigned char>());
@@ -499,17 +595,26 @@ bool RgbdCameraSensor::Update(const ignition::common::Time &_now)
       // publish
       {
         this->AddSequence(this->dataPtr->pointMsg.mutable_header(), "pointMsg");
-        IGN_PROFILE("RgbdCameraSensor::Update Publish point cloud");
-        this->dataPtr->pointPub.Publish(this->dataPtr->pointMsg);
+        IGN_SENSORS_PROFILE("RgbdCameraSensor::Update Publish point cloud");
+        if (this->dataPtr->densePointCloud)
+        {
+          this->dataPtr->pointsUtil.Compact(this->dataPtr->pointMsg,
+              this->dataPtr->densePointCloudIndex, this->dataPtr->denseMsg);
+          this->Publish(this->dataPtr->pointPub, this->dataPtr->denseMsg);
+        }
+        else
+        {
+          this->Publish(this->dataPtr->pointPub, this->dataPtr->pointMsg);
+        }
       }
     }
 
     // publish the 2d image message
-    if (this->dataPtr->imagePub.HasConnections())
+    if (this->HasConnections(this->dataPtr->imagePub))
     {
       if (!filledImgData)
       {
-        IGN_PROFILE("RgbdCameraSensor::Update Fill RGB Image");
+        IGN_SENSORS_PROFILE("RgbdCameraSensor::Update Fill RGB Image");
         // extract image data from point cloud data
         this->dataPtr->pointsUtil.RGBFromPointCloud(
             this->dataPtr->image.Data<unsigned char>(),
@@ -519,7 +624,7 @@ bool RgbdCameraSensor::Update(const ignition::common::Time &_now)
 
       unsigned char *data = this->dataPtr->image.Data<unsigned char>();
 
-      ignition::msgs::Image msg;
+      auto &msg = this->FrameMessage<msgs::Image>();
       msg.set_width(width);
       msg.set_height(height);
       msg.set_step(width * rendering::PixelUtil::BytesPerPixel(
@@ -530,14 +635,15 @@ bool RgbdCameraSensor::Update(const ignition::common::Time &_now)
       auto frame = msg.mutable_header()->add_data();
       frame->set_key("frame_id");
       frame->add_value(this->Name());
-      msg.set_data(data, rendering::PixelUtil::MemorySize(rendering::PF_R8G8B8,
-        width, height));
+      msg.mutable_data()->assign(reinterpret_cast<const char *>(data),
+          rendering::PixelUtil::MemorySize(rendering::PF_R8G8B8,
+          width, height));
 
       // publish the image message
       {
         this->AddSequence(msg.mutable_header(), "rgbdImage");
-        IGN_PROFILE("RgbdCameraSensor::Update Publish RGB image");
-        this->dataPtr->imagePub.Publish(msg);
+        IGN_SENSORS_PROFILE("RgbdCameraSensor::Update Publish RGB image");
+        this->Publish(this->dataPtr->imagePub, msg);
       }
     }
   }
@@ -548,15 +654,84 @@ bool RgbdCameraSensor::Update(const ignition::common::Time &_now)
   return true;
 }
 
+//////////////////////////////////////////////////
+bool RgbdCameraSensor::HasSubscribers() const
+{
+  return this->HasConnections(this->dataPtr->imagePub) ||
+      this->HasConnections(this->dataPtr->depthPub) ||
+      this->HasConnections(this->dataPtr->pointPub) ||
+      this->CameraSensor::HasSubscribers();
+}
+
+//////////////////////////////////////////////////
+SensorMemoryUsage RgbdCameraSensor::MemoryUsage() const
+{
+  SensorMemoryUsage usage = this->CameraSensor::MemoryUsage();
+  const std::size_t samples = this->ImageWidth() * this->ImageHeight();
+
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  if (this->dataPtr->depthBuffer)
+    usage.buffers += samples * sizeof(float);
+  if (this->dataPtr->pointCloudBuffer)
+    usage.buffers += samples * this->dataPtr->channels * sizeof(float);
+  usage.buffers += this->dataPtr->image.MemorySize() +
+      this->dataPtr->cpuRenderer.MemoryUsage();
+  usage.messages += memory::Bytes(this->dataPtr->pointMsg) +
+      memory::Bytes(this->dataPtr->denseMsg);
+  return usage;
+}
+
+//////////////////////////////////////////////////
+void RgbdCameraSensor::SetDensePointCloud(bool _dense)
+{
+  this->dataPtr->densePointCloud = _dense;
+}
+
+//////////////////////////////////////////////////
+bool RgbdCameraSensor::DensePointCloud() const
+{
+  return this->dataPtr->densePointCloud;
+}
+
+//////////////////////////////////////////////////
+void RgbdCameraSensor::SetDensePointCloudIndex(bool _index)
+{
+  this->dataPtr->densePointCloudIndex = _index;
+}
+
+//////////////////////////////////////////////////
+bool RgbdCameraSensor::DensePointCloudIndex() const
+{
+  return this->dataPtr->densePointCloudIndex;
+}
+
+//////////////////////////////////////////////////
+void RgbdCameraSensor::SetPointCloudFrame(const std::string &_frameId,
+    const math::Pose3d &_targetPoseInWorld)
+{
+  this->dataPtr->pointCloudFrame = _frameId;
+  this->dataPtr->pointCloudFramePose = _targetPoseInWorld;
+}
+
+//////////////////////////////////////////////////
+std::string RgbdCameraSensor::PointCloudFrame() const
+{
+  return this->dataPtr->pointCloudFrame;
+}
+
 //////////////////////////////////////////////////
 unsigned int RgbdCameraSensor::ImageWidth() const
 {
+  if (!this->dataPtr->depthCamera)
+    return this->dataPtr->cpuRenderer.Width();
   return this->dataPtr->depthCamera->ImageWidth();
 }
 
 //////////////////////////////////////////////////
 unsigned int RgbdCameraSensor::ImageHeight() const
 {
+  if (!this->dataPtr->depthCamera)
+    return this->dataPtr->cpuRenderer.Height();
   return this->dataPtr->depthCamera->ImageHeight();
 }
 
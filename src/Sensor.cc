@@ -17,10 +17,18 @@
 
 #include "ignition/sensors/Sensor.hh"
 #include <map>
+#include <mutex>
+#include <utility>
 #include <vector>
 #include <ignition/sensors/Manager.hh>
+#include <ignition/sensors/Tracing.hh>
 #include <ignition/common/Console.hh>
-#include <ignition/common/Profiler.hh>
+
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/message.h>
+
+#include "MemoryUsage.hh"
+#include "StateStream.hh"
 
 using namespace ignition::sensors;
 
@@ -64,6 +72,20 @@ class ignition::sensors::SensorPrivate
   /// A map is used so that a single sensor can have multiple sensor
   /// streams each with a sequence counter.
   public: std::map<std::string, uint64_t> sequences;
+
+  /// \brief Protects the sequence counters, which may be updated from a
+  /// rendering sensor's pipeline thread.
+  public: std::mutex sequencesMutex;
+
+  /// \brief Sink receiving the messages instead of the publishers.
+  public: MessageSink *sink = nullptr;
+
+  /// \brief Tap receiving the messages in addition to the publishers.
+  public: MessageSink *tap = nullptr;
+
+  /// \brief Protects the sink and the tap, which may be used from a
+  /// rendering sensor's pipeline thread.
+  public: mutable std::mutex sinkMutex;
 };
 
 SensorId SensorPrivate::idCounter = 0;
@@ -89,6 +111,7 @@ bool SensorPrivate::PopulateFromSDF(const sdf::Sensor &_sdf)
   // \todo(nkoenig) how to use frame?
   this->name = _sdf.Name();
   this->topic = _sdf.Topic();
+  Tracing::SetSensorName(this->id, this->name);
 
   // Try resolving the pose first, and only use the raw pose if that fails
   auto semPose = _sdf.SemanticPose();
@@ -147,6 +170,12 @@ sdf::ElementPtr Sensor::SDF() const
   return this->dataPtr->sdf;
 }
 
+//////////////////////////////////////////////////
+const sdf::Sensor &Sensor::SDFSensor() const
+{
+  return this->dataPtr->sdfSensor;
+}
+
 //////////////////////////////////////////////////
 SensorId Sensor::Id() const
 {
@@ -212,7 +241,7 @@ void Sensor::SetUpdateRate(const double _hz)
 bool Sensor::Update(const ignition::common::Time &_now,
                   const bool _force)
 {
-  IGN_PROFILE("Sensor::Update");
+  IGN_SENSORS_PROFILE_SENSOR("Sensor::Update", this->Id());
   bool result = false;
 
   // Check if it's time to update
@@ -241,16 +270,32 @@ ignition::common::Time Sensor::NextUpdateTime() const
   return this->dataPtr->nextUpdateTime;
 }
 
+//////////////////////////////////////////////////
+void Sensor::SetNextUpdateTime(const ignition::common::Time &_time)
+{
+  this->dataPtr->nextUpdateTime = _time;
+}
+
+//////////////////////////////////////////////////
+bool Sensor::HasSubscribers() const
+{
+  return true;
+}
+
 /////////////////////////////////////////////////
 void Sensor::AddSequence(ignition::msgs::Header *_msg,
                          const std::string &_seqKey)
 {
   std::string value = "0";
 
-  if (this->dataPtr->sequences.find(_seqKey) == this->dataPtr->sequences.end())
-    this->dataPtr->sequences[_seqKey] = 0;
-  else
-    value = std::to_string(++this->dataPtr->sequences[_seqKey]);
+  {
+    std::lock_guard<std::mutex> lock(this->dataPtr->sequencesMutex);
+    auto it = this->dataPtr->sequences.find(_seqKey);
+    if (it == this->dataPtr->sequences.end())
+      this->dataPtr->sequences[_seqKey] = 0;
+    else
+      value = std::to_string(++it->second);
+  }
 
   // Set the value if a `sequence` key already exists.
   for (int index = 0; index < _msg->data_size(); ++index)
@@ -270,3 +315,189 @@ void Sensor::AddSequence(ignition::msgs::Header *_msg,
   map->set_key("seq");
   map->add_value(value);
 }
+
+//////////////////////////////////////////////////
+SensorMemoryUsage Sensor::MemoryUsage() const
+{
+  SensorMemoryUsage usage;
+  usage.config = sizeof(SensorPrivate) +
+      memory::Bytes(this->dataPtr->name) +
+      memory::Bytes(this->dataPtr->parent) +
+      memory::Bytes(this->dataPtr->topic) +
+      memory::Bytes(this->dataPtr->sdf);
+
+  std::lock_guard<std::mutex> lock(this->dataPtr->sequencesMutex);
+  usage.config += memory::Bytes(this->dataPtr->sequences);
+  return usage;
+}
+
+//////////////////////////////////////////////////
+std::size_t SensorMemoryUsage::Total() const
+{
+  return this->buffers + this->messages + this->config;
+}
+
+//////////////////////////////////////////////////
+SensorMemoryUsage &SensorMemoryUsage::operator+=(
+    const SensorMemoryUsage &_usage)
+{
+  this->buffers += _usage.buffers;
+  this->messages += _usage.messages;
+  this->config += _usage.config;
+  return *this;
+}
+
+//////////////////////////////////////////////////
+bool Sensor::SaveState(std::ostream &_out) const
+{
+  state::WriteTime(_out, this->dataPtr->nextUpdateTime);
+
+  std::lock_guard<std::mutex> lock(this->dataPtr->sequencesMutex);
+  state::Write(_out, static_cast<uint32_t>(this->dataPtr->sequences.size()));
+  for (const auto &sequence : this->dataPtr->sequences)
+  {
+    state::WriteString(_out, sequence.first);
+    state::Write(_out, sequence.second);
+  }
+  return static_cast<bool>(_out);
+}
+
+//////////////////////////////////////////////////
+bool Sensor::LoadState(std::istream &_in)
+{
+  common::Time nextUpdateTime;
+  uint32_t count = 0u;
+  if (!state::ReadTime(_in, nextUpdateTime) || !state::Read(_in, count))
+    return false;
+
+  std::map<std::string, uint64_t> sequences;
+  for (uint32_t i = 0u; i < count; ++i)
+  {
+    std::string key;
+    uint64_t value = 0u;
+    if (!state::ReadString(_in, key) || !state::Read(_in, value))
+      return false;
+    sequences[key] = value;
+  }
+
+  this->dataPtr->nextUpdateTime = nextUpdateTime;
+  std::lock_guard<std::mutex> lock(this->dataPtr->sequencesMutex);
+  this->dataPtr->sequences = std::move(sequences);
+  return true;
+}
+
+//////////////////////////////////////////////////
+void Sensor::SetMessageSink(MessageSink *_sink)
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->sinkMutex);
+  this->dataPtr->sink = _sink;
+}
+
+//////////////////////////////////////////////////
+MessageSink *Sensor::Sink() const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->sinkMutex);
+  return this->dataPtr->sink;
+}
+
+//////////////////////////////////////////////////
+void Sensor::SetMessageTap(MessageSink *_tap)
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->sinkMutex);
+  this->dataPtr->tap = _tap;
+}
+
+//////////////////////////////////////////////////
+MessageSink *Sensor::Tap() const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->sinkMutex);
+  return this->dataPtr->tap;
+}
+
+//////////////////////////////////////////////////
+bool Sensor::Publish(ignition::transport::Node::Publisher &_pub,
+    const google::protobuf::Message &_msg)
+{
+  {
+    // Hold the lock while adding, so the sink can't be destroyed meanwhile
+    std::lock_guard<std::mutex> lock(this->dataPtr->sinkMutex);
+    if (this->dataPtr->tap)
+      this->dataPtr->tap->Add(*this, _msg);
+
+    if (this->dataPtr->sink)
+    {
+      this->dataPtr->sink->Add(*this, _msg);
+      return true;
+    }
+  }
+
+  return _pub.Publish(_msg);
+}
+
+//////////////////////////////////////////////////
+bool Sensor::HasConnections(
+    const ignition::transport::Node::Publisher &_pub) const
+{
+  {
+    std::lock_guard<std::mutex> lock(this->dataPtr->sinkMutex);
+    if (this->dataPtr->tap && this->dataPtr->tap->HasConnections())
+      return true;
+    if (this->dataPtr->sink)
+      return this->dataPtr->sink->HasConnections();
+  }
+
+  return _pub.HasConnections();
+}
+
+//////////////////////////////////////////////////
+void Sensor::ResetFrameMessage(google::protobuf::Message &_msg)
+{
+  const google::protobuf::Descriptor *descriptor = _msg.GetDescriptor();
+  const google::protobuf::Reflection *reflection = _msg.GetReflection();
+
+  // Iterate over the descriptor rather than ListFields, which fills a vector
+  for (int i = 0; i < descriptor->field_count(); ++i)
+  {
+    const google::protobuf::FieldDescriptor *field = descriptor->field(i);
+    if (field->is_repeated())
+    {
+      // Repeated fields keep their cleared elements for reuse
+      if (reflection->FieldSize(_msg, field) > 0)
+        reflection->ClearField(&_msg, field);
+      continue;
+    }
+
+    if (!reflection->HasField(_msg, field))
+      continue;
+
+    if (field->containing_oneof())
+    {
+      reflection->ClearField(&_msg, field);
+    }
+    else if (field->cpp_type() ==
+        google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
+    {
+      // Clear() would delete the sub-message
+      ResetFrameMessage(*reflection->MutableMessage(&_msg, field));
+    }
+    else if (field->cpp_type() ==
+        google::protobuf::FieldDescriptor::CPPTYPE_STRING)
+    {
+      // ClearField releases the string buffer. In proto3 an empty string
+      // is the same as an unset one, and assigning it keeps the buffer.
+      if (field->file()->syntax() ==
+          google::protobuf::FileDescriptor::SYNTAX_PROTO3)
+      {
+        reflection->SetString(&_msg, field, std::string());
+      }
+      else
+      {
+        reflection->ClearField(&_msg, field);
+      }
+    }
+    else
+    {
+      reflection->ClearField(&_msg, field);
+    }
+  }
+}
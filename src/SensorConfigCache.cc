@@ -0,0 +1,816 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef _WIN32
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include <ignition/common/Console.hh>
+
+#include "ignition/sensors/SensorConfigCache.hh"
+#include "ignition/sensors/Tracing.hh"
+
+#include "StateStream.hh"
+
+using namespace ignition;
+using namespace sensors;
+
+namespace
+{
+  /// \brief First bytes of a cache file.
+  const char kCacheMagic[8] = {'I', 'G', 'N', 'S', 'C', 'F', 'G', '\0'};
+
+  /// \brief Version of the cache format. Bump it whenever the encoding of
+  /// the entries changes.
+  const uint32_t kCacheVersion = 1u;
+
+  /// \brief Header of a cache file.
+  struct CacheHeader
+  {
+    /// \brief kCacheMagic.
+    char magic[8];
+
+    /// \brief Format version.
+    uint32_t version;
+
+    /// \brief Number of entries.
+    uint32_t count;
+
+    /// \brief Size of the entries, in bytes.
+    uint64_t size;
+
+    /// \brief FNV-1a hash of the entries.
+    uint64_t checksum;
+  };
+
+  /// \brief Compute the 64-bit FNV-1a hash of some bytes.
+  /// \param[in] _data Bytes.
+  /// \param[in] _size Number of bytes.
+  /// \return Hash.
+  uint64_t Checksum(const char *_data, std::size_t _size)
+  {
+    uint64_t hash = 14695981039346656037ull;
+    for (std::size_t i = 0; i < _size; ++i)
+    {
+      hash ^= static_cast<unsigned char>(_data[i]);
+      hash *= 1099511628211ull;
+    }
+    return hash;
+  }
+
+  /// \brief Reads the values of an entry from memory.
+  class EntryReader
+  {
+    /// \brief Constructor
+    /// \param[in] _data Start of the entry.
+    /// \param[in] _size Size of the entry.
+    public: EntryReader(const char *_data, std::size_t _size)
+      : pos(_data), end(_data + _size)
+    {
+    }
+
+    /// \brief Read a value.
+    /// \param[out] _value Value, trivially copyable.
+    /// \return False if the entry ended.
+    public: template<typename T>
+    bool Read(T &_value)
+    {
+      if (static_cast<std::size_t>(this->end - this->pos) < sizeof(T))
+        return false;
+      std::memcpy(&_value, this->pos, sizeof(T));
+      this->pos += sizeof(T);
+      return true;
+    }
+
+    /// \brief Read a string written by state::WriteString().
+    /// \param[out] _value String.
+    /// \return False if the entry ended.
+    public: bool ReadString(std::string &_value)
+    {
+      uint32_t size = 0u;
+      if (!this->Read(size) ||
+          static_cast<std::size_t>(this->end - this->pos) < size)
+      {
+        return false;
+      }
+      _value.assign(this->pos, size);
+      this->pos += size;
+      return true;
+    }
+
+    /// \brief Get whether the whole entry was read.
+    /// \return True at the end of the entry.
+    public: bool Done() const
+    {
+      return this->pos == this->end;
+    }
+
+    /// \brief Next byte to read.
+    private: const char *pos;
+
+    /// \brief End of the entry.
+    private: const char *end;
+  };
+
+  /// \brief Write a pose.
+  /// \param[in] _out Stream to write to.
+  /// \param[in] _pose Pose.
+  void WritePose(std::ostream &_out, const math::Pose3d &_pose)
+  {
+    state::Write(_out, _pose.Pos().X());
+    state::Write(_out, _pose.Pos().Y());
+    state::Write(_out, _pose.Pos().Z());
+    state::Write(_out, _pose.Rot().W());
+    state::Write(_out, _pose.Rot().X());
+    state::Write(_out, _pose.Rot().Y());
+    state::Write(_out, _pose.Rot().Z());
+  }
+
+  /// \brief Read a pose written by WritePose().
+  /// \param[in] _in Entry to read from.
+  /// \param[out] _pose Pose.
+  /// \return False if the entry ended.
+  bool ReadPose(EntryReader &_in, math::Pose3d &_pose)
+  {
+    double v[7];
+    for (double &value : v)
+    {
+      if (!_in.Read(value))
+        return false;
+    }
+    _pose.Set(math::Vector3d(v[0], v[1], v[2]),
+        math::Quaterniond(v[3], v[4], v[5], v[6]));
+    return true;
+  }
+
+  /// \brief Write a noise.
+  /// \param[in] _out Stream to write to.
+  /// \param[in] _noise Noise.
+  void WriteNoise(std::ostream &_out, const sdf::Noise &_noise)
+  {
+    state::Write(_out, static_cast<int32_t>(_noise.Type()));
+    state::Write(_out, _noise.Mean());
+    state::Write(_out, _noise.StdDev());
+    state::Write(_out, _noise.BiasMean());
+    state::Write(_out, _noise.BiasStdDev());
+    state::Write(_out, _noise.DynamicBiasStdDev());
+    state::Write(_out, _noise.DynamicBiasCorrelationTime());
+    state::Write(_out, _noise.Precision());
+  }
+
+  /// \brief Read a noise written by WriteNoise().
+  /// \param[in] _in Entry to read from.
+  /// \param[out] _noise Noise.
+  /// \return False if the entry ended.
+  bool ReadNoise(EntryReader &_in, sdf::Noise &_noise)
+  {
+    int32_t type = 0;
+    double v[7];
+    if (!_in.Read(type))
+      return false;
+    for (double &value : v)
+    {
+      if (!_in.Read(value))
+        return false;
+    }
+    _noise.SetType(static_cast<sdf::NoiseType>(type));
+    _noise.SetMean(v[0]);
+    _noise.SetStdDev(v[1]);
+    _noise.SetBiasMean(v[2]);
+    _noise.SetBiasStdDev(v[3]);
+    _noise.SetDynamicBiasStdDev(v[4]);
+    _noise.SetDynamicBiasCorrelationTime(v[5]);
+    _noise.SetPrecision(v[6]);
+    return true;
+  }
+
+  /// \brief Write a camera.
+  /// \param[in] _out Stream to write to.
+  /// \param[in] _camera Camera.
+  void WriteCamera(std::ostream &_out, const sdf::Camera &_camera)
+  {
+    state::Write(_out, _camera.HorizontalFov().Radian());
+    state::Write(_out, static_cast<uint32_t>(_camera.ImageWidth()));
+    state::Write(_out, static_cast<uint32_t>(_camera.ImageHeight()));
+    state::Write(_out, static_cast<int32_t>(_camera.PixelFormat()));
+    state::Write(_out, _camera.NearClip());
+    state::Write(_out, _camera.FarClip());
+    state::Write(_out, static_cast<uint8_t>(_camera.HasDepthCamera()));
+    state::Write(_out, static_cast<uint8_t>(_camera.HasDepthNearClip()));
+    state::Write(_out, _camera.DepthNearClip());
+    state::Write(_out, static_cast<uint8_t>(_camera.HasDepthFarClip()));
+    state::Write(_out, _camera.DepthFarClip());
+    state::Write(_out, static_cast<uint8_t>(_camera.SaveFrames()));
+    state::WriteString(_out, _camera.SaveFramesPath());
+    WriteNoise(_out, _camera.ImageNoise());
+    state::Write(_out, static_cast<uint32_t>(_camera.VisibilityMask()));
+    state::Write(_out, _camera.LensIntrinsicsFx());
+    state::Write(_out, _camera.LensIntrinsicsFy());
+    state::Write(_out, _camera.LensIntrinsicsCx());
+    state::Write(_out, _camera.LensIntrinsicsCy());
+    state::Write(_out, _camera.DistortionK1());
+    state::Write(_out, _camera.DistortionK2());
+    state::Write(_out, _camera.DistortionK3());
+    state::Write(_out, _camera.DistortionP1());
+    state::Write(_out, _camera.DistortionP2());
+  }
+
+  /// \brief Read a camera written by WriteCamera().
+  /// \param[in] _in Entry to read from.
+  /// \param[out] _camera Camera.
+  /// \return False if the entry ended.
+  bool ReadCamera(EntryReader &_in, sdf::Camera &_camera)
+  {
+    double hfov = 0.0;
+    uint32_t width = 0u;
+    uint32_t height = 0u;
+    int32_t format = 0;
+    double nearClip = 0.0;
+    double farClip = 0.0;
+    uint8_t hasDepthCamera = 0u;
+    uint8_t hasDepthNear = 0u;
+    double depthNear = 0.0;
+    uint8_t hasDepthFar = 0u;
+    double depthFar = 0.0;
+    uint8_t saveFrames = 0u;
+    std::string saveFramesPath;
+    sdf::Noise noise;
+    uint32_t visibilityMask = 0u;
+    double fx = 0.0;
+    double fy = 0.0;
+    double cx = 0.0;
+    double cy = 0.0;
+    double distortion[5];
+    if (!_in.Read(hfov) || !_in.Read(width) || !_in.Read(height) ||
+        !_in.Read(format) || !_in.Read(nearClip) || !_in.Read(farClip) ||
+        !_in.Read(hasDepthCamera) || !_in.Read(hasDepthNear) ||
+        !_in.Read(depthNear) || !_in.Read(hasDepthFar) ||
+        !_in.Read(depthFar) || !_in.Read(saveFrames) ||
+        !_in.ReadString(saveFramesPath) || !ReadNoise(_in, noise) ||
+        !_in.Read(visibilityMask) || !_in.Read(fx) || !_in.Read(fy) ||
+        !_in.Read(cx) || !_in.Read(cy) || !_in.Read(distortion))
+    {
+      return false;
+    }
+
+    _camera.SetHorizontalFov(hfov);
+    _camera.SetImageWidth(width);
+    _camera.SetImageHeight(height);
+    _camera.SetPixelFormat(static_cast<sdf::PixelFormatType>(format));
+    _camera.SetNearClip(nearClip);
+    _camera.SetFarClip(farClip);
+    _camera.SetHasDepthCamera(hasDepthCamera != 0u);
+    if (hasDepthNear)
+      _camera.SetDepthNearClip(depthNear);
+    if (hasDepthFar)
+      _camera.SetDepthFarClip(depthFar);
+    _camera.SetSaveFrames(saveFrames != 0u);
+    _camera.SetSaveFramesPath(saveFramesPath);
+    _camera.SetImageNoise(noise);
+    _camera.SetVisibilityMask(visibilityMask);
+    _camera.SetLensIntrinsicsFx(fx);
+    _camera.SetLensIntrinsicsFy(fy);
+    _camera.SetLensIntrinsicsCx(cx);
+    _camera.SetLensIntrinsicsCy(cy);
+    _camera.SetDistortionK1(distortion[0]);
+    _camera.SetDistortionK2(distortion[1]);
+    _camera.SetDistortionK3(distortion[2]);
+    _camera.SetDistortionP1(distortion[3]);
+    _camera.SetDistortionP2(distortion[4]);
+    return true;
+  }
+
+  /// \brief Write a lidar.
+  /// \param[in] _out Stream to write to.
+  /// \param[in] _lidar Lidar.
+  void WriteLidar(std::ostream &_out, const sdf::Lidar &_lidar)
+  {
+    state::Write(_out, static_cast<uint32_t>(_lidar.HorizontalScanSamples()));
+    state::Write(_out, _lidar.HorizontalScanResolution());
+    state::Write(_out, _lidar.HorizontalScanMinAngle().Radian());
+    state::Write(_out, _lidar.HorizontalScanMaxAngle().Radian());
+    state::Write(_out, static_cast<uint32_t>(_lidar.VerticalScanSamples()));
+    state::Write(_out, _lidar.VerticalScanResolution());
+    state::Write(_out, _lidar.VerticalScanMinAngle().Radian());
+    state::Write(_out, _lidar.VerticalScanMaxAngle().Radian());
+    state::Write(_out, _lidar.RangeMin());
+    state::Write(_out, _lidar.RangeMax());
+    state::Write(_out, _lidar.RangeResolution());
+    WriteNoise(_out, _lidar.LidarNoise());
+  }
+
+  /// \brief Read a lidar written by WriteLidar().
+  /// \param[in] _in Entry to read from.
+  /// \param[out] _lidar Lidar.
+  /// \return False if the entry ended.
+  bool ReadLidar(EntryReader &_in, sdf::Lidar &_lidar)
+  {
+    uint32_t hSamples = 0u;
+    uint32_t vSamples = 0u;
+    double h[3];
+    double v[3];
+    double range[3];
+    sdf::Noise noise;
+    if (!_in.Read(hSamples) || !_in.Read(h[0]) || !_in.Read(h[1]) ||
+        !_in.Read(h[2]) || !_in.Read(vSamples) || !_in.Read(v[0]) ||
+        !_in.Read(v[1]) || !_in.Read(v[2]) || !_in.Read(range[0]) ||
+        !_in.Read(range[1]) || !_in.Read(range[2]) || !ReadNoise(_in, noise))
+    {
+      return false;
+    }
+
+    _lidar.SetHorizontalScanSamples(hSamples);
+    _lidar.SetHorizontalScanResolution(h[0]);
+    _lidar.SetHorizontalScanMinAngle(h[1]);
+    _lidar.SetHorizontalScanMaxAngle(h[2]);
+    _lidar.SetVerticalScanSamples(vSamples);
+    _lidar.SetVerticalScanResolution(v[0]);
+    _lidar.SetVerticalScanMinAngle(v[1]);
+    _lidar.SetVerticalScanMaxAngle(v[2]);
+    _lidar.SetRangeMin(range[0]);
+    _lidar.SetRangeMax(range[1]);
+    _lidar.SetRangeResolution(range[2]);
+    _lidar.SetLidarNoise(noise);
+    return true;
+  }
+
+  /// \brief Encode a sensor.
+  /// \param[in] _out Stream to write to.
+  /// \param[in] _sdf Sensor, supported by the cache.
+  /// \param[in] _parent Parent of the sensor.
+  void WriteSensor(std::ostream &_out, const sdf::Sensor &_sdf,
+      const std::string &_parent)
+  {
+    state::Write(_out, static_cast<int32_t>(_sdf.Type()));
+    state::WriteString(_out, _sdf.Name());
+    state::WriteString(_out, _parent);
+    state::WriteString(_out, _sdf.Topic());
+    state::Write(_out, _sdf.UpdateRate());
+
+    // Store the pose the sensor would resolve, since the pose graph isn't
+    // available when loading the cache
+    math::Pose3d pose;
+    if (!_sdf.SemanticPose().Resolve(pose).empty())
+      pose = _sdf.RawPose();
+    WritePose(_out, pose);
+
+    switch (_sdf.Type())
+    {
+      case sdf::SensorType::AIR_PRESSURE:
+        state::Write(_out, _sdf.AirPressureSensor()->ReferenceAltitude());
+        WriteNoise(_out, _sdf.AirPressureSensor()->PressureNoise());
+        break;
+      case sdf::SensorType::ALTIMETER:
+        WriteNoise(_out, _sdf.AltimeterSensor()->VerticalPositionNoise());
+        WriteNoise(_out, _sdf.AltimeterSensor()->VerticalVelocityNoise());
+        break;
+      case sdf::SensorType::CAMERA:
+      case sdf::SensorType::DEPTH_CAMERA:
+      case sdf::SensorType::RGBD_CAMERA:
+      case sdf::SensorType::THERMAL_CAMERA:
+        WriteCamera(_out, *_sdf.CameraSensor());
+        break;
+      case sdf::SensorType::GPU_LIDAR:
+      case sdf::SensorType::LIDAR:
+        WriteLidar(_out, *_sdf.LidarSensor());
+        break;
+      case sdf::SensorType::IMU:
+      {
+        const sdf::Imu *imu = _sdf.ImuSensor();
+        WriteNoise(_out, imu->LinearAccelerationXNoise());
+        WriteNoise(_out, imu->LinearAccelerationYNoise());
+        WriteNoise(_out, imu->LinearAccelerationZNoise());
+        WriteNoise(_out, imu->AngularVelocityXNoise());
+        WriteNoise(_out, imu->AngularVelocityYNoise());
+        WriteNoise(_out, imu->AngularVelocityZNoise());
+        break;
+      }
+      case sdf::SensorType::MAGNETOMETER:
+        WriteNoise(_out, _sdf.MagnetometerSensor()->XNoise());
+        WriteNoise(_out, _sdf.MagnetometerSensor()->YNoise());
+        WriteNoise(_out, _sdf.MagnetometerSensor()->ZNoise());
+        break;
+      default:
+        break;
+    }
+  }
+
+  /// \brief Decode a sensor written by WriteSensor().
+  /// \param[in] _in Entry to read from.
+  /// \param[out] _sdf Sensor.
+  /// \param[out] _parent Parent of the sensor.
+  /// \return False if the entry is invalid.
+  bool ReadSensor(EntryReader &_in, sdf::Sensor &_sdf, std::string &_parent)
+  {
+    int32_t type = 0;
+    std::string name;
+    std::string topic;
+    double updateRate = 0.0;
+    math::Pose3d pose;
+    if (!_in.Read(type) || !_in.ReadString(name) ||
+        !_in.ReadString(_parent) || !_in.ReadString(topic) ||
+        !_in.Read(updateRate) || !ReadPose(_in, pose))
+    {
+      return false;
+    }
+
+    _sdf = sdf::Sensor();
+    _sdf.SetType(static_cast<sdf::SensorType>(type));
+    _sdf.SetName(name);
+    _sdf.SetTopic(topic);
+    _sdf.SetUpdateRate(updateRate);
+    _sdf.SetRawPose(pose);
+
+    switch (_sdf.Type())
+    {
+      case sdf::SensorType::AIR_PRESSURE:
+      {
+        sdf::AirPressure airPressure;
+        double reference = 0.0;
+        sdf::Noise noise;
+        if (!_in.Read(reference) || !ReadNoise(_in, noise))
+          return false;
+        airPressure.SetReferenceAltitude(reference);
+        airPressure.SetPressureNoise(noise);
+        _sdf.SetAirPressureSensor(airPressure);
+        break;
+      }
+      case sdf::SensorType::ALTIMETER:
+      {
+        sdf::Altimeter altimeter;
+        sdf::Noise position;
+        sdf::Noise velocity;
+        if (!ReadNoise(_in, position) || !ReadNoise(_in, velocity))
+          return false;
+        altimeter.SetVerticalPositionNoise(position);
+        altimeter.SetVerticalVelocityNoise(velocity);
+        _sdf.SetAltimeterSensor(altimeter);
+        break;
+      }
+      case sdf::SensorType::CAMERA:
+      case sdf::SensorType::DEPTH_CAMERA:
+      case sdf::SensorType::RGBD_CAMERA:
+      case sdf::SensorType::THERMAL_CAMERA:
+      {
+        sdf::Camera camera;
+        if (!ReadCamera(_in, camera))
+          return false;
+        _sdf.SetCameraSensor(camera);
+        break;
+      }
+      case sdf::SensorType::GPU_LIDAR:
+      case sdf::SensorType::LIDAR:
+      {
+        sdf::Lidar lidar;
+        if (!ReadLidar(_in, lidar))
+          return false;
+        _sdf.SetLidarSensor(lidar);
+        break;
+      }
+      case sdf::SensorType::IMU:
+      {
+        sdf::Noise noises[6];
+        for (sdf::Noise &noise : noises)
+        {
+          if (!ReadNoise(_in, noise))
+            return false;
+        }
+        sdf::Imu imu;
+        imu.SetLinearAccelerationXNoise(noises[0]);
+        imu.SetLinearAccelerationYNoise(noises[1]);
+        imu.SetLinearAccelerationZNoise(noises[2]);
+        imu.SetAngularVelocityXNoise(noises[3]);
+        imu.SetAngularVelocityYNoise(noises[4]);
+        imu.SetAngularVelocityZNoise(noises[5]);
+        _sdf.SetImuSensor(imu);
+        break;
+      }
+      case sdf::SensorType::MAGNETOMETER:
+      {
+        sdf::Noise noises[3];
+        for (sdf::Noise &noise : noises)
+        {
+          if (!ReadNoise(_in, noise))
+            return false;
+        }
+        sdf::Magnetometer magnetometer;
+        magnetometer.SetXNoise(noises[0]);
+        magnetometer.SetYNoise(noises[1]);
+        magnetometer.SetZNoise(noises[2]);
+        _sdf.SetMagnetometerSensor(magnetometer);
+        break;
+      }
+      default:
+        return false;
+    }
+    return _in.Done();
+  }
+}
+
+/// \brief Private data for SensorConfigCache
+class ignition::sensors::SensorConfigCachePrivate
+{
+  /// \brief Get the encoded entries.
+  /// \return Start of the entries.
+  public: const char *Data() const
+  {
+    return this->mapped ? this->mapped + sizeof(CacheHeader) :
+        this->buffer.data();
+  }
+
+  /// \brief Unmap the opened file, if any.
+  public: void Unmap()
+  {
+#ifndef _WIN32
+    if (this->mapped)
+      munmap(const_cast<char *>(this->mapped), this->mappedSize);
+#endif
+    this->mapped = nullptr;
+    this->mappedSize = 0u;
+  }
+
+  /// \brief Index the entries of the mapped file or of the buffer.
+  /// \param[in] _data Start of the entries.
+  /// \param[in] _size Size of the entries.
+  /// \param[in] _count Expected number of entries.
+  /// \return False if the entries don't match their sizes and count.
+  public: bool Index(const char *_data, std::size_t _size, uint32_t _count)
+  {
+    this->entries.clear();
+    this->entries.reserve(_count);
+    std::size_t offset = 0u;
+    while (offset < _size)
+    {
+      uint32_t entrySize = 0u;
+      if (_size - offset < sizeof(entrySize))
+        return false;
+      std::memcpy(&entrySize, _data + offset, sizeof(entrySize));
+      offset += sizeof(entrySize);
+      if (_size - offset < entrySize)
+        return false;
+      this->entries.emplace_back(offset, entrySize);
+      offset += entrySize;
+    }
+    return this->entries.size() == _count;
+  }
+
+  /// \brief Entries added with Add(), or read from the file on platforms
+  /// without memory mapping. Each entry is prefixed with its size.
+  public: std::string buffer;
+
+  /// \brief Opened file, mapped in memory.
+  public: const char *mapped = nullptr;
+
+  /// \brief Size of the mapped file.
+  public: std::size_t mappedSize = 0u;
+
+  /// \brief Offset and size of each entry, after its size prefix.
+  public: std::vector<std::pair<std::size_t, std::size_t>> entries;
+};
+
+//////////////////////////////////////////////////
+SensorConfigCache::SensorConfigCache()
+  : dataPtr(new SensorConfigCachePrivate)
+{
+}
+
+//////////////////////////////////////////////////
+SensorConfigCache::~SensorConfigCache()
+{
+  this->dataPtr->Unmap();
+}
+
+//////////////////////////////////////////////////
+uint32_t SensorConfigCache::FormatVersion()
+{
+  return kCacheVersion;
+}
+
+//////////////////////////////////////////////////
+bool SensorConfigCache::Supported(const sdf::Sensor &_sdf)
+{
+  switch (_sdf.Type())
+  {
+    case sdf::SensorType::AIR_PRESSURE:
+      return _sdf.AirPressureSensor() != nullptr;
+    case sdf::SensorType::ALTIMETER:
+      return _sdf.AltimeterSensor() != nullptr;
+    case sdf::SensorType::CAMERA:
+    case sdf::SensorType::DEPTH_CAMERA:
+    case sdf::SensorType::RGBD_CAMERA:
+    case sdf::SensorType::THERMAL_CAMERA:
+      return _sdf.CameraSensor() != nullptr;
+    case sdf::SensorType::GPU_LIDAR:
+    case sdf::SensorType::LIDAR:
+      return _sdf.LidarSensor() != nullptr;
+    case sdf::SensorType::IMU:
+      return _sdf.ImuSensor() != nullptr;
+    case sdf::SensorType::MAGNETOMETER:
+      return _sdf.MagnetometerSensor() != nullptr;
+    default:
+      return false;
+  }
+}
+
+//////////////////////////////////////////////////
+bool SensorConfigCache::Add(const sdf::Sensor &_sdf,
+    const std::string &_parent)
+{
+  if (!Supported(_sdf))
+  {
+    ignerr << "Sensor [" << _sdf.Name() << "] of type [" << _sdf.TypeStr()
+           << "] can't be stored in a config cache.\n";
+    return false;
+  }
+
+  // Entries of an opened file are copied before adding to them
+  if (this->dataPtr->mapped)
+  {
+    const char *data = this->dataPtr->Data();
+    this->dataPtr->buffer.assign(data,
+        this->dataPtr->mappedSize - sizeof(CacheHeader));
+    this->dataPtr->Unmap();
+  }
+
+  std::ostringstream entry;
+  WriteSensor(entry, _sdf, _parent);
+  const std::string data = entry.str();
+
+  std::ostringstream prefix;
+  state::Write(prefix, static_cast<uint32_t>(data.size()));
+  this->dataPtr->buffer += prefix.str();
+  this->dataPtr->entries.emplace_back(this->dataPtr->buffer.size(),
+      data.size());
+  this->dataPtr->buffer += data;
+  return true;
+}
+
+//////////////////////////////////////////////////
+std::size_t SensorConfigCache::Count() const
+{
+  return this->dataPtr->entries.size();
+}
+
+//////////////////////////////////////////////////
+bool SensorConfigCache::Entry(std::size_t _index, sdf::Sensor &_sdf,
+    std::string &_parent) const
+{
+  if (_index >= this->dataPtr->entries.size())
+    return false;
+
+  const auto &entry = this->dataPtr->entries[_index];
+  EntryReader reader(this->dataPtr->Data() + entry.first, entry.second);
+  return ReadSensor(reader, _sdf, _parent);
+}
+
+//////////////////////////////////////////////////
+bool SensorConfigCache::Save(const std::string &_path) const
+{
+  IGN_SENSORS_PROFILE("SensorConfigCache::Save");
+  const char *data = this->dataPtr->Data();
+  const std::size_t size = this->dataPtr->mapped ?
+      this->dataPtr->mappedSize - sizeof(CacheHeader) :
+      this->dataPtr->buffer.size();
+
+  CacheHeader header;
+  std::memcpy(header.magic, kCacheMagic, sizeof(header.magic));
+  header.version = kCacheVersion;
+  header.count = static_cast<uint32_t>(this->dataPtr->entries.size());
+  header.size = size;
+  header.checksum = Checksum(data, size);
+
+  std::ofstream file(_path, std::ios::binary | std::ios::trunc);
+  if (!file)
+  {
+    ignerr << "Unable to write sensor config cache [" << _path << "].\n";
+    return false;
+  }
+  state::Write(file, header);
+  file.write(data, size);
+  if (!file)
+  {
+    ignerr << "Unable to write sensor config cache [" << _path << "].\n";
+    return false;
+  }
+  return true;
+}
+
+//////////////////////////////////////////////////
+bool SensorConfigCache::Open(const std::string &_path)
+{
+  IGN_SENSORS_PROFILE("SensorConfigCache::Open");
+  this->Clear();
+
+  const char *file = nullptr;
+  std::size_t fileSize = 0u;
+#ifndef _WIN32
+  int fd = open(_path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    ignerr << "Unable to open sensor config cache [" << _path << "].\n";
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) == 0 &&
+      static_cast<std::size_t>(info.st_size) >= sizeof(CacheHeader))
+  {
+    fileSize = static_cast<std::size_t>(info.st_size);
+    void *map = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED)
+    {
+      this->dataPtr->mapped = static_cast<const char *>(map);
+      this->dataPtr->mappedSize = fileSize;
+      file = this->dataPtr->mapped;
+    }
+  }
+  close(fd);
+#else
+  std::ifstream stream(_path, std::ios::binary);
+  if (!stream)
+  {
+    ignerr << "Unable to open sensor config cache [" << _path << "].\n";
+    return false;
+  }
+  std::ostringstream contents;
+  contents << stream.rdbuf();
+  this->dataPtr->buffer = contents.str();
+  if (this->dataPtr->buffer.size() >= sizeof(CacheHeader))
+  {
+    file = this->dataPtr->buffer.data();
+    fileSize = this->dataPtr->buffer.size();
+  }
+#endif
+
+  if (!file)
+  {
+    ignerr << "Sensor config cache [" << _path << "] is too small or "
+           << "can't be mapped.\n";
+    this->Clear();
+    return false;
+  }
+
+  CacheHeader header;
+  std::memcpy(&header, file, sizeof(header));
+  const char *data = file + sizeof(header);
+  const std::size_t size = fileSize - sizeof(header);
+  if (std::memcmp(header.magic, kCacheMagic, sizeof(header.magic)) != 0)
+  {
+    ignerr << "[" << _path << "] isn't a sensor config cache.\n";
+    this->Clear();
+    return false;
+  }
+
+  if (header.version != kCacheVersion)
+  {
+    ignerr << "Sensor config cache [" << _path << "] has version ["
+           << header.version << "], expected [" << kCacheVersion << "].\n";
+    this->Clear();
+    return false;
+  }
+
+  if (header.size != size || header.checksum != Checksum(data, size) ||
+      !this->dataPtr->Index(data, size, header.count))
+  {
+    ignerr << "Sensor config cache [" << _path << "] is corrupt.\n";
+    this->Clear();
+    return false;
+  }
+
+#ifdef _WIN32
+  // Keep only the entries, as Add() does
+  this->dataPtr->buffer.erase(0, sizeof(CacheHeader));
+#endif
+  return true;
+}
+
+//////////////////////////////////////////////////
+void SensorConfigCache::Clear()
+{
+  this->dataPtr->Unmap();
+  this->dataPtr->buffer.clear();
+  this->dataPtr->entries.clear();
+}
@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include <sdf/sdf.hh>
+
+#include "ignition/sensors/SensorConfigCache.hh"
+
+#include "test_config.h"  // NOLINT(build/include)
+
+using namespace ignition;
+using namespace sensors;
+
+/// \brief Path of the cache written by the tests.
+const std::string kCachePath =
+    std::string(PROJECT_BUILD_PATH) + "/SensorConfigCache_TEST.cache";
+
+/// \brief Create a noise DOM.
+/// \param[in] _stdDev Standard deviation.
+/// \return Gaussian noise.
+sdf::Noise GaussianNoise(double _stdDev)
+{
+  sdf::Noise noise;
+  noise.SetType(sdf::NoiseType::GAUSSIAN);
+  noise.SetMean(0.1);
+  noise.SetStdDev(_stdDev);
+  noise.SetBiasMean(0.01);
+  return noise;
+}
+
+/// \brief Create an IMU sensor DOM.
+/// \return IMU sensor.
+sdf::Sensor ImuSdf()
+{
+  sdf::Imu imu;
+  imu.SetLinearAccelerationXNoise(GaussianNoise(0.5));
+  imu.SetAngularVelocityZNoise(GaussianNoise(0.25));
+
+  sdf::Sensor sensor;
+  sensor.SetType(sdf::SensorType::IMU);
+  sensor.SetName("imu");
+  sensor.SetTopic("/imu");
+  sensor.SetUpdateRate(100.0);
+  sensor.SetRawPose(math::Pose3d(1, 2, 3, 0, 0, 1.57));
+  sensor.SetImuSensor(imu);
+  return sensor;
+}
+
+/// \brief Create a depth camera sensor DOM.
+/// \return Depth camera sensor.
+sdf::Sensor DepthCameraSdf()
+{
+  sdf::Camera camera;
+  camera.SetImageWidth(64);
+  camera.SetImageHeight(48);
+  camera.SetHorizontalFov(1.2);
+  camera.SetNearClip(0.2);
+  camera.SetFarClip(20.0);
+  camera.SetDepthFarClip(15.0);
+  camera.SetImageNoise(GaussianNoise(0.01));
+  camera.SetDistortionK1(-0.1);
+
+  sdf::Sensor sensor;
+  sensor.SetType(sdf::SensorType::DEPTH_CAMERA);
+  sensor.SetName("depth");
+  sensor.SetUpdateRate(30.0);
+  sensor.SetCameraSensor(camera);
+  return sensor;
+}
+
+//////////////////////////////////////////////////
+TEST(SensorConfigCache_TEST, Supported)
+{
+  EXPECT_TRUE(SensorConfigCache::Supported(ImuSdf()));
+  EXPECT_TRUE(SensorConfigCache::Supported(DepthCameraSdf()));
+
+  // Missing sensor DOM
+  sdf::Sensor sensor;
+  sensor.SetType(sdf::SensorType::LIDAR);
+  EXPECT_FALSE(SensorConfigCache::Supported(sensor));
+
+  // Logical cameras read their SDF element
+  sensor.SetType(sdf::SensorType::LOGICAL_CAMERA);
+  EXPECT_FALSE(SensorConfigCache::Supported(sensor));
+
+  SensorConfigCache cache;
+  EXPECT_FALSE(cache.Add(sensor));
+  EXPECT_EQ(0u, cache.Count());
+}
+
+//////////////////////////////////////////////////
+TEST(SensorConfigCache_TEST, SaveOpen)
+{
+  SensorConfigCache cache;
+  EXPECT_TRUE(cache.Add(ImuSdf(), "link"));
+  EXPECT_TRUE(cache.Add(DepthCameraSdf()));
+  EXPECT_EQ(2u, cache.Count());
+  EXPECT_TRUE(cache.Save(kCachePath));
+
+  SensorConfigCache opened;
+  EXPECT_TRUE(opened.Open(kCachePath));
+  ASSERT_EQ(2u, opened.Count());
+
+  sdf::Sensor sensor;
+  std::string parent;
+  EXPECT_FALSE(opened.Entry(2u, sensor, parent));
+
+  ASSERT_TRUE(opened.Entry(0u, sensor, parent));
+  EXPECT_EQ("link", parent);
+  EXPECT_EQ(sdf::SensorType::IMU, sensor.Type());
+  EXPECT_EQ("imu", sensor.Name());
+  EXPECT_EQ("/imu", sensor.Topic());
+  EXPECT_DOUBLE_EQ(100.0, sensor.UpdateRate());
+  EXPECT_EQ(math::Pose3d(1, 2, 3, 0, 0, 1.57), sensor.RawPose());
+  ASSERT_NE(nullptr, sensor.ImuSensor());
+  const sdf::Noise &accel = sensor.ImuSensor()->LinearAccelerationXNoise();
+  EXPECT_EQ(sdf::NoiseType::GAUSSIAN, accel.Type());
+  EXPECT_DOUBLE_EQ(0.1, accel.Mean());
+  EXPECT_DOUBLE_EQ(0.5, accel.StdDev());
+  EXPECT_DOUBLE_EQ(0.01, accel.BiasMean());
+  EXPECT_DOUBLE_EQ(0.25,
+      sensor.ImuSensor()->AngularVelocityZNoise().StdDev());
+  EXPECT_EQ(sdf::NoiseType::NONE,
+      sensor.ImuSensor()->AngularVelocityXNoise().Type());
+
+  ASSERT_TRUE(opened.Entry(1u, sensor, parent));
+  EXPECT_TRUE(parent.empty());
+  EXPECT_EQ(sdf::SensorType::DEPTH_CAMERA, sensor.Type());
+  EXPECT_EQ(nullptr, sensor.ImuSensor());
+  const sdf::Camera *camera = sensor.CameraSensor();
+  ASSERT_NE(nullptr, camera);
+  EXPECT_EQ(64u, camera->ImageWidth());
+  EXPECT_EQ(48u, camera->ImageHeight());
+  EXPECT_DOUBLE_EQ(1.2, camera->HorizontalFov().Radian());
+  EXPECT_DOUBLE_EQ(0.2, camera->NearClip());
+  EXPECT_DOUBLE_EQ(20.0, camera->FarClip());
+  EXPECT_FALSE(camera->HasDepthNearClip());
+  EXPECT_TRUE(camera->HasDepthFarClip());
+  EXPECT_DOUBLE_EQ(15.0, camera->DepthFarClip());
+  EXPECT_DOUBLE_EQ(0.01, camera->ImageNoise().StdDev());
+  EXPECT_DOUBLE_EQ(-0.1, camera->DistortionK1());
+
+  // Adding to an opened cache keeps its entries
+  EXPECT_TRUE(opened.Add(ImuSdf(), "other"));
+  ASSERT_EQ(3u, opened.Count());
+  EXPECT_TRUE(opened.Entry(1u, sensor, parent));
+  EXPECT_EQ("depth", sensor.Name());
+  EXPECT_TRUE(opened.Entry(2u, sensor, parent));
+  EXPECT_EQ("other", parent);
+
+  opened.Clear();
+  EXPECT_EQ(0u, opened.Count());
+}
+
+//////////////////////////////////////////////////
+TEST(SensorConfigCache_TEST, Invalid)
+{
+  SensorConfigCache cache;
+  EXPECT_FALSE(cache.Open(kCachePath + ".missing"));
+
+  EXPECT_TRUE(cache.Add(ImuSdf(), "link"));
+  EXPECT_TRUE(cache.Save(kCachePath));
+
+  std::string contents;
+  {
+    std::ifstream file(kCachePath, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(file),
+        std::istreambuf_iterator<char>());
+  }
+  ASSERT_GT(contents.size(), 40u);
+
+  auto write = [](const std::string &_contents)
+  {
+    std::ofstream file(kCachePath, std::ios::binary | std::ios::trunc);
+    file.write(_contents.data(), _contents.size());
+  };
+
+  // Flipped payload byte fails the checksum
+  std::string corrupt = contents;
+  corrupt.back() ^= 0x1;
+  write(corrupt);
+  EXPECT_FALSE(cache.Open(kCachePath));
+  EXPECT_EQ(0u, cache.Count());
+
+  // Other version
+  corrupt = contents;
+  corrupt[8] ^= 0x1;
+  write(corrupt);
+  EXPECT_FALSE(cache.Open(kCachePath));
+
+  // Truncated
+  write(contents.substr(0, contents.size() - 1));
+  EXPECT_FALSE(cache.Open(kCachePath));
+
+  // Not a cache
+  write("<sdf version='1.6'/>");
+  EXPECT_FALSE(cache.Open(kCachePath));
+
+  write(contents);
+  EXPECT_TRUE(cache.Open(kCachePath));
+  EXPECT_EQ(1u, cache.Count());
+}
+
+//////////////////////////////////////////////////
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -16,12 +16,78 @@
 */
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <ignition/msgs/image.pb.h>
+#include <ignition/msgs/imu.pb.h>
+#include <ignition/msgs/Utility.hh>
+
 #include <ignition/sensors/Export.hh>
 #include <ignition/sensors/Sensor.hh>
 
 using namespace ignition;
 using namespace sensors;
 
+/// \brief Whether to count allocations.
+static std::atomic<bool> g_countAllocations{false};
+
+/// \brief Number of allocations made while counting.
+static std::atomic<unsigned int> g_allocationCount{0};
+
+//////////////////////////////////////////////////
+void *operator new(std::size_t _size)
+{
+  if (g_countAllocations)
+    ++g_allocationCount;
+  void *ptr = std::malloc(_size == 0 ? 1 : _size);
+  if (!ptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+//////////////////////////////////////////////////
+void operator delete(void *_ptr) noexcept
+{
+  std::free(_ptr);
+}
+
+//////////////////////////////////////////////////
+void operator delete(void *_ptr, std::size_t) noexcept
+{
+  std::free(_ptr);
+}
+
+/// \brief Sink that stores the messages it receives.
+class TestSink : public MessageSink
+{
+  // Documentation inherited
+  public: void Add(const Sensor &_sensor,
+              const google::protobuf::Message &_msg) override
+  {
+    this->ids.push_back(_sensor.Id());
+    this->types.push_back(_msg.GetTypeName());
+  }
+
+  // Documentation inherited
+  public: bool HasConnections() const override
+  {
+    return this->connected;
+  }
+
+  /// \brief Ids of the sensors that added messages.
+  public: std::vector<SensorId> ids;
+
+  /// \brief Types of the messages.
+  public: std::vector<std::string> types;
+
+  /// \brief Value returned by HasConnections.
+  public: bool connected = true;
+};
+
 class TestSensor : public Sensor
 {
   public: bool Update(const common::Time &) override
@@ -30,7 +96,69 @@ class TestSensor : public Sensor
     return true;
   }
 
+  /// \brief Fill an IMU message the way ImuSensor does.
+  /// \param[in] _now Stamp of the message.
+  /// \return Filled message.
+  public: const msgs::IMU &FillImu(const common::Time &_now)
+  {
+    auto &msg = this->FrameMessage<msgs::IMU>();
+    msg.mutable_header()->mutable_stamp()->set_sec(_now.sec);
+    msg.mutable_header()->mutable_stamp()->set_nsec(_now.nsec);
+    msg.set_entity_name(this->frameId);
+    auto frame = msg.mutable_header()->add_data();
+    frame->set_key("frame_id");
+    frame->add_value(this->frameId);
+    msgs::Set(msg.mutable_orientation(), math::Quaterniond(0.1, 0.2, 0.3));
+    msgs::Set(msg.mutable_angular_velocity(), math::Vector3d(1, 2, 3));
+    msgs::Set(msg.mutable_linear_acceleration(), math::Vector3d(4, 5, 6));
+    this->AddSequence(msg.mutable_header());
+    return msg;
+  }
+
+  /// \brief Fill an image message the way CameraSensor does.
+  /// \param[in] _now Stamp of the message.
+  /// \param[in] _data Image data.
+  /// \return Filled message.
+  public: const msgs::Image &FillImage(const common::Time &_now,
+              const std::vector<unsigned char> &_data)
+  {
+    auto &msg = this->FrameMessage<msgs::Image>();
+    msg.set_width(16);
+    msg.set_height(static_cast<unsigned int>(_data.size() / 48));
+    msg.set_step(48);
+    msg.set_pixel_format_type(msgs::PixelFormatType::RGB_INT8);
+    msg.mutable_header()->mutable_stamp()->set_sec(_now.sec);
+    msg.mutable_header()->mutable_stamp()->set_nsec(_now.nsec);
+    auto frame = msg.mutable_header()->add_data();
+    frame->set_key("frame_id");
+    frame->add_value(this->frameId);
+    msg.mutable_data()->assign(
+        reinterpret_cast<const char *>(_data.data()), _data.size());
+    this->AddSequence(msg.mutable_header());
+    return msg;
+  }
+
+  /// \brief Publish a message through Sensor::Publish.
+  /// \param[in] _msg Message to publish.
+  public: void PublishTest(const google::protobuf::Message &_msg)
+  {
+    this->Publish(this->pub, _msg);
+  }
+
+  /// \brief Check whether a message would be consumed.
+  /// \return Result of Sensor::HasConnections.
+  public: bool HasConnectionsTest() const
+  {
+    return this->HasConnections(this->pub);
+  }
+
+  /// \brief Publisher that isn't advertised.
+  public: transport::Node::Publisher pub;
+
   public: unsigned int updateCount{0};
+
+  /// \brief Frame id, longer than the small string optimization.
+  public: const std::string frameId{"a_sensor_name_longer_than_short_strings"};
 };
 
 //////////////////////////////////////////////////
@@ -97,6 +225,110 @@ TEST(Sensor_TEST, AddSequence)
   EXPECT_EQ("0", header2.data(0).value(0));
 }
 
+//////////////////////////////////////////////////
+TEST(Sensor_TEST, MemoryUsage)
+{
+  TestSensor sensor;
+  SensorMemoryUsage usage = sensor.MemoryUsage();
+  EXPECT_EQ(0u, usage.buffers);
+  EXPECT_EQ(0u, usage.messages);
+  EXPECT_LT(0u, usage.config);
+  EXPECT_EQ(usage.config, usage.Total());
+
+  // Sequences are part of the configuration
+  ignition::msgs::Header header;
+  sensor.AddSequence(&header, sensor.frameId);
+  SensorMemoryUsage withSequence = sensor.MemoryUsage();
+  EXPECT_LT(usage.config + sensor.frameId.size(), withSequence.config);
+
+  SensorMemoryUsage sum;
+  sum.buffers = 1u;
+  sum.messages = 2u;
+  sum += withSequence;
+  sum += withSequence;
+  EXPECT_EQ(1u, sum.buffers);
+  EXPECT_EQ(2u, sum.messages);
+  EXPECT_EQ(2u * withSequence.config, sum.config);
+  EXPECT_EQ(3u + 2u * withSequence.config, sum.Total());
+}
+
+//////////////////////////////////////////////////
+TEST(Sensor_TEST, FrameMessage)
+{
+  TestSensor sensor;
+  std::vector<unsigned char> data(16 * 12 * 3, 7);
+
+  // Warm up, the first messages allocate their fields and the sequences
+  sensor.FillImu(common::Time(1, 0));
+  sensor.FillImage(common::Time(1, 0), data);
+
+  // Messages are cleared before being refilled
+  const msgs::IMU &imu = sensor.FillImu(common::Time(2, 5));
+  EXPECT_EQ(2, imu.header().stamp().sec());
+  EXPECT_EQ(5, imu.header().stamp().nsec());
+  ASSERT_EQ(2, imu.header().data_size());
+  EXPECT_EQ("frame_id", imu.header().data(0).key());
+  ASSERT_EQ(1, imu.header().data(0).value_size());
+  EXPECT_EQ("seq", imu.header().data(1).key());
+  EXPECT_EQ("2", imu.header().data(1).value(0));
+  EXPECT_DOUBLE_EQ(5.0, imu.linear_acceleration().y());
+
+  // Filling the same fields again doesn't allocate
+  g_allocationCount = 0;
+  g_countAllocations = true;
+  for (int i = 0; i < 100; ++i)
+  {
+    sensor.FillImu(common::Time(3 + i, 0));
+    sensor.FillImage(common::Time(3 + i, 0), data);
+  }
+  g_countAllocations = false;
+  EXPECT_EQ(0u, g_allocationCount);
+
+  const msgs::Image &image = sensor.FillImage(common::Time(200, 0), data);
+  EXPECT_EQ(12u, image.height());
+  EXPECT_EQ(data.size(), image.data().size());
+  ASSERT_EQ(2, image.header().data_size());
+  EXPECT_EQ("seq", image.header().data(1).key());
+  EXPECT_EQ("203", image.header().data(1).value(0));
+
+  // A smaller image reuses the buffer
+  std::vector<unsigned char> smaller(16 * 6 * 3, 9);
+  g_allocationCount = 0;
+  g_countAllocations = true;
+  sensor.FillImage(common::Time(201, 0), smaller);
+  g_countAllocations = false;
+  EXPECT_EQ(0u, g_allocationCount);
+}
+
+//////////////////////////////////////////////////
+TEST(Sensor_TEST, MessageSink)
+{
+  TestSensor sensor;
+  TestSink sink;
+  EXPECT_EQ(nullptr, sensor.Sink());
+  EXPECT_FALSE(sensor.HasConnectionsTest());
+
+  sensor.SetMessageSink(&sink);
+  EXPECT_EQ(&sink, sensor.Sink());
+  EXPECT_TRUE(sensor.HasConnectionsTest());
+  sink.connected = false;
+  EXPECT_FALSE(sensor.HasConnectionsTest());
+
+  sensor.PublishTest(msgs::IMU());
+  sensor.PublishTest(msgs::Image());
+  ASSERT_EQ(2u, sink.ids.size());
+  EXPECT_EQ(sensor.Id(), sink.ids[0]);
+  EXPECT_EQ(sensor.Id(), sink.ids[1]);
+  EXPECT_EQ("ignition.msgs.IMU", sink.types[0]);
+  EXPECT_EQ("ignition.msgs.Image", sink.types[1]);
+
+  // Messages go to the publisher again
+  sensor.SetMessageSink(nullptr);
+  EXPECT_EQ(nullptr, sensor.Sink());
+  sensor.PublishTest(msgs::IMU());
+  EXPECT_EQ(2u, sink.ids.size());
+}
+
 //////////////////////////////////////////////////
 int main(int argc, char **argv)
 {
@@ -0,0 +1,767 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <ignition/msgs/boolean.pb.h>
+#include <ignition/msgs/param.pb.h>
+#include <ignition/msgs/pose_v.pb.h>
+#include <ignition/msgs/stringmsg.pb.h>
+#include <ignition/msgs/uint64.pb.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include <ignition/common/Console.hh>
+#include <ignition/msgs/Utility.hh>
+#include <ignition/transport/Node.hh>
+
+#include "ignition/sensors/Sharding.hh"
+#include "ignition/sensors/Tracing.hh"
+
+using namespace ignition;
+using namespace sensors;
+
+namespace
+{
+  /// \brief Rate that sensors updating every step count as, in Hz.
+  const double kStepRate = 1000.0;
+
+  /// \brief Load factor of rendering sensors.
+  const double kRenderingLoad = 100.0;
+
+  /// \brief Estimate the load of a sensor for placement.
+  /// \param[in] _sdf The sensor.
+  /// \return Estimated load.
+  double EstimatedLoad(const sdf::Sensor &_sdf)
+  {
+    double load = _sdf.UpdateRate() > 0.0 ? _sdf.UpdateRate() : kStepRate;
+    switch (_sdf.Type())
+    {
+      case sdf::SensorType::CAMERA:
+      case sdf::SensorType::DEPTH_CAMERA:
+      case sdf::SensorType::GPU_LIDAR:
+      case sdf::SensorType::MULTICAMERA:
+      case sdf::SensorType::RGBD_CAMERA:
+      case sdf::SensorType::THERMAL_CAMERA:
+        return load * kRenderingLoad;
+      default:
+        return load;
+    }
+  }
+
+  /// \brief Wrap a sensor element in a document a worker can parse.
+  /// \param[in] _sensor SDF <sensor> element.
+  /// \return SDF document.
+  std::string SensorDocument(const sdf::ElementPtr &_sensor)
+  {
+    return "<?xml version='1.0'?><sdf version='" + sdf::SDF::Version() +
+        "'><model name='shard'><link name='link'>" + _sensor->ToString("") +
+        "</link></model></sdf>";
+  }
+
+  /// \brief Set a value of a statistics message.
+  /// \param[in,out] _msg Statistics message.
+  /// \param[in] _key Name of the value.
+  /// \return The value to set.
+  ignition::msgs::Any &StatsValue(ignition::msgs::Param &_msg,
+      const std::string &_key)
+  {
+    return (*_msg.mutable_params())[_key];
+  }
+
+  /// \brief A worker of a ShardCoordinator.
+  class ShardWorkerState
+  {
+    /// \brief Name of the worker.
+    public: std::string name;
+
+    /// \brief Prefix of the worker topics.
+    public: std::string prefix;
+
+    /// \brief Publisher of steps.
+    public: transport::Node::Publisher stepPub;
+
+    /// \brief Step message, reused between steps.
+    public: msgs::Pose_V stepMsg;
+
+    /// \brief Estimated load of the sensors placed on the worker.
+    public: double load = 0.0;
+
+    /// \brief Number of sensors placed on the worker.
+    public: unsigned int sensorCount = 0u;
+
+    /// \brief Whether the worker was waited for to subscribe to its steps.
+    public: bool discovered = false;
+
+    /// \brief Last statistics reported by the worker.
+    public: ShardStatistics stats;
+  };
+
+  /// \brief A sensor placed by a ShardCoordinator.
+  struct ShardedSensor
+  {
+    /// \brief Worker of the sensor.
+    ShardWorkerState *worker = nullptr;
+
+    /// \brief Id of the sensor on the worker.
+    SensorId remoteId = NO_SENSOR;
+
+    /// \brief Estimated load of the sensor.
+    double load = 0.0;
+  };
+}
+
+/// \brief Private data for ShardCoordinator
+class ignition::sensors::ShardCoordinatorPrivate
+{
+  /// \brief Find a worker.
+  /// \param[in] _name Name of the worker.
+  /// \return The worker, nullptr if it wasn't added.
+  public: ShardWorkerState *Worker(const std::string &_name) const;
+
+  /// \brief Choose the worker of a new sensor.
+  /// \param[in] _sdf The sensor.
+  /// \return The worker, nullptr if there are none.
+  public: ShardWorkerState *Place(const sdf::Sensor &_sdf);
+
+  /// \brief Wait for a worker to subscribe to its steps, up to the request
+  /// timeout.
+  /// \param[in] _worker The worker.
+  public: void WaitForDiscovery(ShardWorkerState &_worker) const;
+
+  /// \brief Store the statistics of a worker.
+  /// \param[in] _worker Name of the worker.
+  /// \param[in] _msg Statistics message.
+  public: void OnStats(const std::string &_worker,
+              const msgs::Param &_msg);
+
+  /// \brief Namespace of the worker topics.
+  public: std::string ns;
+
+  /// \brief Workers in the order they were added.
+  public: std::vector<std::unique_ptr<ShardWorkerState>> workers;
+
+  /// \brief How new sensors are placed.
+  public: ShardPlacement placement = ShardPlacement::BY_LOAD;
+
+  /// \brief Worker of each sensor type, with ShardPlacement::BY_TYPE.
+  public: std::map<std::string, std::string> typeWorkers;
+
+  /// \brief Timeout of create and remove requests, in milliseconds.
+  public: unsigned int requestTimeout = 5000u;
+
+  /// \brief Placed sensors by id.
+  public: std::map<SensorId, ShardedSensor> sensors;
+
+  /// \brief Id of the last placed sensor.
+  public: SensorId lastId = NO_SENSOR;
+
+  /// \brief Poses to send with the next step.
+  public: std::map<SensorId, math::Pose3d> poses;
+
+  /// \brief Protects the statistics, received on the transport thread.
+  public: mutable std::mutex statsMutex;
+
+  /// \brief Node of the worker topics. Declared last so subscriptions end
+  /// before the rest is destroyed.
+  public: transport::Node node;
+};
+
+/// \brief Private data for ShardWorker
+class ignition::sensors::ShardWorkerPrivate
+{
+  /// \brief Create a sensor for the coordinator.
+  /// \param[in] _req Sensor SDF document.
+  /// \param[out] _rep Id of the sensor, zero on failure.
+  /// \return True, the reply is always valid.
+  public: bool OnCreate(const msgs::StringMsg &_req, msgs::UInt64 &_rep);
+
+  /// \brief Remove a sensor for the coordinator.
+  /// \param[in] _req Id of the sensor.
+  /// \param[out] _rep Whether the sensor was removed.
+  /// \return True, the reply is always valid.
+  public: bool OnRemove(const msgs::UInt64 &_req, msgs::Boolean &_rep);
+
+  /// \brief Run a step from the coordinator.
+  /// \param[in] _msg Step time and sensor poses.
+  public: void OnStep(const msgs::Pose_V &_msg);
+
+  /// \brief Name of the worker.
+  public: std::string name;
+
+  /// \brief Prefix of the worker topics.
+  public: std::string prefix;
+
+  /// \brief Manager of the sensors.
+  public: Manager manager;
+
+  /// \brief Estimated load of each sensor.
+  public: std::map<SensorId, double> loads;
+
+  /// \brief Number of completed steps.
+  public: std::atomic<uint64_t> completedSteps{0u};
+
+  /// \brief Statistics message, reused between steps.
+  public: msgs::Param statsMsg;
+
+  /// \brief Publisher of statistics.
+  public: transport::Node::Publisher statsPub;
+
+  /// \brief Serializes the requests and steps, which may arrive on
+  /// different transport threads.
+  public: std::mutex mutex;
+
+  /// \brief Node of the worker topics. Declared last so callbacks end
+  /// before the manager is destroyed.
+  public: transport::Node node;
+};
+
+//////////////////////////////////////////////////
+ShardWorkerState *ShardCoordinatorPrivate::Worker(
+    const std::string &_name) const
+{
+  for (const auto &worker : this->workers)
+  {
+    if (worker->name == _name)
+      return worker.get();
+  }
+  return nullptr;
+}
+
+//////////////////////////////////////////////////
+ShardWorkerState *ShardCoordinatorPrivate::Place(const sdf::Sensor &_sdf)
+{
+  if (this->workers.empty())
+    return nullptr;
+
+  auto leastLoaded = [this]()
+  {
+    return std::min_element(this->workers.begin(), this->workers.end(),
+        [](const std::unique_ptr<ShardWorkerState> &_a,
+           const std::unique_ptr<ShardWorkerState> &_b)
+        {
+          return _a->load < _b->load;
+        })->get();
+  };
+
+  if (this->placement == ShardPlacement::BY_LOAD)
+    return leastLoaded();
+
+  const std::string type = _sdf.TypeStr();
+  auto it = this->typeWorkers.find(type);
+  if (it != this->typeWorkers.end())
+  {
+    ShardWorkerState *worker = this->Worker(it->second);
+    if (worker)
+      return worker;
+  }
+
+  // A new type goes to the worker with the fewest types
+  ShardWorkerState *best = nullptr;
+  std::size_t bestTypes = std::numeric_limits<std::size_t>::max();
+  for (const auto &worker : this->workers)
+  {
+    std::size_t types = std::count_if(this->typeWorkers.begin(),
+        this->typeWorkers.end(),
+        [&worker](const std::pair<const std::string, std::string> &_t)
+        {
+          return _t.second == worker->name;
+        });
+    if (types < bestTypes ||
+        (types == bestTypes && worker->load < best->load))
+    {
+      best = worker.get();
+      bestTypes = types;
+    }
+  }
+  this->typeWorkers[type] = best->name;
+  return best;
+}
+
+//////////////////////////////////////////////////
+void ShardCoordinatorPrivate::WaitForDiscovery(
+    ShardWorkerState &_worker) const
+{
+  IGN_SENSORS_PROFILE("ShardCoordinator::WaitForDiscovery");
+  _worker.discovered = true;
+  auto deadline = std::chrono::steady_clock::now() +
+      std::chrono::milliseconds(this->requestTimeout);
+  while (!_worker.stepPub.HasConnections())
+  {
+    if (std::chrono::steady_clock::now() >= deadline)
+    {
+      ignwarn << "Shard worker [" << _worker.name << "] didn't subscribe "
+              << "to its steps, they may be lost.\n";
+      return;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+}
+
+//////////////////////////////////////////////////
+void ShardCoordinatorPrivate::OnStats(const std::string &_worker,
+    const msgs::Param &_msg)
+{
+  std::lock_guard<std::mutex> lock(this->statsMutex);
+  ShardWorkerState *worker = this->Worker(_worker);
+  if (!worker)
+    return;
+
+  ShardStatistics &stats = worker->stats;
+  for (const auto &param : _msg.params())
+  {
+    const msgs::Any &value = param.second;
+    if (param.first == "sensors")
+      stats.sensors = static_cast<unsigned int>(value.int_value());
+    else if (param.first == "load")
+      stats.load = value.double_value();
+    else if (param.first == "completed_steps")
+      stats.completedSteps = static_cast<uint64_t>(value.double_value());
+    else if (param.first == "step_time")
+      stats.stepTime = msgs::Convert(value.time_value());
+    else if (param.first == "update_time")
+      stats.updateTime = value.double_value();
+  }
+}
+
+//////////////////////////////////////////////////
+ShardCoordinator::ShardCoordinator(const std::string &_namespace)
+  : dataPtr(new ShardCoordinatorPrivate)
+{
+  this->dataPtr->ns = _namespace;
+}
+
+//////////////////////////////////////////////////
+ShardCoordinator::~ShardCoordinator()
+{
+}
+
+//////////////////////////////////////////////////
+bool ShardCoordinator::AddWorker(const std::string &_name)
+{
+  if (_name.empty())
+  {
+    ignerr << "Empty shard worker name.\n";
+    return false;
+  }
+
+  if (this->dataPtr->Worker(_name))
+  {
+    ignerr << "Shard worker [" << _name << "] already exists.\n";
+    return false;
+  }
+
+  std::unique_ptr<ShardWorkerState> worker(new ShardWorkerState);
+  worker->name = _name;
+  worker->prefix = this->dataPtr->ns + "/" + _name;
+  worker->stepPub =
+      this->dataPtr->node.Advertise<msgs::Pose_V>(worker->prefix + "/step");
+  if (!worker->stepPub)
+  {
+    ignerr << "Unable to create publisher on topic[" << worker->prefix
+           << "/step].\n";
+    return false;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->dataPtr->statsMutex);
+    this->dataPtr->workers.push_back(std::move(worker));
+  }
+
+  ShardCoordinatorPrivate *data = this->dataPtr.get();
+  std::function<void(const msgs::Param &)> onStats =
+      [data, _name](const msgs::Param &_msg)
+      {
+        data->OnStats(_name, _msg);
+      };
+  const std::string statsTopic =
+      this->dataPtr->ns + "/" + _name + "/stats";
+  if (!this->dataPtr->node.Subscribe(statsTopic, onStats))
+  {
+    ignwarn << "Unable to subscribe to [" << statsTopic
+            << "], the statistics of the worker won't be available.\n";
+  }
+  return true;
+}
+
+//////////////////////////////////////////////////
+std::vector<std::string> ShardCoordinator::Workers() const
+{
+  std::vector<std::string> names;
+  for (const auto &worker : this->dataPtr->workers)
+    names.push_back(worker->name);
+  return names;
+}
+
+//////////////////////////////////////////////////
+void ShardCoordinator::SetPlacement(ShardPlacement _placement)
+{
+  this->dataPtr->placement = _placement;
+}
+
+//////////////////////////////////////////////////
+ShardPlacement ShardCoordinator::Placement() const
+{
+  return this->dataPtr->placement;
+}
+
+//////////////////////////////////////////////////
+bool ShardCoordinator::AssignType(const std::string &_type,
+    const std::string &_worker)
+{
+  if (!this->dataPtr->Worker(_worker))
+  {
+    ignerr << "Shard worker [" << _worker << "] doesn't exist.\n";
+    return false;
+  }
+  this->dataPtr->typeWorkers[_type] = _worker;
+  return true;
+}
+
+//////////////////////////////////////////////////
+void ShardCoordinator::SetRequestTimeout(unsigned int _ms)
+{
+  this->dataPtr->requestTimeout = _ms;
+}
+
+//////////////////////////////////////////////////
+SensorId ShardCoordinator::CreateSensor(sdf::ElementPtr _sdf)
+{
+  if (!_sdf)
+  {
+    ignerr << "Null sensor element.\n";
+    return NO_SENSOR;
+  }
+
+  sdf::Sensor sdfSensor;
+  sdfSensor.Load(_sdf);
+  return this->CreateSensor(sdfSensor);
+}
+
+//////////////////////////////////////////////////
+SensorId ShardCoordinator::CreateSensor(const sdf::Sensor &_sdf)
+{
+  IGN_SENSORS_PROFILE("ShardCoordinator::CreateSensor");
+  if (!_sdf.Element())
+  {
+    ignerr << "Sensor [" << _sdf.Name() << "] wasn't loaded from an SDF "
+           << "element, it can't be sent to a worker.\n";
+    return NO_SENSOR;
+  }
+
+  ShardWorkerState *worker = this->dataPtr->Place(_sdf);
+  if (!worker)
+  {
+    ignerr << "No shard worker to place sensor [" << _sdf.Name()
+           << "] on.\n";
+    return NO_SENSOR;
+  }
+
+  msgs::StringMsg req;
+  req.set_data(SensorDocument(_sdf.Element()));
+  msgs::UInt64 rep;
+  bool result = false;
+  const std::string service = worker->prefix + "/create";
+  if (!this->dataPtr->node.Request(service, req,
+      this->dataPtr->requestTimeout, rep, result) || !result)
+  {
+    ignerr << "Shard worker [" << worker->name << "] didn't answer the "
+           << "creation of sensor [" << _sdf.Name() << "].\n";
+    return NO_SENSOR;
+  }
+
+  // Step messages carry the worker's ids as 32 bit pose ids
+  if (rep.data() == NO_SENSOR ||
+      rep.data() > std::numeric_limits<uint32_t>::max())
+  {
+    ignerr << "Shard worker [" << worker->name << "] failed to create "
+           << "sensor [" << _sdf.Name() << "].\n";
+    return NO_SENSOR;
+  }
+
+  ShardedSensor sensor;
+  sensor.worker = worker;
+  sensor.remoteId = static_cast<SensorId>(rep.data());
+  sensor.load = EstimatedLoad(_sdf);
+  worker->load += sensor.load;
+  ++worker->sensorCount;
+
+  SensorId id = ++this->dataPtr->lastId;
+  this->dataPtr->sensors[id] = sensor;
+  return id;
+}
+
+//////////////////////////////////////////////////
+bool ShardCoordinator::Remove(SensorId _id)
+{
+  auto it = this->dataPtr->sensors.find(_id);
+  if (it == this->dataPtr->sensors.end())
+    return false;
+
+  ShardedSensor &sensor = it->second;
+  msgs::UInt64 req;
+  req.set_data(sensor.remoteId);
+  msgs::Boolean rep;
+  bool result = false;
+  const std::string service = sensor.worker->prefix + "/remove";
+  if (!this->dataPtr->node.Request(service, req,
+      this->dataPtr->requestTimeout, rep, result) || !result)
+  {
+    ignerr << "Shard worker [" << sensor.worker->name << "] didn't answer "
+           << "the removal of sensor [" << _id << "].\n";
+    return false;
+  }
+
+  sensor.worker->load = std::max(0.0, sensor.worker->load - sensor.load);
+  --sensor.worker->sensorCount;
+  this->dataPtr->poses.erase(_id);
+  this->dataPtr->sensors.erase(it);
+  return rep.data();
+}
+
+//////////////////////////////////////////////////
+std::string ShardCoordinator::SensorWorker(SensorId _id) const
+{
+  auto it = this->dataPtr->sensors.find(_id);
+  if (it == this->dataPtr->sensors.end())
+    return "";
+  return it->second.worker->name;
+}
+
+//////////////////////////////////////////////////
+bool ShardCoordinator::SetPose(SensorId _id, const math::Pose3d &_pose)
+{
+  if (this->dataPtr->sensors.find(_id) == this->dataPtr->sensors.end())
+    return false;
+  this->dataPtr->poses[_id] = _pose;
+  return true;
+}
+
+//////////////////////////////////////////////////
+void ShardCoordinator::RunOnce(const common::Time &_time, bool _force)
+{
+  IGN_SENSORS_PROFILE("ShardCoordinator::RunOnce");
+  for (auto &worker : this->dataPtr->workers)
+  {
+    // Clearing the repeated fields keeps their elements for the next step
+    msgs::Pose_V &msg = worker->stepMsg;
+    msg.mutable_pose()->Clear();
+    msg.mutable_header()->mutable_data()->Clear();
+    msgs::Set(msg.mutable_header()->mutable_stamp(), _time);
+    if (_force)
+    {
+      auto force = msg.mutable_header()->add_data();
+      force->set_key("force");
+      force->add_value("1");
+    }
+  }
+
+  for (const auto &pose : this->dataPtr->poses)
+  {
+    const ShardedSensor &sensor = this->dataPtr->sensors[pose.first];
+    auto poseMsg = sensor.worker->stepMsg.add_pose();
+    msgs::Set(poseMsg, pose.second);
+    poseMsg->set_id(static_cast<uint32_t>(sensor.remoteId));
+  }
+  this->dataPtr->poses.clear();
+
+  for (auto &worker : this->dataPtr->workers)
+  {
+    // The worker answered the creation of its sensors, but in another
+    // process its step subscription may not be discovered yet, and steps
+    // published before it is are lost.
+    if (!worker->discovered && worker->sensorCount > 0u)
+      this->dataPtr->WaitForDiscovery(*worker);
+    worker->stepPub.Publish(worker->stepMsg);
+  }
+}
+
+//////////////////////////////////////////////////
+std::map<std::string, ShardStatistics> ShardCoordinator::Statistics() const
+{
+  std::lock_guard<std::mutex> lock(this->dataPtr->statsMutex);
+  std::map<std::string, ShardStatistics> stats;
+  for (const auto &worker : this->dataPtr->workers)
+    stats[worker->name] = worker->stats;
+  return stats;
+}
+
+//////////////////////////////////////////////////
+bool ShardWorkerPrivate::OnCreate(const msgs::StringMsg &_req,
+    msgs::UInt64 &_rep)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  _rep.set_data(NO_SENSOR);
+
+  sdf::SDFPtr sdfParsed(new sdf::SDF());
+  sdf::init(sdfParsed);
+  if (!sdf::readString(_req.data(), sdfParsed))
+  {
+    ignerr << "Shard worker [" << this->name << "] received invalid "
+           << "sensor SDF.\n";
+    return true;
+  }
+
+  sdf::ElementPtr elem = sdfParsed->Root();
+  for (const char *child : {"model", "link", "sensor"})
+  {
+    if (!elem->HasElement(child))
+    {
+      ignerr << "Shard worker [" << this->name << "] received SDF "
+             << "without a sensor.\n";
+      return true;
+    }
+    elem = elem->GetElement(child);
+  }
+
+  sdf::Sensor sdfSensor;
+  sdfSensor.Load(elem);
+  SensorId id = this->manager.CreateSensor(sdfSensor);
+  if (id == NO_SENSOR)
+    return true;
+
+  this->loads[id] = EstimatedLoad(sdfSensor);
+  _rep.set_data(id);
+  return true;
+}
+
+//////////////////////////////////////////////////
+bool ShardWorkerPrivate::OnRemove(const msgs::UInt64 &_req,
+    msgs::Boolean &_rep)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->loads.erase(_req.data());
+  _rep.set_data(this->manager.Remove(_req.data()));
+  return true;
+}
+
+//////////////////////////////////////////////////
+void ShardWorkerPrivate::OnStep(const msgs::Pose_V &_msg)
+{
+  IGN_SENSORS_PROFILE("ShardWorker::OnStep");
+  std::lock_guard<std::mutex> lock(this->mutex);
+  for (const auto &pose : _msg.pose())
+  {
+    Sensor *sensor = this->manager.Sensor(pose.id());
+    if (sensor)
+      sensor->SetPose(msgs::Convert(pose));
+  }
+
+  bool force = false;
+  for (const auto &data : _msg.header().data())
+  {
+    if (data.key() == "force")
+      force = data.value_size() > 0 && data.value(0) == "1";
+  }
+
+  const common::Time time = msgs::Convert(_msg.header().stamp());
+  auto start = std::chrono::steady_clock::now();
+  this->manager.RunOnce(time, force);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  uint64_t steps = ++this->completedSteps;
+
+  double load = 0.0;
+  for (const auto &sensorLoad : this->loads)
+    load += sensorLoad.second;
+
+  msgs::Param &stats = this->statsMsg;
+  msgs::Set(stats.mutable_header()->mutable_stamp(), time);
+  StatsValue(stats, "sensors").set_type(msgs::Any::INT32);
+  StatsValue(stats, "sensors").set_int_value(
+      static_cast<int>(this->loads.size()));
+  StatsValue(stats, "load").set_type(msgs::Any::DOUBLE);
+  StatsValue(stats, "load").set_double_value(load);
+  // Any has no 64 bit integer, a double holds step counts exactly up to
+  // 2^53 where an int32 would overflow after weeks of steps at 1 kHz
+  StatsValue(stats, "completed_steps").set_type(msgs::Any::DOUBLE);
+  StatsValue(stats, "completed_steps").set_double_value(
+      static_cast<double>(steps));
+  StatsValue(stats, "step_time").set_type(msgs::Any::TIME);
+  msgs::Set(StatsValue(stats, "step_time").mutable_time_value(), time);
+  StatsValue(stats, "update_time").set_type(msgs::Any::DOUBLE);
+  StatsValue(stats, "update_time").set_double_value(elapsed.count());
+  this->statsPub.Publish(stats);
+}
+
+//////////////////////////////////////////////////
+ShardWorker::ShardWorker(const std::string &_name,
+    const std::string &_namespace)
+  : dataPtr(new ShardWorkerPrivate)
+{
+  this->dataPtr->name = _name;
+  this->dataPtr->prefix = _namespace + "/" + _name;
+}
+
+//////////////////////////////////////////////////
+ShardWorker::~ShardWorker()
+{
+}
+
+//////////////////////////////////////////////////
+std::string ShardWorker::Name() const
+{
+  return this->dataPtr->name;
+}
+
+//////////////////////////////////////////////////
+Manager &ShardWorker::SensorManager()
+{
+  return this->dataPtr->manager;
+}
+
+//////////////////////////////////////////////////
+bool ShardWorker::Start()
+{
+  const std::string &prefix = this->dataPtr->prefix;
+  this->dataPtr->statsPub =
+      this->dataPtr->node.Advertise<msgs::Param>(prefix + "/stats");
+  if (!this->dataPtr->statsPub)
+  {
+    ignerr << "Unable to create publisher on topic[" << prefix
+           << "/stats].\n";
+    return false;
+  }
+
+  if (!this->dataPtr->node.Advertise(prefix + "/create",
+      &ShardWorkerPrivate::OnCreate, this->dataPtr.get()) ||
+      !this->dataPtr->node.Advertise(prefix + "/remove",
+      &ShardWorkerPrivate::OnRemove, this->dataPtr.get()))
+  {
+    ignerr << "Unable to advertise the services of shard worker ["
+           << this->dataPtr->name << "].\n";
+    return false;
+  }
+
+  if (!this->dataPtr->node.Subscribe(prefix + "/step",
+      &ShardWorkerPrivate::OnStep, this->dataPtr.get()))
+  {
+    ignerr << "Unable to subscribe to [" << prefix << "/step].\n";
+    return false;
+  }
+  return true;
+}
+
+//////////////////////////////////////////////////
+uint64_t ShardWorker::CompletedSteps() const
+{
+  return this->dataPtr->completedSteps;
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef IGNITION_SENSORS_SPSCQUEUE_HH_
+#define IGNITION_SENSORS_SPSCQUEUE_HH_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "ignition/sensors/config.hh"
+
+namespace ignition
+{
+  namespace sensors
+  {
+    // Inline bracket to help doxygen filtering.
+    inline namespace IGNITION_SENSORS_VERSION_NAMESPACE {
+    //
+    /// \brief Bounded lock-free queue with a single producer thread and a
+    /// single consumer thread.
+    ///
+    /// Elements live in a ring of slots that is allocated once. Pushing
+    /// moves an element into a slot and popping moves it out, so elements
+    /// holding buffers can hand them back and forth without allocating.
+    /// The queue doesn't block, callers wait for room or for elements on
+    /// their own.
+    template<typename T>
+    class SpscQueue
+    {
+      /// \brief Constructor
+      /// \param[in] _capacity Maximum number of elements, at least one.
+      public: explicit SpscQueue(std::size_t _capacity)
+        : slots(std::max<std::size_t>(_capacity, 1u) + 1u)
+      {
+      }
+
+      /// \brief Get the maximum number of elements.
+      /// \return Capacity.
+      public: std::size_t Capacity() const
+      {
+        return this->slots.size() - 1u;
+      }
+
+      /// \brief Add an element. Only call from the producer thread.
+      /// \param[in,out] _value Element to move into the queue. Receives
+      /// the previous content of the slot.
+      /// \return False if the queue is full, in which case _value is
+      /// unchanged.
+      public: bool Push(T &_value)
+      {
+        const std::size_t slot = this->tail.load(std::memory_order_relaxed);
+        const std::size_t next = this->Next(slot);
+        if (next == this->head.load(std::memory_order_acquire))
+          return false;
+
+        std::swap(this->slots[slot], _value);
+        this->tail.store(next, std::memory_order_release);
+        return true;
+      }
+
+      /// \brief Remove the oldest element. Only call from the consumer
+      /// thread.
+      /// \param[in,out] _value Receives the element. Its previous content
+      /// is left in the slot, to be reused by a later Push.
+      /// \return False if the queue is empty.
+      public: bool Pop(T &_value)
+      {
+        const std::size_t slot = this->head.load(std::memory_order_relaxed);
+        if (slot == this->tail.load(std::memory_order_acquire))
+          return false;
+
+        std::swap(this->slots[slot], _value);
+        this->head.store(this->Next(slot), std::memory_order_release);
+        return true;
+      }
+
+      /// \brief Get whether the queue is empty. The result may be stale
+      /// when called from the producer thread.
+      /// \return True if there are no elements.
+      public: bool Empty() const
+      {
+        return this->head.load(std::memory_order_acquire) ==
+            this->tail.load(std::memory_order_acquire);
+      }
+
+      /// \brief Get the slot after a slot.
+      /// \param[in] _index Slot index.
+      /// \return Next slot index.
+      private: std::size_t Next(std::size_t _index) const
+      {
+        return _index + 1u == this->slots.size() ? 0u : _index + 1u;
+      }
+
+      /// \brief Ring of elements, with one unused slot to tell a full queue
+      /// from an empty one.
+      private: std::vector<T> slots;
+
+      /// \brief Slot of the oldest element, written by the consumer.
+      private: alignas(64) std::atomic<std::size_t> head{0u};
+
+      /// \brief Slot after the newest element, written by the producer.
+      private: alignas(64) std::atomic<std::size_t> tail{0u};
+    };
+    }
+  }
+}
+
+#endif
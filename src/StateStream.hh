@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef IGNITION_SENSORS_STATESTREAM_HH_
+#define IGNITION_SENSORS_STATESTREAM_HH_
+
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <type_traits>
+
+#include <ignition/common/Time.hh>
+
+#include "ignition/sensors/config.hh"
+#include "ignition/sensors/Noise.hh"
+#include "ignition/sensors/SensorTypes.hh"
+
+namespace ignition
+{
+  namespace sensors
+  {
+    // Inline bracket to help doxygen filtering.
+    inline namespace IGNITION_SENSORS_VERSION_NAMESPACE {
+    //
+    /// \brief Helpers to write and read the binary runtime state of sensors,
+    /// see Manager::SaveState(). Values are stored in host byte order.
+    namespace state
+    {
+      /// \brief Write a value.
+      /// \param[in] _out Stream to write to.
+      /// \param[in] _value Value, trivially copyable.
+      template<typename T>
+      void Write(std::ostream &_out, const T &_value)
+      {
+        static_assert(std::is_trivially_copyable<T>::value,
+            "Only trivially copyable values can be written");
+        _out.write(reinterpret_cast<const char *>(&_value), sizeof(T));
+      }
+
+      /// \brief Read a value.
+      /// \param[in] _in Stream to read from.
+      /// \param[out] _value Value, trivially copyable.
+      /// \return False if the stream ended.
+      template<typename T>
+      bool Read(std::istream &_in, T &_value)
+      {
+        static_assert(std::is_trivially_copyable<T>::value,
+            "Only trivially copyable values can be read");
+        _in.read(reinterpret_cast<char *>(&_value), sizeof(T));
+        return static_cast<bool>(_in);
+      }
+
+      /// \brief Write a string, prefixed with its length.
+      /// \param[in] _out Stream to write to.
+      /// \param[in] _value String.
+      inline void WriteString(std::ostream &_out, const std::string &_value)
+      {
+        Write(_out, static_cast<uint32_t>(_value.size()));
+        _out.write(_value.data(), _value.size());
+      }
+
+      /// \brief Read a string written by WriteString().
+      /// \param[in] _in Stream to read from.
+      /// \param[out] _value String.
+      /// \return False if the stream ended.
+      inline bool ReadString(std::istream &_in, std::string &_value)
+      {
+        uint32_t size = 0u;
+        if (!Read(_in, size))
+          return false;
+
+        // Grow with the data read, so a corrupt size fails at the end of
+        // the stream instead of allocating it upfront
+        _value.clear();
+        char buffer[256];
+        while (size > 0u)
+        {
+          uint32_t chunk = std::min<uint32_t>(size, sizeof(buffer));
+          if (!_in.read(buffer, chunk))
+            return false;
+          _value.append(buffer, chunk);
+          size -= chunk;
+        }
+        return true;
+      }
+
+      /// \brief Write a time.
+      /// \param[in] _out Stream to write to.
+      /// \param[in] _time Time.
+      inline void WriteTime(std::ostream &_out, const common::Time &_time)
+      {
+        Write(_out, static_cast<int32_t>(_time.sec));
+        Write(_out, static_cast<int32_t>(_time.nsec));
+      }
+
+      /// \brief Read a time written by WriteTime().
+      /// \param[in] _in Stream to read from.
+      /// \param[out] _time Time.
+      /// \return False if the stream ended.
+      inline bool ReadTime(std::istream &_in, common::Time &_time)
+      {
+        int32_t sec = 0;
+        int32_t nsec = 0;
+        if (!Read(_in, sec) || !Read(_in, nsec))
+          return false;
+        _time = common::Time(sec, nsec);
+        return true;
+      }
+
+      /// \brief Write the state of the noise models of a sensor.
+      /// \param[in] _out Stream to write to.
+      /// \param[in] _noises Noise models by type.
+      /// \return False if a model failed to write its state.
+      inline bool WriteNoises(std::ostream &_out,
+          const std::map<SensorNoiseType, NoisePtr> &_noises)
+      {
+        Write(_out, static_cast<uint32_t>(_noises.size()));
+        for (const auto &noise : _noises)
+        {
+          Write(_out, static_cast<int32_t>(noise.first));
+          if (!noise.second->SaveState(_out))
+            return false;
+        }
+        return static_cast<bool>(_out);
+      }
+
+      /// \brief Read the state of the noise models of a sensor, written by
+      /// WriteNoises(). The sensor must have the same noise models.
+      /// \param[in] _in Stream to read from.
+      /// \param[in,out] _noises Noise models by type.
+      /// \return False if the stream ended or the models differ.
+      inline bool ReadNoises(std::istream &_in,
+          std::map<SensorNoiseType, NoisePtr> &_noises)
+      {
+        uint32_t count = 0u;
+        if (!Read(_in, count) || count != _noises.size())
+          return false;
+
+        for (uint32_t i = 0u; i < count; ++i)
+        {
+          int32_t type = 0;
+          if (!Read(_in, type))
+            return false;
+          auto it = _noises.find(static_cast<SensorNoiseType>(type));
+          if (it == _noises.end() || !it->second->LoadState(_in))
+            return false;
+        }
+        return true;
+      }
+    }
+    }
+  }
+}
+
+#endif
@@ -18,10 +18,10 @@
 
 #include <algorithm>
 #include <mutex>
+#include <vector>
 
 #include <ignition/common/Console.hh>
 #include <ignition/common/Image.hh>
-#include <ignition/common/Profiler.hh>
 #include <ignition/common/SystemPaths.hh>
 
 #include <ignition/math/Angle.hh>
@@ -33,6 +33,9 @@
 #include "ignition/sensors/ImageGaussianNoiseModel.hh"
 #include "ignition/sensors/RenderingEvents.hh"
 #include "ignition/sensors/SensorFactory.hh"
+#include "ignition/sensors/Tracing.hh"
+
+#include "MemoryUsage.hh"
 
 /// \brief Private data for ThermalCameraSensor
 class ignition::sensors::ThermalCameraSensorPrivate
@@ -66,8 +69,12 @@ class ignition::sensors::ThermalCameraSensorPrivate
   /// \brief Rendering camera
   public: ignition::rendering::ThermalCameraPtr thermalCamera;
 
-  /// \brief Thermal data buffer.
-  public: uint16_t *thermalBuffer = nullptr;
+  /// \brief Thermal data buffers, one for each frame that may be in the
+  /// post-processing pipeline.
+  public: std::vector<std::vector<uint16_t>> thermalBuffers;
+
+  /// \brief Index of the buffer that receives data from the thermal camera.
+  public: unsigned int thermalSlot = 0u;
 
   /// \brief Thermal data buffer used when saving image.
   public: unsigned char *imgThermalBuffer = nullptr;
@@ -145,9 +152,9 @@ ThermalCameraSensor::ThermalCameraSensor()
 //////////////////////////////////////////////////
 ThermalCameraSensor::~ThermalCameraSensor()
 {
+  this->FlushPipeline();
+
   this->dataPtr->thermalConnection.reset();
-  if (this->dataPtr->thermalBuffer)
-    delete [] this->dataPtr->thermalBuffer;
 
   if (this->dataPtr->imgThermalBuffer)
     delete[] this->dataPtr->imgThermalBuffer;
@@ -326,10 +333,13 @@ void ThermalCameraSensor::OnNewThermalFrame(const uint16_t *_scan,
   unsigned int samples = _width * _height;
   unsigned int thermalBufferSize = samples * sizeof(uint16_t);
 
-  if (!this->dataPtr->thermalBuffer)
-    this->dataPtr->thermalBuffer = new uint16_t[samples];
+  if (this->dataPtr->thermalBuffers.empty())
+    this->dataPtr->thermalBuffers.resize(1);
+  std::vector<uint16_t> &thermalBuffer =
+      this->dataPtr->thermalBuffers[this->dataPtr->thermalSlot];
+  thermalBuffer.resize(samples);
 
-  memcpy(this->dataPtr->thermalBuffer, _scan, thermalBufferSize);
+  memcpy(thermalBuffer.data(), _scan, thermalBufferSize);
 }
 
 /////////////////////////////////////////////////
@@ -364,7 +374,7 @@ void ThermalCameraSensor::SetScene(ignition::rendering::ScenePtr _scene)
 //////////////////////////////////////////////////
 bool ThermalCameraSensor::Update(const ignition::common::Time &_now)
 {
-  IGN_PROFILE("ThermalCameraSensor::Update");
+  IGN_SENSORS_PROFILE_SENSOR("ThermalCameraSensor::Update", this->Id());
   if (!this->dataPtr->initialized)
   {
     ignerr << "Not initialized, update ignored.\n";
@@ -377,63 +387,119 @@ bool ThermalCameraSensor::Update(const ignition::common::Time &_now)
     return false;
   }
 
-  if (!this->dataPtr->thermalPub.HasConnections() &&
+  if (!this->HasConnections(this->dataPtr->thermalPub) &&
       this->dataPtr->imageEvent.ConnectionCount() == 0u)
     return false;
 
-  // generate sensor data - this triggers image callback
-  this->Render();
+  // Reuse the last frame if nothing changed since it was rendered
+  unsigned int slot;
+  if (!this->FrameDirty())
+  {
+    if (this->FrameReuse() == FrameReusePolicy::SKIP)
+      return true;
+    std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+    slot = this->dataPtr->thermalSlot;
+  }
+  else
+  {
+    // Each frame that may be in the pipeline receives data in its own slot.
+    slot = this->NextPipelineSlot();
+    {
+      std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+      if (this->dataPtr->thermalBuffers.size() != this->PipelineDepth() + 1u)
+        this->dataPtr->thermalBuffers.resize(this->PipelineDepth() + 1u);
+      this->dataPtr->thermalSlot = slot;
+    }
 
-  if (!this->dataPtr->thermalBuffer)
+    // generate sensor data - this triggers image callback
+    this->Render();
+  }
+
+  if (this->dataPtr->thermalBuffers[slot].empty())
     return false;
 
   unsigned int width = this->dataPtr->thermalCamera->ImageWidth();
   unsigned int height = this->dataPtr->thermalCamera->ImageHeight();
 
-  auto commonFormat = common::Image::L_INT16;
-  auto msgsFormat = msgs::PixelFormatType::L_INT16;
-
-  // create message
-  this->dataPtr->thermalMsg.set_width(width);
-  this->dataPtr->thermalMsg.set_height(height);
-  this->dataPtr->thermalMsg.set_step(
-      width * rendering::PixelUtil::BytesPerPixel(rendering::PF_L16));
-  this->dataPtr->thermalMsg.set_pixel_format_type(msgsFormat);
-  auto stamp = this->dataPtr->thermalMsg.mutable_header()->mutable_stamp();
-  stamp->set_sec(_now.sec);
-  stamp->set_nsec(_now.nsec);
-  auto frame = this->dataPtr->thermalMsg.mutable_header()->add_data();
-  frame->set_key("frame_id");
-  frame->add_value(this->Name());
+  // Convert and publish, possibly while the next frame renders.
+  this->PostProcess(_now, [this, _now, width, height, slot]()
+  {
+    const std::vector<uint16_t> &thermalBuffer =
+        this->dataPtr->thermalBuffers[slot];
+
+    auto commonFormat = common::Image::L_INT16;
+    auto msgsFormat = msgs::PixelFormatType::L_INT16;
+
+    // create message
+    this->dataPtr->thermalMsg.set_width(width);
+    this->dataPtr->thermalMsg.set_height(height);
+    this->dataPtr->thermalMsg.set_step(
+        width * rendering::PixelUtil::BytesPerPixel(rendering::PF_L16));
+    this->dataPtr->thermalMsg.set_pixel_format_type(msgsFormat);
+    auto stamp = this->dataPtr->thermalMsg.mutable_header()->mutable_stamp();
+    stamp->set_sec(_now.sec);
+    stamp->set_nsec(_now.nsec);
+    // Remove 'data' entries before adding new ones
+    this->dataPtr->thermalMsg.mutable_header()->clear_data();
+    auto frame = this->dataPtr->thermalMsg.mutable_header()->add_data();
+    frame->set_key("frame_id");
+    frame->add_value(this->Name());
+
+    this->dataPtr->thermalMsg.set_data(thermalBuffer.data(),
+        rendering::PixelUtil::MemorySize(rendering::PF_L16,
+        width, height));
+
+    // publish the camera info message
+    this->PublishInfo(_now);
+
+    this->Publish(this->dataPtr->thermalPub, this->dataPtr->thermalMsg);
+
+    // Trigger callbacks.
+    try
+    {
+      this->dataPtr->imageEvent(this->dataPtr->thermalMsg);
+    }
+    catch(...)
+    {
+      ignerr << "Exception thrown in an image callback.\n";
+    }
 
-  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
-  this->dataPtr->thermalMsg.set_data(this->dataPtr->thermalBuffer,
-      rendering::PixelUtil::MemorySize(rendering::PF_L16,
-      width, height));
+    // Save image
+    if (this->dataPtr->saveImage)
+    {
+      this->dataPtr->SaveImage(thermalBuffer.data(), width, height,
+          commonFormat);
+    }
+  });
 
-  // publish the camera info message
-  this->PublishInfo(_now);
+  return true;
+}
 
-  this->dataPtr->thermalPub.Publish(this->dataPtr->thermalMsg);
+//////////////////////////////////////////////////
+bool ThermalCameraSensor::HasSubscribers() const
+{
+  return this->HasConnections(this->dataPtr->thermalPub) ||
+      this->dataPtr->imageEvent.ConnectionCount() > 0 ||
+      this->CameraSensor::HasSubscribers();
+}
 
-  // Trigger callbacks.
-  try
-  {
-    this->dataPtr->imageEvent(this->dataPtr->thermalMsg);
-  }
-  catch(...)
-  {
-    ignerr << "Exception thrown in an image callback.\n";
-  }
+//////////////////////////////////////////////////
+SensorMemoryUsage ThermalCameraSensor::MemoryUsage() const
+{
+  SensorMemoryUsage usage = this->CameraSensor::MemoryUsage();
 
-  // Save image
-  if (this->dataPtr->saveImage)
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  usage.buffers += memory::Bytes(this->dataPtr->thermalBuffers) +
+      this->dataPtr->image.MemorySize();
+  if (this->dataPtr->imgThermalBuffer)
   {
-    this->dataPtr->SaveImage(this->dataPtr->thermalBuffer, width, height,
-        commonFormat);
+    usage.buffers += this->dataPtr->imgThermalBufferSize.X() *
+        this->dataPtr->imgThermalBufferSize.Y() * 3u;
   }
-
-  return true;
+  usage.messages += memory::Bytes(this->dataPtr->thermalMsg);
+  usage.config += memory::Bytes(this->dataPtr->saveImagePath) +
+      memory::Bytes(this->dataPtr->saveImagePrefix);
+  return usage;
 }
 
 //////////////////////////////////////////////////
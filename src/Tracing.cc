@@ -0,0 +1,435 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifdef _WIN32
+  #include <process.h>
+#else
+  #include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <ignition/common/Console.hh>
+
+#include "ignition/sensors/Tracing.hh"
+
+using namespace ignition;
+using namespace sensors;
+
+namespace
+{
+  /// \brief Environment variable holding the path of the trace to dump at
+  /// exit.
+  const char kTraceEnvironment[] = "IGN_SENSORS_TRACE";
+
+  /// \brief An event of a ring buffer. Fields are atomic so that they can
+  /// be read while the thread records, which costs nothing more than plain
+  /// stores with relaxed ordering.
+  struct TraceEvent
+  {
+    /// \brief Name of the zone.
+    std::atomic<const char *> name{nullptr};
+
+    /// \brief Start time in nanoseconds.
+    std::atomic<int64_t> start{0};
+
+    /// \brief Duration in nanoseconds.
+    std::atomic<int64_t> duration{0};
+
+    /// \brief Id of the sensor, zero for none.
+    std::atomic<SensorId> sensor{0u};
+  };
+
+  /// \brief Copy of an event, taken when dumping.
+  struct TraceEventCopy
+  {
+    /// \brief Name of the zone.
+    const char *name;
+
+    /// \brief Start time in nanoseconds.
+    int64_t start;
+
+    /// \brief Duration in nanoseconds.
+    int64_t duration;
+
+    /// \brief Id of the sensor, zero for none.
+    SensorId sensor;
+  };
+
+  /// \brief Ring buffer of the events of a thread.
+  struct ThreadBuffer
+  {
+    /// \brief Constructor
+    /// \param[in] _capacity Number of events.
+    /// \param[in] _tid Id of the thread in the trace.
+    ThreadBuffer(std::size_t _capacity, uint32_t _tid)
+      : events(new TraceEvent[_capacity]), capacity(_capacity), tid(_tid)
+    {
+    }
+
+    /// \brief The events, written in a circle.
+    std::unique_ptr<TraceEvent[]> events;
+
+    /// \brief Number of events.
+    std::size_t capacity;
+
+    /// \brief Number of events recorded so far. The event at index i is
+    /// at events[i % capacity].
+    std::atomic<uint64_t> head{0u};
+
+    /// \brief Number of events whose recording started, one more than
+    /// head while an event is being written.
+    std::atomic<uint64_t> started{0u};
+
+    /// \brief Index of the first event kept by Clear().
+    std::atomic<uint64_t> base{0u};
+
+    /// \brief Id of the thread in the trace.
+    uint32_t tid;
+
+    /// \brief Name of the thread, protected by TraceState::mutex.
+    std::string name;
+  };
+
+  /// \brief Global state of the tracer.
+  struct TraceState
+  {
+    /// \brief Constructor, starts tracing if the environment asks for it.
+    TraceState()
+    {
+      const char *path = std::getenv(kTraceEnvironment);
+      if (path && *path)
+      {
+        this->exitPath = path;
+        this->enabled = true;
+      }
+    }
+
+    /// \brief Destructor, dumps the trace if the environment asked for it.
+    ~TraceState();
+
+    /// \brief True while zones are recorded.
+    std::atomic<bool> enabled{false};
+
+    /// \brief Capacity of the ring buffers created next.
+    std::atomic<std::size_t> capacity{65536u};
+
+    /// \brief Protects the buffer list and the names.
+    std::mutex mutex;
+
+    /// \brief Ring buffers of all threads that recorded zones. They are
+    /// kept after their thread exits, so its events can be dumped.
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+    /// \brief Sensor names by id.
+    std::map<SensorId, std::string> sensorNames;
+
+    /// \brief Path to dump the trace to at exit, empty for none.
+    std::string exitPath;
+  };
+
+  /// \brief Get the global state of the tracer.
+  /// \return The state.
+  TraceState &State()
+  {
+    static TraceState state;
+    return state;
+  }
+
+  /// \brief Creates the state when the library is loaded, so that the
+  /// environment variable takes effect before the first zone.
+  const bool kStateCreated = (State(), true);
+
+  /// \brief Ring buffer of the calling thread, null until it records its
+  /// first zone.
+  thread_local ThreadBuffer *threadBuffer = nullptr;
+
+  /// \brief Get the ring buffer of the calling thread, creating it.
+  /// \return The ring buffer.
+  ThreadBuffer &Buffer()
+  {
+    if (!threadBuffer)
+    {
+      TraceState &state = State();
+      std::lock_guard<std::mutex> lock(state.mutex);
+      state.buffers.push_back(std::make_unique<ThreadBuffer>(
+          std::max<std::size_t>(state.capacity, 1u),
+          static_cast<uint32_t>(state.buffers.size() + 1u)));
+      threadBuffer = state.buffers.back().get();
+    }
+    return *threadBuffer;
+  }
+
+  /// \brief Write a string as a JSON string literal.
+  /// \param[in] _out Stream to write to.
+  /// \param[in] _value String.
+  void WriteJsonString(std::ostream &_out, const char *_value)
+  {
+    _out << '"';
+    for (const char *c = _value; *c; ++c)
+    {
+      if (*c == '"' || *c == '\\')
+      {
+        _out << '\\' << *c;
+      }
+      else if (static_cast<unsigned char>(*c) < 0x20u)
+      {
+        char escaped[8];
+        std::snprintf(escaped, sizeof(escaped), "\\u%04x",
+            static_cast<unsigned int>(*c));
+        _out << escaped;
+      }
+      else
+      {
+        _out << *c;
+      }
+    }
+    _out << '"';
+  }
+
+  /// \brief Write nanoseconds as microseconds, the unit of the trace.
+  /// \param[in] _out Stream to write to.
+  /// \param[in] _ns Nanoseconds, not negative.
+  void WriteMicroseconds(std::ostream &_out, int64_t _ns)
+  {
+    _out << _ns / 1000 << '.' << std::setw(3) << std::setfill('0')
+         << _ns % 1000 << std::setfill(' ');
+  }
+
+  /// \brief Write the events of the tracer as Chrome Trace Event JSON.
+  /// \param[in] _state State of the tracer.
+  /// \param[in] _out Stream to write to.
+  /// \return False if the stream failed.
+  bool DumpState(TraceState &_state, std::ostream &_out)
+  {
+#ifdef _WIN32
+    const int pid = _getpid();
+#else
+    const int pid = static_cast<int>(getpid());
+#endif
+
+    std::lock_guard<std::mutex> lock(_state.mutex);
+    _out << "{\"traceEvents\":[";
+    bool first = true;
+    auto separate = [&]()
+    {
+      _out << (first ? "\n" : ",\n");
+      first = false;
+    };
+
+    std::vector<TraceEventCopy> events;
+    for (auto &buffer : _state.buffers)
+    {
+      if (!buffer->name.empty())
+      {
+        separate();
+        _out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+             << ",\"tid\":" << buffer->tid << ",\"args\":{\"name\":";
+        WriteJsonString(_out, buffer->name.c_str());
+        _out << "}}";
+      }
+
+      // Copy the events, then drop those the thread may have overwritten
+      // while they were copied
+      uint64_t head = buffer->head.load(std::memory_order_acquire);
+      uint64_t begin = std::max(buffer->base.load(),
+          head - std::min<uint64_t>(head, buffer->capacity));
+      events.clear();
+      for (uint64_t i = begin; i < head; ++i)
+      {
+        const TraceEvent &event = buffer->events[i % buffer->capacity];
+        events.push_back({event.name.load(std::memory_order_relaxed),
+            event.start.load(std::memory_order_relaxed),
+            event.duration.load(std::memory_order_relaxed),
+            event.sensor.load(std::memory_order_relaxed)});
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      uint64_t started = buffer->started.load(std::memory_order_relaxed);
+      std::size_t skip = 0u;
+      if (started >= buffer->capacity &&
+          started - buffer->capacity > begin)
+      {
+        skip = static_cast<std::size_t>(std::min<uint64_t>(
+            started - buffer->capacity - begin, events.size()));
+      }
+
+      for (std::size_t i = skip; i < events.size(); ++i)
+      {
+        const TraceEventCopy &event = events[i];
+        if (!event.name)
+          continue;
+
+        separate();
+        _out << "{\"name\":";
+        WriteJsonString(_out, event.name);
+        _out << ",\"cat\":\"sensors\",\"ph\":\"X\",\"ts\":";
+        WriteMicroseconds(_out, event.start);
+        _out << ",\"dur\":";
+        WriteMicroseconds(_out, event.duration);
+        _out << ",\"pid\":" << pid << ",\"tid\":" << buffer->tid;
+        if (event.sensor != 0u)
+        {
+          _out << ",\"args\":{\"sensor\":";
+          auto name = _state.sensorNames.find(event.sensor);
+          WriteJsonString(_out, name != _state.sensorNames.end() ?
+              name->second.c_str() : "");
+          _out << ",\"id\":" << event.sensor << "}";
+        }
+        _out << "}";
+      }
+    }
+    _out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return static_cast<bool>(_out);
+  }
+
+  //////////////////////////////////////////////////
+  TraceState::~TraceState()
+  {
+    this->enabled = false;
+    if (this->exitPath.empty())
+      return;
+
+    std::ofstream out(this->exitPath, std::ios::binary);
+    if (!out || !DumpState(*this, out))
+      ignerr << "Failed to write the trace to [" << this->exitPath << "].\n";
+  }
+}
+
+//////////////////////////////////////////////////
+void Tracing::Start(std::size_t _capacity)
+{
+  State().capacity = _capacity;
+  State().enabled = true;
+}
+
+//////////////////////////////////////////////////
+void Tracing::Stop()
+{
+  State().enabled = false;
+}
+
+//////////////////////////////////////////////////
+bool Tracing::Enabled()
+{
+  return State().enabled.load(std::memory_order_relaxed);
+}
+
+//////////////////////////////////////////////////
+void Tracing::Clear()
+{
+  TraceState &state = State();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  for (auto &buffer : state.buffers)
+    buffer->base = buffer->head.load();
+}
+
+//////////////////////////////////////////////////
+std::size_t Tracing::EventCount()
+{
+  TraceState &state = State();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  std::size_t count = 0u;
+  for (auto &buffer : state.buffers)
+  {
+    uint64_t head = buffer->head.load();
+    uint64_t base = std::min(buffer->base.load(), head);
+    count += static_cast<std::size_t>(
+        std::min<uint64_t>(head - base, buffer->capacity));
+  }
+  return count;
+}
+
+//////////////////////////////////////////////////
+bool Tracing::Dump(std::ostream &_out)
+{
+  return DumpState(State(), _out);
+}
+
+//////////////////////////////////////////////////
+bool Tracing::Dump(const std::string &_path)
+{
+  std::ofstream out(_path, std::ios::binary);
+  if (!out || !Dump(out))
+  {
+    ignerr << "Failed to write the trace to [" << _path << "].\n";
+    return false;
+  }
+  return true;
+}
+
+//////////////////////////////////////////////////
+void Tracing::SetThreadName(const std::string &_name)
+{
+  ThreadBuffer &buffer = Buffer();
+  std::lock_guard<std::mutex> lock(State().mutex);
+  buffer.name = _name;
+}
+
+//////////////////////////////////////////////////
+void Tracing::SetSensorName(SensorId _id, const std::string &_name)
+{
+  std::lock_guard<std::mutex> lock(State().mutex);
+  State().sensorNames[_id] = _name;
+}
+
+//////////////////////////////////////////////////
+void Tracing::Record(const char *_name, int64_t _start, SensorId _sensor)
+{
+  int64_t end = Now();
+  ThreadBuffer &buffer = Buffer();
+  uint64_t head = buffer.head.load(std::memory_order_relaxed);
+  buffer.started.store(head + 1u, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  TraceEvent &event = buffer.events[head % buffer.capacity];
+  event.name.store(_name, std::memory_order_relaxed);
+  event.start.store(_start, std::memory_order_relaxed);
+  event.duration.store(end - _start, std::memory_order_relaxed);
+  event.sensor.store(_sensor, std::memory_order_relaxed);
+  buffer.head.store(head + 1u, std::memory_order_release);
+}
+
+//////////////////////////////////////////////////
+int64_t Tracing::Now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//////////////////////////////////////////////////
+TraceZone::TraceZone(const char *_name, SensorId _sensor)
+  : name(Tracing::Enabled() ? _name : nullptr), sensor(_sensor)
+{
+  if (this->name)
+    this->start = Tracing::Now();
+}
+
+//////////////////////////////////////////////////
+TraceZone::~TraceZone()
+{
+  if (this->name)
+    Tracing::Record(this->name, this->start, this->sensor);
+}
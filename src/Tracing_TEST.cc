@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "ignition/sensors/Tracing.hh"
+
+using namespace ignition;
+using namespace sensors;
+
+/// \brief Count the occurrences of a string.
+/// \param[in] _text Text to search.
+/// \param[in] _value String to count.
+/// \return Number of occurrences.
+std::size_t Count(const std::string &_text, const std::string &_value)
+{
+  std::size_t count = 0u;
+  for (std::size_t pos = _text.find(_value); pos != std::string::npos;
+       pos = _text.find(_value, pos + _value.size()))
+  {
+    ++count;
+  }
+  return count;
+}
+
+//////////////////////////////////////////////////
+TEST(Tracing_TEST, Zones)
+{
+  Tracing::Stop();
+  Tracing::Clear();
+  EXPECT_FALSE(Tracing::Enabled());
+
+  // Nothing is recorded while stopped
+  {
+    IGN_SENSORS_PROFILE("Tracing_TEST::Stopped");
+  }
+  EXPECT_EQ(0u, Tracing::EventCount());
+
+  Tracing::Start();
+  EXPECT_TRUE(Tracing::Enabled());
+  Tracing::SetSensorName(42u, "my \"imu\"");
+  {
+    IGN_SENSORS_PROFILE("Tracing_TEST::Outer");
+    IGN_SENSORS_PROFILE_SENSOR("Tracing_TEST::Sensor", 42u);
+  }
+
+  std::thread worker([]
+  {
+    IGN_SENSORS_PROFILE_THREAD_NAME("TracingWorker");
+    IGN_SENSORS_PROFILE("Tracing_TEST::Worker");
+  });
+  worker.join();
+  Tracing::Stop();
+  EXPECT_EQ(3u, Tracing::EventCount());
+
+  std::ostringstream out;
+  EXPECT_TRUE(Tracing::Dump(out));
+  std::string trace = out.str();
+  EXPECT_EQ(0u, trace.find("{\"traceEvents\":["));
+  EXPECT_NE(std::string::npos, trace.find("\"displayTimeUnit\":\"ms\"}"));
+  EXPECT_EQ(3u, Count(trace, "\"ph\":\"X\""));
+  EXPECT_EQ(0u, Count(trace, "Tracing_TEST::Stopped"));
+  EXPECT_EQ(1u, Count(trace, "\"name\":\"Tracing_TEST::Outer\""));
+  EXPECT_EQ(1u, Count(trace, "\"name\":\"Tracing_TEST::Worker\""));
+
+  // Sensor zones are tagged with the escaped sensor name and id
+  EXPECT_EQ(1u, Count(trace,
+      "\"args\":{\"sensor\":\"my \\\"imu\\\"\",\"id\":42}"));
+
+  // The worker thread is named
+  EXPECT_EQ(1u, Count(trace, "\"ph\":\"M\""));
+  EXPECT_EQ(1u, Count(trace, "{\"name\":\"TracingWorker\"}"));
+
+  Tracing::Clear();
+  EXPECT_EQ(0u, Tracing::EventCount());
+  out.str("");
+  EXPECT_TRUE(Tracing::Dump(out));
+  EXPECT_EQ(0u, Count(out.str(), "\"ph\":\"X\""));
+}
+
+//////////////////////////////////////////////////
+TEST(Tracing_TEST, RingBuffer)
+{
+  // The capacity applies to threads that record their first zone
+  Tracing::Start(4u);
+  std::thread worker([]
+  {
+    for (int i = 0; i < 10; ++i)
+    {
+      IGN_SENSORS_PROFILE("Tracing_TEST::Ring");
+    }
+  });
+  worker.join();
+  Tracing::Stop();
+
+  std::ostringstream out;
+  EXPECT_TRUE(Tracing::Dump(out));
+  EXPECT_EQ(4u, Count(out.str(), "Tracing_TEST::Ring"));
+  Tracing::Clear();
+}
+
+//////////////////////////////////////////////////
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
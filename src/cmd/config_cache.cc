@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <iostream>
+#include <string>
+
+#include <sdf/sdf.hh>
+
+#include "ignition/sensors/SensorConfigCache.hh"
+
+using namespace ignition;
+
+/// \brief Print the usage of the tool.
+/// \param[in] _name Name of the executable.
+void usage(const char *_name)
+{
+  std::cerr << "Usage:\n"
+            << "  " << _name << " build <file.sdf> <cache>\n"
+            << "      Compile the sensors of an SDF file into a cache.\n"
+            << "  " << _name << " validate <cache>\n"
+            << "      Check a cache and list its sensors.\n";
+}
+
+/// \brief Add the <sensor> elements under an element to a cache. The
+/// parent of a sensor is the name of its enclosing element.
+/// \param[in] _elem Element to search.
+/// \param[in,out] _cache Cache to add to.
+/// \return False if some sensor couldn't be added.
+bool addSensors(sdf::ElementPtr _elem, sensors::SensorConfigCache &_cache)
+{
+  bool result = true;
+  for (sdf::ElementPtr child = _elem->GetFirstElement(); child;
+       child = child->GetNextElement())
+  {
+    if (child->GetName() != "sensor")
+    {
+      result = addSensors(child, _cache) && result;
+      continue;
+    }
+
+    sdf::Sensor sensor;
+    sdf::Errors errors = sensor.Load(child);
+    for (const auto &error : errors)
+      std::cerr << error << std::endl;
+
+    std::string parent;
+    if (_elem->HasAttribute("name"))
+      parent = _elem->Get<std::string>("name");
+
+    if (!errors.empty() || !_cache.Add(sensor, parent))
+    {
+      std::cerr << "Skipping sensor [" << sensor.Name() << "]\n";
+      result = false;
+    }
+  }
+  return result;
+}
+
+/// \brief Compile the sensors of an SDF file.
+/// \param[in] _sdfPath Path of the SDF file.
+/// \param[in] _cachePath Path of the cache to write.
+/// \return Exit code.
+int build(const std::string &_sdfPath, const std::string &_cachePath)
+{
+  sdf::SDFPtr sdfFile = sdf::readFile(_sdfPath);
+  if (!sdfFile)
+  {
+    std::cerr << "Unable to read [" << _sdfPath << "]\n";
+    return -1;
+  }
+
+  sensors::SensorConfigCache cache;
+  bool complete = addSensors(sdfFile->Root(), cache);
+  if (!cache.Save(_cachePath))
+    return -1;
+
+  std::cout << "Wrote " << cache.Count() << " sensors to [" << _cachePath
+            << "]\n";
+  return complete ? 0 : 1;
+}
+
+/// \brief Check a cache and list its sensors.
+/// \param[in] _cachePath Path of the cache.
+/// \return Exit code.
+int validate(const std::string &_cachePath)
+{
+  sensors::SensorConfigCache cache;
+  if (!cache.Open(_cachePath))
+    return -1;
+
+  int result = 0;
+  sdf::Sensor sensor;
+  std::string parent;
+  for (std::size_t i = 0u; i < cache.Count(); ++i)
+  {
+    if (!cache.Entry(i, sensor, parent))
+    {
+      std::cerr << "Invalid entry [" << i << "]\n";
+      result = -1;
+      continue;
+    }
+    std::cout << "[" << i << "] " << parent << "::" << sensor.Name()
+              << " (" << sensor.TypeStr() << ", "
+              << sensor.UpdateRate() << " Hz)\n";
+  }
+
+  std::cout << "Format version " << sensors::SensorConfigCache::FormatVersion()
+            << ", " << cache.Count() << " sensors\n";
+  return result;
+}
+
+//////////////////////////////////////////////////
+int main(int _argc, char **_argv)
+{
+  const std::string command = _argc > 1 ? _argv[1] : "";
+  if (command == "build" && _argc == 4)
+    return build(_argv[2], _argv[3]);
+  if (command == "validate" && _argc == 3)
+    return validate(_argv[2]);
+
+  usage(_argv[0]);
+  return -1;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <iostream>
+#include <string>
+
+#include <ignition/transport/Node.hh>
+
+#include "ignition/sensors/Sharding.hh"
+
+using namespace ignition;
+
+/// \brief Print the usage of the tool.
+/// \param[in] _name Name of the executable.
+void usage(const char *_name)
+{
+  std::cerr << "Usage:\n"
+            << "  " << _name << " <worker> [namespace] [plugin path...]\n"
+            << "      Host the sensors a ShardCoordinator places on the\n"
+            << "      worker, until interrupted. The namespace defaults to\n"
+            << "      /sensors/shards.\n";
+}
+
+//////////////////////////////////////////////////
+int main(int _argc, char **_argv)
+{
+  if (_argc < 2 || std::string(_argv[1]).empty() || _argv[1][0] == '-')
+  {
+    usage(_argv[0]);
+    return -1;
+  }
+
+  const std::string ns = _argc > 2 ? _argv[2] : "/sensors/shards";
+  sensors::ShardWorker worker(_argv[1], ns);
+  for (int i = 3; i < _argc; ++i)
+    worker.SensorManager().AddPluginPaths(_argv[i]);
+
+  if (!worker.Start())
+    return -1;
+
+  std::cout << "Shard worker [" << worker.Name() << "] running under ["
+            << ns << "]" << std::endl;
+  transport::waitForShutdown();
+
+  std::cout << "Shard worker [" << worker.Name() << "] completed "
+            << worker.CompletedSteps() << " steps" << std::endl;
+  return 0;
+}
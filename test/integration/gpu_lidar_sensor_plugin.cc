@@ -17,6 +17,9 @@
 
 #include <gtest/gtest.h>
 
+#include <cmath>
+#include <cstring>
+
 #include <ignition/common/Console.hh>
 #include <ignition/common/Filesystem.hh>
 #include <ignition/common/Event.hh>
@@ -388,9 +391,37 @@ void GpuLidarSensorTest::DetectBox(const std::string &_renderEngine)
   EXPECT_FALSE(pointMsgs.back().is_bigendian());
   EXPECT_EQ(32u, pointMsgs.back().point_step());
   EXPECT_EQ(32u * horzSamples, pointMsgs.back().row_step());
-  EXPECT_TRUE(pointMsgs.back().is_dense());
+  EXPECT_FALSE(pointMsgs.back().is_dense());
   EXPECT_EQ(32u * horzSamples * vertSamples, pointMsgs.back().data().size());
 
+  // A dense cloud only has the rays that hit the box
+  sensor->SetDensePointCloud(true);
+  pointMsgs.clear();
+  mgr.RunOnce(ignition::common::Time(0.1), true);
+  i = 0;
+  while (pointMsgs.empty() && i < 300)
+  {
+    ignition::common::Time::Sleep(waitTime);
+    i++;
+  }
+  ASSERT_FALSE(pointMsgs.empty());
+  const ignition::msgs::PointCloudPacked &dense = pointMsgs.back();
+  EXPECT_EQ(1u, dense.height());
+  EXPECT_TRUE(dense.is_dense());
+  EXPECT_LT(0u, dense.width());
+  EXPECT_GT(static_cast<uint32_t>(horzSamples * vertSamples), dense.width());
+  ASSERT_EQ(dense.point_step() * dense.width(), dense.data().size());
+  for (unsigned int p = 0u; p < dense.width(); ++p)
+  {
+    for (int f = 0; f < 3; ++f)
+    {
+      float value;
+      memcpy(&value, dense.data().data() + p * dense.point_step() +
+          dense.field(f).offset(), sizeof(value));
+      EXPECT_TRUE(std::isfinite(value));
+    }
+  }
+
   // Clean up
   //
   engine->DestroyScene(scene);
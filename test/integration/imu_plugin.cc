@@ -17,9 +17,17 @@
 
 #include <gtest/gtest.h>
 
+#include <set>
+#include <sstream>
+#include <vector>
+
 #include <sdf/sdf.hh>
 
+#include <ignition/msgs/serialized.pb.h>
+
 #include <ignition/sensors/ImuSensor.hh>
+#include <ignition/sensors/Manager.hh>
+#include <ignition/sensors/Replay.hh>
 #include <ignition/sensors/SensorFactory.hh>
 
 #include "test_config.h"  // NOLINT(build/include)
@@ -226,6 +234,313 @@ TEST_F(ImuSensorTest, SensorReadings)
       ignition::msgs::Convert(msg.orientation()));
 }
 
+/////////////////////////////////////////////////
+TEST_F(ImuSensorTest, Bundle)
+{
+  const std::string bundleTopic = "/ignition/sensors/test/imu_bundle";
+  ignition::math::Pose3d sensorPose(ignition::math::Vector3d(0.25, 0.0, 0.5),
+      ignition::math::Quaterniond::Identity);
+
+  ignition::sensors::Manager mgr;
+  mgr.AddPluginPaths(ignition::common::joinPaths(PROJECT_BUILD_PATH, "lib"));
+  ignition::sensors::SensorId id1 = mgr.CreateSensor(ImuToSDF("imu1",
+      sensorPose, 0, "/ignition/sensors/test/imu1", true, false));
+  ignition::sensors::SensorId id2 = mgr.CreateSensor(ImuToSDF("imu2",
+      sensorPose, 0, "/ignition/sensors/test/imu2", true, false));
+  ASSERT_NE(ignition::sensors::NO_SENSOR, id1);
+  ASSERT_NE(ignition::sensors::NO_SENSOR, id2);
+
+  EXPECT_TRUE(mgr.AddBundle(bundleTopic, {id1, id2}));
+  EXPECT_FALSE(mgr.AddBundle(bundleTopic + "2", {id2}));
+
+  WaitForMessageTestHelper<ignition::msgs::SerializedState> msgHelper(
+      bundleTopic);
+
+  mgr.RunOnce(ignition::common::Time(2, 0));
+
+  EXPECT_TRUE(msgHelper.WaitForMessage()) << msgHelper;
+  auto msg = msgHelper.Message();
+  EXPECT_EQ(2, msg.header().stamp().sec());
+  ASSERT_EQ(2, msg.entities_size());
+
+  std::set<uint64_t> ids;
+  for (const auto &entity : msg.entities())
+  {
+    ids.insert(entity.id());
+    ASSERT_EQ(1, entity.components_size());
+    EXPECT_EQ(
+        ignition::sensors::Manager::BundleComponentType("ignition.msgs.IMU"),
+        static_cast<uint64_t>(entity.components(0).type()));
+
+    // Each member keeps its own header and sequence
+    ignition::msgs::IMU imu;
+    ASSERT_TRUE(imu.ParseFromString(entity.components(0).component()));
+    EXPECT_EQ(2, imu.header().stamp().sec());
+    bool hasSeq = false;
+    for (const auto &data : imu.header().data())
+    {
+      if (data.key() == "seq")
+      {
+        hasSeq = true;
+        EXPECT_EQ("0", data.value(0));
+      }
+    }
+    EXPECT_TRUE(hasSeq);
+  }
+  EXPECT_EQ(1u, ids.count(id1));
+  EXPECT_EQ(1u, ids.count(id2));
+
+  EXPECT_TRUE(mgr.RemoveBundle(bundleTopic));
+  EXPECT_TRUE(mgr.AddBundle(bundleTopic + "2", {id2}));
+}
+
+/////////////////////////////////////////////////
+TEST_F(ImuSensorTest, RateGovernor)
+{
+  const std::string topic = "/ignition/sensors/test/imu_governed";
+  ignition::math::Pose3d sensorPose(ignition::math::Vector3d(0.25, 0.0, 0.5),
+      ignition::math::Quaterniond::Identity);
+
+  ignition::sensors::Manager mgr;
+  mgr.AddPluginPaths(ignition::common::joinPaths(PROJECT_BUILD_PATH, "lib"));
+  ignition::sensors::SensorId id = mgr.CreateSensor(ImuToSDF("governed",
+      sensorPose, 100, topic, true, false));
+  ASSERT_NE(ignition::sensors::NO_SENSOR, id);
+
+  mgr.SetRateGovernorEnabled(true);
+  mgr.SetRateFloor(2);
+
+  // Nobody listens, the rate drops to the floor
+  mgr.RunOnce(ignition::common::Time(1, 0));
+  EXPECT_DOUBLE_EQ(2.0, mgr.EffectiveUpdateRate(id));
+  EXPECT_DOUBLE_EQ(100.0, mgr.NominalUpdateRate(id));
+  auto stats = mgr.RateGovernorStats();
+  EXPECT_EQ(1u, stats.idleSensors);
+  EXPECT_EQ(1u, stats.throttledSensors);
+  EXPECT_DOUBLE_EQ(2.0, stats.effectiveRates[id]);
+
+  // A subscriber brings it back to the nominal rate, without waiting for
+  // the update planned at the floor rate
+  WaitForMessageTestHelper<ignition::msgs::IMU> msgHelper(topic);
+  mgr.RunOnce(ignition::common::Time(1, 100000000));
+  EXPECT_DOUBLE_EQ(100.0, mgr.EffectiveUpdateRate(id));
+  EXPECT_TRUE(msgHelper.WaitForMessage()) << msgHelper;
+  stats = mgr.RateGovernorStats();
+  EXPECT_EQ(0u, stats.idleSensors);
+  EXPECT_EQ(0u, stats.throttledSensors);
+
+  // An impossible budget scales the rate down, but not below the floor
+  mgr.SetStepBudget(1e-12);
+  for (int i = 0; i < 50; ++i)
+    mgr.RunOnce(ignition::common::Time(2 + i, 0));
+  EXPECT_LT(mgr.RateGovernorStats().loadScale, 1.0);
+  EXPECT_LT(mgr.EffectiveUpdateRate(id), 100.0);
+  EXPECT_GE(mgr.EffectiveUpdateRate(id), 2.0);
+
+  // Disabling the governor restores the nominal rate
+  mgr.SetRateGovernorEnabled(false);
+  EXPECT_DOUBLE_EQ(100.0, mgr.EffectiveUpdateRate(id));
+}
+
+/////////////////////////////////////////////////
+TEST_F(ImuSensorTest, SensorThread)
+{
+  const std::string topic = "/ignition/sensors/test/imu_thread";
+  ignition::math::Pose3d sensorPose(ignition::math::Vector3d(0.25, 0.0, 0.5),
+      ignition::math::Quaterniond::Identity);
+
+  ignition::sensors::Manager mgr;
+  mgr.AddPluginPaths(ignition::common::joinPaths(PROJECT_BUILD_PATH, "lib"));
+  ignition::sensors::ImuSensor *sensor =
+      mgr.CreateSensor<ignition::sensors::ImuSensor>(ImuToSDF("threaded",
+      sensorPose, 0, topic, true, false));
+  ASSERT_NE(nullptr, sensor);
+
+  WaitForMessageTestHelper<ignition::msgs::IMU> msgHelper(topic);
+  ASSERT_TRUE(mgr.StartSensorThread(1u));
+
+  // Poses and states are applied on the sensor thread before the update
+  const ignition::math::Vector3d angularVel(1, 2, 3);
+  const ignition::math::Pose3d pose(1, 2, 3, 0, 0, 0);
+  ignition::sensors::SensorStep step;
+  uint64_t fence = 0u;
+  for (int i = 1; i <= 5; ++i)
+  {
+    step.time = ignition::common::Time(i, 0);
+    step.poses.emplace_back(sensor->Id(), pose);
+    step.states.emplace_back(sensor->Id(),
+        [&angularVel](ignition::sensors::Sensor &_sensor)
+        {
+          static_cast<ignition::sensors::ImuSensor &>(
+              _sensor).SetAngularVelocity(angularVel);
+        });
+    fence = mgr.SubmitStep(step);
+    EXPECT_EQ(static_cast<uint64_t>(i), fence);
+  }
+  EXPECT_TRUE(mgr.WaitForFence(fence));
+  EXPECT_TRUE(msgHelper.WaitForMessage()) << msgHelper;
+
+  // Sensors can be accessed once their steps completed
+  EXPECT_EQ(pose, sensor->Pose());
+  EXPECT_EQ(angularVel, sensor->AngularVelocity());
+
+  mgr.StopSensorThread();
+  EXPECT_EQ(5u, mgr.CompletedFence());
+}
+
+/////////////////////////////////////////////////
+TEST_F(ImuSensorTest, SaveLoadState)
+{
+  // IMU with noisy gyroscopes, whose bias drifts
+  std::ostringstream stream;
+  stream
+    << "<?xml version='1.0'?>"
+    << "<sdf version='1.6'>"
+    << " <model name='m1'>"
+    << "  <link name='link1'>"
+    << "    <sensor name='noisy' type='imu'>"
+    << "      <topic>/ignition/sensors/test/imu_state</topic>"
+    << "      <update_rate>10</update_rate>"
+    << "      <imu><angular_velocity>";
+  for (const std::string axis : {"x", "y", "z"})
+  {
+    stream
+      << "<" << axis << "><noise type='gaussian'>"
+      << "  <stddev>0.1</stddev>"
+      << "  <bias_mean>0.2</bias_mean>"
+      << "  <bias_stddev>0.05</bias_stddev>"
+      << "  <dynamic_bias_stddev>0.01</dynamic_bias_stddev>"
+      << "  <dynamic_bias_correlation_time>10</dynamic_bias_correlation_time>"
+      << "</noise></" << axis << ">";
+  }
+  stream
+    << "      </angular_velocity></imu>"
+    << "    </sensor>"
+    << "  </link>"
+    << " </model>"
+    << "</sdf>";
+
+  auto imuSdf = [&stream]()
+  {
+    sdf::SDFPtr sdfParsed(new sdf::SDF());
+    sdf::init(sdfParsed);
+    EXPECT_TRUE(sdf::readString(stream.str(), sdfParsed));
+    return sdfParsed->Root()->GetElement("model")->GetElement("link")
+      ->GetElement("sensor");
+  };
+
+  const ignition::math::Vector3d angularVel(1, 2, 3);
+  auto run = [&angularVel](ignition::sensors::Manager &_mgr,
+      ignition::sensors::ImuSensor *_sensor, int _first, int _last)
+  {
+    std::vector<ignition::math::Vector3d> values;
+    for (int i = _first; i < _last; ++i)
+    {
+      _sensor->SetAngularVelocity(angularVel);
+      _mgr.RunOnce(ignition::common::Time(0, i * 100000000));
+      values.push_back(_sensor->AngularVelocity());
+    }
+    return values;
+  };
+
+  ignition::sensors::Manager mgr;
+  mgr.AddPluginPaths(ignition::common::joinPaths(PROJECT_BUILD_PATH, "lib"));
+  ignition::sensors::ImuSensor *sensor =
+      mgr.CreateSensor<ignition::sensors::ImuSensor>(imuSdf());
+  ASSERT_NE(nullptr, sensor);
+  run(mgr, sensor, 0, 5);
+
+  std::stringstream snapshot;
+  ASSERT_TRUE(mgr.SaveState(snapshot));
+  auto expected = run(mgr, sensor, 5, 10);
+
+  // Sensors re-created from SDF continue where the snapshot was taken
+  ignition::sensors::Manager restoredMgr;
+  restoredMgr.AddPluginPaths(
+      ignition::common::joinPaths(PROJECT_BUILD_PATH, "lib"));
+  ignition::sensors::ImuSensor *restored =
+      restoredMgr.CreateSensor<ignition::sensors::ImuSensor>(imuSdf());
+  ASSERT_NE(nullptr, restored);
+  ASSERT_TRUE(restoredMgr.LoadState(snapshot));
+  EXPECT_EQ(ignition::common::Time(0, 500000000), restored->NextUpdateTime());
+
+  WaitForMessageTestHelper<ignition::msgs::IMU> msgHelper(
+      "/ignition/sensors/test/imu_state");
+  auto values = run(restoredMgr, restored, 5, 10);
+  ASSERT_EQ(expected.size(), values.size());
+  for (std::size_t i = 0; i < values.size(); ++i)
+    EXPECT_EQ(expected[i], values[i]);
+
+  // Sequence numbers continue too
+  EXPECT_TRUE(msgHelper.WaitForMessage()) << msgHelper;
+  auto msg = msgHelper.Message();
+  ASSERT_LT(0, msg.header().data_size());
+  bool hasSeq = false;
+  for (const auto &data : msg.header().data())
+  {
+    if (data.key() == "seq")
+    {
+      hasSeq = true;
+      EXPECT_LE(5, std::stoi(data.value(0)));
+    }
+  }
+  EXPECT_TRUE(hasSeq);
+
+  // Snapshots of other data are rejected
+  std::stringstream invalid("not a snapshot");
+  EXPECT_FALSE(restoredMgr.LoadState(invalid));
+}
+
+/////////////////////////////////////////////////
+TEST_F(ImuSensorTest, Recording)
+{
+  const std::string path =
+      ignition::common::joinPaths(PROJECT_BUILD_PATH, "imu_recording.rec");
+
+  ignition::sensors::Manager mgr;
+  mgr.AddPluginPaths(ignition::common::joinPaths(PROJECT_BUILD_PATH, "lib"));
+  ignition::sensors::ImuSensor *sensor =
+      mgr.CreateSensor<ignition::sensors::ImuSensor>(ImuToSDF("recorded",
+      ignition::math::Pose3d(), 10, "/ignition/sensors/test/imu_recorded",
+      true, false));
+  ASSERT_NE(nullptr, sensor);
+
+  EXPECT_FALSE(mgr.Recording());
+  EXPECT_FALSE(mgr.StopRecording());
+  ASSERT_TRUE(mgr.StartRecording(path));
+  EXPECT_TRUE(mgr.Recording());
+  for (int i = 0; i < 10; ++i)
+  {
+    sensor->SetLinearAcceleration(ignition::math::Vector3d(i, 0, 0));
+    mgr.RunOnce(ignition::common::Time(0, i * 100000000));
+  }
+  EXPECT_TRUE(mgr.StopRecording());
+  EXPECT_FALSE(mgr.Recording());
+  EXPECT_EQ(nullptr, sensor->Tap());
+
+  ignition::sensors::Replay replay;
+  ASSERT_TRUE(replay.Open(path));
+  EXPECT_EQ(10u, replay.MessageCount());
+  EXPECT_EQ(ignition::common::Time(0, 900000000), replay.EndTime());
+
+  ASSERT_TRUE(replay.Seek(ignition::common::Time(0, 300000000)));
+  ignition::sensors::ReplayMessage msg;
+  ASSERT_TRUE(replay.Next(msg));
+  EXPECT_EQ("recorded", msg.sensor);
+  EXPECT_EQ("/ignition/sensors/test/imu_recorded", msg.topic);
+  ignition::msgs::IMU imu;
+  ASSERT_TRUE(msg.Parse(imu));
+  EXPECT_EQ(ignition::common::Time(0, 300000000),
+      ignition::common::Time(imu.header().stamp().sec(),
+      imu.header().stamp().nsec()));
+
+  // Republish the rest on the recorded topic
+  WaitForMessageTestHelper<ignition::msgs::IMU> msgHelper(
+      "/ignition/sensors/test/imu_recorded");
+  EXPECT_EQ(6u, replay.Play(0.0));
+  EXPECT_TRUE(msgHelper.WaitForMessage()) << msgHelper;
+}
+
 int main(int argc, char **argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
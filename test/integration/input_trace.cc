@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sdf/sdf.hh>
+
+#include <ignition/common/Filesystem.hh>
+#include <ignition/sensors/InputTrace.hh>
+#include <ignition/sensors/Manager.hh>
+
+#include "test_config.h"  // NOLINT(build/include)
+
+/// \brief Gaussian noise of the axes of an IMU or magnetometer.
+const char kAxisNoise[] =
+  "<x><noise type='gaussian'><mean>0</mean><stddev>0.1</stddev>"
+  "<bias_mean>0.2</bias_mean><bias_stddev>0.1</bias_stddev></noise></x>"
+  "<y><noise type='gaussian'><mean>0</mean><stddev>0.1</stddev>"
+  "<bias_mean>0.2</bias_mean><bias_stddev>0.1</bias_stddev></noise></y>"
+  "<z><noise type='gaussian'><mean>0</mean><stddev>0.1</stddev>"
+  "<bias_mean>0.2</bias_mean><bias_stddev>0.1</bias_stddev></noise></z>";
+
+/// \brief Helper function to create the sdf elements of a noisy IMU, a
+/// noisy magnetometer and a logical camera.
+/// \return The sensor elements, empty on error.
+std::vector<sdf::ElementPtr> SensorsToSDF()
+{
+  std::ostringstream stream;
+  stream
+    << "<?xml version='1.0'?>"
+    << "<sdf version='1.6'>"
+    << " <model name='m1'>"
+    << "  <link name='link1'>"
+    << "    <sensor name='imu' type='imu'>"
+    << "      <topic>/ignition/sensors/test/input_trace/imu</topic>"
+    << "      <update_rate>100</update_rate>"
+    << "      <imu>"
+    << "        <linear_acceleration>" << kAxisNoise
+    << "        </linear_acceleration>"
+    << "      </imu>"
+    << "    </sensor>"
+    << "    <sensor name='mag' type='magnetometer'>"
+    << "      <topic>/ignition/sensors/test/input_trace/mag</topic>"
+    << "      <update_rate>50</update_rate>"
+    << "      <magnetometer>" << kAxisNoise << "</magnetometer>"
+    << "    </sensor>"
+    << "    <sensor name='camera' type='logical_camera'>"
+    << "      <topic>/ignition/sensors/test/input_trace/camera</topic>"
+    << "      <update_rate>25</update_rate>"
+    << "      <logical_camera>"
+    << "        <near>0.55</near>"
+    << "        <far>5</far>"
+    << "        <horizontal_fov>1.04719755</horizontal_fov>"
+    << "        <aspect_ratio>1.778</aspect_ratio>"
+    << "      </logical_camera>"
+    << "    </sensor>"
+    << "  </link>"
+    << " </model>"
+    << "</sdf>";
+
+  sdf::SDFPtr sdfParsed(new sdf::SDF());
+  sdf::init(sdfParsed);
+  if (!sdf::readString(stream.str(), sdfParsed))
+    return {};
+
+  std::vector<sdf::ElementPtr> sensors;
+  sdf::ElementPtr link =
+      sdfParsed->Root()->GetElement("model")->GetElement("link");
+  for (sdf::ElementPtr sensor = link->GetElement("sensor"); sensor;
+       sensor = sensor->GetNextElement("sensor"))
+  {
+    sensors.push_back(sensor);
+  }
+  return sensors;
+}
+
+/// \brief Create sensors in a manager.
+/// \param[in] _mgr The manager.
+/// \param[in] _count Number of sensors of SensorsToSDF() to create.
+/// \return Ids of the sensors.
+std::vector<ignition::sensors::SensorId> CreateSensors(
+    ignition::sensors::Manager &_mgr, std::size_t _count)
+{
+  _mgr.AddPluginPaths(ignition::common::joinPaths(PROJECT_BUILD_PATH, "lib"));
+  std::vector<ignition::sensors::SensorId> ids;
+  std::vector<sdf::ElementPtr> sensors = SensorsToSDF();
+  for (std::size_t i = 0u; i < _count && i < sensors.size(); ++i)
+    ids.push_back(_mgr.CreateSensor(sensors[i]));
+  return ids;
+}
+
+class InputTraceTest: public testing::Test
+{
+};
+
+/////////////////////////////////////////////////
+TEST_F(InputTraceTest, RecordReplay)
+{
+  const unsigned int steps = 100u;
+  std::stringstream inputs;
+  {
+    ignition::sensors::Manager mgr;
+    std::vector<ignition::sensors::SensorId> ids = CreateSensors(mgr, 3u);
+    ASSERT_EQ(3u, ids.size());
+    const ignition::sensors::SensorId imu = ids[0];
+    const ignition::sensors::SensorId mag = ids[1];
+    const ignition::sensors::SensorId camera = ids[2];
+    for (ignition::sensors::SensorId id : ids)
+      ASSERT_NE(ignition::sensors::NO_SENSOR, id);
+
+    ignition::sensors::InputRecorder recorder(mgr);
+
+    // Inputs that don't match the sensor type are rejected
+    EXPECT_FALSE(recorder.SetWorldMagneticField(imu,
+        ignition::math::Vector3d::UnitX));
+    EXPECT_FALSE(recorder.SetLinearAcceleration(camera,
+        ignition::math::Vector3d::Zero));
+    EXPECT_FALSE(recorder.SetPose(camera + 1u,
+        ignition::math::Pose3d::Zero));
+    EXPECT_FALSE(recorder.SetObjectPose(ignition::sensors::NO_RAY_OBJECT,
+        ignition::math::Pose3d::Zero));
+
+    ignition::sensors::RayObjectId box = recorder.AddBox(
+        ignition::math::Vector3d::One,
+        ignition::math::Pose3d(2, 0, 0, 0, 0, 0));
+    ignition::sensors::RayObjectId wall = recorder.AddBox(
+        ignition::math::Vector3d(0.1, 4, 4),
+        ignition::math::Pose3d(1, 0, 0, 0, 0, 0));
+    EXPECT_NE(ignition::sensors::NO_RAY_OBJECT, box);
+    EXPECT_EQ(2u, recorder.Scene()->ObjectCount());
+    EXPECT_TRUE(recorder.SetCpuScene(camera));
+    EXPECT_TRUE(recorder.SetOcclusionEnabled(camera, true));
+    EXPECT_TRUE(recorder.SetModelObjects(camera, {{"box", {box}}}));
+    EXPECT_TRUE(recorder.SetWorldMagneticField(mag,
+        ignition::math::Vector3d(0.2, 0.0, -0.4)));
+
+    for (unsigned int i = 0u; i < steps; ++i)
+    {
+      double t = i * 0.01;
+      ignition::math::Pose3d pose(0, 0, 0, 0, 0, t);
+      EXPECT_TRUE(recorder.SetWorldPose(imu, pose));
+      EXPECT_TRUE(recorder.SetWorldPose(mag, pose));
+      EXPECT_TRUE(recorder.SetLinearAcceleration(imu,
+          ignition::math::Vector3d(t, 0, -9.8)));
+      EXPECT_TRUE(recorder.SetAngularVelocity(imu,
+          ignition::math::Vector3d(0, 0, 1)));
+
+      ignition::math::Pose3d boxPose(2, -1 + t * 0.02, 0, 0, 0, 0);
+      EXPECT_TRUE(recorder.SetObjectPose(box, boxPose));
+      EXPECT_TRUE(recorder.SetModelPoses(camera, {{"box", boxPose}}));
+
+      // The wall hides the box half of the time
+      if (i == steps / 2u)
+      {
+        EXPECT_TRUE(recorder.RemoveObject(wall));
+      }
+
+      recorder.RunOnce(ignition::common::Time(t));
+    }
+    EXPECT_FALSE(recorder.RemoveObject(wall));
+    EXPECT_EQ(steps, recorder.StepCount());
+    EXPECT_TRUE(recorder.Save(inputs));
+  }
+
+  ignition::sensors::InputReplay replay;
+  ASSERT_TRUE(replay.Load(inputs));
+  EXPECT_EQ(steps, replay.StepCount());
+
+  // The recorded sensor state replaces the noise of the new sensors, so
+  // the replay produces the same messages
+  ignition::sensors::Manager mgr;
+  ASSERT_EQ(3u, CreateSensors(mgr, 3u).size());
+  for (int run = 0; run < 2; ++run)
+  {
+    ignition::sensors::InputReplayReport report = replay.Run(mgr);
+    EXPECT_TRUE(report.equivalent) << "run " << run;
+    EXPECT_EQ(steps, report.steps);
+    EXPECT_EQ(-1, report.firstMismatch);
+    EXPECT_EQ(0u, report.mismatches);
+    EXPECT_TRUE(report.missingSensors.empty());
+
+    // 100 IMU, 50 magnetometer and 25 logical camera messages
+    EXPECT_EQ(175u, report.messages);
+    EXPECT_LT(0.0, report.wallTime);
+    EXPECT_LT(0.0, report.stepsPerSecond);
+    EXPECT_LE(report.medianLatency, report.p99Latency);
+    EXPECT_LE(report.p99Latency, report.maxLatency);
+    EXPECT_LE(report.maxLatency, report.wallTime);
+    EXPECT_LT(0.0, report.digestTime);
+  }
+
+  // Without the equivalence check only the sensors are timed
+  EXPECT_TRUE(replay.EquivalenceCheck());
+  replay.SetEquivalenceCheck(false);
+  EXPECT_FALSE(replay.EquivalenceCheck());
+  {
+    ignition::sensors::InputReplayReport report = replay.Run(mgr);
+    EXPECT_FALSE(report.equivalent);
+    EXPECT_EQ(steps, report.steps);
+    EXPECT_EQ(0u, report.messages);
+    EXPECT_EQ(0u, report.mismatches);
+    EXPECT_DOUBLE_EQ(0.0, report.digestTime);
+    EXPECT_LT(0.0, report.wallTime);
+    EXPECT_LE(report.maxLatency, report.wallTime);
+  }
+  replay.SetEquivalenceCheck(true);
+
+  // A missing sensor changes the output
+  ignition::sensors::Manager partial;
+  ASSERT_EQ(2u, CreateSensors(partial, 2u).size());
+  ignition::sensors::InputReplayReport report = replay.Run(partial);
+  EXPECT_FALSE(report.equivalent);
+  EXPECT_EQ(steps, report.steps);
+  ASSERT_EQ(1u, report.missingSensors.size());
+  EXPECT_EQ("camera", report.missingSensors[0]);
+  EXPECT_EQ(0, report.firstMismatch);
+  EXPECT_EQ(25u, report.mismatches);
+}
+
+/////////////////////////////////////////////////
+TEST_F(InputTraceTest, Invalid)
+{
+  ignition::sensors::InputReplay replay;
+  std::stringstream empty;
+  EXPECT_FALSE(replay.Load(empty));
+  EXPECT_EQ(0u, replay.StepCount());
+
+  std::stringstream garbage("not recorded inputs");
+  EXPECT_FALSE(replay.Load(garbage));
+
+  // Truncated inputs are rejected
+  std::stringstream inputs;
+  {
+    ignition::sensors::Manager mgr;
+    ASSERT_EQ(1u, CreateSensors(mgr, 1u).size());
+    ignition::sensors::InputRecorder recorder(mgr);
+    recorder.RunOnce(ignition::common::Time(0.0));
+    recorder.RunOnce(ignition::common::Time(0.01));
+    EXPECT_TRUE(recorder.Save(inputs));
+  }
+  std::string data = inputs.str();
+  std::stringstream truncated(data.substr(0, data.size() - 1u));
+  EXPECT_FALSE(replay.Load(truncated));
+  EXPECT_EQ(0u, replay.StepCount());
+
+  std::stringstream complete(data);
+  EXPECT_TRUE(replay.Load(complete));
+  EXPECT_EQ(2u, replay.StepCount());
+}
+
+//////////////////////////////////////////////////
+int main(int argc, char **argv)
+{
+  ignition::common::Console::SetVerbosity(4);
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
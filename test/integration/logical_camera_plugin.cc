@@ -23,6 +23,7 @@
 #include <ignition/common/Time.hh>
 
 #include <ignition/sensors/LogicalCameraSensor.hh>
+#include <ignition/sensors/RayScene.hh>
 #include <ignition/sensors/SensorFactory.hh>
 #include <ignition/sensors/Export.hh>
 
@@ -230,6 +231,114 @@ TEST_F(LogicalCameraSensorTest, DetectBox)
   EXPECT_EQ(0, img.model().size());
 }
 
+/////////////////////////////////////////////////
+/// \brief Test detecting boxes that are occluded by other boxes
+TEST_F(LogicalCameraSensorTest, DetectOccludedBox)
+{
+  const std::string name = "TestLogicalCamera";
+  const std::string topic = "/ignition/sensors/test/logical_camera_occlusion";
+  const double updateRate = 30;
+  const double near = 0.55;
+  const double far = 10;
+  const double horzFov = 1.04719755;
+  const double aspectRatio = 1.778;
+  const bool alwaysOn = 1;
+  const bool visualize = 1;
+
+  ignition::math::Pose3d sensorPose(ignition::math::Vector3d(0, 0, 0.5),
+      ignition::math::Quaterniond::Identity);
+  sdf::ElementPtr logicalCameraSDF = LogicalCameraToSDF(name, sensorPose,
+        updateRate, topic, near, far, horzFov, aspectRatio, alwaysOn,
+        visualize);
+
+  ignition::sensors::SensorFactory sf;
+  sf.AddPluginPaths(ignition::common::joinPaths(PROJECT_BUILD_PATH, "lib"));
+  std::unique_ptr<ignition::sensors::LogicalCameraSensor> sensor =
+      sf.CreateSensor<ignition::sensors::LogicalCameraSensor>(logicalCameraSDF);
+  ASSERT_TRUE(sensor != nullptr);
+
+  EXPECT_FALSE(sensor->OcclusionEnabled());
+  EXPECT_EQ(32u, sensor->OcclusionSamples());
+  EXPECT_DOUBLE_EQ(0.0, sensor->MinVisibleFraction());
+
+  // A small box behind a wall, and a box that is half hidden by it
+  auto scene = std::make_shared<ignition::sensors::RayScene>();
+  ignition::math::Pose3d wallPose(3, 0, 0.5, 0, 0, 0);
+  ignition::math::Pose3d hiddenPose(6, 0, 0.5, 0, 0, 0);
+  ignition::math::Pose3d partialPose(6, 1.5, 0.5, 0, 0, 0);
+  auto wall = scene->AddBox(ignition::math::Vector3d(0.2, 1.6, 1.5),
+      wallPose);
+  auto hidden = scene->AddBox(ignition::math::Vector3d::One, hiddenPose);
+  auto partial = scene->AddBox(ignition::math::Vector3d(0.5, 2, 1),
+      partialPose);
+  sensor->SetCpuScene(scene);
+  EXPECT_EQ(scene, sensor->CpuScene());
+
+  std::map<std::string, std::vector<ignition::sensors::RayObjectId>> objects;
+  objects["wall"] = {wall};
+  objects["hidden"] = {hidden};
+  objects["partial"] = {partial};
+  sensor->SetModelObjects(std::move(objects));
+
+  std::map<std::string, ignition::math::Pose3d> modelPoses;
+  modelPoses["wall"] = wallPose;
+  modelPoses["hidden"] = hiddenPose;
+  modelPoses["partial"] = partialPose;
+  sensor->SetModelPoses(std::map<std::string, ignition::math::Pose3d>(
+      modelPoses));
+
+  // Without occlusion every model is detected
+  sensor->Update(ignition::common::Time::Zero);
+  auto img = sensor->Image();
+  EXPECT_EQ(3, img.model().size());
+  EXPECT_DOUBLE_EQ(1.0, sensor->VisibleFraction("hidden"));
+
+  sensor->SetOcclusionEnabled(true);
+  EXPECT_TRUE(sensor->OcclusionEnabled());
+  sensor->SetOcclusionSamples(64u);
+  EXPECT_EQ(64u, sensor->OcclusionSamples());
+  sensor->Update(ignition::common::Time::Zero);
+
+  img = sensor->Image();
+  ASSERT_EQ(2, img.model().size());
+  EXPECT_EQ("partial", img.model(0).name());
+  EXPECT_EQ("wall", img.model(1).name());
+  EXPECT_EQ(partialPose - sensorPose,
+      ignition::msgs::Convert(img.model(0).pose()));
+  EXPECT_DOUBLE_EQ(0.0, sensor->VisibleFraction("hidden"));
+  EXPECT_DOUBLE_EQ(1.0, sensor->VisibleFraction("wall"));
+  double fraction = sensor->VisibleFraction("partial");
+  EXPECT_GT(fraction, 0.2);
+  EXPECT_LT(fraction, 0.8);
+
+  // The fractions are also in the header
+  bool found = false;
+  for (const auto &data : img.header().data())
+  {
+    if (data.key() != "visible_fraction")
+      continue;
+    found = true;
+    ASSERT_EQ(2, data.value().size());
+    EXPECT_NEAR(fraction, std::stod(data.value(0)), 1e-5);
+  }
+  EXPECT_TRUE(found);
+
+  // Require most of a model to be visible
+  sensor->SetMinVisibleFraction(0.9);
+  sensor->Update(ignition::common::Time::Zero);
+  img = sensor->Image();
+  ASSERT_EQ(1, img.model().size());
+  EXPECT_EQ("wall", img.model(0).name());
+
+  // Moving the wall away reveals the hidden box, which now hides a corner
+  // of the other box
+  sensor->SetMinVisibleFraction(0.0);
+  scene->SetObjectPose(wall, ignition::math::Pose3d(3, 0, 20, 0, 0, 0));
+  sensor->Update(ignition::common::Time::Zero);
+  EXPECT_DOUBLE_EQ(1.0, sensor->VisibleFraction("hidden"));
+  EXPECT_GT(sensor->VisibleFraction("partial"), 0.9);
+}
+
 int main(int argc, char **argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,354 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char **environ;
+#endif
+
+#include <sdf/sdf.hh>
+
+#include <ignition/common/Filesystem.hh>
+
+#include <ignition/msgs/altimeter.pb.h>
+#include <ignition/msgs/imu.pb.h>
+
+#include <ignition/sensors/Sharding.hh>
+
+#include "test_config.h"  // NOLINT(build/include)
+#include "TransportTestTools.hh"
+
+/// \brief Helper function to create a sensor sdf element
+sdf::ElementPtr SensorToSDF(const std::string &_name,
+    const std::string &_type, const std::string &_topic)
+{
+  std::ostringstream stream;
+  stream
+    << "<?xml version='1.0'?>"
+    << "<sdf version='1.6'>"
+    << " <model name='m1'>"
+    << "  <link name='link1'>"
+    << "    <sensor name='" << _name << "' type='" << _type << "'>"
+    << "      <topic>" << _topic << "</topic>"
+    << "      <update_rate>0</update_rate>"
+    << "      <always_on>1</always_on>"
+    << "    </sensor>"
+    << "  </link>"
+    << " </model>"
+    << "</sdf>";
+
+  sdf::SDFPtr sdfParsed(new sdf::SDF());
+  sdf::init(sdfParsed);
+  if (!sdf::readString(stream.str(), sdfParsed))
+    return sdf::ElementPtr();
+
+  return sdfParsed->Root()->GetElement("model")->GetElement("link")
+    ->GetElement("sensor");
+}
+
+/// \brief Wait until every worker reported a step.
+/// \param[in] _coordinator Coordinator of the workers.
+/// \param[in] _steps Number of completed steps to wait for.
+/// \return True if the workers reported the steps within 5 seconds.
+bool WaitForSteps(const ignition::sensors::ShardCoordinator &_coordinator,
+    uint64_t _steps)
+{
+  for (int i = 0; i < 500; ++i)
+  {
+    bool done = true;
+    for (const auto &stats : _coordinator.Statistics())
+      done = done && stats.second.completedSteps >= _steps;
+    if (done)
+      return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+#ifndef _WIN32
+/// \brief A shard worker running in its own process.
+class WorkerProcess
+{
+  /// \brief Start a worker process.
+  /// \param[in] _name Name of the worker.
+  /// \param[in] _namespace Namespace of the worker topics.
+  public: WorkerProcess(const std::string &_name,
+              const std::string &_namespace)
+  {
+    const std::string pluginPath =
+        ignition::common::joinPaths(PROJECT_BUILD_PATH, "lib");
+    std::vector<std::string> args = {SHARD_WORKER_EXECUTABLE, _name,
+        _namespace, pluginPath};
+    std::vector<char *> argv;
+    for (auto &arg : args)
+      argv.push_back(&arg[0]);
+    argv.push_back(nullptr);
+
+    if (posix_spawn(&this->pid, argv[0], nullptr, nullptr, argv.data(),
+        environ) != 0)
+    {
+      this->pid = -1;
+    }
+  }
+
+  /// \brief Destructor, stops the process if it still runs.
+  public: ~WorkerProcess()
+  {
+    this->Stop();
+  }
+
+  /// \brief Interrupt the process and wait for it to exit.
+  /// \return True if the process exited normally with status 0.
+  public: bool Stop()
+  {
+    if (this->pid <= 0)
+      return false;
+
+    kill(this->pid, SIGTERM);
+    int status = 0;
+    pid_t result = waitpid(this->pid, &status, 0);
+    this->pid = -1;
+    return result > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  }
+
+  /// \brief Id of the process, -1 if it isn't running.
+  public: pid_t pid = -1;
+};
+#endif
+
+class ShardingTest: public testing::Test
+{
+};
+
+/////////////////////////////////////////////////
+TEST_F(ShardingTest, PlaceByLoad)
+{
+  const std::string ns = "/ignition/sensors/test/shards_load";
+  ignition::sensors::ShardWorker w1("w1", ns);
+  ignition::sensors::ShardWorker w2("w2", ns);
+  for (auto *worker : {&w1, &w2})
+  {
+    worker->SensorManager().AddPluginPaths(
+        ignition::common::joinPaths(PROJECT_BUILD_PATH, "lib"));
+    ASSERT_TRUE(worker->Start());
+  }
+
+  ignition::sensors::ShardCoordinator coordinator(ns);
+  EXPECT_EQ(ignition::sensors::ShardPlacement::BY_LOAD,
+      coordinator.Placement());
+  EXPECT_TRUE(coordinator.AddWorker("w1"));
+  EXPECT_TRUE(coordinator.AddWorker("w2"));
+  EXPECT_FALSE(coordinator.AddWorker("w1"));
+  EXPECT_FALSE(coordinator.AddWorker(""));
+  EXPECT_EQ(2u, coordinator.Workers().size());
+
+  const std::string topic1 = "/ignition/sensors/test/shards/imu1";
+  const std::string topic2 = "/ignition/sensors/test/shards/imu2";
+  ignition::sensors::SensorId id1 =
+      coordinator.CreateSensor(SensorToSDF("imu1", "imu", topic1));
+  ignition::sensors::SensorId id2 =
+      coordinator.CreateSensor(SensorToSDF("imu2", "imu", topic2));
+  ASSERT_NE(ignition::sensors::NO_SENSOR, id1);
+  ASSERT_NE(ignition::sensors::NO_SENSOR, id2);
+  EXPECT_NE(id1, id2);
+
+  // Equal loads are spread over the workers
+  EXPECT_FALSE(coordinator.SensorWorker(id1).empty());
+  EXPECT_FALSE(coordinator.SensorWorker(id2).empty());
+  EXPECT_NE(coordinator.SensorWorker(id1), coordinator.SensorWorker(id2));
+  EXPECT_TRUE(coordinator.SensorWorker(id2 + 1).empty());
+
+  // Sensors publish from the workers on their own topics
+  WaitForMessageTestHelper<ignition::msgs::IMU> msgHelper1(topic1);
+  WaitForMessageTestHelper<ignition::msgs::IMU> msgHelper2(topic2);
+
+  EXPECT_TRUE(coordinator.SetPose(id1,
+      ignition::math::Pose3d(1, 2, 3, 0, 0, 0)));
+  EXPECT_FALSE(coordinator.SetPose(id2 + 1, ignition::math::Pose3d::Zero));
+  coordinator.RunOnce(ignition::common::Time(1, 0), true);
+
+  EXPECT_TRUE(msgHelper1.WaitForMessage()) << msgHelper1;
+  EXPECT_TRUE(msgHelper2.WaitForMessage()) << msgHelper2;
+  EXPECT_EQ(1, msgHelper1.Message().header().stamp().sec());
+  EXPECT_EQ(1, msgHelper2.Message().header().stamp().sec());
+
+  ASSERT_TRUE(WaitForSteps(coordinator, 1u));
+  EXPECT_EQ(1u, w1.CompletedSteps());
+  EXPECT_EQ(1u, w2.CompletedSteps());
+
+  auto stats = coordinator.Statistics();
+  ASSERT_EQ(2u, stats.size());
+  for (const auto &workerStats : stats)
+  {
+    EXPECT_EQ(1u, workerStats.second.sensors);
+    EXPECT_DOUBLE_EQ(1000.0, workerStats.second.load);
+    EXPECT_EQ(ignition::common::Time(1, 0), workerStats.second.stepTime);
+    EXPECT_LE(0.0, workerStats.second.updateTime);
+  }
+
+  EXPECT_TRUE(coordinator.Remove(id1));
+  EXPECT_FALSE(coordinator.Remove(id1));
+  EXPECT_TRUE(coordinator.SensorWorker(id1).empty());
+
+  // The freed worker gets the next sensor
+  const std::string freed = coordinator.SensorWorker(id2) == "w1" ?
+      "w2" : "w1";
+  ignition::sensors::SensorId id3 = coordinator.CreateSensor(
+      SensorToSDF("imu3", "imu", "/ignition/sensors/test/shards/imu3"));
+  ASSERT_NE(ignition::sensors::NO_SENSOR, id3);
+  EXPECT_EQ(freed, coordinator.SensorWorker(id3));
+}
+
+/////////////////////////////////////////////////
+TEST_F(ShardingTest, PlaceByType)
+{
+  const std::string ns = "/ignition/sensors/test/shards_type";
+  ignition::sensors::ShardWorker w1("w1", ns);
+  ignition::sensors::ShardWorker w2("w2", ns);
+  for (auto *worker : {&w1, &w2})
+  {
+    worker->SensorManager().AddPluginPaths(
+        ignition::common::joinPaths(PROJECT_BUILD_PATH, "lib"));
+    ASSERT_TRUE(worker->Start());
+  }
+
+  ignition::sensors::ShardCoordinator coordinator(ns);
+  EXPECT_TRUE(coordinator.AddWorker("w1"));
+  EXPECT_TRUE(coordinator.AddWorker("w2"));
+  coordinator.SetPlacement(ignition::sensors::ShardPlacement::BY_TYPE);
+  EXPECT_EQ(ignition::sensors::ShardPlacement::BY_TYPE,
+      coordinator.Placement());
+  EXPECT_FALSE(coordinator.AssignType("altimeter", "w3"));
+  EXPECT_TRUE(coordinator.AssignType("altimeter", "w2"));
+
+  ignition::sensors::SensorId imu1 = coordinator.CreateSensor(
+      SensorToSDF("imu1", "imu", "/ignition/sensors/test/shards/t_imu1"));
+  ignition::sensors::SensorId imu2 = coordinator.CreateSensor(
+      SensorToSDF("imu2", "imu", "/ignition/sensors/test/shards/t_imu2"));
+  const std::string altTopic = "/ignition/sensors/test/shards/t_alt";
+  ignition::sensors::SensorId alt = coordinator.CreateSensor(
+      SensorToSDF("alt", "altimeter", altTopic));
+  ASSERT_NE(ignition::sensors::NO_SENSOR, imu1);
+  ASSERT_NE(ignition::sensors::NO_SENSOR, imu2);
+  ASSERT_NE(ignition::sensors::NO_SENSOR, alt);
+
+  // IMUs share the worker with the fewest types, away from altimeters
+  EXPECT_EQ("w1", coordinator.SensorWorker(imu1));
+  EXPECT_EQ("w1", coordinator.SensorWorker(imu2));
+  EXPECT_EQ("w2", coordinator.SensorWorker(alt));
+
+  WaitForMessageTestHelper<ignition::msgs::Altimeter> msgHelper(altTopic);
+  coordinator.RunOnce(ignition::common::Time(2, 0), true);
+  EXPECT_TRUE(msgHelper.WaitForMessage()) << msgHelper;
+  EXPECT_EQ(2, msgHelper.Message().header().stamp().sec());
+
+  ASSERT_TRUE(WaitForSteps(coordinator, 1u));
+  auto stats = coordinator.Statistics();
+  EXPECT_EQ(2u, stats["w1"].sensors);
+  EXPECT_EQ(1u, stats["w2"].sensors);
+}
+
+/////////////////////////////////////////////////
+#ifndef _WIN32
+TEST_F(ShardingTest, WorkerProcesses)
+#else
+TEST_F(ShardingTest, DISABLED_WorkerProcesses)
+#endif
+{
+#ifndef _WIN32
+  // Each worker is its own process, so the coordinator only reaches it
+  // through discovery
+  const std::string ns = "/ignition/sensors/test/shards_proc";
+  WorkerProcess p1("p1", ns);
+  WorkerProcess p2("p2", ns);
+  ASSERT_GT(p1.pid, 0);
+  ASSERT_GT(p2.pid, 0);
+
+  const std::string topic1 = "/ignition/sensors/test/shards/p_imu1";
+  const std::string topic2 = "/ignition/sensors/test/shards/p_imu2";
+  WaitForMessageTestHelper<ignition::msgs::IMU> msgHelper1(topic1);
+  WaitForMessageTestHelper<ignition::msgs::IMU> msgHelper2(topic2);
+
+  ignition::sensors::ShardCoordinator coordinator(ns);
+  EXPECT_TRUE(coordinator.AddWorker("p1"));
+  EXPECT_TRUE(coordinator.AddWorker("p2"));
+
+  // Creation waits for the services of the workers to be discovered
+  ignition::sensors::SensorId id1 =
+      coordinator.CreateSensor(SensorToSDF("imu1", "imu", topic1));
+  ignition::sensors::SensorId id2 =
+      coordinator.CreateSensor(SensorToSDF("imu2", "imu", topic2));
+  ASSERT_NE(ignition::sensors::NO_SENSOR, id1);
+  ASSERT_NE(ignition::sensors::NO_SENSOR, id2);
+  EXPECT_NE(coordinator.SensorWorker(id1), coordinator.SensorWorker(id2));
+
+  // Steps sent right after the sensors were created aren't lost
+  const uint64_t steps = 5u;
+  for (uint64_t i = 1u; i <= steps; ++i)
+    coordinator.RunOnce(ignition::common::Time(static_cast<int>(i), 0), true);
+
+  ASSERT_TRUE(WaitForSteps(coordinator, steps));
+  for (const auto &workerStats : coordinator.Statistics())
+  {
+    EXPECT_EQ(steps, workerStats.second.completedSteps)
+        << workerStats.first;
+    EXPECT_EQ(1u, workerStats.second.sensors) << workerStats.first;
+    EXPECT_EQ(ignition::common::Time(static_cast<int>(steps), 0),
+        workerStats.second.stepTime) << workerStats.first;
+  }
+
+  EXPECT_TRUE(msgHelper1.WaitForMessage()) << msgHelper1;
+  EXPECT_TRUE(msgHelper2.WaitForMessage()) << msgHelper2;
+
+  EXPECT_TRUE(coordinator.Remove(id1));
+  EXPECT_TRUE(p1.Stop());
+  EXPECT_TRUE(p2.Stop());
+#endif
+}
+
+/////////////////////////////////////////////////
+TEST_F(ShardingTest, NoWorkers)
+{
+  ignition::sensors::ShardCoordinator coordinator(
+      "/ignition/sensors/test/shards_none");
+  EXPECT_EQ(ignition::sensors::NO_SENSOR, coordinator.CreateSensor(
+      SensorToSDF("imu", "imu", "/ignition/sensors/test/shards/none")));
+  EXPECT_TRUE(coordinator.Statistics().empty());
+
+  // A worker that isn't running doesn't answer
+  EXPECT_TRUE(coordinator.AddWorker("missing"));
+  coordinator.SetRequestTimeout(100);
+  EXPECT_EQ(ignition::sensors::NO_SENSOR, coordinator.CreateSensor(
+      SensorToSDF("imu", "imu", "/ignition/sensors/test/shards/none")));
+  coordinator.RunOnce(ignition::common::Time(1, 0));
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}